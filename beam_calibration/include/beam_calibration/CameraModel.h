@@ -88,6 +88,36 @@ public:
    */
   virtual bool InProjectionDomain(const Eigen::Vector3d& point) = 0;
 
+  /**
+   * @brief Method for projecting many points at once. This is much faster
+   * than calling ProjectPoint on each point since it avoids a virtual call per
+   * point, and models override it with vectorized implementations that work
+   * on all points at once in single precision. The default implementation
+   * calls ProjectPoint on each point.
+   * @param[in] points 3d points to be projected, one [x,y,z]^T per column
+   * @param[out] pixels pixels the points project to [col, row], one per column
+   * @param[out] valid_mask 1 for each point that is in the projection domain
+   * and projects into the image plane (see PixelInImage), otherwise 0. Pixels
+   * of invalid points are undefined
+   */
+  virtual void ProjectPoints(const Eigen::Matrix3Xf& points,
+                             Eigen::Matrix2Xf& pixels,
+                             std::vector<uint8_t>& valid_mask);
+
+  /**
+   * @brief Method for back projecting many pixels at once, see ProjectPoints.
+   * Unlike BackProject, the pixels do not need to be integers. The default
+   * implementation rounds each pixel and calls BackProject.
+   * @param[in] pixels pixels to back project [col, row], one per column
+   * @param[out] rays rays towards the input pixels, one per column. These are
+   * not normalized, and have the same scale as the rays from BackProject
+   * @param[out] valid_mask 1 for each pixel that is in the back projection
+   * domain, otherwise 0. Rays of invalid pixels are undefined
+   */
+  virtual void BackProjectPixels(const Eigen::Matrix2Xf& pixels,
+                                 Eigen::Matrix3Xf& rays,
+                                 std::vector<uint8_t>& valid_mask);
+
   /**
    * @brief Method for setting the LadyBug camera ID
    * @param id of the camera to use
@@ -108,6 +138,61 @@ public:
   bool UndistortPixel(const Eigen::Vector2i& in_pixel,
                       Eigen::Vector2i& out_pixel);
 
+  /**
+   * @brief Create a table with the back projection of every pixel in the
+   * image (a W x H x 3 float table of bearing vectors, 12 bytes per pixel).
+   * Once created, BackProject of any pixel in the image is a lookup in this
+   * table instead of evaluating the model. Rays are the same as BackProject up
+   * to float precision, and pixels which cannot be back projected (or which
+   * back project to a ray that is not finite) are stored as invalid. The table
+   * is cleared if the intrinsics or image size are changed.
+   * @param num_threads number of threads used to fill the table. If <= 0,
+   * this will use all hardware threads. Ladybug models are always filled
+   * with one thread since the SDK is not thread safe
+   */
+  void InitBearingTable(int num_threads = 0);
+
+  /**
+   * @brief Write the bearing table to a binary file, so that it can be loaded
+   * at startup instead of being recomputed. This is usually stored next to
+   * the calibration json
+   * @param file_path full path to output file
+   * @return false if the table is not initialized or the file can't be written
+   */
+  bool WriteBearingTable(const std::string& file_path) const;
+
+  /**
+   * @brief Load a bearing table written by WriteBearingTable
+   * @param file_path full path to table file
+   * @return false if the file can't be read, or if it was written for a model
+   * with a different type, image size or intrinsics. In that case the current
+   * table is left unchanged
+   */
+  bool LoadBearingTable(const std::string& file_path);
+
+  /**
+   * @brief Returns true if the bearing table is initialized
+   */
+  bool HasBearingTable() const;
+
+  /**
+   * @brief Free the bearing table
+   */
+  void ClearBearingTable();
+
+  /**
+   * @brief Method for looking up a pixel in the bearing table. Derived
+   * classes call this at the start of BackProject, and it can be used to read
+   * the table directly without going through the virtual BackProject
+   * @param[in] in_pixel pixel to back project [col, row]
+   * @param[out] out_point ray towards the input pixel, only set if valid
+   * @param[out] in_domain whether the pixel can be back projected
+   * @return false if the table is not initialized or the pixel is outside the
+   * image, in which case the back projection needs to be computed
+   */
+  bool LookupBearing(const Eigen::Vector2i& in_pixel,
+                     Eigen::Vector3d& out_point, bool& in_domain) const;
+
   /**
    * @brief Returns a rectified camera model
    */
@@ -248,6 +333,18 @@ protected:
    */
   void OutputCameraTypes();
 
+  /**
+   * @brief Method for filling the valid mask of ProjectPoints from the
+   * projected pixels, this applies the same checks as PixelInImage
+   * @param u column of each pixel
+   * @param v row of each pixel
+   * @param in_domain whether each point is in the projection domain
+   * @param valid_mask output mask
+   */
+  void SetProjectionMask(const Eigen::ArrayXf& u, const Eigen::ArrayXf& v,
+                         const Eigen::Array<bool, Eigen::Dynamic, 1>& in_domain,
+                         std::vector<uint8_t>& valid_mask) const;
+
   std::shared_ptr<cv::Mat> pixel_map_;
   std::shared_ptr<CameraModel> rectified_model_;
 
@@ -260,6 +357,10 @@ protected:
   Eigen::VectorXd intrinsics_;
   bool undistort_map_initialized_{false};
 
+  // back projection of each pixel in row major order, x y z per pixel. NaN
+  // for pixels that can't be back projected. Empty if not initialized
+  std::vector<float> bearing_table_;
+
   unsigned int cam_id_ = 0;
 
   // Map for keeping required number of values in distortion vector
@@ -63,6 +63,21 @@ public:
    */
   bool InProjectionDomain(const Eigen::Vector3d& point) override;
 
+  /**
+   * @brief Vectorized projection of many points, see
+   * CameraModel::ProjectPoints
+   */
+  void ProjectPoints(const Eigen::Matrix3Xf& points, Eigen::Matrix2Xf& pixels,
+                     std::vector<uint8_t>& valid_mask) override;
+
+  /**
+   * @brief Vectorized back projection of many pixels, see
+   * CameraModel::BackProjectPixels. Uses the same recursive undistortion as
+   * BackProject, and pixels are invalid if the resulting ray is not finite
+   */
+  void BackProjectPixels(const Eigen::Matrix2Xf& pixels, Eigen::Matrix3Xf& rays,
+                         std::vector<uint8_t>& valid_mask) override;
+
 protected:
   void Distortion(const Eigen::Vector2d& p_u, Eigen::Vector2d& d_u) const;
 
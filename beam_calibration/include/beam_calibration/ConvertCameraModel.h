@@ -51,36 +51,25 @@ public:
 
   /**
    * @brief Converts an image taken with the source model to an image with the
-   * output_model
-   * @param source_image image to be converted
+   * output_model. This is a single remap with precomputed fixed-point maps, see
+   * cv::remap, so that the conversion is vectorized and split across threads
+   * by OpenCV. Output pixels which do not map to the source image are zero.
+   * @param source_image image to be converted, pointT must be its pixel type
+   * @param interpolation_method interpolation method used, see opencv remap
+   * function. Default is nearest neighbour, use cv::INTER_LINEAR for bilinear
+   * interpolation
    * @return output image of size output_height x output_width
    */
   template <typename pointT>
-  cv::Mat ConvertImage(const cv::Mat& source_image) {
-    // check dimensions are consistent
-    if (source_image.cols != src_width_ || source_image.rows != src_height_) {
-      BEAM_ERROR(
-          "Invalid source image dimensions. Required: {} x {}, given: {} x {}",
-          src_height_, src_width_, source_image.rows, source_image.cols);
-      throw std::runtime_error{"Invalid source image dimensions."};
+  cv::Mat ConvertImage(const cv::Mat& source_image,
+                       int interpolation_method = cv::INTER_NEAREST) {
+    if (sizeof(pointT) != source_image.elemSize()) {
+      BEAM_ERROR("Invalid source image type, pixel size is {} bytes but the "
+                 "requested type has {} bytes.",
+                 source_image.elemSize(), sizeof(pointT));
+      throw std::runtime_error{"Invalid source image type."};
     }
-
-    cv::Mat image_out(out_height_, out_width_, source_image.type());
-    for (int i = 0; i < out_height_; i++) {
-      for (int j = 0; j < out_width_; j++) {
-        int new_u = pixel_map_.at<cv::Vec2i>(i, j).val[0];
-        int new_v = pixel_map_.at<cv::Vec2i>(i, j).val[1];
-        pointT new_pixel_vals;
-        if (new_u < 0 || new_v < 0 || new_u > source_image.cols ||
-            new_v > source_image.rows) {
-          new_pixel_vals = pointT();
-        } else {
-          new_pixel_vals = source_image.at<pointT>(new_v, new_u);
-        }
-        image_out.at<pointT>(i, j) = new_pixel_vals;
-      }
-    }
-    return image_out;
+    return RemapImage(source_image, interpolation_method);
   }
 
   /**
@@ -124,16 +113,29 @@ private:
 
   /**
    * @brief This creates a map of dimensions equal to the output image
-   * dimensions, where each element in the map points to the pixel coordinates
-   * in the source image to copy to the new image. It sets the member variable
-   * pixel_map_
+   * dimensions, where each element in the map points to the (subpixel)
+   * coordinates in the source image to copy to the new image. Output pixels
+   * that don't map to the source image are set to -1. The map is computed
+   * with the batch projection functions of the camera models, with the rows
+   * split across threads, and is stored as the fixed-point maps map1_ and
+   * map2_ (see cv::convertMaps)
    * @param source_model camera model of source images to be converted
    * @param output_model camera model that output images will be transformed to
    */
   void CreatePixelMap(const std::shared_ptr<CameraModel>& source_model,
                       const std::shared_ptr<CameraModel>& output_model);
 
-  cv::Mat pixel_map_;
+  /**
+   * @brief remap an image with map1_ and map2_, see ConvertImage
+   */
+  cv::Mat RemapImage(const cv::Mat& source_image,
+                     int interpolation_method) const;
+
+  // fixed-point maps from output image to source image. map1_ is the integer
+  // source pixel (CV_16SC2) and map2_ the index of the fractional part in the
+  // interpolation tables (CV_16UC1)
+  cv::Mat map1_;
+  cv::Mat map2_;
   int src_height_;
   int src_width_;
   int src_model_height_;
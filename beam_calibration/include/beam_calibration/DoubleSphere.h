@@ -63,6 +63,20 @@ public:
    */
   bool InProjectionDomain(const Eigen::Vector3d& point) override;
 
+  /**
+   * @brief Vectorized projection of many points, see
+   * CameraModel::ProjectPoints
+   */
+  void ProjectPoints(const Eigen::Matrix3Xf& points, Eigen::Matrix2Xf& pixels,
+                     std::vector<uint8_t>& valid_mask) override;
+
+  /**
+   * @brief Vectorized back projection of many pixels, see
+   * CameraModel::BackProjectPixels
+   */
+  void BackProjectPixels(const Eigen::Matrix2Xf& pixels, Eigen::Matrix3Xf& rays,
+                         std::vector<uint8_t>& valid_mask) override;
+
 protected:
   double fx_;
   double fy_;
@@ -63,6 +63,24 @@ public:
    */
   bool InProjectionDomain(const Eigen::Vector3d& point) override;
 
+  /**
+   * @brief Vectorized projection of many points, see
+   * CameraModel::ProjectPoints. Unlike ProjectPoint, points on the optical
+   * axis project to the principal point
+   */
+  void ProjectPoints(const Eigen::Matrix3Xf& points, Eigen::Matrix2Xf& pixels,
+                     std::vector<uint8_t>& valid_mask) override;
+
+  /**
+   * @brief Vectorized back projection of many pixels, see
+   * CameraModel::BackProjectPixels. Theta is solved for with Newton's method
+   * on the polynomial directly, and pixels are invalid if this does not
+   * converge. Unlike BackProject, this means pixels outside the range of the
+   * polynomial are invalid
+   */
+  void BackProjectPixels(const Eigen::Matrix2Xf& pixels, Eigen::Matrix3Xf& rays,
+                         std::vector<uint8_t>& valid_mask) override;
+
 protected:
   double fx_;
   double fy_;
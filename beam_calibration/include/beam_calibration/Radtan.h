@@ -57,10 +57,12 @@ public:
                     std::shared_ptr<Eigen::MatrixXd> J = nullptr) override;
 
   /**
-   * @brief Method back projecting
+   * @brief Method back projecting. The pixel is undistorted using Newton's
+   * method on the distortion function
    * @param[in] in_pixel pixel to back project
    * @param[out] out_point ray towards the input pixel
-   * @return return whether the input pixel is in the domain of the function
+   * @return return whether the input pixel is in the domain of the function,
+   * i.e. whether the undistortion converged
    */
   bool BackProject(const Eigen::Vector2i& in_pixel,
                    Eigen::Vector3d& out_point) override;
@@ -79,6 +81,23 @@ public:
    */
   bool InProjectionDomain(const Eigen::Vector3d& point) override;
 
+  /**
+   * @brief Vectorized projection of many points, see
+   * CameraModel::ProjectPoints
+   */
+  void ProjectPoints(const Eigen::Matrix3Xf& points, Eigen::Matrix2Xf& pixels,
+                     std::vector<uint8_t>& valid_mask) override;
+
+  /**
+   * @brief Vectorized back projection of many pixels, see
+   * CameraModel::BackProjectPixels. Pixels are undistorted with the same
+   * Newton iterations as BackProject, and are invalid if these do not converge
+   * (which happens far outside the image, where the distortion model is not
+   * invertible)
+   */
+  void BackProjectPixels(const Eigen::Matrix2Xf& pixels, Eigen::Matrix3Xf& rays,
+                         std::vector<uint8_t>& valid_mask) override;
+
 protected:
   /**
    * @brief Method to distort point
@@ -1,16 +1,43 @@
 #include <beam_calibration/CameraModels.h>
 
 #include <chrono>
+#include <cmath>
+#include <cstring>
 #include <ctime>
+#include <limits>
 
 #include <boost/filesystem.hpp>
 #include <nlohmann/json.hpp>
 
 #include <beam_utils/log.h>
+#include <beam_utils/parallel.h>
 #include <beam_utils/pointclouds.h>
 
 namespace beam_calibration {
 
+namespace {
+
+/** first bytes of a bearing table file, followed by the format version */
+constexpr char k_bearing_table_magic[8] = {'B', 'E', 'A', 'M',
+                                           'B', 'R', 'N', 'G'};
+constexpr uint32_t k_bearing_table_version{1};
+
+/** image rows are split between threads when filling the bearing table */
+constexpr size_t k_min_bearing_rows_per_thread{16};
+
+template <typename T>
+void WriteBinary(std::ofstream& file, const T& value) {
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool ReadBinary(std::ifstream& file, T& value) {
+  file.read(reinterpret_cast<char*>(&value), sizeof(T));
+  return static_cast<bool>(file);
+}
+
+} // namespace
+
 std::shared_ptr<CameraModel> CameraModel::Create(std::string& file_location) {
   std::shared_ptr<CameraModel> camera_model;
 
@@ -109,6 +136,138 @@ bool CameraModel::UndistortPixel(const Eigen::Vector2i& in_pixel,
   return true;
 }
 
+void CameraModel::InitBearingTable(int num_threads) {
+  BEAM_INFO("Creating bearing table...");
+  // BackProject uses the table if it exists, so clear it first
+  ClearBearingTable();
+  std::vector<float> table(3 * static_cast<size_t>(image_width_) *
+                           image_height_);
+  if (type_ == CameraType::LADYBUG) { num_threads = 1; }
+  int n_threads = beam::GetNumThreads(num_threads, image_height_,
+                                      k_min_bearing_rows_per_thread);
+  beam::ParallelForChunks(
+      image_height_, n_threads,
+      [&](int /*thread_id*/, size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+          for (uint32_t col = 0; col < image_width_; col++) {
+            float* bearing = &table[3 * (row * image_width_ + col)];
+            Eigen::Vector3d ray;
+            if (BackProject(Eigen::Vector2i(col, row), ray) &&
+                ray.allFinite()) {
+              bearing[0] = ray[0];
+              bearing[1] = ray[1];
+              bearing[2] = ray[2];
+            } else {
+              std::fill(bearing, bearing + 3,
+                        std::numeric_limits<float>::quiet_NaN());
+            }
+          }
+        }
+      });
+  bearing_table_ = std::move(table);
+  BEAM_INFO("Done.");
+}
+
+bool CameraModel::WriteBearingTable(const std::string& file_path) const {
+  if (bearing_table_.empty()) {
+    BEAM_ERROR("Bearing table not initialized, cannot write to file.");
+    return false;
+  }
+  std::ofstream file(file_path, std::ios::binary);
+  if (!file) {
+    BEAM_ERROR("Cannot open bearing table file for writing: {}", file_path);
+    return false;
+  }
+  file.write(k_bearing_table_magic, sizeof(k_bearing_table_magic));
+  WriteBinary(file, k_bearing_table_version);
+  WriteBinary(file, static_cast<uint32_t>(type_));
+  WriteBinary(file, image_width_);
+  WriteBinary(file, image_height_);
+  WriteBinary(file, static_cast<uint32_t>(intrinsics_.size()));
+  for (Eigen::Index i = 0; i < intrinsics_.size(); i++) {
+    WriteBinary(file, intrinsics_[i]);
+  }
+  file.write(reinterpret_cast<const char*>(bearing_table_.data()),
+             bearing_table_.size() * sizeof(float));
+  if (!file) {
+    BEAM_ERROR("Error writing bearing table file: {}", file_path);
+    return false;
+  }
+  return true;
+}
+
+bool CameraModel::LoadBearingTable(const std::string& file_path) {
+  std::ifstream file(file_path, std::ios::binary);
+  if (!file) {
+    BEAM_ERROR("Cannot open bearing table file: {}", file_path);
+    return false;
+  }
+
+  // check the table was written for this model
+  char magic[sizeof(k_bearing_table_magic)];
+  uint32_t version, type, width, height, num_intrinsics;
+  file.read(magic, sizeof(magic));
+  if (!file ||
+      std::memcmp(magic, k_bearing_table_magic, sizeof(magic)) != 0 ||
+      !ReadBinary(file, version) || version != k_bearing_table_version) {
+    BEAM_ERROR("Invalid bearing table file: {}", file_path);
+    return false;
+  }
+  if (!ReadBinary(file, type) || !ReadBinary(file, width) ||
+      !ReadBinary(file, height) || !ReadBinary(file, num_intrinsics) ||
+      type != static_cast<uint32_t>(type_) || width != image_width_ ||
+      height != image_height_ ||
+      num_intrinsics != static_cast<uint32_t>(intrinsics_.size())) {
+    BEAM_ERROR("Bearing table file {} does not match the camera model type "
+               "or image size.",
+               file_path);
+    return false;
+  }
+  for (uint32_t i = 0; i < num_intrinsics; i++) {
+    double intrinsic;
+    if (!ReadBinary(file, intrinsic) || intrinsic != intrinsics_[i]) {
+      BEAM_ERROR("Bearing table file {} does not match the camera model "
+                 "intrinsics.",
+                 file_path);
+      return false;
+    }
+  }
+
+  std::vector<float> table(3 * static_cast<size_t>(width) * height);
+  file.read(reinterpret_cast<char*>(table.data()),
+            table.size() * sizeof(float));
+  if (!file) {
+    BEAM_ERROR("Bearing table file {} is truncated.", file_path);
+    return false;
+  }
+  bearing_table_ = std::move(table);
+  return true;
+}
+
+bool CameraModel::HasBearingTable() const {
+  return !bearing_table_.empty();
+}
+
+void CameraModel::ClearBearingTable() {
+  std::vector<float>().swap(bearing_table_);
+}
+
+bool CameraModel::LookupBearing(const Eigen::Vector2i& in_pixel,
+                                Eigen::Vector3d& out_point,
+                                bool& in_domain) const {
+  if (bearing_table_.empty() || in_pixel[0] < 0 || in_pixel[1] < 0 ||
+      in_pixel[0] >= static_cast<int>(image_width_) ||
+      in_pixel[1] >= static_cast<int>(image_height_)) {
+    return false;
+  }
+  const float* bearing =
+      &bearing_table_[3 * (static_cast<size_t>(in_pixel[1]) * image_width_ +
+                           in_pixel[0])];
+  in_domain = !std::isnan(bearing[0]);
+  if (in_domain) { out_point << bearing[0], bearing[1], bearing[2]; }
+  return true;
+}
+
 std::shared_ptr<CameraModel> CameraModel::GetRectifiedModel() {
   if (!rectified_model_) {
     Eigen::Matrix<double, 8, 1> intrinsics;
@@ -144,6 +303,7 @@ void CameraModel::SetCalibrationDate(const std::string& date) {
 void CameraModel::SetImageDims(const uint32_t height, const uint32_t width) {
   image_width_ = width;
   image_height_ = height;
+  ClearBearingTable();
 }
 
 Eigen::Matrix3d CameraModel::GetIntrinsicMatrix() {
@@ -170,6 +330,7 @@ void CameraModel::SetIntrinsics(const Eigen::VectorXd& intrinsics) {
         "Invalid number of elements in intrinsics vector."};
   } else {
     intrinsics_ = intrinsics;
+    ClearBearingTable();
   }
 }
 
@@ -224,6 +385,58 @@ bool CameraModel::PixelInImage(const Eigen::Vector2d& pixel) {
   return true;
 }
 
+void CameraModel::ProjectPoints(const Eigen::Matrix3Xf& points,
+                                Eigen::Matrix2Xf& pixels,
+                                std::vector<uint8_t>& valid_mask) {
+  pixels.resize(2, points.cols());
+  valid_mask.assign(points.cols(), 0);
+  for (Eigen::Index i = 0; i < points.cols(); i++) {
+    Eigen::Vector2d pixel(0, 0);
+    bool in_image_plane = false;
+    if (ProjectPoint(points.col(i).cast<double>(), pixel, in_image_plane)) {
+      valid_mask[i] = in_image_plane;
+    }
+    pixels.col(i) = pixel.cast<float>();
+  }
+}
+
+void CameraModel::BackProjectPixels(const Eigen::Matrix2Xf& pixels,
+                                    Eigen::Matrix3Xf& rays,
+                                    std::vector<uint8_t>& valid_mask) {
+  rays.resize(3, pixels.cols());
+  valid_mask.assign(pixels.cols(), 0);
+  for (Eigen::Index i = 0; i < pixels.cols(); i++) {
+    Eigen::Vector2i pixel(std::round(pixels(0, i)), std::round(pixels(1, i)));
+    Eigen::Vector3d ray(0, 0, 0);
+    valid_mask[i] = BackProject(pixel, ray);
+    rays.col(i) = ray.cast<float>();
+  }
+}
+
+void CameraModel::SetProjectionMask(
+    const Eigen::ArrayXf& u, const Eigen::ArrayXf& v,
+    const Eigen::Array<bool, Eigen::Dynamic, 1>& in_domain,
+    std::vector<uint8_t>& valid_mask) const {
+  const float max_u = static_cast<float>(image_width_) - 1;
+  const float max_v = static_cast<float>(image_height_) - 1;
+  const float cx = intrinsics_[2];
+  const float cy = intrinsics_[3];
+  const float r2_max =
+      static_cast<float>(safe_projection_radius_) * safe_projection_radius_;
+  valid_mask.resize(u.size());
+  for (Eigen::Index i = 0; i < u.size(); i++) {
+    // written so that NaN pixels are invalid
+    bool valid = in_domain[i] && u[i] >= 0 && v[i] >= 0 && u[i] <= max_u &&
+                 v[i] <= max_v;
+    if (valid && safe_projection_radius_ > 0) {
+      float du = u[i] - cx;
+      float dv = v[i] - cy;
+      valid = du * du + dv * dv <= r2_max;
+    }
+    valid_mask[i] = valid;
+  }
+}
+
 void CameraModel::LoadJSON(const std::string& file_location) {
   // load file
   nlohmann::json J;
@@ -2,6 +2,13 @@
 
 namespace beam_calibration {
 
+namespace {
+
+/** number of iterations of the recursive distortion model in BackProject */
+constexpr int k_undistort_iterations{8};
+
+} // namespace
+
 Cataditropic::Cataditropic(const std::string& file_path) {
   type_ = CameraType::CATADITROPIC;
   LoadJSON(file_path);
@@ -59,6 +66,9 @@ bool Cataditropic::ProjectPoint(const Eigen::Vector3d& in_point,
 
 bool Cataditropic::BackProject(const Eigen::Vector2i& in_pixel,
                                Eigen::Vector3d& out_point) {
+  bool in_domain;
+  if (LookupBearing(in_pixel, out_point, in_domain)) { return in_domain; }
+
   double mx_d, my_d, mx_u, my_u, rho2_d;
   // double lambda;
 
@@ -67,7 +77,7 @@ bool Cataditropic::BackProject(const Eigen::Vector2i& in_pixel,
   my_d = m_inv_K22 * in_pixel(1) + m_inv_K23;
 
   // Recursive distortion model
-  int n = 8;
+  int n = k_undistort_iterations;
   Eigen::Vector2d d_u;
   this->Distortion(Eigen::Vector2d(mx_d, my_d), d_u);
   // Approximate value
@@ -111,4 +121,85 @@ void Cataditropic::Distortion(const Eigen::Vector2d& p_u,
       p_u(1) * rad_dist_u + 2.0 * p2_ * mxy_u + p1_ * (rho2_u + 2.0 * my2_u);
 }
 
+void Cataditropic::ProjectPoints(const Eigen::Matrix3Xf& points,
+                                 Eigen::Matrix2Xf& pixels,
+                                 std::vector<uint8_t>& valid_mask) {
+  const float fx = fx_, fy = fy_, cx = cx_, cy = cy_, xi = xi_;
+  const float k1 = k1_, k2 = k2_, p1 = p1_, p2 = p2_;
+
+  // copy each coordinate to a contiguous array so that all operations below
+  // are vectorized
+  const Eigen::ArrayXf x = points.row(0).transpose();
+  const Eigen::ArrayXf y = points.row(1).transpose();
+  const Eigen::ArrayXf z = points.row(2).transpose();
+
+  // project points to the normalised plane
+  const Eigen::ArrayXf z_inv =
+      (z + xi * (x.square() + y.square() + z.square()).sqrt()).inverse();
+  const Eigen::ArrayXf mx = x * z_inv;
+  const Eigen::ArrayXf my = y * z_inv;
+
+  // apply distortion, same as Distortion
+  const Eigen::ArrayXf mx2 = mx.square();
+  const Eigen::ArrayXf my2 = my.square();
+  const Eigen::ArrayXf mxy = mx * my;
+  const Eigen::ArrayXf rho2 = mx2 + my2;
+  const Eigen::ArrayXf rad_dist = rho2 * (k1 + k2 * rho2);
+  const Eigen::ArrayXf u =
+      fx * (mx + mx * rad_dist + 2 * p1 * mxy + p2 * (rho2 + 2 * mx2)) + cx;
+  const Eigen::ArrayXf v =
+      fy * (my + my * rad_dist + 2 * p2 * mxy + p1 * (rho2 + 2 * my2)) + cy;
+
+  pixels.resize(2, points.cols());
+  pixels.row(0) = u.transpose();
+  pixels.row(1) = v.transpose();
+  SetProjectionMask(u, v, z >= 0, valid_mask);
+}
+
+void Cataditropic::BackProjectPixels(const Eigen::Matrix2Xf& pixels,
+                                     Eigen::Matrix3Xf& rays,
+                                     std::vector<uint8_t>& valid_mask) {
+  const float k1 = k1_, k2 = k2_, p1 = p1_, p2 = p2_, xi = xi_;
+  const float inv_K11 = m_inv_K11, inv_K13 = m_inv_K13;
+  const float inv_K22 = m_inv_K22, inv_K23 = m_inv_K23;
+
+  // lift points to normalised plane
+  const Eigen::ArrayXf mx_d = inv_K11 * pixels.row(0).transpose().array() +
+                              inv_K13;
+  const Eigen::ArrayXf my_d = inv_K22 * pixels.row(1).transpose().array() +
+                              inv_K23;
+
+  // recursive distortion model, same as BackProject
+  Eigen::ArrayXf mx_u = mx_d;
+  Eigen::ArrayXf my_u = my_d;
+  Eigen::ArrayXf mx2, my2, mxy, rho2, rad_dist;
+  for (int i = 0; i < k_undistort_iterations; i++) {
+    mx2 = mx_u.square();
+    my2 = my_u.square();
+    mxy = mx_u * my_u;
+    rho2 = mx2 + my2;
+    rad_dist = rho2 * (k1 + k2 * rho2);
+    mx_u = mx_d - (mx_u * rad_dist + 2 * p1 * mxy + p2 * (rho2 + 2 * mx2));
+    my_u = my_d - (my_u * rad_dist + 2 * p2 * mxy + p1 * (rho2 + 2 * my2));
+  }
+
+  // obtain a projective ray
+  rho2 = mx_u.square() + my_u.square();
+  rays.resize(3, pixels.cols());
+  rays.row(0) = mx_u.transpose();
+  rays.row(1) = my_u.transpose();
+  if (xi_ == 1.0) {
+    rays.row(2) = ((1 - rho2) / 2).transpose();
+  } else {
+    rays.row(2) =
+        (1 - xi * (rho2 + 1) / (xi + (1 + (1 - xi * xi) * rho2).sqrt()))
+            .transpose();
+  }
+
+  valid_mask.resize(pixels.cols());
+  for (Eigen::Index i = 0; i < pixels.cols(); i++) {
+    valid_mask[i] = rays.col(i).allFinite();
+  }
+}
+
 } // namespace beam_calibration
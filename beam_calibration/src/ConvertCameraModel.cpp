@@ -1,8 +1,17 @@
 #include <beam_calibration/ConvertCameraModel.h>
+
 #include <beam_calibration/Radtan.h>
+#include <beam_utils/parallel.h>
 
 namespace beam_calibration {
 
+namespace {
+
+/** output rows are split between threads when creating the pixel map */
+constexpr size_t k_min_map_rows_per_thread{16};
+
+} // namespace
+
 ConvertCameraModel::ConvertCameraModel(
     const std::shared_ptr<CameraModel>& source_model,
     const Eigen::Vector2i& source_image_size,
@@ -15,9 +24,10 @@ ConvertCameraModel::ConvertCameraModel(
   src_model_width_ = source_model->GetWidth();
   src_model_height_ = source_model->GetHeight();
 
-  // check to make sure integer overflow will not occur
-  if (src_width_ > std::numeric_limits<int32_t>::max() ||
-      src_height_ > std::numeric_limits<int32_t>::max()) {
+  // check to make sure integer overflow will not occur, the fixed-point maps
+  // store source pixel coordinates as 16 bit integers
+  if (src_width_ > std::numeric_limits<int16_t>::max() ||
+      src_height_ > std::numeric_limits<int16_t>::max()) {
     throw std::invalid_argument{"Input image too large."};
   }
 
@@ -85,49 +95,78 @@ void ConvertCameraModel::CreatePixelMap(
     const std::shared_ptr<CameraModel>& output_model) {
   BEAM_INFO("Creating distortion map...");
 
-  pixel_map_ = cv::Mat(out_height_, out_width_, CV_32SC2);
-  // take into account the size of the output image relative to the output model
-  int u_start = (output_model->GetWidth() - out_width_) / 2;
-  int v_start = (output_model->GetHeight() - out_height_) / 2;
-  for (int i = 0; i < out_height_; i++) {
-    for (int j = 0; j < out_width_; j++) {
-      Eigen::Vector3d point_back_projected;
-      if (!output_model->BackProject(Eigen::Vector2i(j + u_start, i + v_start),
-                                     point_back_projected)) {
-        pixel_map_.at<cv::Vec2i>(i, j).val[0] = -1;
-        pixel_map_.at<cv::Vec2i>(i, j).val[1] = -1;
-        continue;
-      }
-
-      Eigen::Vector2d point_projected;
-      bool in_image_plane = false;
-      if (!source_model->ProjectPoint(point_back_projected, point_projected,
-                                      in_image_plane)) {
-        pixel_map_.at<cv::Vec2i>(i, j).val[0] = -1;
-        pixel_map_.at<cv::Vec2i>(i, j).val[1] = -1;
-        continue;
-      }
-      if (in_image_plane) {
-        // take into account the size of the input image relative to the input
-        // model
-        int new_u =
-            point_projected[0] - (source_model->GetWidth() - src_width_) / 2;
-        int new_v =
-            point_projected[1] - (source_model->GetHeight() - src_height_) / 2;
-
-        if (new_u < 0 || new_v < 0 || new_u > src_width_ ||
-            new_v > src_height_) {
-          pixel_map_.at<cv::Vec2i>(i, j).val[0] = -1;
-          pixel_map_.at<cv::Vec2i>(i, j).val[1] = -1;
-          continue;
+  cv::Mat map_x(out_height_, out_width_, CV_32FC1);
+  cv::Mat map_y(out_height_, out_width_, CV_32FC1);
+
+  // take into account the size of the output image relative to the output
+  // model, and the size of the input image relative to the input model
+  int u_start = (static_cast<int>(output_model->GetWidth()) - out_width_) / 2;
+  int v_start = (static_cast<int>(output_model->GetHeight()) - out_height_) / 2;
+  int u_offset = (static_cast<int>(source_model->GetWidth()) - src_width_) / 2;
+  int v_offset =
+      (static_cast<int>(source_model->GetHeight()) - src_height_) / 2;
+
+  // the ladybug SDK is not thread safe
+  int n_threads = 0;
+  if (source_model->GetType() == CameraType::LADYBUG ||
+      output_model->GetType() == CameraType::LADYBUG) {
+    n_threads = 1;
+  }
+  n_threads = beam::GetNumThreads(n_threads, out_height_,
+                                  k_min_map_rows_per_thread);
+  beam::ParallelForChunks(
+      out_height_, n_threads, [&](int /*thread_id*/, size_t begin, size_t end) {
+        Eigen::Matrix2Xf output_pixels(2, out_width_);
+        Eigen::Matrix3Xf rays;
+        Eigen::Matrix2Xf source_pixels;
+        std::vector<uint8_t> back_project_mask;
+        std::vector<uint8_t> project_mask;
+        for (size_t i = begin; i < end; i++) {
+          for (int j = 0; j < out_width_; j++) {
+            output_pixels(0, j) = j + u_start;
+            output_pixels(1, j) = static_cast<int>(i) + v_start;
+          }
+          output_model->BackProjectPixels(output_pixels, rays,
+                                          back_project_mask);
+          source_model->ProjectPoints(rays, source_pixels, project_mask);
+
+          float* row_x = map_x.ptr<float>(i);
+          float* row_y = map_y.ptr<float>(i);
+          for (int j = 0; j < out_width_; j++) {
+            float new_u = source_pixels(0, j) - u_offset;
+            float new_v = source_pixels(1, j) - v_offset;
+            if (!back_project_mask[j] || !project_mask[j] || new_u < 0 ||
+                new_v < 0 || new_u > src_width_ - 1 ||
+                new_v > src_height_ - 1) {
+              row_x[j] = -1;
+              row_y[j] = -1;
+              continue;
+            }
+            row_x[j] = new_u;
+            row_y[j] = new_v;
+          }
         }
+      });
 
-        pixel_map_.at<cv::Vec2i>(i, j).val[0] = new_u;
-        pixel_map_.at<cv::Vec2i>(i, j).val[1] = new_v;
-      }
-    }
-  }
+  // fixed-point maps are faster to remap with than float maps
+  cv::convertMaps(map_x, map_y, map1_, map2_, CV_16SC2);
   BEAM_INFO("Done.");
 }
 
+cv::Mat ConvertCameraModel::RemapImage(const cv::Mat& source_image,
+                                       int interpolation_method) const {
+  // check dimensions are consistent
+  if (source_image.cols != src_width_ || source_image.rows != src_height_) {
+    BEAM_ERROR(
+        "Invalid source image dimensions. Required: {} x {}, given: {} x {}",
+        src_height_, src_width_, source_image.rows, source_image.cols);
+    throw std::runtime_error{"Invalid source image dimensions."};
+  }
+
+  cv::Mat image_out;
+  cv::remap(source_image, image_out, map1_, map2_, interpolation_method,
+            cv::BORDER_CONSTANT, cv::Scalar::all(0));
+  return image_out;
+}
+
 } // namespace beam_calibration
\ No newline at end of file
@@ -80,6 +80,9 @@ bool DoubleSphere::ProjectPoint(const Eigen::Vector3d& in_point,
 
 bool DoubleSphere::BackProject(const Eigen::Vector2i& in_pixel,
                                Eigen::Vector3d& out_point) {
+  bool in_domain;
+  if (LookupBearing(in_pixel, out_point, in_domain)) { return in_domain; }
+
   double mx = (in_pixel[0] - cx_) / fx_;
   double my = (in_pixel[1] - cy_) / fy_;
   double r2 = mx * mx + my * my;
@@ -114,4 +117,63 @@ bool DoubleSphere::InProjectionDomain(const Eigen::Vector3d& point) {
   return true;
 }
 
+void DoubleSphere::ProjectPoints(const Eigen::Matrix3Xf& points,
+                                 Eigen::Matrix2Xf& pixels,
+                                 std::vector<uint8_t>& valid_mask) {
+  const float fx = fx_, fy = fy_, cx = cx_, cy = cy_;
+  const float eps = eps_, alpha = alpha_;
+
+  // copy each coordinate to a contiguous array so that all operations below
+  // are vectorized
+  const Eigen::ArrayXf x = points.row(0).transpose();
+  const Eigen::ArrayXf y = points.row(1).transpose();
+  const Eigen::ArrayXf z = points.row(2).transpose();
+  const Eigen::ArrayXf xy2 = x.square() + y.square();
+  const Eigen::ArrayXf d1 = (xy2 + z.square()).sqrt();
+  const Eigen::ArrayXf ez = eps * d1 + z;
+  const Eigen::ArrayXf d2 = (xy2 + ez.square()).sqrt();
+  const Eigen::ArrayXf denom_inv = (alpha * d2 + (1 - alpha) * ez).inverse();
+  const Eigen::ArrayXf u = fx * x * denom_inv + cx;
+  const Eigen::ArrayXf v = fy * y * denom_inv + cy;
+
+  // same as InProjectionDomain
+  double w1 = alpha_ > 0.5 ? (1 - alpha_) / alpha_ : alpha_ / (1 - alpha_);
+  const float w2 = (w1 + eps_) / sqrt(2 * w1 * eps_ + eps_ * eps_ + 1);
+
+  pixels.resize(2, points.cols());
+  pixels.row(0) = u.transpose();
+  pixels.row(1) = v.transpose();
+  SetProjectionMask(u, v, z > -w2 * d1, valid_mask);
+}
+
+void DoubleSphere::BackProjectPixels(const Eigen::Matrix2Xf& pixels,
+                                     Eigen::Matrix3Xf& rays,
+                                     std::vector<uint8_t>& valid_mask) {
+  const float fx = fx_, fy = fy_, cx = cx_, cy = cy_;
+  const float eps = eps_, alpha = alpha_;
+  const Eigen::ArrayXf mx = (pixels.row(0).transpose().array() - cx) / fx;
+  const Eigen::ArrayXf my = (pixels.row(1).transpose().array() - cy) / fy;
+  const Eigen::ArrayXf r2 = mx.square() + my.square();
+  const Eigen::ArrayXf mz =
+      (1 - alpha * alpha * r2) /
+      (alpha * (1 - (2 * alpha - 1) * r2).sqrt() + 1 - alpha);
+  const Eigen::ArrayXf A =
+      (mz * eps + (mz.square() + (1 - eps * eps) * r2).sqrt()) /
+      (mz.square() + r2);
+
+  rays.resize(3, pixels.cols());
+  rays.row(0) = (A * mx).transpose();
+  rays.row(1) = (A * my).transpose();
+  rays.row(2) = (A * mz - eps).transpose();
+
+  // check pixels are valid for back projection, same as BackProject
+  if (alpha_ > 0.5) {
+    const float max_r2 = 1 / (2 * alpha_ - 1);
+    const Eigen::Array<bool, Eigen::Dynamic, 1> valid = r2 <= max_r2;
+    valid_mask.assign(valid.data(), valid.data() + valid.size());
+  } else {
+    valid_mask.assign(pixels.cols(), 1);
+  }
+}
+
 } // namespace beam_calibration
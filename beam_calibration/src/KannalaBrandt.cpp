@@ -2,6 +2,16 @@
 
 namespace beam_calibration {
 
+namespace {
+
+/** number of Newton iterations used to solve for theta in BackProjectPixels */
+constexpr int k_back_project_iterations{10};
+
+/** max error in pixels of a back projected pixel when projected again */
+constexpr float k_max_back_project_error_px{0.01};
+
+} // namespace
+
 KannalaBrandt::KannalaBrandt(const std::string& file_path) {
   type_ = CameraType::KANNALABRANDT;
   LoadJSON(file_path);
@@ -109,6 +119,9 @@ bool KannalaBrandt::ProjectPoint(const Eigen::Vector3d& in_point,
 
 bool KannalaBrandt::BackProject(const Eigen::Vector2i& in_pixel,
                                 Eigen::Vector3d& out_point) {
+  bool in_domain;
+  if (LookupBearing(in_pixel, out_point, in_domain)) { return in_domain; }
+
   double u = in_pixel[0], v = in_pixel[1];
   double mx = (u - cx_) / fx_, my = (v - cy_) / fy_;
   double ru = sqrt((mx * mx) + (my * my));
@@ -146,4 +159,71 @@ bool KannalaBrandt::InProjectionDomain(const Eigen::Vector3d& point) {
   return true;
 }
 
+void KannalaBrandt::ProjectPoints(const Eigen::Matrix3Xf& points,
+                                  Eigen::Matrix2Xf& pixels,
+                                  std::vector<uint8_t>& valid_mask) {
+  const float fx = fx_, fy = fy_, cx = cx_, cy = cy_;
+  const float k1 = k1_, k2 = k2_, k3 = k3_, k4 = k4_;
+
+  // copy each coordinate to a contiguous array so that all operations below
+  // are vectorized
+  const Eigen::ArrayXf x = points.row(0).transpose();
+  const Eigen::ArrayXf y = points.row(1).transpose();
+  const Eigen::ArrayXf z = points.row(2).transpose();
+  const Eigen::ArrayXf r = (x.square() + y.square()).sqrt();
+  const Eigen::ArrayXf th = (r / z).atan();
+  const Eigen::ArrayXf th2 = th.square();
+  const Eigen::ArrayXf d =
+      th * (1 + th2 * (k1 + th2 * (k2 + th2 * (k3 + th2 * k4))));
+
+  // d / r goes to 1 / z on the optical axis
+  const Eigen::ArrayXf scale = (r > 0).select(d / r, z.inverse());
+  const Eigen::ArrayXf u = fx * scale * x + cx;
+  const Eigen::ArrayXf v = fy * scale * y + cy;
+
+  pixels.resize(2, points.cols());
+  pixels.row(0) = u.transpose();
+  pixels.row(1) = v.transpose();
+  SetProjectionMask(u, v, z != 0, valid_mask);
+}
+
+void KannalaBrandt::BackProjectPixels(const Eigen::Matrix2Xf& pixels,
+                                      Eigen::Matrix3Xf& rays,
+                                      std::vector<uint8_t>& valid_mask) {
+  const float fx = fx_, fy = fy_, cx = cx_, cy = cy_;
+  const float k1 = k1_, k2 = k2_, k3 = k3_, k4 = k4_;
+  const Eigen::ArrayXf mx = (pixels.row(0).transpose().array() - cx) / fx;
+  const Eigen::ArrayXf my = (pixels.row(1).transpose().array() - cy) / fy;
+  const Eigen::ArrayXf ru = (mx.square() + my.square()).sqrt();
+
+  // solve d(th) = ru with Newton's method
+  Eigen::ArrayXf th = ru;
+  Eigen::ArrayXf th2, error, derivative;
+  auto compute_error = [&]() {
+    th2 = th.square();
+    error = th * (1 + th2 * (k1 + th2 * (k2 + th2 * (k3 + th2 * k4)))) - ru;
+    derivative =
+        1 + th2 * (3 * k1 + th2 * (5 * k2 + th2 * (7 * k3 + th2 * 9 * k4)));
+  };
+  compute_error();
+  for (int i = 0; i < k_back_project_iterations; i++) {
+    th -= error / derivative;
+    compute_error();
+  }
+
+  // the x and y scale goes to 1 at the principal point, where mx = my = 0
+  const Eigen::ArrayXf scale = (ru > 0).select(th.sin() / ru, 1.0f);
+  rays.resize(3, pixels.cols());
+  rays.row(0) = (scale * mx).transpose();
+  rays.row(1) = (scale * my).transpose();
+  rays.row(2) = th.cos().transpose();
+
+  // pixels far from the center can be outside the range of d(th), or converge
+  // to a solution past the max of d(th) which is not physical. Written so
+  // that NaN errors are invalid
+  const Eigen::Array<bool, Eigen::Dynamic, 1> valid =
+      (fx * error).abs() <= k_max_back_project_error_px && derivative > 0;
+  valid_mask.assign(valid.data(), valid.data() + valid.size());
+}
+
 } // namespace beam_calibration
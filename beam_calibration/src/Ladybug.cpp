@@ -74,6 +74,9 @@ bool Ladybug::ProjectPoint(const Eigen::Vector3d& in_point,
 
 bool Ladybug::BackProject(const Eigen::Vector2i& in_pixel,
                           Eigen::Vector3d& out_point) {
+  bool in_domain;
+  if (LookupBearing(in_pixel, out_point, in_domain)) { return in_domain; }
+
   Eigen::Vector2d pixel_out = {0, 0};
   lb_error_ = ladybugRectifyPixel(lb_context_, cam_id_, in_pixel[0],
                                   in_pixel[1], &pixel_out[0], &pixel_out[1]);
@@ -93,6 +96,7 @@ void Ladybug::SetCameraID(unsigned int id) {
   LadybugCheckError();
 
   intrinsics_ << focal_length_, focal_length_, cx_, cy_;
+  ClearBearingTable();
 }
 
 void Ladybug::LadybugCheckError() {
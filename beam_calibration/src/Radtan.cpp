@@ -2,6 +2,16 @@
 
 namespace beam_calibration {
 
+namespace {
+
+/** number of Newton iterations used to undistort pixels */
+constexpr int k_undistort_iterations{10};
+
+/** max error in pixels of an undistorted pixel when distorted again */
+constexpr double k_max_undistort_error_px{0.01};
+
+} // namespace
+
 Radtan::Radtan(const std::string& file_path) {
   type_ = CameraType::RADTAN;
   LoadJSON(file_path);
@@ -88,20 +98,29 @@ bool Radtan::ProjectPoint(const Eigen::Vector3d& in_point,
 
 bool Radtan::BackProject(const Eigen::Vector2i& in_pixel,
                          Eigen::Vector3d& out_point) {
-  cv::Point2f p(in_pixel[0], in_pixel[1]);
-  std::vector<cv::Point2f> src = {p};
-  std::vector<cv::Point2f> dst;
+  bool in_domain;
+  if (LookupBearing(in_pixel, out_point, in_domain)) { return in_domain; }
 
-  Eigen::Matrix3d camera_matrix;
-  camera_matrix << fx_, 0, cx_, 0, fy_, cy_, 0, 0, 1;
-  cv::Mat K(3, 3, CV_32F);
-  cv::eigen2cv(camera_matrix, K);
+  const Eigen::Vector2d distorted((in_pixel[0] - cx_) / fx_,
+                                  (in_pixel[1] - cy_) / fy_);
 
-  std::vector<double> dist_coeffs = {k1_, k2_, p1_, p2_};
-  // undistort points automatically normalizes the output
-  cv::undistortPoints(src, dst, K, dist_coeffs);
+  // solve DistortPixel(undistorted) = distorted with Newton's method, starting
+  // from the distorted point
+  Eigen::Vector2d undistorted = distorted;
+  Eigen::Vector2d error = DistortPixel(undistorted) - distorted;
+  for (int i = 0; i < k_undistort_iterations; i++) {
+    undistorted -= ComputeDistortionJacobian(undistorted).inverse() * error;
+    error = DistortPixel(undistorted) - distorted;
+  }
 
-  out_point << dst[0].x, dst[0].y, 1;
+  // error is in normalized coordinates, convert to pixels
+  double error_u = fx_ * error[0];
+  double error_v = fy_ * error[1];
+  if (!(error_u * error_u + error_v * error_v <=
+        k_max_undistort_error_px * k_max_undistort_error_px)) {
+    return false;
+  }
+  out_point << undistorted[0], undistorted[1], 1;
   return true;
 }
 
@@ -111,6 +130,84 @@ bool Radtan::InProjectionDomain(const Eigen::Vector3d& point) {
   return true;
 }
 
+void Radtan::ProjectPoints(const Eigen::Matrix3Xf& points,
+                           Eigen::Matrix2Xf& pixels,
+                           std::vector<uint8_t>& valid_mask) {
+  const float fx = fx_, fy = fy_, cx = cx_, cy = cy_;
+  const float k1 = k1_, k2 = k2_, p1 = p1_, p2 = p2_;
+
+  // copy each coordinate to a contiguous array so that all operations below
+  // are vectorized
+  const Eigen::ArrayXf z = points.row(2).transpose();
+  const Eigen::ArrayXf rz = z.inverse();
+  const Eigen::ArrayXf x = points.row(0).transpose().array() * rz;
+  const Eigen::ArrayXf y = points.row(1).transpose().array() * rz;
+
+  // same as DistortPixel
+  const Eigen::ArrayXf x2 = x.square();
+  const Eigen::ArrayXf y2 = y.square();
+  const Eigen::ArrayXf xy = x * y;
+  const Eigen::ArrayXf r2 = x2 + y2;
+  const Eigen::ArrayXf rad_dist = r2 * (k1 + k2 * r2);
+  const Eigen::ArrayXf u =
+      fx * (x + x * rad_dist + 2 * p1 * xy + p2 * (r2 + 2 * x2)) + cx;
+  const Eigen::ArrayXf v =
+      fy * (y + y * rad_dist + 2 * p2 * xy + p1 * (r2 + 2 * y2)) + cy;
+
+  pixels.resize(2, points.cols());
+  pixels.row(0) = u.transpose();
+  pixels.row(1) = v.transpose();
+  SetProjectionMask(u, v, z > 0, valid_mask);
+}
+
+void Radtan::BackProjectPixels(const Eigen::Matrix2Xf& pixels,
+                               Eigen::Matrix3Xf& rays,
+                               std::vector<uint8_t>& valid_mask) {
+  const float fx = fx_, fy = fy_, cx = cx_, cy = cy_;
+  const float k1 = k1_, k2 = k2_, p1 = p1_, p2 = p2_;
+  const Eigen::ArrayXf x_d = (pixels.row(0).transpose().array() - cx) / fx;
+  const Eigen::ArrayXf y_d = (pixels.row(1).transpose().array() - cy) / fy;
+
+  // same Newton iterations as BackProject, with the distortion and its
+  // jacobian written out so that they are vectorized over all pixels
+  Eigen::ArrayXf x = x_d;
+  Eigen::ArrayXf y = y_d;
+  Eigen::ArrayXf x2, y2, xy, r2, rad_dist, error_x, error_y;
+  Eigen::ArrayXf dxdx, dxdy, dydy, det;
+  auto compute_error = [&]() {
+    x2 = x.square();
+    y2 = y.square();
+    xy = x * y;
+    r2 = x2 + y2;
+    rad_dist = r2 * (k1 + k2 * r2);
+    error_x = x + x * rad_dist + 2 * p1 * xy + p2 * (r2 + 2 * x2) - x_d;
+    error_y = y + y * rad_dist + 2 * p2 * xy + p1 * (r2 + 2 * y2) - y_d;
+  };
+  compute_error();
+  for (int i = 0; i < k_undistort_iterations; i++) {
+    dxdx = 1 + rad_dist + 2 * k1 * x2 + 4 * k2 * r2 * x2 + 2 * p1 * y +
+           6 * p2 * x;
+    dxdy = 2 * k1 * xy + 4 * k2 * r2 * xy + 2 * p1 * x + 2 * p2 * y;
+    dydy = 1 + rad_dist + 2 * k1 * y2 + 4 * k2 * r2 * y2 + 2 * p2 * x +
+           6 * p1 * y;
+    det = dxdx * dydy - dxdy * dxdy;
+    x -= (dydy * error_x - dxdy * error_y) / det;
+    y -= (dxdx * error_y - dxdy * error_x) / det;
+    compute_error();
+  }
+
+  rays.resize(3, pixels.cols());
+  rays.row(0) = x.transpose();
+  rays.row(1) = y.transpose();
+  rays.row(2).setOnes();
+
+  // written so that NaN errors are invalid
+  const float max_error2 = k_max_undistort_error_px * k_max_undistort_error_px;
+  const Eigen::Array<bool, Eigen::Dynamic, 1> converged =
+      (fx * error_x).square() + (fy * error_y).square() <= max_error2;
+  valid_mask.assign(converged.data(), converged.data() + converged.size());
+}
+
 void Radtan::UndistortImage(const cv::Mat& image_input, cv::Mat& image_output) {
   uint32_t height = image_input.rows, width = image_input.cols;
   Eigen::Matrix3d camera_matrix;
@@ -130,4 +130,4 @@ TEST_CASE("Test back project with invalid pixels") {
     bool in_domain = camera_model_->ProjectPoint(point, pixel, in_image);
     REQUIRE(!in_domain);
   }
-}
\ No newline at end of file
+}
@@ -114,6 +114,52 @@ TEST_CASE("Test converting a Radtan Image to the same model") {
   SaveImage("test_case_1_image_new.png", output_image);
 }
 
+TEST_CASE("Test converting with bilinear interpolation") {
+  std::shared_ptr<beam_calibration::CameraModel> source_model =
+      LoadRadtanModel("camera_model_conversion_test_intrinsics.json");
+  std::shared_ptr<beam_calibration::CameraModel> output_model =
+      LoadRadtanModel("camera_model_conversion_test_intrinsics.json");
+
+  // crop image to speed up test
+  cv::Mat image_in = cv::imread(GetDataPath("image.png"), cv::IMREAD_COLOR);
+  int x = static_cast<int>(source_model->GetWidth() / 2);
+  int y = static_cast<int>(source_model->GetHeight() / 2);
+  int width = 50;
+  int height = 50;
+  cv::Mat source_image = image_in(cv::Rect(x, y, width, height));
+  Eigen::Vector2i dims(height, width);
+
+  beam_calibration::ConvertCameraModel converter(source_model, dims, dims,
+                                                 output_model);
+
+  // the pixel type must match the image
+  REQUIRE_THROWS(converter.ConvertImage<uint8_t>(source_image));
+
+  // converting to the same model maps each pixel to itself, so bilinear
+  // interpolation should give the same image up to rounding
+  cv::Mat output_image =
+      converter.ConvertImage<cv::Vec3b>(source_image, cv::INTER_LINEAR);
+  REQUIRE(source_image.rows == output_image.rows);
+  REQUIRE(source_image.cols == output_image.cols);
+  int num_correct = 0;
+  int num_total = 0;
+  for (int i = 1; i < height - 1; i++) {
+    for (int j = 1; j < width - 1; j++) {
+      cv::Vec3b source = source_image.at<cv::Vec3b>(i, j);
+      cv::Vec3b output = output_image.at<cv::Vec3b>(i, j);
+      bool correct = true;
+      for (int c = 0; c < 3; c++) {
+        if (std::abs(source[c] - output[c]) > 1) { correct = false; }
+      }
+      if (correct) { num_correct++; }
+      num_total++;
+    }
+  }
+  double percent_correct =
+      static_cast<double>(num_correct) / static_cast<double>(num_total);
+  REQUIRE(percent_correct > 0.93);
+}
+
 TEST_CASE("Test distorting and undistoring a radtan simulation image") {
   // load model that created the image
   std::shared_ptr<beam_calibration::CameraModel> source_model =
@@ -319,4 +365,50 @@ TEST_CASE("Test undistorting a kannala brandt image") {
   SaveImage("test_case_4_image_original.png", source_image);
   SaveImage("test_case_4_image_upsampled.png", upsampled_image);
   SaveImage("test_case_4_image_undistorted.png", output_image);
-}
\ No newline at end of file
+}
+TEST_CASE("Test batch projection and back projection") {
+  for (const std::string& filename :
+       {"Radtan_test.json", "KB_test.json", "DS_test.json",
+        "Cataditropic_test.json"}) {
+    INFO(filename);
+    std::string intrinsics_location = GetDataPath(filename);
+    std::shared_ptr<beam_calibration::CameraModel> camera_model =
+        beam_calibration::CameraModel::Create(intrinsics_location);
+
+    // create random test points, including some that are behind the camera
+    int num_points = 200;
+    Eigen::Matrix3Xf points = Eigen::Matrix3Xf::Random(3, num_points) * 2;
+    points.row(2).array() = points.row(2).array() * 3 + 4;
+
+    // batch projection should match projecting each point
+    Eigen::Matrix2Xf pixels;
+    std::vector<uint8_t> valid_mask;
+    camera_model->ProjectPoints(points, pixels, valid_mask);
+    REQUIRE(pixels.cols() == num_points);
+    REQUIRE(valid_mask.size() == num_points);
+    for (int i = 0; i < num_points; i++) {
+      Eigen::Vector2d pixel;
+      bool in_image = false;
+      bool in_domain = camera_model->ProjectPoint(
+          points.col(i).cast<double>(), pixel, in_image);
+      REQUIRE(static_cast<bool>(valid_mask[i]) == (in_domain && in_image));
+      if (!valid_mask[i]) { continue; }
+      REQUIRE(std::abs(pixel[0] - pixels(0, i)) < 1e-2);
+      REQUIRE(std::abs(pixel[1] - pixels(1, i)) < 1e-2);
+    }
+
+    // back projecting the pixels should give rays towards the points
+    Eigen::Matrix3Xf rays;
+    std::vector<uint8_t> back_project_mask;
+    camera_model->BackProjectPixels(pixels, rays, back_project_mask);
+    REQUIRE(rays.cols() == num_points);
+    REQUIRE(back_project_mask.size() == num_points);
+    for (int i = 0; i < num_points; i++) {
+      if (!valid_mask[i] || points(2, i) <= 0) { continue; }
+      REQUIRE(back_project_mask[i]);
+      Eigen::Vector3f error =
+          rays.col(i).normalized() - points.col(i).normalized();
+      REQUIRE(error.norm() < 1e-3);
+    }
+  }
+}
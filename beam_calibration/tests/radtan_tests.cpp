@@ -223,4 +223,52 @@ TEST_CASE("Test safe projection") {
     }
   }
   cv::imwrite("/tmp/radtan_tests_result.jpg", img_markedup);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test bearing table") {
+  LoadCameraModel();
+  REQUIRE(!camera_model_->HasBearingTable());
+  uint32_t w = camera_model_->GetWidth();
+  uint32_t h = camera_model_->GetHeight();
+
+  // back project random pixels without the table
+  int num_pixels = 30;
+  std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels;
+  std::vector<Eigen::Vector3d, beam::AlignVec3d> rays;
+  for (int i = 0; i < num_pixels; i++) {
+    Eigen::Vector2i pixel(fRand(0, w - 1), fRand(0, h - 1));
+    Eigen::Vector3d ray;
+    REQUIRE(camera_model_->BackProject(pixel, ray));
+    pixels.push_back(pixel);
+    rays.push_back(ray);
+  }
+
+  auto check_table = [&]() {
+    REQUIRE(camera_model_->HasBearingTable());
+    for (int i = 0; i < num_pixels; i++) {
+      Eigen::Vector3d ray;
+      REQUIRE(camera_model_->BackProject(pixels[i], ray));
+      REQUIRE((ray - rays[i]).norm() < 1e-6);
+    }
+  };
+
+  // rays from the table should match
+  camera_model_->InitBearingTable();
+  check_table();
+
+  // and also once the table is written and loaded again
+  std::string table_path = "/tmp/radtan_tests_bearing_table.bin";
+  REQUIRE(camera_model_->WriteBearingTable(table_path));
+  camera_model_->ClearBearingTable();
+  REQUIRE(!camera_model_->HasBearingTable());
+  REQUIRE(camera_model_->LoadBearingTable(table_path));
+  check_table();
+
+  // the table can't be loaded for different intrinsics
+  Eigen::VectorXd intrinsics = camera_model_->GetIntrinsics();
+  intrinsics[4] += 0.01;
+  camera_model_->SetIntrinsics(intrinsics);
+  REQUIRE(!camera_model_->HasBearingTable());
+  REQUIRE(!camera_model_->LoadBearingTable(table_path));
+  std::remove(table_path.c_str());
+}
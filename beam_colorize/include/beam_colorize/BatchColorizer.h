@@ -0,0 +1,192 @@
+/** @file
+ * @ingroup colorizer
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <opencv2/core.hpp>
+
+#include <beam_calibration/CameraModel.h>
+#include <beam_colorize/Colorizer.h>
+#include <beam_utils/pointclouds.h>
+
+namespace beam_colorize {
+/** @addtogroup colorizer
+ *  @{ */
+
+/**
+ * @brief Enum class for the ways colors from multiple images are combined
+ */
+enum class ColorFusionType {
+  // color from the image taken closest to the point
+  NEAREST_VIEW = 0,
+  // average color over all images which see the point
+  MEAN,
+  // weighted average color, where the weight is the cosine of the angle
+  // between the ray to the point and the optical axis, so that images which
+  // see the point near their center count more than images which see it near
+  // their edges
+  VIEW_ANGLE_WEIGHTED
+};
+
+/**
+ * @brief Class for colorizing a map from many images at once. Instead of
+ * transforming and projecting the full map for every image, the map is split
+ * into a grid of cells once and each image only projects the points in the
+ * cells that intersect its field of view. Images are projected in parallel
+ * using the Colorizer given by the params (so occlusions are handled the same
+ * way as when colorizing with a single image), and the colors each point gets
+ * from all images are fused into a single color.
+ *
+ * Each point is visited at most once per image whose field of view contains
+ * its cell, plus once when fusing colors. Black pixels are ignored as in
+ * Colorizer::ColorizePointCloud.
+ */
+class BatchColorizer {
+public:
+  struct Params {
+    /// colorizer used to project the points of each image
+    ColorizerType colorizer_type{ColorizerType::PROJECTION};
+
+    /// how colors from multiple images are combined
+    ColorFusionType fusion_type{ColorFusionType::NEAREST_VIEW};
+
+    /// set to true if the images are distorted, see Colorizer::SetDistortion
+    bool image_distorted{true};
+
+    /// points further than this from a camera are not colorized by it. If <=
+    /// 0, there is no limit
+    double max_depth_m{0};
+
+    /// edge length of the grid cells used to cull points outside the field of
+    /// view of each image, must be positive
+    double cell_size_m{2};
+
+    /// number of images projected in parallel. If <= 0, this will use all
+    /// hardware threads
+    int num_threads{0};
+  };
+
+  /**
+   * @brief constructor with default params
+   */
+  BatchColorizer() = default;
+
+  /**
+   * @brief constructor
+   * @param params see Params
+   */
+  explicit BatchColorizer(const Params& params);
+
+  /**
+   * @brief Default destructor
+   */
+  ~BatchColorizer() = default;
+
+  /**
+   * @brief add an image to colorize the map with. Camera models can be shared
+   * between images.
+   * @param image 8 bit, 3 channel BGR image
+   * @param T_CAM_WORLD transform from world frame to camera frame
+   * @param camera_model camera model of the image. The image must have the
+   * same size as the camera model
+   * @return false if the image or camera model are invalid
+   */
+  bool AddView(const cv::Mat& image, const Eigen::Matrix4d& T_CAM_WORLD,
+               const std::shared_ptr<beam_calibration::CameraModel>&
+                   camera_model);
+
+  /**
+   * @brief remove all images
+   */
+  void ClearViews();
+
+  /**
+   * @brief get the number of images added
+   */
+  size_t NumViews() const { return views_.size(); }
+
+  /**
+   * @brief colorize a map with all images added
+   * @param map_in_world_frame map to colorize
+   * @return colored map in world frame, with the same points in the same
+   * order as the input. Points not seen by any image are black, and all
+   * points are black if the params are invalid.
+   */
+  PointCloudCol::Ptr Colorize(const PointCloud& map_in_world_frame) const;
+
+private:
+  struct View {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    cv::Mat image;
+    Eigen::Matrix4d T_CAM_WORLD;
+    std::shared_ptr<beam_calibration::CameraModel> camera_model;
+  };
+
+  /**
+   * @brief bounding sphere of the points in a grid cell, and the range of
+   * their indices in the sorted cell point vector
+   */
+  struct Cell {
+    Eigen::Vector3d center;
+    double radius;
+    size_t begin;
+    size_t end;
+  };
+
+  /**
+   * @brief color of a point from a single image
+   */
+  struct Observation {
+    uint32_t point_id;
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    float depth;
+    float weight;
+  };
+
+  /**
+   * @brief split the finite points of a map into grid cells
+   * @param map map in world frame
+   * @param cells output cells
+   * @param cell_points output point indices, sorted by cell
+   */
+  void BuildCells(const PointCloud& map, std::vector<Cell>& cells,
+                  std::vector<uint32_t>& cell_points) const;
+
+  /**
+   * @brief get the max angle between the optical axis and a ray through any
+   * pixel on the image border
+   */
+  double GetMaxViewAngle(beam_calibration::CameraModel& camera_model) const;
+
+  /**
+   * @brief project the points in all cells which intersect the field of view
+   * of an image
+   * @param view image to project to
+   * @param colorizer colorizer initialized with the image and camera model
+   * @param max_view_angle see GetMaxViewAngle
+   * @param map map in world frame
+   * @param cells grid cells of the map
+   * @param cell_points point indices sorted by cell
+   * @param observations output colors of the points seen by the image
+   */
+  void ProjectView(const View& view, const Colorizer& colorizer,
+                   double max_view_angle, const PointCloud& map,
+                   const std::vector<Cell>& cells,
+                   const std::vector<uint32_t>& cell_points,
+                   std::vector<Observation>& observations) const;
+
+  Params params_;
+  std::vector<View, Eigen::aligned_allocator<View>> views_;
+};
+
+/** @} group colorizer */
+
+} // namespace beam_colorize
@@ -15,6 +15,7 @@
 #include <sensor_msgs/Image.h>
 
 #include <beam_calibration/CameraModel.h>
+#include <beam_colorize/ProjectionMap.h>
 #include <beam_containers/PointBridge.h>
 #include <beam_utils/pointclouds.h>
 
@@ -41,44 +42,6 @@ using Pixel = cv::Point3_<uchar>;
  */
 typedef pcl::PointCloud<beam_containers::PointBridge> DefectCloud;
 
-struct ProjectedPointMeta {
-  ProjectedPointMeta(uint64_t _id, double _depth) : id(_id), depth(_depth) {}
-
-  uint64_t id;  // id in original cloud
-  double depth; // depth from camera in m
-};
-
-using UMapType = std::unordered_map<uint64_t, ProjectedPointMeta>;
-
-/**
- * @brief class for storing a point projection map. This is stored as a 2D (or
- * two level nested) hash map so we can lookup point IDs associated with image
- * pixel coordinates (u,v). Note that since we only want to colorize closest
- * points to the image, we only store the closest points to each individual
- * pixel
- *
- */
-class ProjectionMap {
-public:
-  void Add(uint64_t u, uint64_t v, uint64_t point_id, double depth = 0);
-
-  bool Get(uint64_t u, uint64_t v, ProjectedPointMeta& point_meta);
-
-  void Erase(uint64_t u, uint64_t v);
-
-  int Size();
-
-  std::unordered_map<uint64_t, UMapType>::iterator VBegin();
-
-  std::unordered_map<uint64_t, UMapType>::iterator VEnd();
-
-private:
-  // map: v -> {map: u -> closest point ID}
-  std::unordered_map<uint64_t, UMapType> map_;
-
-  const pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_;
-};
-
 /**
  * @brief Abstract class which different colorization methods can implement
  */
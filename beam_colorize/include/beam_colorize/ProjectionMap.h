@@ -0,0 +1,161 @@
+/** @file
+ * @ingroup colorizer
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace beam_colorize {
+/** @addtogroup colorizer
+ *  @{ */
+
+struct ProjectedPointMeta {
+  ProjectedPointMeta(uint64_t _id, double _depth) : id(_id), depth(_depth) {}
+
+  uint64_t id;  // id in original cloud
+  double depth; // depth from camera in m
+};
+
+using UMapType = std::unordered_map<uint64_t, ProjectedPointMeta>;
+
+/**
+ * @brief class for storing a point projection map, so we can lookup point IDs
+ * associated with image pixel coordinates (u,v). Note that since we only want
+ * to colorize closest points to the image, we only store the closest points to
+ * each individual pixel.
+ *
+ * There are two backends:
+ *
+ *  - sparse (default constructor): a 2D (or two level nested) hash map keyed
+ *  by v then u. This has no bounds on the pixel coordinates.
+ *
+ *  - dense (image size constructor): an image sized z-buffer stored row major
+ *  in contiguous memory, with an id and float depth per pixel. Optionally,
+ *  each pixel can store a short list of the N closest points (sorted by
+ *  depth) instead of only the closest. Points outside the image are ignored.
+ *  Add, Get and Erase are a single array access and nothing is allocated
+ *  after construction, so this should be used whenever the image size is
+ *  known. Ids must fit in 32 bits.
+ */
+class ProjectionMap {
+public:
+  /**
+   * @brief constructor for a sparse projection map
+   */
+  ProjectionMap() = default;
+
+  /**
+   * @brief constructor for a dense projection map
+   * @param width image width in pixels
+   * @param height image height in pixels
+   * @param points_per_pixel number of closest points stored per pixel, must be
+   * in [1, 255]
+   */
+  ProjectionMap(uint64_t width, uint64_t height, uint8_t points_per_pixel = 1);
+
+  /**
+   * @brief add a point projected to a pixel. If the pixel is full, the point
+   * is only kept if it is closer than the furthest point in the pixel
+   */
+  void Add(uint64_t u, uint64_t v, uint64_t point_id, double depth = 0);
+
+  /**
+   * @brief get the closest point projected to a pixel
+   * @return false if no point projects to the pixel
+   */
+  bool Get(uint64_t u, uint64_t v, ProjectedPointMeta& point_meta) const;
+
+  /**
+   * @brief get all points stored for a pixel, sorted by increasing depth. For
+   * sparse maps, or dense maps with one point per pixel, this is at most one
+   * point
+   * @return false if no point projects to the pixel
+   */
+  bool GetAll(uint64_t u, uint64_t v,
+              std::vector<ProjectedPointMeta>& point_metas) const;
+
+  /**
+   * @brief remove all points stored for a pixel
+   */
+  void Erase(uint64_t u, uint64_t v);
+
+  /**
+   * @brief get the number of pixels with at least one point
+   */
+  int Size() const { return num_pixels_; }
+
+  /**
+   * @brief call a function on the closest point of every pixel with at least
+   * one point. This works with both backends and should be preferred over
+   * VBegin/VEnd. Dense maps are visited in row major order
+   * @param func function with signature void(uint64_t u, uint64_t v, const
+   * ProjectedPointMeta& point_meta)
+   */
+  template <typename Func>
+  void ForEach(Func&& func) const {
+    if (!dense_) {
+      for (const auto& [v, u_map] : map_) {
+        for (const auto& [u, point_meta] : u_map) { func(u, v, point_meta); }
+      }
+      return;
+    }
+    for (uint64_t v = 0; v < height_; v++) {
+      for (uint64_t u = 0; u < width_; u++) {
+        uint64_t pixel = v * width_ + u;
+        if (counts_[pixel] == 0) { continue; }
+        const PixelEntry& entry = entries_[pixel * points_per_pixel_];
+        func(u, v, ProjectedPointMeta(entry.id, entry.depth));
+      }
+    }
+  }
+
+  /**
+   * @brief true if this map uses the dense backend
+   */
+  bool IsDense() const { return dense_; }
+
+  /**
+   * @brief get the image width of a dense map, 0 for sparse maps
+   */
+  uint64_t GetWidth() const { return width_; }
+
+  /**
+   * @brief get the image height of a dense map, 0 for sparse maps
+   */
+  uint64_t GetHeight() const { return height_; }
+
+  /**
+   * @brief iterators over the rows of a sparse map. Throws for dense maps,
+   * use ForEach instead
+   */
+  std::unordered_map<uint64_t, UMapType>::iterator VBegin();
+
+  std::unordered_map<uint64_t, UMapType>::iterator VEnd();
+
+private:
+  struct PixelEntry {
+    uint32_t id;
+    float depth;
+  };
+
+  bool dense_{false};
+  int num_pixels_{0};
+
+  // sparse backend. map: v -> {map: u -> closest point ID}
+  std::unordered_map<uint64_t, UMapType> map_;
+
+  // dense backend. entries_ holds points_per_pixel_ entries per pixel sorted
+  // by depth, of which the first counts_[pixel] are valid
+  uint64_t width_{0};
+  uint64_t height_{0};
+  uint8_t points_per_pixel_{1};
+  std::vector<PixelEntry> entries_;
+  std::vector<uint8_t> counts_;
+};
+
+/** @} group colorizer */
+
+} // namespace beam_colorize
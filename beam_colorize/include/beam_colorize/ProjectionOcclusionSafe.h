@@ -17,7 +17,14 @@ namespace beam_colorize {
  * checks if there's a large distance discrepancy between the points, if so, it
  * removes the far points. This also helps remove the colorizing error that's
  * common to the perimeter of objects due to poor calibrations or slightly
- * incorrect SLAM poses
+ * incorrect SLAM poses.
+ *
+ * The image is covered by overlapping square windows. In each window, points
+ * are visited in order of increasing depth and kept until there is a jump in
+ * depth larger than the threshold, so only the closest surface in each window
+ * is colorized. Windows only read the initial projection map, so they are
+ * processed independently on multiple threads and the points kept by each
+ * thread are merged once all windows are done.
  */
 class ProjectionOcclusionSafe : public Colorizer {
 public:
@@ -43,6 +50,13 @@ public:
 
   void SetDepthThreshold(double depth_seg_thresh_m);
 
+  /**
+   * @brief set the number of threads used to check windows for occlusions
+   * @param num_threads number of threads. If <= 0, this will use all hardware
+   * threads
+   */
+  void SetNumThreads(int num_threads);
+
 private:
   struct ProjectedPoint {
     uint64_t u;
@@ -52,15 +66,26 @@ private:
   };
 
   ProjectionMap
-      RemoveOccludedPointsFromMap(ProjectionMap& projection_map_orig) const;
+      RemoveOccludedPointsFromMap(const ProjectionMap& projection_map) const;
 
-  void CheckOcclusionsInWindow(ProjectionMap& projection_map_to_keep,
-                               ProjectionMap& projection_map, uint64_t u_start,
-                               uint64_t v_start) const;
+  /**
+   * @brief find the points in a window which belong to the closest surface
+   * @param projection_map dense projection map of all points
+   * @param u_start first column of the window
+   * @param v_start first row of the window
+   * @param window_points buffer for the points in the window, reused between
+   * windows to avoid allocations
+   * @param points_to_keep output vector the kept points are appended to
+   */
+  void CheckOcclusionsInWindow(
+      const ProjectionMap& projection_map, uint64_t u_start, uint64_t v_start,
+      std::vector<ProjectedPoint>& window_points,
+      std::vector<ProjectedPoint>& points_to_keep) const;
 
   uint8_t window_size_{90};
   uint8_t window_stride_{67};
   double depth_seg_thresh_m_{0.15};
+  int num_threads_{0};
 };
 /** @} group colorizer */
 
@@ -0,0 +1,295 @@
+#include <beam_colorize/BatchColorizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <pcl/common/io.h>
+
+#include <beam_colorize/ProjectionOcclusionSafe.h>
+#include <beam_utils/log.h>
+#include <beam_utils/parallel.h>
+
+namespace beam_colorize {
+
+BatchColorizer::BatchColorizer(const Params& params) : params_(params) {}
+
+bool BatchColorizer::AddView(
+    const cv::Mat& image, const Eigen::Matrix4d& T_CAM_WORLD,
+    const std::shared_ptr<beam_calibration::CameraModel>& camera_model) {
+  if (camera_model == nullptr) {
+    BEAM_ERROR("Cannot add view to BatchColorizer, camera model is null.");
+    return false;
+  }
+  if (image.type() != CV_8UC3) {
+    BEAM_ERROR("Cannot add view to BatchColorizer, image must be of type "
+               "CV_8UC3.");
+    return false;
+  }
+  if (image.cols != static_cast<int>(camera_model->GetWidth()) ||
+      image.rows != static_cast<int>(camera_model->GetHeight())) {
+    BEAM_ERROR("Cannot add view to BatchColorizer, image size ({} x {}) does "
+               "not match camera model ({} x {}).",
+               image.cols, image.rows, camera_model->GetWidth(),
+               camera_model->GetHeight());
+    return false;
+  }
+  View view;
+  view.image = image;
+  view.T_CAM_WORLD = T_CAM_WORLD;
+  view.camera_model = camera_model;
+  views_.push_back(view);
+  return true;
+}
+
+void BatchColorizer::ClearViews() {
+  views_.clear();
+}
+
+PointCloudCol::Ptr
+    BatchColorizer::Colorize(const PointCloud& map_in_world_frame) const {
+  auto map_colored = std::make_shared<PointCloudCol>();
+  pcl::copyPointCloud(map_in_world_frame, *map_colored);
+  if (params_.cell_size_m <= 0) {
+    BEAM_ERROR("Cannot colorize map, cell size must be positive, got {}.",
+               params_.cell_size_m);
+    return map_colored;
+  }
+  if (views_.empty() || map_in_world_frame.empty()) { return map_colored; }
+
+  std::vector<Cell> cells;
+  std::vector<uint32_t> cell_points;
+  BuildCells(map_in_world_frame, cells, cell_points);
+
+  // running color of each point. For NEAREST_VIEW, rgb is the color of the
+  // closest view so far, otherwise it is the weighted sum of all colors
+  struct Accumulator {
+    float r{0};
+    float g{0};
+    float b{0};
+    float weight{0};
+    float depth{std::numeric_limits<float>::max()};
+  };
+  std::vector<Accumulator> accumulators(map_in_world_frame.size());
+
+  // views are projected in batches of n_threads, each thread projects one
+  // view into its own observations and these are fused in order of the views
+  int n_threads = beam::GetNumThreads(params_.num_threads, views_.size());
+  std::vector<std::vector<Observation>> observations(n_threads);
+  for (size_t batch_start = 0; batch_start < views_.size();
+       batch_start += n_threads) {
+    size_t batch_size =
+        std::min<size_t>(n_threads, views_.size() - batch_start);
+
+    // colorizers lazily build rectified models when initialized, so this is
+    // done before starting the threads
+    std::vector<std::unique_ptr<Colorizer>> colorizers(batch_size);
+    std::vector<double> max_view_angles(batch_size);
+    for (size_t i = 0; i < batch_size; i++) {
+      const View& view = views_[batch_start + i];
+      colorizers[i] = Colorizer::Create(params_.colorizer_type);
+      if (colorizers[i] == nullptr) {
+        BEAM_CRITICAL("Invalid colorizer type in BatchColorizer params.");
+        throw std::runtime_error{"Invalid colorizer type."};
+      }
+      colorizers[i]->SetImage(view.image);
+      colorizers[i]->SetIntrinsics(view.camera_model);
+      colorizers[i]->SetDistortion(params_.image_distorted);
+      auto occlusion_safe =
+          dynamic_cast<ProjectionOcclusionSafe*>(colorizers[i].get());
+      if (occlusion_safe != nullptr && n_threads > 1) {
+        occlusion_safe->SetNumThreads(1);
+      }
+      max_view_angles[i] = GetMaxViewAngle(
+          params_.image_distorted ? *view.camera_model
+                                  : *view.camera_model->GetRectifiedModel());
+    }
+
+    beam::ParallelForChunks(
+        batch_size, static_cast<int>(batch_size),
+        [&](int /*thread_id*/, size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            ProjectView(views_[batch_start + i], *colorizers[i],
+                        max_view_angles[i], map_in_world_frame, cells,
+                        cell_points, observations[i]);
+          }
+        });
+
+    for (size_t i = 0; i < batch_size; i++) {
+      for (const Observation& o : observations[i]) {
+        Accumulator& a = accumulators[o.point_id];
+        if (params_.fusion_type == ColorFusionType::NEAREST_VIEW) {
+          if (o.depth < a.depth) {
+            a.r = o.r;
+            a.g = o.g;
+            a.b = o.b;
+            a.weight = 1;
+            a.depth = o.depth;
+          }
+          continue;
+        }
+        float weight = params_.fusion_type == ColorFusionType::MEAN
+                           ? 1
+                           : o.weight;
+        a.r += weight * o.r;
+        a.g += weight * o.g;
+        a.b += weight * o.b;
+        a.weight += weight;
+      }
+    }
+  }
+
+  int counter{0};
+  for (size_t i = 0; i < accumulators.size(); i++) {
+    const Accumulator& a = accumulators[i];
+    if (a.weight <= 0) { continue; }
+    counter++;
+    PointTypeCol& p = map_colored->points[i];
+    p.r = static_cast<uint8_t>(std::round(a.r / a.weight));
+    p.g = static_cast<uint8_t>(std::round(a.g / a.weight));
+    p.b = static_cast<uint8_t>(std::round(a.b / a.weight));
+  }
+  BEAM_INFO("Coloured {} of {} total points using {} images.", counter,
+            map_colored->size(), views_.size());
+  return map_colored;
+}
+
+void BatchColorizer::BuildCells(const PointCloud& map,
+                                std::vector<Cell>& cells,
+                                std::vector<uint32_t>& cell_points) const {
+  // sort point ids by the key of their cell. Each cell coordinate is stored in
+  // 21 bits
+  const int64_t offset = 1 << 20;
+  const int64_t mask = (1 << 21) - 1;
+  std::vector<std::pair<uint64_t, uint32_t>> keys;
+  keys.reserve(map.size());
+  for (uint32_t i = 0; i < map.size(); i++) {
+    const auto& p = map.points[i];
+    if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+      continue;
+    }
+    uint64_t key = 0;
+    for (float c : {p.x, p.y, p.z}) {
+      int64_t cell = static_cast<int64_t>(std::floor(c / params_.cell_size_m));
+      key = (key << 21) | static_cast<uint64_t>((cell + offset) & mask);
+    }
+    keys.emplace_back(key, i);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  cells.clear();
+  cell_points.resize(keys.size());
+  size_t begin = 0;
+  while (begin < keys.size()) {
+    size_t end = begin;
+    Eigen::Vector3f min_pt = map.points[keys[begin].second].getVector3fMap();
+    Eigen::Vector3f max_pt = min_pt;
+    while (end < keys.size() && keys[end].first == keys[begin].first) {
+      const auto& p = map.points[keys[end].second].getVector3fMap();
+      min_pt = min_pt.cwiseMin(p);
+      max_pt = max_pt.cwiseMax(p);
+      cell_points[end] = keys[end].second;
+      end++;
+    }
+    Cell cell;
+    cell.center = (0.5f * (min_pt + max_pt)).cast<double>();
+    cell.radius = 0.5 * (max_pt - min_pt).cast<double>().norm();
+    cell.begin = begin;
+    cell.end = end;
+    cells.push_back(cell);
+    begin = end;
+  }
+}
+
+double BatchColorizer::GetMaxViewAngle(
+    beam_calibration::CameraModel& camera_model) const {
+  int width = camera_model.GetWidth();
+  int height = camera_model.GetHeight();
+  std::vector<Eigen::Vector2i> border_pixels;
+  int num_samples = 32;
+  for (int i = 0; i <= num_samples; i++) {
+    int u = i * (width - 1) / num_samples;
+    int v = i * (height - 1) / num_samples;
+    border_pixels.emplace_back(u, 0);
+    border_pixels.emplace_back(u, height - 1);
+    border_pixels.emplace_back(0, v);
+    border_pixels.emplace_back(width - 1, v);
+  }
+
+  double max_angle = 0;
+  for (const auto& pixel : border_pixels) {
+    Eigen::Vector3d ray;
+    if (!camera_model.BackProject(pixel, ray)) { continue; }
+    max_angle = std::max(max_angle, std::acos(ray.normalized().z()));
+  }
+
+  // don't cull anything if the border could not be back projected
+  if (max_angle == 0) { return M_PI; }
+
+  // add a margin for the field of view between sampled pixels
+  return std::min(max_angle + 0.02, M_PI);
+}
+
+void BatchColorizer::ProjectView(const View& view, const Colorizer& colorizer,
+                                 double max_view_angle, const PointCloud& map,
+                                 const std::vector<Cell>& cells,
+                                 const std::vector<uint32_t>& cell_points,
+                                 std::vector<Observation>& observations) const {
+  observations.clear();
+  const Eigen::Matrix3d R = view.T_CAM_WORLD.block<3, 3>(0, 0);
+  const Eigen::Vector3d t = view.T_CAM_WORLD.block<3, 1>(0, 3);
+
+  // get points in cells which intersect the view cone of the image
+  auto cloud_in_camera_frame = std::make_shared<PointCloudCol>();
+  std::vector<uint32_t> point_ids;
+  for (const Cell& cell : cells) {
+    Eigen::Vector3d center = R * cell.center + t;
+    double distance = center.norm();
+    if (params_.max_depth_m > 0 &&
+        distance - cell.radius > params_.max_depth_m) {
+      continue;
+    }
+    if (distance > cell.radius) {
+      double angle = std::acos(center.z() / distance) -
+                     std::asin(cell.radius / distance);
+      if (angle > max_view_angle) { continue; }
+    }
+
+    for (size_t i = cell.begin; i < cell.end; i++) {
+      const auto& p = map.points[cell_points[i]];
+      Eigen::Vector3d point = R * p.getVector3fMap().cast<double>() + t;
+      if (params_.max_depth_m > 0 && point.norm() > params_.max_depth_m) {
+        continue;
+      }
+      PointTypeCol p_cam;
+      p_cam.x = point.x();
+      p_cam.y = point.y();
+      p_cam.z = point.z();
+      cloud_in_camera_frame->push_back(p_cam);
+      point_ids.push_back(cell_points[i]);
+    }
+  }
+  if (cloud_in_camera_frame->empty()) { return; }
+
+  ProjectionMap projection_map =
+      colorizer.CreateProjectionMap(cloud_in_camera_frame);
+  projection_map.ForEach([&](uint64_t u, uint64_t v,
+                             const ProjectedPointMeta& point_meta) {
+    cv::Vec3b colors = view.image.at<cv::Vec3b>(v, u);
+    // ignore black colors, this happens at edges when images are undistorted
+    if (colors.val[0] == 0 && colors.val[1] == 0 && colors.val[2] == 0) {
+      return;
+    }
+    const auto& p = cloud_in_camera_frame->points[point_meta.id];
+    Observation o;
+    o.point_id = point_ids[point_meta.id];
+    o.b = colors.val[0];
+    o.g = colors.val[1];
+    o.r = colors.val[2];
+    o.depth = point_meta.depth;
+    o.weight = std::max(1e-3f, p.z / p.getVector3fMap().norm());
+    observations.push_back(o);
+  });
+}
+
+} // namespace beam_colorize
@@ -9,7 +9,8 @@ Projection::Projection() : Colorizer() {}
 
 ProjectionMap Projection::CreateProjectionMap(
     const PointCloudCol::Ptr& cloud_in_camera_frame) const {
-  ProjectionMap projection_map;
+  ProjectionMap projection_map(camera_model_->GetWidth(),
+                               camera_model_->GetHeight());
   for (uint32_t i = 0; i < cloud_in_camera_frame->points.size(); i++) {
     Eigen::Vector3d point(cloud_in_camera_frame->points[i].x,
                           cloud_in_camera_frame->points[i].y,
@@ -30,7 +31,8 @@ ProjectionMap Projection::CreateProjectionMap(
 
 ProjectionMap Projection::CreateProjectionMap(
     const DefectCloud::Ptr& cloud_in_camera_frame) const {
-  ProjectionMap projection_map;
+  ProjectionMap projection_map(camera_model_->GetWidth(),
+                               camera_model_->GetHeight());
   for (uint32_t i = 0; i < cloud_in_camera_frame->points.size(); i++) {
     Eigen::Vector3d point(cloud_in_camera_frame->points[i].x,
                           cloud_in_camera_frame->points[i].y,
@@ -0,0 +1,145 @@
+#include <beam_colorize/ProjectionMap.h>
+
+#include <stdexcept>
+
+#include <beam_utils/log.h>
+
+namespace beam_colorize {
+
+ProjectionMap::ProjectionMap(uint64_t width, uint64_t height,
+                             uint8_t points_per_pixel)
+    : dense_(true),
+      width_(width),
+      height_(height),
+      points_per_pixel_(points_per_pixel) {
+  if (points_per_pixel_ == 0) {
+    BEAM_ERROR("Invalid number of points per pixel, using 1.");
+    points_per_pixel_ = 1;
+  }
+  entries_.resize(width_ * height_ * points_per_pixel_);
+  counts_.resize(width_ * height_, 0);
+}
+
+void ProjectionMap::Add(uint64_t u, uint64_t v, uint64_t point_id,
+                        double depth) {
+  if (dense_) {
+    if (u >= width_ || v >= height_) { return; }
+    uint64_t pixel = v * width_ + u;
+    PixelEntry* entries = &entries_[pixel * points_per_pixel_];
+    uint8_t& count = counts_[pixel];
+    float depth_f = static_cast<float>(depth);
+
+    // pixel is full and all points are closer
+    if (count == points_per_pixel_ &&
+        entries[points_per_pixel_ - 1].depth <= depth_f) {
+      return;
+    }
+
+    // insertion sort, dropping the furthest point if the pixel is full
+    if (count == 0) { num_pixels_++; }
+    int i = count < points_per_pixel_ ? count : points_per_pixel_ - 1;
+    while (i > 0 && entries[i - 1].depth > depth_f) {
+      entries[i] = entries[i - 1];
+      i--;
+    }
+    entries[i] = PixelEntry{static_cast<uint32_t>(point_id), depth_f};
+    if (count < points_per_pixel_) { count++; }
+    return;
+  }
+
+  auto v_iter = map_.find(v);
+
+  // if v isn't found, add row
+  if (v_iter == map_.end()) {
+    UMapType u_map;
+    u_map.emplace(u, ProjectedPointMeta(point_id, depth));
+    map_.emplace(v, u_map);
+    num_pixels_++;
+    return;
+  }
+
+  auto u_iter = v_iter->second.find(u);
+  // if u isn't found, add u and ID
+  if (u_iter == v_iter->second.end()) {
+    v_iter->second.emplace(u, ProjectedPointMeta(point_id, depth));
+    num_pixels_++;
+    return;
+  }
+
+  // else, check distance and keep point closest to camera
+  if (u_iter->second.depth > depth) {
+    u_iter->second = ProjectedPointMeta(point_id, depth);
+  }
+}
+
+bool ProjectionMap::Get(uint64_t u, uint64_t v,
+                        ProjectedPointMeta& point_meta) const {
+  if (dense_) {
+    if (u >= width_ || v >= height_) { return false; }
+    uint64_t pixel = v * width_ + u;
+    if (counts_[pixel] == 0) { return false; }
+    const PixelEntry& entry = entries_[pixel * points_per_pixel_];
+    point_meta = ProjectedPointMeta(entry.id, entry.depth);
+    return true;
+  }
+
+  auto v_iter = map_.find(v);
+  if (v_iter == map_.end()) { return false; }
+  auto u_iter = v_iter->second.find(u);
+  if (u_iter == v_iter->second.end()) { return false; }
+  point_meta = u_iter->second;
+  return true;
+}
+
+bool ProjectionMap::GetAll(uint64_t u, uint64_t v,
+                           std::vector<ProjectedPointMeta>& point_metas) const {
+  point_metas.clear();
+  if (!dense_) {
+    ProjectedPointMeta point_meta(0, 0);
+    if (!Get(u, v, point_meta)) { return false; }
+    point_metas.push_back(point_meta);
+    return true;
+  }
+
+  if (u >= width_ || v >= height_) { return false; }
+  uint64_t pixel = v * width_ + u;
+  const PixelEntry* entries = &entries_[pixel * points_per_pixel_];
+  for (uint8_t i = 0; i < counts_[pixel]; i++) {
+    point_metas.emplace_back(entries[i].id, entries[i].depth);
+  }
+  return !point_metas.empty();
+}
+
+void ProjectionMap::Erase(uint64_t u, uint64_t v) {
+  if (dense_) {
+    if (u >= width_ || v >= height_) { return; }
+    uint8_t& count = counts_[v * width_ + u];
+    if (count > 0) {
+      count = 0;
+      num_pixels_--;
+    }
+    return;
+  }
+
+  auto v_iter = map_.find(v);
+  if (v_iter == map_.end()) { return; }
+  if (v_iter->second.erase(u) > 0) { num_pixels_--; }
+}
+
+std::unordered_map<uint64_t, UMapType>::iterator ProjectionMap::VBegin() {
+  if (dense_) {
+    throw std::runtime_error{
+        "VBegin is not supported by dense projection maps, use ForEach."};
+  }
+  return map_.begin();
+}
+
+std::unordered_map<uint64_t, UMapType>::iterator ProjectionMap::VEnd() {
+  if (dense_) {
+    throw std::runtime_error{
+        "VEnd is not supported by dense projection maps, use ForEach."};
+  }
+  return map_.end();
+}
+
+} // namespace beam_colorize
@@ -1,8 +1,11 @@
 #include "beam_colorize/ProjectionOcclusionSafe.h"
 
+#include <algorithm>
+
 #include <pcl/common/transforms.h>
 #include <pcl/io/pcd_io.h>
 
+#include <beam_utils/parallel.h>
 #include <beam_utils/pointclouds.h>
 
 namespace beam_colorize {
@@ -11,7 +14,8 @@ ProjectionOcclusionSafe::ProjectionOcclusionSafe() : Colorizer() {}
 
 ProjectionMap ProjectionOcclusionSafe::CreateProjectionMap(
     const PointCloudCol::Ptr& cloud_in_camera_frame) const {
-  ProjectionMap projection_map;
+  ProjectionMap projection_map(camera_model_->GetWidth(),
+                               camera_model_->GetHeight());
   for (uint32_t i = 0; i < cloud_in_camera_frame->points.size(); i++) {
     Eigen::Vector3d point(cloud_in_camera_frame->points[i].x,
                           cloud_in_camera_frame->points[i].y,
@@ -34,7 +38,8 @@ ProjectionMap ProjectionOcclusionSafe::CreateProjectionMap(
 
 ProjectionMap ProjectionOcclusionSafe::CreateProjectionMap(
     const DefectCloud::Ptr& cloud_in_camera_frame) const {
-  ProjectionMap projection_map;
+  ProjectionMap projection_map(camera_model_->GetWidth(),
+                               camera_model_->GetHeight());
   for (uint32_t i = 0; i < cloud_in_camera_frame->points.size(); i++) {
     Eigen::Vector3d point(cloud_in_camera_frame->points[i].x,
                           cloud_in_camera_frame->points[i].y,
@@ -56,55 +61,86 @@ ProjectionMap ProjectionOcclusionSafe::CreateProjectionMap(
 }
 
 ProjectionMap ProjectionOcclusionSafe::RemoveOccludedPointsFromMap(
-    ProjectionMap& projection_map_orig) const {
-  uint64_t u_max = image_->cols;
-  uint64_t v_max = image_->rows;
-  ProjectionMap projection_map_to_keep;
+    const ProjectionMap& projection_map) const {
+  uint64_t u_max = projection_map.GetWidth();
+  uint64_t v_max = projection_map.GetHeight();
+
+  // get the start coordinates of all windows
+  std::vector<std::pair<uint64_t, uint64_t>> windows;
   for (uint64_t v = 0; v < v_max; v += window_stride_) {
     for (uint64_t u = 0; u < u_max; u += window_stride_) {
-      CheckOcclusionsInWindow(projection_map_to_keep, projection_map_orig, u,
-                              v);
+      windows.emplace_back(u, v);
+    }
+  }
+
+  // each thread stores the points it keeps in its own vector. Windows overlap,
+  // so a point can be kept by more than one window, but it is always added
+  // with the same id and depth
+  int n_threads = beam::GetNumThreads(num_threads_, windows.size());
+  std::vector<std::vector<ProjectedPoint>> points_to_keep(n_threads);
+  beam::ParallelForChunks(
+      windows.size(), n_threads, [&](int thread_id, size_t begin, size_t end) {
+        std::vector<ProjectedPoint> window_points;
+        window_points.reserve(window_size_ * window_size_);
+        for (size_t i = begin; i < end; i++) {
+          CheckOcclusionsInWindow(projection_map, windows[i].first,
+                                  windows[i].second, window_points,
+                                  points_to_keep[thread_id]);
+        }
+      });
+
+  ProjectionMap projection_map_to_keep(u_max, v_max);
+  for (const auto& points : points_to_keep) {
+    for (const auto& p : points) {
+      projection_map_to_keep.Add(p.u, p.v, p.id, p.depth);
     }
   }
   return projection_map_to_keep;
 }
 
 void ProjectionOcclusionSafe::CheckOcclusionsInWindow(
-    ProjectionMap& projection_map_to_keep, ProjectionMap& projection_map,
-    uint64_t u_start, uint64_t v_start) const {
-  // map: distance -> {u, v, id}
-  std::map<float, ProjectedPoint> points;
-  for (uint64_t v = v_start; v < v_start + window_size_; v++) {
-    for (uint64_t u = u_start; u < u_start + window_size_; u++) {
+    const ProjectionMap& projection_map, uint64_t u_start, uint64_t v_start,
+    std::vector<ProjectedPoint>& window_points,
+    std::vector<ProjectedPoint>& points_to_keep) const {
+  uint64_t u_end =
+      std::min<uint64_t>(u_start + window_size_, projection_map.GetWidth());
+  uint64_t v_end =
+      std::min<uint64_t>(v_start + window_size_, projection_map.GetHeight());
+  window_points.clear();
+  ProjectedPointMeta point_meta(0, 0);
+  for (uint64_t v = v_start; v < v_end; v++) {
+    for (uint64_t u = u_start; u < u_end; u++) {
       // get point id projected to this pixel. If none exists, then skip pixel
-      ProjectedPointMeta point_meta(0, 0);
       if (!projection_map.Get(u, v, point_meta)) { continue; }
-
-      // add point to sorted map
-      points.emplace(point_meta.depth,
-                     ProjectedPoint{.u = u, .v = v, .id = point_meta.id});
+      window_points.push_back(ProjectedPoint{
+          .u = u, .v = v, .id = point_meta.id, .depth = point_meta.depth});
     }
   }
 
-  if (points.empty()) { return; }
-
-  // add the first point as we know it'll have the lowest depth
-  projection_map_to_keep.Add(points.begin()->second.u, points.begin()->second.v,
-                             points.begin()->second.id, points.begin()->first);
-
-  // iterate through map sorted by distance and colorize all points up until
-  // there's a jump in distance more than the threshold. Keep others in map to
-  // be revisited in another window.
-  for (auto curr_iter = std::next(points.begin()); curr_iter != points.end();
-       curr_iter++) {
-    auto prev_iter = std::prev(curr_iter);
-    if (curr_iter->first - prev_iter->first < depth_seg_thresh_m_) {
-      projection_map.Erase(curr_iter->second.u, curr_iter->second.v);
-      projection_map_to_keep.Add(curr_iter->second.u, curr_iter->second.v,
-                                 curr_iter->second.id, curr_iter->second.depth);
-    } else {
+  if (window_points.empty()) { return; }
+
+  // build a min heap on depth so that we only sort the points up until the
+  // first jump in depth, instead of the whole window
+  auto further = [](const ProjectedPoint& p1, const ProjectedPoint& p2) {
+    return p1.depth > p2.depth;
+  };
+  auto heap_end = window_points.end();
+  std::make_heap(window_points.begin(), heap_end, further);
+
+  // keep the closest point, then all points up until there's a jump in
+  // distance more than the threshold. Points past the jump may still be kept
+  // by another window.
+  double prev_depth = window_points.front().depth;
+  while (heap_end != window_points.begin()) {
+    const ProjectedPoint& closest = window_points.front();
+    if (heap_end != window_points.end() &&
+        closest.depth - prev_depth >= depth_seg_thresh_m_) {
       break;
     }
+    prev_depth = closest.depth;
+    points_to_keep.push_back(closest);
+    std::pop_heap(window_points.begin(), heap_end, further);
+    heap_end--;
   }
 }
 
@@ -120,4 +156,8 @@ void ProjectionOcclusionSafe::SetDepthThreshold(double depth_seg_thresh_m) {
   depth_seg_thresh_m_ = depth_seg_thresh_m;
 }
 
+void ProjectionOcclusionSafe::SetNumThreads(int num_threads) {
+  num_threads_ = num_threads;
+}
+
 } // namespace beam_colorize
@@ -10,6 +10,7 @@
 #include <pcl/io/pcd_io.h>
 
 #include <beam_calibration/Radtan.h>
+#include <beam_colorize/BatchColorizer.h>
 #include <beam_colorize/Projection.h>
 #include <beam_colorize/RayTrace.h>
 
@@ -132,3 +133,122 @@ TEST_CASE("Test setter functions") {
   REQUIRE_NOTHROW(raytrace.SetImage(image));
   REQUIRE_NOTHROW(raytrace.SetIntrinsics(model));
 }
+
+TEST_CASE("Test sparse and dense projection maps") {
+  beam_colorize::ProjectionMap sparse;
+  beam_colorize::ProjectionMap dense(640, 480);
+  beam_colorize::ProjectionMap dense_lists(640, 480, 3);
+  REQUIRE(!sparse.IsDense());
+  REQUIRE(dense.IsDense());
+
+  for (auto* map : {&sparse, &dense, &dense_lists}) {
+    map->Add(10, 20, 0, 5.0);
+    map->Add(10, 20, 1, 3.0);
+    map->Add(10, 20, 2, 4.0);
+    map->Add(10, 20, 3, 6.0);
+    map->Add(639, 479, 4, 1.0);
+    map->Add(600, 10, 5, 2.0);
+    map->Erase(600, 10);
+    REQUIRE(map->Size() == 2);
+
+    beam_colorize::ProjectedPointMeta meta(0, 0);
+    REQUIRE(map->Get(10, 20, meta));
+    REQUIRE(meta.id == 1);
+    REQUIRE(meta.depth == Approx(3.0));
+    REQUIRE(!map->Get(20, 10, meta));
+    REQUIRE(!map->Get(600, 10, meta));
+
+    int num_visited = 0;
+    map->ForEach([&](uint64_t u, uint64_t v,
+                     const beam_colorize::ProjectedPointMeta& point_meta) {
+      num_visited++;
+      beam_colorize::ProjectedPointMeta expected(0, 0);
+      REQUIRE(map->Get(u, v, expected));
+      REQUIRE(point_meta.id == expected.id);
+    });
+    REQUIRE(num_visited == 2);
+  }
+
+  // points outside the image are ignored by dense maps
+  dense.Add(640, 0, 6, 1.0);
+  dense.Add(0, 480, 7, 1.0);
+  REQUIRE(dense.Size() == 2);
+  REQUIRE_THROWS(dense.VBegin());
+
+  // short lists keep the closest points sorted by depth
+  std::vector<beam_colorize::ProjectedPointMeta> metas;
+  REQUIRE(dense_lists.GetAll(10, 20, metas));
+  REQUIRE(metas.size() == 3);
+  REQUIRE(metas[0].id == 1);
+  REQUIRE(metas[1].id == 2);
+  REQUIRE(metas[2].id == 0);
+  REQUIRE(dense.GetAll(10, 20, metas));
+  REQUIRE(metas.size() == 1);
+}
+
+TEST_CASE("Test batch colorization") {
+  std::string current_file_path = "colorize_test.cpp";
+  std::string cur_dir = __FILE__;
+  cur_dir.erase(cur_dir.end() - current_file_path.length(), cur_dir.end());
+  std::shared_ptr<beam_calibration::CameraModel> model =
+      std::make_shared<beam_calibration::Radtan>(cur_dir +
+                                                 "test_data/camera0.json");
+
+  // plane in front of the camera, and a point behind it
+  PointCloud map;
+  for (float x = -0.5; x <= 0.5; x += 0.1) {
+    for (float y = -0.5; y <= 0.5; y += 0.1) {
+      map.push_back(pcl::PointXYZ(x, y, 5));
+    }
+  }
+  map.push_back(pcl::PointXYZ(0, 0, -5));
+
+  // second camera is 1 m further back than the first
+  Eigen::Matrix4d T_CAM1_WORLD = Eigen::Matrix4d::Identity();
+  Eigen::Matrix4d T_CAM2_WORLD = Eigen::Matrix4d::Identity();
+  T_CAM2_WORLD(2, 3) = 1;
+  cv::Mat image1(model->GetHeight(), model->GetWidth(), CV_8UC3,
+                 cv::Scalar(10, 20, 30));
+  cv::Mat image2(model->GetHeight(), model->GetWidth(), CV_8UC3,
+                 cv::Scalar(30, 40, 50));
+
+  beam_colorize::BatchColorizer::Params params;
+  params.image_distorted = false;
+  params.cell_size_m = 0.25;
+  params.fusion_type = beam_colorize::ColorFusionType::NEAREST_VIEW;
+  beam_colorize::BatchColorizer nearest(params);
+  REQUIRE(nearest.AddView(image1, T_CAM1_WORLD, model));
+  REQUIRE(nearest.AddView(image2, T_CAM2_WORLD, model));
+  REQUIRE(!nearest.AddView(cv::Mat(10, 10, CV_8UC3), T_CAM1_WORLD, model));
+  REQUIRE(nearest.NumViews() == 2);
+
+  params.fusion_type = beam_colorize::ColorFusionType::MEAN;
+  beam_colorize::BatchColorizer mean(params);
+  mean.AddView(image1, T_CAM1_WORLD, model);
+  mean.AddView(image2, T_CAM2_WORLD, model);
+
+  PointCloudCol::Ptr nearest_colored = nearest.Colorize(map);
+  PointCloudCol::Ptr mean_colored = mean.Colorize(map);
+  REQUIRE(nearest_colored->size() == map.size());
+  REQUIRE(mean_colored->size() == map.size());
+  for (size_t i = 0; i < map.size() - 1; i++) {
+    const auto& p_nearest = nearest_colored->points[i];
+    REQUIRE(p_nearest.b == 10);
+    REQUIRE(p_nearest.g == 20);
+    REQUIRE(p_nearest.r == 30);
+    const auto& p_mean = mean_colored->points[i];
+    REQUIRE(p_mean.b == 20);
+    REQUIRE(p_mean.g == 30);
+    REQUIRE(p_mean.r == 40);
+  }
+  REQUIRE(nearest_colored->points.back().r == 0);
+  REQUIRE(mean_colored->points.back().r == 0);
+
+  // invalid cell size leaves the map uncolored
+  params.cell_size_m = 0;
+  beam_colorize::BatchColorizer invalid(params);
+  invalid.AddView(image1, T_CAM1_WORLD, model);
+  PointCloudCol::Ptr invalid_colored = invalid.Colorize(map);
+  REQUIRE(invalid_colored->size() == map.size());
+  REQUIRE(invalid_colored->points.front().r == 0);
+}
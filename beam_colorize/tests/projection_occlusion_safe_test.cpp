@@ -1,6 +1,8 @@
 #define CATCH_CONFIG_MAIN
 
 #include <iostream>
+#include <set>
+#include <tuple>
 #include <typeinfo>
 
 #include <boost/filesystem.hpp>
@@ -313,6 +315,91 @@ TEST_CASE("Test mask colorization") {
   SaveMap(defect_map_in_map_frame, "projection_occlusion_safe_mask.pcd");
 }
 
+TEST_CASE("parallel occlusion check matches a serial reference") {
+  std::shared_ptr<beam_calibration::CameraModel> camera_model =
+      beam_calibration::CameraModel::Create(intrinsics_path_);
+
+  // background wall with overlapping occluders in front of it, in the camera
+  // frame
+  PointCloudCol::Ptr cloud = std::make_shared<PointCloudCol>();
+  auto add_plane = [&](double depth, double x_min, double x_max, double y_min,
+                       double y_max, double step) {
+    for (double x = x_min; x < x_max; x += step) {
+      for (double y = y_min; y < y_max; y += step) {
+        PointTypeCol p;
+        p.x = x;
+        p.y = y;
+        p.z = depth;
+        cloud->push_back(p);
+      }
+    }
+  };
+  add_plane(10, -8, 8, -6, 6, 0.03);
+  add_plane(4, -2, 1, -2, 1, 0.01);
+  add_plane(3, 0, 2, 0, 2, 0.01);
+  add_plane(3.1, -1, 0.5, 0.5, 1.5, 0.01);
+
+  uint8_t window_size = 20;
+  uint8_t window_stride = 15;
+  double depth_threshold = 0.2;
+
+  // serial reference: project all points, then in each window keep points in
+  // order of increasing depth until the first jump in depth
+  uint64_t width = camera_model->GetWidth();
+  uint64_t height = camera_model->GetHeight();
+  beam_colorize::ProjectionMap initial_map(width, height);
+  for (uint32_t i = 0; i < cloud->size(); i++) {
+    Eigen::Vector3d point(cloud->at(i).x, cloud->at(i).y, cloud->at(i).z);
+    bool in_image = false;
+    Eigen::Vector2d coords;
+    if (!camera_model->ProjectPoint(point, coords, in_image) || !in_image) {
+      continue;
+    }
+    initial_map.Add(static_cast<uint64_t>(round(coords[0])),
+                    static_cast<uint64_t>(round(coords[1])), i, point.norm());
+  }
+  std::set<std::tuple<uint64_t, uint64_t, uint64_t>> expected;
+  for (uint64_t v0 = 0; v0 < height; v0 += window_stride) {
+    for (uint64_t u0 = 0; u0 < width; u0 += window_stride) {
+      std::vector<std::tuple<double, uint64_t, uint64_t, uint64_t>> points;
+      for (uint64_t v = v0; v < std::min(v0 + window_size, height); v++) {
+        for (uint64_t u = u0; u < std::min(u0 + window_size, width); u++) {
+          beam_colorize::ProjectedPointMeta meta(0, 0);
+          if (initial_map.Get(u, v, meta)) {
+            points.emplace_back(meta.depth, u, v, meta.id);
+          }
+        }
+      }
+      std::sort(points.begin(), points.end());
+      for (size_t i = 0; i < points.size(); i++) {
+        const auto& [depth, u, v, id] = points[i];
+        if (i > 0 && depth - std::get<0>(points[i - 1]) >= depth_threshold) {
+          break;
+        }
+        expected.emplace(u, v, id);
+      }
+    }
+  }
+  REQUIRE(expected.size() > 0);
+  REQUIRE(expected.size() < static_cast<size_t>(initial_map.Size()));
+
+  beam_colorize::ProjectionOcclusionSafe colorizer;
+  colorizer.SetIntrinsics(camera_model);
+  colorizer.SetWindowSize(window_size);
+  colorizer.SetWindowStride(window_stride);
+  colorizer.SetDepthThreshold(depth_threshold);
+  for (int num_threads : {1, 4}) {
+    colorizer.SetNumThreads(num_threads);
+    beam_colorize::ProjectionMap map = colorizer.CreateProjectionMap(cloud);
+    std::set<std::tuple<uint64_t, uint64_t, uint64_t>> kept;
+    map.ForEach([&](uint64_t u, uint64_t v,
+                    const beam_colorize::ProjectedPointMeta& meta) {
+      kept.emplace(u, v, meta.id);
+    });
+    REQUIRE(kept == expected);
+  }
+}
+
 /*
 TEST_CASE("param searching") {
   // get map path
@@ -4,8 +4,10 @@
 
 #pragma once
 
+#include <cmath>
 #include <functional>
 #include <type_traits>
+#include <vector>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/opencv.hpp>
@@ -17,9 +19,69 @@
 #include <beam_calibration/CameraModel.h>
 #include <beam_containers/PointBridge.h>
 #include <beam_utils/kdtree.h>
+#include <beam_utils/parallel.h>
 #include <beam_utils/utils.h>
 
 namespace beam_cv {
+
+/**
+ * @brief Enum class for the search structures used to find ray hits
+ */
+enum class RaycastBackend {
+  // march each ray with nearest neighbour searches in a kd tree
+  KDTREE = 0,
+  // traverse a voxel grid of the points along each ray (see RayVoxelGrid)
+  VOXEL_GRID
+};
+
+/**
+ * @brief Uniform voxel grid for finding the first point hit by a ray, where
+ * points are treated as spheres of a given radius. Each point is stored in all
+ * voxels its sphere overlaps, so a ray only needs to check the points in the
+ * voxels it passes through, which are visited in order with a 3D DDA.
+ * Casting rays is const, so it can be done from multiple threads.
+ */
+class RayVoxelGrid {
+public:
+  /**
+   * @brief constructor
+   * @param cloud points to cast rays against
+   * @param hit_radius max distance between a ray and a point it hits
+   * @param max_num_voxels max number of voxels in the grid. The voxel size is
+   * increased if needed
+   */
+  RayVoxelGrid(const pcl::PointCloud<pcl::PointXYZ>& cloud, double hit_radius,
+               size_t max_num_voxels = 1 << 24);
+
+  /**
+   * @brief find the first point along a ray which is within the hit radius of
+   * the ray
+   * @param origin ray origin
+   * @param direction ray direction, does not need to be normalized
+   * @param max_distance max distance from the origin along the ray
+   * @return index of the point in the input cloud, or -1 if nothing is hit
+   */
+  int CastRay(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction,
+              double max_distance) const;
+
+  /**
+   * @brief get the edge length of the voxels
+   */
+  double GetVoxelSize() const { return voxel_size_; }
+
+private:
+  std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f>>
+      points_;
+  double hit_radius_;
+  double voxel_size_{1};
+  Eigen::Vector3d grid_min_{Eigen::Vector3d::Zero()};
+  Eigen::Vector3i dims_{Eigen::Vector3i::Zero()};
+
+  // points in voxel i are voxel_points_[voxel_starts_[i]:voxel_starts_[i+1]]
+  std::vector<uint32_t> voxel_starts_;
+  std::vector<uint32_t> voxel_points_;
+};
+
 /**
  * @brief Class to store a raycasting object for a specified point cloud
  * and camera model.
@@ -52,14 +114,20 @@ public:
   ~Raycast() = default;
 
   /**
-   * @brief Performs ray casting with custom behaviour on hit
-   * @param threshold threshold to determine ray contact (how far between ray
-   * tip and point is considered a hit in metres)
+   * @brief Performs ray casting with custom behaviour on hit. A ray is cast
+   * through every pixel which at least one point projects to. With the
+   * VOXEL_GRID backend, rays are cast in parallel over image rows and then
+   * behaviour is called on the calling thread in row major order, so it does
+   * not need to be thread safe.
+   * @param threshold threshold to determine ray contact. This is compared to
+   * the squared distance in metres between the ray and a point, i.e., the hit
+   * radius is sqrt(threshold)
    * @param behaviour function that determines the hit behaviour, expected
    signature:
    * {std::shared_ptr<cv::Mat>& image,
                      pcl::PointCloud<pcl::PointXYZRGB>::Ptr& cloud,
                      const int* position, int index}
+   * where position is {row, col}
    */
   template <typename func>
   void Execute(float threshold, func behaviour) {
@@ -73,7 +141,8 @@ public:
 
     // create image mask where white pixels = projection hit
     BEAM_DEBUG("creating hit mask");
-    cv::Mat1b hit_mask(model_->GetHeight(), model_->GetWidth());
+    cv::Mat1b hit_mask =
+        cv::Mat1b::zeros(model_->GetHeight(), model_->GetWidth());
     int num_hit = 0;
     for (uint32_t i = 0; i < cloud_->points.size(); i++) {
       Eigen::Vector3d point(cloud_->points[i].x, cloud_->points[i].y,
@@ -94,9 +163,80 @@ public:
       search_cloud->push_back(pcl::PointXYZ(point[0], point[1], point[2]));
     }
 
+    if (backend_ == RaycastBackend::VOXEL_GRID) {
+      ExecuteVoxelGrid(threshold, behaviour, search_cloud,
+                       search_cloud_pt_to_orig_cloud_pt, hit_mask);
+    } else {
+      ExecuteKdTree(threshold, behaviour, search_cloud,
+                    search_cloud_pt_to_orig_cloud_pt, hit_mask, num_hit);
+    }
+  }
+
+  /**
+   * @brief Backend setter
+   * @param backend search structure used to find ray hits. Default:
+   * VOXEL_GRID
+   */
+  void SetBackend(RaycastBackend backend) { backend_ = backend; }
+
+  /**
+   * @brief Number of threads setter, only used by the VOXEL_GRID backend
+   * @param num_threads number of threads. If <= 0, this will use all hardware
+   * threads
+   */
+  void SetNumThreads(int num_threads) { num_threads_ = num_threads; }
+
+  /**
+   * @brief Cloud setter
+   * @param cloud_i cloud to set
+   * @return void
+   */
+  void SetCloud(typename pcl::PointCloud<PointType>::Ptr cloud_i) {
+    cloud_ = cloud_i;
+  }
+
+  /**
+   * @brief Camera model setter
+   * @param model_i camera model to set
+   * @return void
+   */
+  void SetCameraModel(std::shared_ptr<beam_calibration::CameraModel> model_i) {
+    model_ = model_i;
+  }
+
+  /**
+   * @brief Image setter
+   * @param image_i image to set
+   * @return void
+   */
+  void SetImage(std::shared_ptr<cv::Mat> image_i) { image_ = image_i; }
+
+  /**
+   * @brief Cloud getter
+   * @return point cloud
+   */
+  typename pcl::PointCloud<PointType>::Ptr GetCloud() { return cloud_; }
+
+  /**
+   * @brief Image getter
+   * @return image
+   */
+  std::shared_ptr<cv::Mat> GetImage() { return image_; }
+
+protected:
+  /**
+   * @brief cast rays by marching them with nearest neighbour searches
+   */
+  template <typename func>
+  void ExecuteKdTree(float threshold, func& behaviour,
+                     const pcl::PointCloud<pcl::PointXYZ>::Ptr& search_cloud,
+                     const std::vector<int>& search_cloud_pt_to_orig_cloud_pt,
+                     const cv::Mat1b& hit_mask, int num_hit) {
     // create kdtree
     BEAM_DEBUG("creating kd search tree");
-    beam::KdTree<pcl::PointXYZ> kdtree(*search_cloud);
+    beam::KdTree<pcl::PointXYZ> kdtree(search_cloud);
+    std::vector<uint32_t> point_idx(1);
+    std::vector<float> point_distance(1);
 
     // cast ray for every pixel in the hit mask
     int current = 1;
@@ -123,8 +263,6 @@ public:
           search_point.z = ray(2, 0);
 
           // search for closest point to ray
-          std::vector<uint32_t> point_idx(1);
-          std::vector<float> point_distance(1);
           kdtree.nearestKSearch(search_point, 1, point_idx, point_distance);
           float distance = point_distance[0];
 
@@ -149,47 +287,63 @@ public:
   }
 
   /**
-   * @brief Cloud setter
-   * @param cloud_i cloud to set
-   * @return void
-   */
-  void SetCloud(typename pcl::PointCloud<PointType>::Ptr cloud_i) {
-    cloud_ = cloud_i;
-  }
-
-  /**
-   * @brief Camera model setter
-   * @param model_i camera model to set
-   * @return void
-   */
-  void SetCameraModel(std::shared_ptr<beam_calibration::CameraModel> model_i) {
-    model_ = model_i;
-  }
-
-  /**
-   * @brief Image setter
-   * @param image_i image to set
-   * @return void
+   * @brief cast rays through a voxel grid of the points, in parallel over
+   * image rows
    */
-  void SetImage(std::shared_ptr<cv::Mat> image_i) { image_ = image_i; }
+  template <typename func>
+  void ExecuteVoxelGrid(
+      float threshold, func& behaviour,
+      const pcl::PointCloud<pcl::PointXYZ>::Ptr& search_cloud,
+      const std::vector<int>& search_cloud_pt_to_orig_cloud_pt,
+      const cv::Mat1b& hit_mask) {
+    BEAM_DEBUG("creating voxel grid");
+    RayVoxelGrid grid(*search_cloud, std::sqrt(std::max(threshold, 0.0f)));
 
-  /**
-   * @brief Cloud getter
-   * @return point cloud
-   */
-  typename pcl::PointCloud<PointType>::Ptr GetCloud() { return cloud_; }
+    // each thread stores the hits for a contiguous block of rows, so they can
+    // be passed to behaviour in row major order after
+    struct Hit {
+      int row;
+      int col;
+      int index;
+    };
+    int n_threads = beam::GetNumThreads(num_threads_, hit_mask.rows, 16);
+    std::vector<std::vector<Hit>> hits(n_threads);
+    beam::ParallelForChunks(
+        hit_mask.rows, n_threads, [&](int thread_id, size_t begin, size_t end) {
+          Eigen::Vector3d origin(0, 0, 0);
+          for (int row = begin; row < static_cast<int>(end); row++) {
+            for (int col = 0; col < hit_mask.cols; col++) {
+              if (hit_mask.at<uchar>(row, col) != 255) { continue; }
+              Eigen::Vector3d direction;
+              if (!model_->BackProject(Eigen::Vector2i(col, row), direction)) {
+                continue;
+              }
+              int index = grid.CastRay(origin, direction, max_ray_dist_m_);
+              if (index >= 0) { hits[thread_id].push_back({row, col, index}); }
+            }
+          }
+        });
 
-  /**
-   * @brief Image getter
-   * @return image
-   */
-  std::shared_ptr<cv::Mat> GetImage() { return image_; }
+    int num_extracted = 0;
+    for (const auto& thread_hits : hits) {
+      for (const Hit& hit : thread_hits) {
+        int position[2];
+        position[0] = hit.row;
+        position[1] = hit.col;
+        behaviour(image_, cloud_, position,
+                  search_cloud_pt_to_orig_cloud_pt[hit.index]);
+        num_extracted++;
+      }
+    }
+    BEAM_DEBUG("{} rays hit the cloud", num_extracted);
+  }
 
-protected:
   typename pcl::PointCloud<PointType>::Ptr cloud_;
   std::shared_ptr<beam_calibration::CameraModel> model_;
   std::shared_ptr<cv::Mat> image_;
   int max_ray_extensions_;
   double max_ray_dist_m_;
+  RaycastBackend backend_{RaycastBackend::VOXEL_GRID};
+  int num_threads_{0};
 };
 } // namespace beam_cv
@@ -52,6 +52,26 @@ inline std::string GetDetectorTypes() {
  */
 class Detector {
 public:
+  /**
+   * @brief Params for how the image grid is processed by DetectFeatures. These
+   * apply to all detector types.
+   */
+  struct GridParams {
+    // number of threads used to detect features in the grid cells. Each extra
+    // thread detects with its own copy of the detector, see Clone. If <= 0,
+    // this will use all hardware threads
+    int num_threads{1};
+
+    // max number of keypoints kept in each cell, by strongest response. If <=
+    // 0, all keypoints returned by the detector are kept
+    int max_features_per_cell{0};
+
+    // keypoints within this many pixels of a stronger keypoint from another
+    // cell are removed, so that features are not duplicated on cell borders.
+    // If <= 0, no suppression is done
+    float border_nms_radius{0};
+  };
+
   /**
    * @brief Default constructor
    */
@@ -68,11 +88,24 @@ public:
 
   /** @brief Gridded feature keypoint detection. Calls DetectLocalFeatures
    * defined in each derived class.  Returns a max of num_features_ keypoints.
+   * Cells cover the full image and are processed in parallel, see GridParams.
+   * Keypoints are returned in order of their cells (row major), so the result
+   * does not depend on the number of threads.
    *  @param image the image to detect features in.
    *  @return a vector of the detected keypoints.
    */
   std::vector<cv::KeyPoint> DetectFeatures(const cv::Mat& image);
 
+  /** @brief Sets the params for processing the image grid
+   *  @param params see GridParams
+   */
+  void SetGridParams(const GridParams& params) { grid_params_ = params; }
+
+  /** @brief Gets the params for processing the image grid
+   *  @return see GridParams
+   */
+  const GridParams& GetGridParams() const { return grid_params_; }
+
   /** @brief Gets the string representation of the type of descriptor
    *  @return string of descriptor type
    */
@@ -83,10 +116,18 @@ public:
    */
   virtual DetectorType GetType() const = 0;
 
+  /** @brief Creates a new detector with the same params and grid params. The
+   * new detector does not share any OpenCV objects with this one, so both can
+   * be used at the same time from different threads
+   *  @return new detector
+   */
+  virtual std::shared_ptr<Detector> Clone() const = 0;
+
 private:
   /** @brief Detects keypoints in an image/grid space. Calls a different
    * detector depending on the derived class.  Returns a max of num_features
-   * divided by grid spaces keypoints
+   * divided by grid spaces keypoints. When GridParams::num_threads != 1,
+   * each thread calls this on its own detector from Clone.
    *  @param image the image to detect features in.
    *  @return a vector of the detected keypoints.
    */
@@ -95,6 +136,7 @@ private:
 
   int grid_cols_ = 3;
   int grid_rows_ = 2;
+  GridParams grid_params_;
 };
 
 } // namespace beam_cv
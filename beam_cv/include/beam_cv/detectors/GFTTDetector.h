@@ -81,6 +81,11 @@ public:
    */
   DetectorType GetType() const { return DetectorType::GFTT; }
 
+  /** @brief Creates a new detector with the same params, see Detector::Clone
+   *  @return new detector
+   */
+  std::shared_ptr<Detector> Clone() const;
+
 private:
   // this gets called in each constructor
   void Setup();
@@ -8,6 +8,7 @@
 
 #include <beam_calibration/CameraModel.h>
 #include <beam_cv/Utils.h>
+#include <beam_cv/geometry/Ransac.h>
 #include <beam_utils/optional.h>
 
 namespace beam_cv {
@@ -43,10 +44,12 @@ public:
    * @param points 3d locations of features
    * @param seed to seed the random number generator, default value of -1 will
    * use time as seed
-   * @param max_iterations number of ransac iterations to perform
+   * @param max_iterations number of ransac iterations to perform. All of them
+   * are performed, use the RansacParams overload to stop once the inlier
+   * ratio is high enough
    * @param inlier_threshold pixel distance to count an inlier as
    * @returns Transformation matrix in the reference frame the points are given
-   * in
+   * in, identity if no pose was found
    *
    */
   static Eigen::Matrix4d RANSACEstimator(
@@ -55,6 +58,22 @@ public:
       const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points,
       int max_iterations = 100, double inlier_threshold = 5.0, int seed = -1);
 
+  /**
+   * @brief RANSAC wrapper for P3PEstimator, see above
+   * @param cam camera model for image
+   * @param pixels detected pixel locations of features
+   * @param points 3d locations of features
+   * @param params see RansacParams
+   * @param inlier_threshold pixel distance to count an inlier as
+   * @returns Transformation matrix in the reference frame the points are given
+   * in, if a pose with at least one inlier was found
+   */
+  static beam::opt<Eigen::Matrix4d> RANSACEstimator(
+      const std::shared_ptr<beam_calibration::CameraModel>& cam,
+      const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
+      const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points,
+      const RansacParams& params, double inlier_threshold = 5.0);
+
   /**
    * @brief P3P helper -- eigen decomp of a matrix which is known to have a 0
    * eigen value.
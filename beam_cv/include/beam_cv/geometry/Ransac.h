@@ -0,0 +1,417 @@
+/** @file
+ * @ingroup cv
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+
+#include <beam_utils/parallel.h>
+
+namespace beam_cv {
+
+/**
+ * @brief Params for Ransac
+ */
+struct RansacParams {
+  /// max number of samples to draw
+  int max_iterations{100};
+
+  /// probability that at least one sample only has inliers. Once enough
+  /// samples were drawn to reach this for the best inlier ratio so far, no
+  /// more samples are drawn. If <= 0 or >= 1, all max_iterations samples are
+  /// drawn
+  double confidence{0.99};
+
+  /// seed for the random number generator, -1 will use time as seed
+  int seed{-1};
+
+  /// number of threads. If <= 0, this will use all hardware threads
+  int num_threads{0};
+
+  /// use preemptive scoring: all max_iterations samples are drawn first, then
+  /// all models are scored on the same blocks of the data and the worse half
+  /// is dropped after each block, until one model is left. This scores far
+  /// fewer data than scoring every model on all the data, but the result is
+  /// not always the model with the most inliers. confidence is not used
+  bool preemptive{false};
+};
+
+/**
+ * @brief Generic RANSAC engine. Samples are sets of indices into the data,
+ * and each sample gets its own random number generator seeded from the seed
+ * and the sample number, so samples do not depend on the number of threads.
+ * Samples are drawn and scored in parallel in batches, and after each batch
+ * the number of samples needed to reach the confidence with the best inlier
+ * ratio so far is updated.
+ *
+ * Models are scored on blocks of the data, with an early bail-out once a
+ * model can not have more inliers than the best model so far. This never
+ * changes the result: the best model is the one with the most inliers, and
+ * ties go to the earliest sample, as with a serial loop.
+ *
+ * With RansacParams::preemptive, models are instead compared with each other
+ * on the same blocks of the data (visited in random order) and only the
+ * better half is kept after each block, see Nister, "Preemptive RANSAC for
+ * live structure and motion estimation".
+ *
+ * @tparam Model type of the estimated model, e.g. a pose
+ */
+template <typename Model>
+class Ransac {
+public:
+  using Models = std::vector<Model, Eigen::aligned_allocator<Model>>;
+
+  /// max number of data scored at once, see Run
+  static constexpr size_t k_block_size{64};
+
+  struct Result {
+    /// best model, only valid if num_inliers >= 0
+    Model model;
+
+    /// number of inliers of the best model, -1 if no model was found
+    int num_inliers{-1};
+
+    /// number of samples drawn
+    int num_iterations{0};
+  };
+
+  /**
+   * @brief Runs RANSAC. Both functions are called from multiple threads at
+   * once, so they must be thread safe.
+   * @param num_data number of data (e.g. correspondences)
+   * @param sample_size number of data in each sample
+   * @param params see RansacParams
+   * @param solve callable with signature void(const std::vector<uint32_t>&,
+   * Models&) which adds the models fit to the data with the given indices.
+   * The models are cleared before each call
+   * @param score callable with signature int(const Model&, size_t, size_t)
+   * which returns the number of inliers of a model among the data in [begin,
+   * end). Ranges are never larger than k_block_size
+   * @return best model
+   */
+  template <typename SolveFunc, typename ScoreFunc>
+  static Result Run(size_t num_data, size_t sample_size,
+                    const RansacParams& params, SolveFunc&& solve,
+                    ScoreFunc&& score) {
+    uint64_t seed = params.seed;
+    if (params.seed == -1) {
+      seed = std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+    seed = Random::Mix(seed);
+    auto draw_sample = [&](int iteration, std::vector<uint32_t>& sample) {
+      Random random(Random::Mix(seed + iteration));
+      DrawSample(random, num_data, sample);
+    };
+    return Run(num_data, sample_size, params, draw_sample, solve, score);
+  }
+
+  /**
+   * @brief Runs RANSAC with samples given by draw_sample instead of the
+   * random number generator, so params.seed is not used. See above
+   * @param draw_sample callable with signature void(int,
+   * std::vector<uint32_t>&) which fills the sample (of size sample_size) for
+   * the given iteration. This is called from multiple threads at once
+   */
+  template <typename SampleFunc, typename SolveFunc, typename ScoreFunc>
+  static Result Run(size_t num_data, size_t sample_size,
+                    const RansacParams& params, SampleFunc&& draw_sample,
+                    SolveFunc&& solve, ScoreFunc&& score) {
+    Result result;
+    if (sample_size == 0 || num_data < sample_size ||
+        params.max_iterations <= 0) {
+      return result;
+    }
+    if (params.preemptive) {
+      return RunPreemptive(num_data, sample_size, params, draw_sample, solve,
+                           score);
+    }
+
+    // best model found by each thread, and buffers reused for all samples
+    struct ThreadState {
+      Model model;
+      int num_inliers{-1};
+      int iteration{0};
+      std::vector<uint32_t> sample;
+      Models models;
+    };
+    int max_threads = beam::GetNumThreads(
+        params.num_threads, k_iterations_per_batch * num_data,
+        k_min_scores_per_thread);
+    std::vector<ThreadState, Eigen::aligned_allocator<ThreadState>> states(
+        max_threads);
+    for (auto& state : states) { state.sample.resize(sample_size); }
+
+    // only used to stop scoring models early, so this can be updated by
+    // threads in any order
+    std::atomic<int> best_inliers{-1};
+
+    int required_iterations = params.max_iterations;
+    while (result.num_iterations < required_iterations) {
+      const int batch_begin = result.num_iterations;
+      const int batch_size = std::min(k_iterations_per_batch,
+                                      required_iterations - batch_begin);
+      const int n_threads = std::min(max_threads, batch_size);
+      beam::ParallelForChunks(
+          batch_size, n_threads, [&](int thread_id, size_t begin, size_t end) {
+            ThreadState& state = states[thread_id];
+            for (size_t b = begin; b < end; b++) {
+              const int iteration = batch_begin + static_cast<int>(b);
+              draw_sample(iteration, state.sample);
+              state.models.clear();
+              solve(state.sample, state.models);
+              for (const Model& model : state.models) {
+                int inliers = Score(model, num_data, score, best_inliers);
+                // samples are processed in order by each thread, so only a
+                // strictly better model replaces the best
+                if (inliers <= state.num_inliers) { continue; }
+                state.model = model;
+                state.num_inliers = inliers;
+                state.iteration = iteration;
+                int best = best_inliers.load(std::memory_order_relaxed);
+                while (inliers > best &&
+                       !best_inliers.compare_exchange_weak(best, inliers)) {}
+              }
+            }
+          });
+      result.num_iterations += batch_size;
+
+      // merge the best models of all threads, ties go to the earliest sample
+      result.num_inliers = -1;
+      int best_iteration = 0;
+      for (const ThreadState& state : states) {
+        if (state.num_inliers < 0) { continue; }
+        if (state.num_inliers > result.num_inliers ||
+            (state.num_inliers == result.num_inliers &&
+             state.iteration < best_iteration)) {
+          result.model = state.model;
+          result.num_inliers = state.num_inliers;
+          best_iteration = state.iteration;
+        }
+      }
+
+      if (result.num_inliers > 0 && params.confidence > 0 &&
+          params.confidence < 1) {
+        required_iterations = std::min(
+            required_iterations,
+            RequiredIterations(static_cast<double>(result.num_inliers) /
+                                   num_data,
+                               sample_size, params.confidence));
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @brief Gets the number of samples needed so that with the given
+   * probability at least one sample only has inliers
+   * @param inlier_ratio ratio of inliers in the data
+   * @param sample_size number of data in each sample
+   * @param confidence probability in (0, 1)
+   * @return number of samples, or INT_MAX if it can not be reached
+   */
+  static int RequiredIterations(double inlier_ratio, size_t sample_size,
+                                double confidence) {
+    double all_inliers = std::pow(inlier_ratio, sample_size);
+    if (all_inliers >= 1) { return 1; }
+    double iterations = std::log(1 - confidence) / std::log1p(-all_inliers);
+    if (!std::isfinite(iterations) ||
+        iterations >= std::numeric_limits<int>::max()) {
+      return std::numeric_limits<int>::max();
+    }
+    return std::max(1, static_cast<int>(std::ceil(iterations)));
+  }
+
+  /**
+   * @brief Draws samples with std::rand the way the pose estimators did
+   * before this class was added: each index is picked among the data not yet
+   * in the sample, after seeding with std::srand. The legacy estimator
+   * overloads use these so that seeded calls give the same samples as
+   * before. std::rand is global, so this must only be called from one thread
+   * @param num_data number of data
+   * @param sample_size number of data in each sample
+   * @param num_samples number of samples to draw
+   * @param seed seed for std::srand, -1 will use time as seed
+   * @return indices of all samples, sample_size per sample
+   */
+  static std::vector<uint32_t> LegacySamples(size_t num_data,
+                                             size_t sample_size,
+                                             int num_samples, int seed) {
+    std::srand(seed == -1 ? std::time(nullptr) : seed);
+    std::vector<uint32_t> samples;
+    samples.reserve(num_samples * sample_size);
+    std::vector<uint32_t> sorted;
+    for (int s = 0; s < num_samples; s++) {
+      sorted.clear();
+      for (size_t i = 0; i < sample_size; i++) {
+        // the n-th remaining index skips all smaller sampled indices
+        uint32_t index = std::rand() % (num_data - i);
+        auto it = sorted.begin();
+        for (; it != sorted.end() && *it <= index; it++) { index++; }
+        sorted.insert(it, index);
+        samples.push_back(index);
+      }
+    }
+    return samples;
+  }
+
+private:
+  /// number of samples drawn between updates of the required iterations
+  static constexpr int k_iterations_per_batch{32};
+
+  /// minimum number of data scored by each thread in a batch, assuming one
+  /// model per sample
+  static constexpr size_t k_min_scores_per_thread{4096};
+
+  /**
+   * @brief small random number generator (splitmix64) which is cheap enough
+   * to create for every sample
+   */
+  class Random {
+  public:
+    explicit Random(uint64_t state) : state_(state) {}
+
+    uint64_t operator()() { return Mix(state_ += 0x9e3779b97f4a7c15); }
+
+    static uint64_t Mix(uint64_t z) {
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      return z ^ (z >> 31);
+    }
+
+  private:
+    uint64_t state_;
+  };
+
+  /**
+   * @brief draws distinct indices in [0, num_data) into sample
+   */
+  static void DrawSample(Random& random, size_t num_data,
+                         std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size();) {
+      uint32_t index = random() % num_data;
+      if (std::find(sample.begin(), sample.begin() + i, index) ==
+          sample.begin() + i) {
+        sample[i++] = index;
+      }
+    }
+  }
+
+  /**
+   * @brief Runs preemptive RANSAC, see RansacParams::preemptive. Ties go to
+   * the earliest sample
+   */
+  template <typename SampleFunc, typename SolveFunc, typename ScoreFunc>
+  static Result RunPreemptive(size_t num_data, size_t sample_size,
+                              const RansacParams& params,
+                              SampleFunc& draw_sample, SolveFunc& solve,
+                              ScoreFunc& score) {
+    Result result;
+    result.num_iterations = params.max_iterations;
+
+    // models of each sample, so they can be merged in sample order
+    std::vector<Models> sample_models(params.max_iterations);
+    int n_threads =
+        beam::GetNumThreads(params.num_threads, params.max_iterations);
+    std::vector<std::vector<uint32_t>> samples(
+        n_threads, std::vector<uint32_t>(sample_size));
+    beam::ParallelForChunks(
+        params.max_iterations, n_threads,
+        [&](int thread_id, size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            draw_sample(static_cast<int>(i), samples[thread_id]);
+            solve(samples[thread_id], sample_models[i]);
+          }
+        });
+    Models models;
+    for (const Models& m : sample_models) {
+      models.insert(models.end(), m.begin(), m.end());
+    }
+    if (models.empty()) { return result; }
+
+    // models still in the running, as indices into models
+    struct Candidate {
+      size_t model;
+      int inliers;
+    };
+    std::vector<Candidate> candidates(models.size());
+    for (size_t i = 0; i < models.size(); i++) { candidates[i] = {i, 0}; }
+
+    // visit blocks in random order, so the data order does not matter
+    uint64_t seed = params.seed;
+    if (params.seed == -1) {
+      seed = std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+    Random random(Random::Mix(seed));
+    std::vector<size_t> blocks((num_data + k_block_size - 1) / k_block_size);
+    for (size_t i = 0; i < blocks.size(); i++) { blocks[i] = i; }
+    for (size_t i = blocks.size(); i > 1; i--) {
+      std::swap(blocks[i - 1], blocks[random() % i]);
+    }
+
+    size_t num_blocks = 0;
+    while (num_blocks < blocks.size() && candidates.size() > 1) {
+      size_t begin = blocks[num_blocks++] * k_block_size;
+      size_t end = std::min(begin + k_block_size, num_data);
+      int threads = beam::GetNumThreads(params.num_threads,
+                                        candidates.size() * (end - begin),
+                                        k_min_scores_per_thread);
+      beam::ParallelForChunks(
+          candidates.size(), threads, [&](int, size_t c_begin, size_t c_end) {
+            for (size_t c = c_begin; c < c_end; c++) {
+              candidates[c].inliers +=
+                  score(models[candidates[c].model], begin, end);
+            }
+          });
+      std::sort(candidates.begin(), candidates.end(),
+                [](const Candidate& a, const Candidate& b) {
+                  return a.inliers > b.inliers ||
+                         (a.inliers == b.inliers && a.model < b.model);
+                });
+      candidates.resize((candidates.size() + 1) / 2);
+    }
+
+    result.model = models[candidates[0].model];
+    result.num_inliers = candidates[0].inliers;
+    if (num_blocks < blocks.size()) {
+      // the last model was only scored on some of the data
+      std::atomic<int> no_bail_out{-1};
+      result.num_inliers = Score(result.model, num_data, score, no_bail_out);
+    }
+    return result;
+  }
+
+  /**
+   * @brief scores a model block by block, with an early bail-out
+   * @return number of inliers, or -1 if scoring stopped because the model
+   * has less inliers than best_inliers
+   */
+  template <typename ScoreFunc>
+  static int Score(const Model& model, size_t num_data, ScoreFunc& score,
+                   const std::atomic<int>& best_inliers) {
+    int inliers = 0;
+    for (size_t begin = 0; begin < num_data; begin += k_block_size) {
+      size_t end = std::min(begin + k_block_size, num_data);
+      inliers += score(model, begin, end);
+      int remaining = static_cast<int>(num_data - end);
+      if (inliers + remaining <
+          best_inliers.load(std::memory_order_relaxed)) {
+        return -1;
+      }
+    }
+    return inliers;
+  }
+};
+
+} // namespace beam_cv
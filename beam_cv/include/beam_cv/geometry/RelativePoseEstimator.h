@@ -8,6 +8,7 @@
 
 #include <beam_calibration/CameraModel.h>
 #include <beam_cv/Utils.h>
+#include <beam_cv/geometry/Ransac.h>
 #include <beam_utils/optional.h>
 
 namespace beam_cv {
@@ -55,7 +56,9 @@ public:
    * @param method essential matrix estimator method
    * @param seed to seed the random number generator, default value of -1 will
    * use time as seed
-   * @param max_iterations number of ransac iterations to perform
+   * @param max_iterations number of ransac iterations to perform. All of them
+   * are performed, use the RansacParams overload to stop once the inlier
+   * ratio is high enough
    * @param inlier_threshold pixel distance to count an inlier as
    * @return transformation matrix from cam1 to cam2 (T_CAM2_CAM1)
    */
@@ -67,6 +70,25 @@ public:
       EstimatorMethod method = EstimatorMethod::EIGHTPOINT,
       int max_iterations = 100, double inlier_threshold = 5.0, int seed = -1);
 
+  /**
+   * @brief Performs RANSAC on the given estimator, see above
+   * @param cam1 camera model for image 1
+   * @param cam2 camera model for image 2
+   * @param p1_v corresponding pixels in image 1
+   * @param p2_v corresponding pixels in image 2
+   * @param method essential matrix estimator method
+   * @param params see RansacParams
+   * @param inlier_threshold pixel distance to count an inlier as
+   * @return transformation matrix from cam1 to cam2 (T_CAM2_CAM1)
+   */
+  static beam::opt<Eigen::Matrix4d> RANSACEstimator(
+      const std::shared_ptr<beam_calibration::CameraModel>& cam1,
+      const std::shared_ptr<beam_calibration::CameraModel>& cam2,
+      const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p1_v,
+      const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p2_v,
+      EstimatorMethod method, const RansacParams& params,
+      double inlier_threshold = 5.0);
+
   /**
    * @brief Computes the transformation matrix given an essential matrix
    * @param E essential matrix
@@ -38,6 +38,22 @@ public:
       const Eigen::Vector2i& p1, const Eigen::Vector2i& p2,
       const double max_dist = 100, const double reprojection_threshold = -1);
 
+  /**
+   * @brief Triangulates single point given the rays towards it from two
+   * cameras, e.g., back projected pixels. This avoids back projecting the same
+   * pixels again when triangulating with many poses.
+   * @param m1 unit ray towards the point in camera 1 frame
+   * @param m2 unit ray towards the point in camera 2 frame
+   * @param T_cam1_world transformation matrix from world to image 1 frame
+   * @param T_cam2_world transformation matrix from world to image 2 frame
+   * @param max_dist maximum distance from the camera to accept as a valid
+   * solution
+   */
+  static beam::opt<Eigen::Vector3d> TriangulateRays(
+      const Eigen::Vector3d& m1, const Eigen::Vector3d& m2,
+      const Eigen::Matrix4d& T_cam1_world, const Eigen::Matrix4d& T_cam2_world,
+      const double max_dist = 100);
+
   /**
    * @brief Triangulates single point given a single camera model and multiple
    * measurements
@@ -0,0 +1,159 @@
+/** @file
+ * @ingroup cv
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <beam_cv/matchers/Matcher.h>
+
+namespace beam_cv {
+
+/** Brute force matcher for binary descriptors (ORB, BEBLID, BRISK, ...).
+ *  Hamming distances are computed with AVX2 or the popcnt instruction when the
+ *  cpu supports them, which is checked at runtime, so the library does not
+ *  need to be compiled with -mavx2. Other cpus use a portable popcount.
+ *  Query descriptors are matched in parallel.
+ *
+ *  If a search radius is set, the keypoints of the second image are hashed
+ *  into a grid with cells of the radius size, and each query descriptor is
+ *  only compared to the keypoints within the radius of its predicted pixel.
+ *  This makes matching close to linear in the number of keypoints when
+ *  tracking, instead of comparing all pairs.
+ */
+class HammingMatcher : public Matcher {
+public:
+  struct Params {
+    /** Ratio test heuristic: a match is only accepted if the best distance is
+     * less than this times the second best distance. If >= 1, the ratio test
+     * is not used. */
+    double ratio_threshold = 0.8;
+
+    /** Max hamming distance (in bits) of an accepted match */
+    int max_distance = 64;
+
+    /** Only keep matches which are also the best match from the second image
+     * to the first */
+    bool cross_check = false;
+
+    /** Remove outliers with a fundamental matrix, see RemoveOutliers */
+    bool auto_remove_outliers = true;
+
+    /** If > 0, only keypoints within this many pixels of the predicted pixel
+     * of a query keypoint are compared. When no prediction is given, the
+     * query keypoint's own pixel is used */
+    double search_radius = 0;
+
+    /** number of threads. If <= 0, this will use all hardware threads */
+    int num_threads = 0;
+
+    // load params from json. If empty, it will use default params
+    void LoadFromJson(const std::string& config_path);
+  };
+
+  /**
+   * @brief Constructor that requires a params object
+   * @param params see struct above
+   */
+  HammingMatcher(const Params& params);
+
+  /**
+   * @brief Custom constructor. The user can also specify their own params or
+   * use default.
+   */
+  HammingMatcher(double ratio_threshold = 0.8, int max_distance = 64,
+                 bool cross_check = false, bool auto_remove_outliers = true,
+                 double search_radius = 0);
+
+  /**
+   * @brief Default destructor
+   */
+  ~HammingMatcher() override = default;
+
+  /** Remove outliers between matches using epipolar constraints
+   *
+   * @param matches the unfiltered matches computed from two images
+   * @param keypoints_1 the keypoints from the first image
+   * @param keypoints_2 the keypoints from the second image
+   *
+   * @return the filtered matches
+   */
+  std::vector<cv::DMatch> RemoveOutliers(
+      const std::vector<cv::DMatch>& matches,
+      const std::vector<cv::KeyPoint>& keypoints_1,
+      const std::vector<cv::KeyPoint>& keypoints_2) const override;
+
+  /** Matches keypoints descriptors between two images. If a search radius is
+   *  set, the pixels of keypoints_1 are used as the predicted pixels.
+   *  @param descriptors_1 CV_8U descriptors extracted from the first image.
+   *  @param descriptors_2 CV_8U descriptors extracted from the second image.
+   *  @param keypoints_1 the keypoints detected in the first image
+   *  @param keypoints_2 the keypoints detected in the second image
+   *  @param mask optional CV_8U mask of size descriptors_1.rows x
+   *  descriptors_2.rows, see Matcher::MatchDescriptors
+   *  @return vector containing the best matches.
+   */
+  std::vector<cv::DMatch>
+      MatchDescriptors(cv::Mat& descriptors_1, cv::Mat& descriptors_2,
+                       const std::vector<cv::KeyPoint>& keypoints_1,
+                       const std::vector<cv::KeyPoint>& keypoints_2,
+                       cv::InputArray mask = cv::noArray()) override;
+
+  /** Matches keypoints descriptors between two images, searching around the
+   *  predicted pixel of each keypoint in the first image, e.g., from a motion
+   *  model. The search radius must be set in the params.
+   *  @param descriptors_1 CV_8U descriptors extracted from the first image.
+   *  @param descriptors_2 CV_8U descriptors extracted from the second image.
+   *  @param keypoints_1 the keypoints detected in the first image
+   *  @param keypoints_2 the keypoints detected in the second image
+   *  @param predicted_pixels predicted pixel in the second image of each
+   *  keypoint in the first image
+   *  @return vector containing the best matches.
+   */
+  std::vector<cv::DMatch>
+      MatchDescriptors(const cv::Mat& descriptors_1,
+                       const cv::Mat& descriptors_2,
+                       const std::vector<cv::KeyPoint>& keypoints_1,
+                       const std::vector<cv::KeyPoint>& keypoints_2,
+                       const std::vector<cv::Point2f>& predicted_pixels);
+
+  /** Computes the hamming distance between two binary descriptors
+   *  @param a first descriptor
+   *  @param b second descriptor
+   *  @param num_bytes number of bytes in each descriptor
+   *  @return number of differing bits
+   */
+  static int HammingDistance(const uint8_t* a, const uint8_t* b,
+                             int num_bytes);
+
+private:
+  /** @brief Matches descriptors, see the MatchDescriptors overloads
+   *  @param predicted_pixels nullptr to compare all pairs
+   */
+  std::vector<cv::DMatch>
+      Match(const cv::Mat& descriptors_1, const cv::Mat& descriptors_2,
+            const std::vector<cv::KeyPoint>& keypoints_1,
+            const std::vector<cv::KeyPoint>& keypoints_2,
+            const std::vector<cv::Point2f>* predicted_pixels,
+            const cv::Mat& mask) const;
+
+  /** @brief Keeps matches with a distance of at most params_.max_distance
+   *  @param matches the unfiltered matches computed from two images.
+   *  @return the filtered matches.
+   */
+  std::vector<cv::DMatch>
+      FilterMatches(const std::vector<cv::DMatch>& matches) const override;
+
+  /** @brief Ratio test on the two best matches of each query descriptor
+   *  @param matches the unfiltered matches computed from two images.
+   *  @return the filtered matches.
+   */
+  std::vector<cv::DMatch> FilterMatches(
+      const std::vector<std::vector<cv::DMatch>>& matches) const override;
+
+  Params params_;
+};
+
+} // namespace beam_cv
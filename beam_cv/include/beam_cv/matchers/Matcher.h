@@ -15,17 +15,19 @@ namespace beam_cv {
 /**
  * @brief Enum class for different types of matchers
  */
-enum class MatcherType { BF = 0, FLANN };
+enum class MatcherType { BF = 0, FLANN, HAMMING };
 
   // Map for storing string input
 static std::map<std::string, MatcherType> MatcherTypeStringMap = {
     {"BF", MatcherType::BF},
-    {"FLANN", MatcherType::FLANN}};
+    {"FLANN", MatcherType::FLANN},
+    {"HAMMING", MatcherType::HAMMING}};
 
 // Map for storing int input
 static std::map<uint8_t, MatcherType> MatcherTypeIntMap = {
     {0, MatcherType::BF},
-    {1, MatcherType::FLANN}};
+    {1, MatcherType::FLANN},
+    {2, MatcherType::HAMMING}};
 
 // function for listing types of detectors available
 inline std::string GetMatcherTypes(){
@@ -1,3 +1,4 @@
 #pragma once
 #include <beam_cv/matchers/BFMatcher.h>
 #include <beam_cv/matchers/FLANNMatcher.h>
+#include <beam_cv/matchers/HammingMatcher.h>
@@ -0,0 +1,189 @@
+/**
+ * @file
+ * Asynchronous front end for feature trackers.
+ * @ingroup beam_cv
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <beam_cv/trackers/Tracker.h>
+
+namespace beam_cv {
+
+/**
+ * @brief Runs a tracker as a pipeline on two worker threads, so that images
+ * can be added without blocking the caller while they are tracked. The first
+ * stage runs Tracker::PreprocessImage (pyramid building for KLTracker,
+ * detection and description for DescMatchingTracker) and the second runs
+ * Tracker::AddPreprocessedImage (optical flow or matching, and landmark
+ * registration). While the second stage tracks one image, the first stage
+ * preprocesses the next, and images are always tracked in the order they
+ * were added.
+ *
+ * Each stage has a bounded input queue. AddImage blocks when the queue is
+ * full, and TryAddImage returns false instead so the caller can decide to
+ * drop the image.
+ *
+ * The tracks of each image are returned through a future, and optionally a
+ * callback which is called on the tracking thread. The wrapped tracker must
+ * not be used by other threads while images are pending, call WaitAll first.
+ */
+class AsyncTracker {
+public:
+  using TracksCallback = std::function<void(
+      const ros::Time& stamp, const std::vector<FeatureTrack>& tracks)>;
+
+  /**
+   * @brief constructor which starts the worker threads
+   * @param tracker tracker to run
+   * @param queue_size max number of images waiting for each stage
+   * @param callback optional function called with the tracks of each image
+   * once it has been tracked. This is called on the tracking thread, so it
+   * should return quickly
+   */
+  AsyncTracker(std::shared_ptr<Tracker> tracker, size_t queue_size = 4,
+               TracksCallback callback = nullptr);
+
+  /**
+   * @brief destructor. Waits for all added images to be tracked, then stops
+   * the worker threads
+   */
+  ~AsyncTracker();
+
+  AsyncTracker(const AsyncTracker&) = delete;
+
+  AsyncTracker& operator=(const AsyncTracker&) = delete;
+
+  /**
+   * @brief add an image to be tracked, blocking while the queue is full. The
+   * image is not copied, so it must not be modified until its future is ready
+   * @param image the image to add
+   * @param stamp the time at which the image was captured
+   * @return future which will hold the tracks of all landmarks in the image,
+   * see Tracker::GetTracks. If the tracker throws, the future holds the
+   * exception
+   */
+  std::future<std::vector<FeatureTrack>> AddImage(const cv::Mat& image,
+                                                  const ros::Time& stamp);
+
+  /**
+   * @brief add an image to be tracked if the queue is not full, see AddImage
+   * @param image the image to add
+   * @param stamp the time at which the image was captured
+   * @param tracks future which will hold the tracks of the image, only set if
+   * the image was added
+   * @return false if the queue is full
+   */
+  bool TryAddImage(const cv::Mat& image, const ros::Time& stamp,
+                   std::future<std::vector<FeatureTrack>>& tracks);
+
+  /**
+   * @brief block until all added images have been tracked
+   */
+  void WaitAll();
+
+  /**
+   * @brief get the number of images which have been added but not tracked
+   */
+  size_t NumPending() const { return num_pending_; }
+
+  /**
+   * @brief get the wrapped tracker. This must only be used when no images are
+   * pending, see WaitAll
+   */
+  std::shared_ptr<Tracker> GetTracker() const { return tracker_; }
+
+private:
+  struct Job {
+    TrackerFrame frame;
+    std::promise<std::vector<FeatureTrack>> promise;
+    // set if the image could not be preprocessed
+    std::exception_ptr error;
+  };
+
+  /**
+   * @brief bounded first in first out queue of jobs between two stages
+   */
+  class JobQueue {
+  public:
+    explicit JobQueue(size_t capacity)
+        : capacity_(std::max<size_t>(1, capacity)) {}
+
+    /**
+     * @brief push a job to the back of the queue
+     * @param job job to push, only moved from if this returns true
+     * @param block set to true to wait while the queue is full
+     * @return false if the queue is full and block is false, or the queue has
+     * been closed
+     */
+    bool Push(Job& job, bool block);
+
+    /**
+     * @brief pop a job from the front of the queue, waiting while it is empty
+     * @return false if the queue has been closed and is empty
+     */
+    bool Pop(Job& job);
+
+    /**
+     * @brief stop accepting jobs and wake up all waiting threads. Jobs already
+     * in the queue can still be popped
+     */
+    void Close();
+
+  private:
+    std::deque<Job> jobs_;
+    size_t capacity_;
+    bool closed_{false};
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+  };
+
+  /**
+   * @brief create a job and push it to the input queue
+   */
+  bool Add(const cv::Mat& image, const ros::Time& stamp, bool block,
+           std::future<std::vector<FeatureTrack>>& tracks);
+
+  /**
+   * @brief function run by the preprocessing thread
+   */
+  void PreprocessSpin();
+
+  /**
+   * @brief function run by the tracking thread
+   */
+  void TrackSpin();
+
+  /**
+   * @brief mark a job as finished and wake up threads waiting in WaitAll
+   */
+  void FinishJob();
+
+  std::shared_ptr<Tracker> tracker_;
+  TracksCallback callback_;
+  JobQueue input_queue_;
+  JobQueue preprocessed_queue_;
+
+  // number of jobs added and not finished. This is decremented while holding
+  // done_mutex_ so that WaitAll is always woken up
+  std::atomic<size_t> num_pending_{0};
+  std::mutex done_mutex_;
+  std::condition_variable done_condition_;
+
+  std::thread preprocess_thread_;
+  std::thread track_thread_;
+};
+
+} // namespace beam_cv
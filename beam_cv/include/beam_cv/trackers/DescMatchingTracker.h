@@ -45,13 +45,18 @@ public:
    */
   ~DescMatchingTracker() = default;
 
+  /**
+   * @brief Detects keypoints and computes their descriptors in an image
+   * @param frame frame with the image set
+   */
+  void PreprocessImage(TrackerFrame& frame) const override;
+
   /**
    * @brief Track features within an image (presumably the next in a
-   * sequence).
-   * @param image the image to add.
-   * @param current_time the time at which the image was captured
+   * sequence) by matching its descriptors to those of the previous image.
+   * @param frame frame which has been passed to PreprocessImage
    */
-  void AddImage(const cv::Mat& image, const ros::Time& current_time) override;
+  void AddPreprocessedImage(const TrackerFrame& frame) override;
 
   /**
    * @brief Purges the container but retains the current id value
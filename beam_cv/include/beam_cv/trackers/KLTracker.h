@@ -48,6 +48,22 @@ public:
     cv::TermCriteria criteria = cv::TermCriteria(
         cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 30, 0.01);
 
+    /** set to true to track keypoints back from the current image to the
+     * previous image, and drop keypoints which do not return to where they
+     * started. This reuses the pyramids of both images. */
+    bool forward_backward_check{false};
+
+    /** max distance in pixels between a keypoint and its position after
+     * tracking forwards then backwards, when forward_backward_check is on. */
+    double max_forward_backward_error{1.0};
+
+    /** pyramid level at which tracking stops. If set to 0, keypoints are
+     * tracked at full resolution, if set to 1, they are tracked at half
+     * resolution, and so on. This reduces the cost of tracking with high
+     * resolution cameras, at the cost of keypoint accuracy. max_level is
+     * counted from this level. */
+    int tracking_level{0};
+
     /** load params from a json config file. If empty, it will use default
      * params. */
     void LoadFromJson(const std::string& config_path);
@@ -97,13 +113,19 @@ public:
    */
   void ValidateParams();
 
+  /**
+   * @brief Builds the optical flow pyramid of an image, with levels up to
+   * params.tracking_level + params.max_level
+   * @param frame frame with the image set
+   */
+  void PreprocessImage(TrackerFrame& frame) const override;
+
   /**
    * @brief Track features within an image (presumably the next in a
    * sequence).
-   * @param image the image to add.
-   * @param current_time the time at which the image was captured
+   * @param frame frame which has been passed to PreprocessImage
    */
-  void AddImage(const cv::Mat& image, const ros::Time& current_time) override;
+  void AddPreprocessedImage(const TrackerFrame& frame) override;
 
   /**
    * @brief Purges the container but retains the current id value
@@ -114,11 +136,21 @@ private:
   /**
    * @brief This extracts keypoints and descriptors (if descriptor object
    * initialized) and fills in the following member variables: curr_ids_,
-   * tracked_features_count_, prev_kp_, prev_desc_ (optional), prev_image_
+   * tracked_features_count_, prev_kp_, prev_desc_ (optional)
    * @param image first image of a series
    */
   void DetectInitialFeatures(const cv::Mat& image);
 
+  /**
+   * @brief tracks prev_kp_ from the previous pyramid into curr_kp_, at
+   * params_.tracking_level, with the optional forward-backward check
+   * @param curr_pyramid pyramid of the current image, see PreprocessImage
+   * @param status output status, 1 if the keypoint was tracked and 0
+   * otherwise
+   */
+  void TrackKeypoints(const std::vector<cv::Mat>& curr_pyramid,
+                      std::vector<uchar>& status);
+
   /**
    * @brief this function takes all successful keypoint that were tracked, moves
    * them to the tracked keypoints (if not already there), then adds they
@@ -176,9 +208,11 @@ private:
   uint32_t tracked_features_count_{0};
   uint32_t original_feature_count_{0};
 
-  // Need to store keypoints & image from the previous timestep
+  // Need to store keypoints & image pyramid from the previous timestep. The
+  // pyramid of each image is built once and used as the current pyramid, then
+  // as the previous one
   std::vector<cv::Point2f> prev_kp_;
-  cv::Mat prev_image_;
+  std::vector<cv::Mat> prev_pyramid_;
   cv::Mat prev_desc_;
 
   // also store current keypoints and descriptors for ease of use
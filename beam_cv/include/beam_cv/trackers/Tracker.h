@@ -45,6 +45,23 @@ inline std::string GetTrackerTypes() {
   return types;
 }
 
+/**
+ * @brief Data of a single image passed between the stages of a tracker. This
+ * is filled by Tracker::PreprocessImage, which only depends on the image, and
+ * then consumed by Tracker::AddPreprocessedImage.
+ */
+struct TrackerFrame {
+  cv::Mat image;
+  ros::Time stamp;
+
+  // image pyramid used for optical flow, see cv::buildOpticalFlowPyramid
+  std::vector<cv::Mat> pyramid;
+
+  // keypoints and descriptors detected in the image
+  std::vector<cv::KeyPoint> keypoints;
+  cv::Mat descriptors;
+};
+
 /**
  * @brief Image tracker class base class. This class defines the interface and
  * implements some common functionality for all tracker classes
@@ -63,21 +80,39 @@ public:
   /**
    * @brief Default destructor
    */
-  ~Tracker() = default;
+  virtual ~Tracker() = default;
+
+  /**
+   * @brief Track and add tracked features in a new image to the tracker. We
+   * assume that this function is called on images in sequence. This calls
+   * PreprocessImage then AddPreprocessedImage on the caller's thread, see
+   * AsyncTracker to run these stages on separate threads.
+   * @param image the image to add. This needs to be a greyscal image
+   * @param current_time the time at which the image was captured
+   */
+  void AddImage(const cv::Mat& image, const ros::Time& current_time);
+
+  /**
+   * @brief Pure virtual method for the work on a new image which does not
+   * depend on the state of the tracker, e.g., building image pyramids or
+   * detecting features. This may be called on the next image while
+   * AddPreprocessedImage is running on the previous one, so it must not
+   * modify the tracker.
+   * @param frame frame with the image and stamp set, to be filled
+   */
+  virtual void PreprocessImage(TrackerFrame& frame) const = 0;
 
   /**
-   * @brief Pure virtual method for tracking and adding tracked features in a
-   * new image to the tracker. We assume that this function is called on images
-   * in sequence.
+   * @brief Pure virtual method for tracking features from the previous image
+   * into a preprocessed image, and adding them to the tracker. We assume that
+   * this function is called on images in sequence.
    *
    * IMPORTANT NOTE: this function must call PurgeContainer
    * (defined in base class)
    *
-   * @param image the image to add. This needs to be a greyscal image
-   * @param current_time the time at which the image was captured
+   * @param frame frame which has been passed to PreprocessImage
    */
-  virtual void AddImage(const cv::Mat& image,
-                        const ros::Time& current_time) = 0;
+  virtual void AddPreprocessedImage(const TrackerFrame& frame) = 0;
 
   /**
    * @brief Purges the container but retains the current id value
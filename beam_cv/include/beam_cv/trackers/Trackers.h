@@ -1,2 +1,3 @@
+#include <beam_cv/trackers/AsyncTracker.h>
 #include <beam_cv/trackers/DescMatchingTracker.h>
 #include <beam_cv/trackers/KLTracker.h>
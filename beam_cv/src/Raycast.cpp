@@ -1,3 +1,167 @@
 #include "beam_cv/Raycast.h"
+
+#include <algorithm>
+#include <limits>
+
 namespace beam_cv {
+
+RayVoxelGrid::RayVoxelGrid(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                           double hit_radius, size_t max_num_voxels)
+    : hit_radius_(std::max(hit_radius, 0.0)) {
+  points_.reserve(cloud.size());
+  Eigen::Vector3d min_pt = Eigen::Vector3d::Constant(
+      std::numeric_limits<double>::max());
+  Eigen::Vector3d max_pt = Eigen::Vector3d::Constant(
+      std::numeric_limits<double>::lowest());
+  for (const auto& p : cloud) {
+    points_.emplace_back(p.x, p.y, p.z);
+    min_pt = min_pt.cwiseMin(points_.back().cast<double>());
+    max_pt = max_pt.cwiseMax(points_.back().cast<double>());
+  }
+  if (points_.empty()) { return; }
+
+  // pad the bounds by the hit radius so that all spheres are inside the grid
+  grid_min_ = min_pt - Eigen::Vector3d::Constant(hit_radius_);
+  Eigen::Vector3d extent =
+      max_pt - min_pt + Eigen::Vector3d::Constant(2 * hit_radius_);
+
+  // voxels need to be at least as large as the spheres so each point is in at
+  // most 8 voxels, and are grown so that there are not many more voxels than
+  // points
+  double volume = std::max(extent.prod(), 1e-9);
+  voxel_size_ = std::max({2 * hit_radius_,
+                          std::cbrt(volume / points_.size()),
+                          std::cbrt(volume / std::max<size_t>(max_num_voxels,
+                                                              1))});
+  for (int i = 0; i < 3; i++) {
+    dims_[i] =
+        std::max(1, static_cast<int>(std::ceil(extent[i] / voxel_size_)));
+  }
+
+  // get the range of voxels overlapped by the sphere around each point
+  auto get_voxel_range = [&](const Eigen::Vector3f& p, Eigen::Vector3i& lower,
+                             Eigen::Vector3i& upper) {
+    for (int i = 0; i < 3; i++) {
+      lower[i] = std::clamp(static_cast<int>(std::floor(
+                                (p[i] - hit_radius_ - grid_min_[i]) /
+                                voxel_size_)),
+                            0, dims_[i] - 1);
+      upper[i] = std::clamp(static_cast<int>(std::floor(
+                                (p[i] + hit_radius_ - grid_min_[i]) /
+                                voxel_size_)),
+                            0, dims_[i] - 1);
+    }
+  };
+  auto for_each_voxel = [&](const Eigen::Vector3f& p, auto&& func) {
+    Eigen::Vector3i lower, upper;
+    get_voxel_range(p, lower, upper);
+    for (int x = lower[0]; x <= upper[0]; x++) {
+      for (int y = lower[1]; y <= upper[1]; y++) {
+        for (int z = lower[2]; z <= upper[2]; z++) {
+          func((static_cast<size_t>(z) * dims_[1] + y) * dims_[0] + x);
+        }
+      }
+    }
+  };
+
+  // counting sort of the points into their voxels
+  size_t num_voxels = static_cast<size_t>(dims_[0]) * dims_[1] * dims_[2];
+  voxel_starts_.assign(num_voxels + 1, 0);
+  for (const auto& p : points_) {
+    for_each_voxel(p, [&](size_t voxel) { voxel_starts_[voxel + 1]++; });
+  }
+  for (size_t i = 0; i < num_voxels; i++) {
+    voxel_starts_[i + 1] += voxel_starts_[i];
+  }
+  voxel_points_.resize(voxel_starts_.back());
+  std::vector<uint32_t> next(voxel_starts_.begin(), voxel_starts_.end() - 1);
+  for (uint32_t i = 0; i < points_.size(); i++) {
+    for_each_voxel(points_[i],
+                   [&](size_t voxel) { voxel_points_[next[voxel]++] = i; });
+  }
 }
+
+int RayVoxelGrid::CastRay(const Eigen::Vector3d& origin,
+                          const Eigen::Vector3d& direction,
+                          double max_distance) const {
+  if (points_.empty() || direction.norm() == 0) { return -1; }
+  Eigen::Vector3d dir = direction.normalized();
+
+  // clip the ray to the grid bounds
+  Eigen::Vector3d grid_max =
+      grid_min_ + dims_.cast<double>() * voxel_size_;
+  double t_start = 0;
+  double t_end = max_distance;
+  for (int i = 0; i < 3; i++) {
+    if (dir[i] == 0) {
+      if (origin[i] < grid_min_[i] || origin[i] > grid_max[i]) { return -1; }
+      continue;
+    }
+    double t0 = (grid_min_[i] - origin[i]) / dir[i];
+    double t1 = (grid_max[i] - origin[i]) / dir[i];
+    if (t0 > t1) { std::swap(t0, t1); }
+    t_start = std::max(t_start, t0);
+    t_end = std::min(t_end, t1);
+  }
+  if (t_start > t_end) { return -1; }
+
+  // initialize the DDA at the voxel where the ray enters the grid
+  Eigen::Vector3d start = (origin + t_start * dir - grid_min_) / voxel_size_;
+  Eigen::Vector3i voxel;
+  Eigen::Vector3i step;
+  Eigen::Vector3d t_next;
+  Eigen::Vector3d t_delta;
+  for (int i = 0; i < 3; i++) {
+    voxel[i] = std::clamp(static_cast<int>(std::floor(start[i])), 0,
+                          dims_[i] - 1);
+    if (dir[i] > 0) {
+      step[i] = 1;
+      t_next[i] = (grid_min_[i] + (voxel[i] + 1) * voxel_size_ - origin[i]) /
+                  dir[i];
+      t_delta[i] = voxel_size_ / dir[i];
+    } else if (dir[i] < 0) {
+      step[i] = -1;
+      t_next[i] =
+          (grid_min_[i] + voxel[i] * voxel_size_ - origin[i]) / dir[i];
+      t_delta[i] = -voxel_size_ / dir[i];
+    } else {
+      step[i] = 0;
+      t_next[i] = std::numeric_limits<double>::max();
+      t_delta[i] = std::numeric_limits<double>::max();
+    }
+  }
+
+  // visit voxels in order along the ray. A hit found in a voxel is the first
+  // hit if it is before the ray leaves the voxel, otherwise a closer hit could
+  // still be found in the next voxels
+  double r2 = hit_radius_ * hit_radius_;
+  double best_t = std::numeric_limits<double>::max();
+  int best_index = -1;
+  while (true) {
+    size_t v = (static_cast<size_t>(voxel[2]) * dims_[1] + voxel[1]) *
+                   dims_[0] +
+               voxel[0];
+    for (uint32_t i = voxel_starts_[v]; i < voxel_starts_[v + 1]; i++) {
+      uint32_t index = voxel_points_[i];
+      Eigen::Vector3d p = points_[index].cast<double>() - origin;
+      double t = p.dot(dir);
+      if (t < 0 || t > max_distance || t >= best_t) { continue; }
+      if (p.squaredNorm() - t * t < r2) {
+        best_t = t;
+        best_index = index;
+      }
+    }
+
+    int axis;
+    t_next.minCoeff(&axis);
+    double t_exit = t_next[axis];
+    if (best_index >= 0 && best_t <= t_exit) { return best_index; }
+    if (t_exit > t_end) { break; }
+    voxel[axis] += step[axis];
+    if (voxel[axis] < 0 || voxel[axis] >= dims_[axis]) { break; }
+    t_next[axis] += t_delta[axis];
+  }
+  return best_index;
+}
+
+} // namespace beam_cv
@@ -1,12 +1,81 @@
 #include <beam_cv/detectors/Detectors.h>
 
+#include <algorithm>
+#include <numeric>
+
 #include <boost/filesystem.hpp>
 #include <nlohmann/json.hpp>
 
 #include <beam_utils/log.h>
+#include <beam_utils/parallel.h>
 
 namespace beam_cv {
 
+namespace {
+
+/**
+ * @brief greedy non max suppression between keypoints of different cells.
+ * Keypoints are visited from strongest to weakest and removed if a kept
+ * keypoint from another cell is within the radius. Keypoints are hashed into
+ * buckets of the radius size so only neighbouring buckets are searched.
+ * @param keypoints keypoints in image coordinates, filtered in place keeping
+ * their order
+ * @param cell_ids grid cell of each keypoint
+ * @param radius suppression radius in pixels
+ * @param image_size size of the image the keypoints were detected in
+ */
+void SuppressAcrossCells(std::vector<cv::KeyPoint>& keypoints,
+                         const std::vector<int>& cell_ids, float radius,
+                         const cv::Size& image_size) {
+  std::vector<size_t> order(keypoints.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return keypoints[a].response > keypoints[b].response;
+  });
+
+  int bucket_cols = static_cast<int>(image_size.width / radius) + 1;
+  int bucket_rows = static_cast<int>(image_size.height / radius) + 1;
+  auto bucket_of = [&](const cv::Point2f& pt, int& bx, int& by) {
+    bx = std::clamp(static_cast<int>(pt.x / radius), 0, bucket_cols - 1);
+    by = std::clamp(static_cast<int>(pt.y / radius), 0, bucket_rows - 1);
+  };
+
+  std::vector<std::vector<size_t>> buckets(bucket_cols * bucket_rows);
+  std::vector<bool> keep(keypoints.size(), false);
+  float radius_sq = radius * radius;
+  for (size_t i : order) {
+    const cv::Point2f& pt = keypoints[i].pt;
+    int bx, by;
+    bucket_of(pt, bx, by);
+    bool suppressed = false;
+    for (int y = std::max(by - 1, 0);
+         y <= std::min(by + 1, bucket_rows - 1) && !suppressed; y++) {
+      for (int x = std::max(bx - 1, 0);
+           x <= std::min(bx + 1, bucket_cols - 1) && !suppressed; x++) {
+        for (size_t j : buckets[y * bucket_cols + x]) {
+          if (cell_ids[j] == cell_ids[i]) { continue; }
+          cv::Point2f d = keypoints[j].pt - pt;
+          if (d.dot(d) < radius_sq) {
+            suppressed = true;
+            break;
+          }
+        }
+      }
+    }
+    if (suppressed) { continue; }
+    keep[i] = true;
+    buckets[by * bucket_cols + bx].push_back(i);
+  }
+
+  size_t num_kept = 0;
+  for (size_t i = 0; i < keypoints.size(); i++) {
+    if (keep[i]) { keypoints[num_kept++] = keypoints[i]; }
+  }
+  keypoints.resize(num_kept);
+}
+
+} // namespace
+
 Detector::Detector(int grid_cols, int grid_rows)
     : grid_cols_(grid_cols), grid_rows_(grid_rows) {}
 
@@ -50,26 +119,67 @@ std::shared_ptr<Detector> Detector::Create(DetectorType type,
 }
 
 std::vector<cv::KeyPoint> Detector::DetectFeatures(const cv::Mat& image) {
-  std::vector<cv::KeyPoint> local_keypoints;
+  // cell borders are spread over the image so the remainder pixels are not
+  // dropped when the image size is not divisible by the grid size
+  std::vector<cv::Rect> cells;
+  cells.reserve(grid_cols_ * grid_rows_);
+  for (int row = 0; row < grid_rows_; row++) {
+    int y_start = row * image.rows / grid_rows_;
+    int y_end = (row + 1) * image.rows / grid_rows_;
+    for (int col = 0; col < grid_cols_; col++) {
+      int x_start = col * image.cols / grid_cols_;
+      int x_end = (col + 1) * image.cols / grid_cols_;
+      if (x_end <= x_start || y_end <= y_start) { continue; }
+      cells.emplace_back(x_start, y_start, x_end - x_start, y_end - y_start);
+    }
+  }
+
+  // OpenCV detectors are not safe to call from several threads at once, so
+  // every thread other than the first detects with its own clone
+  std::vector<std::vector<cv::KeyPoint>> cell_keypoints(cells.size());
+  int n_threads = beam::GetNumThreads(grid_params_.num_threads, cells.size());
+  std::vector<std::shared_ptr<Detector>> detectors(n_threads);
+  for (int i = 1; i < n_threads; i++) { detectors[i] = Clone(); }
+  beam::ParallelForChunks(
+      cells.size(), n_threads,
+      [&](int thread_id, size_t begin, size_t end) {
+        Detector* detector = thread_id == 0 ? this : detectors[thread_id].get();
+        for (size_t i = begin; i < end; i++) {
+          const cv::Rect& roi = cells[i];
+          std::vector<cv::KeyPoint>& local_keypoints = cell_keypoints[i];
+          local_keypoints = detector->DetectLocalFeatures(image(roi));
+          int max_features = grid_params_.max_features_per_cell;
+          if (max_features > 0 &&
+              local_keypoints.size() > static_cast<size_t>(max_features)) {
+            cv::KeyPointsFilter::retainBest(local_keypoints, max_features);
+            // tied scores result in overages
+            local_keypoints.resize(max_features);
+          }
+          // translate local to global coords
+          for (cv::KeyPoint& keypoint : local_keypoints) {
+            keypoint.pt.x += roi.x;
+            keypoint.pt.y += roi.y;
+          }
+        }
+      });
+
+  size_t num_keypoints = 0;
+  for (const auto& local_keypoints : cell_keypoints) {
+    num_keypoints += local_keypoints.size();
+  }
   std::vector<cv::KeyPoint> global_keypoints;
+  global_keypoints.reserve(num_keypoints);
+  std::vector<int> cell_ids;
+  cell_ids.reserve(num_keypoints);
+  for (size_t i = 0; i < cell_keypoints.size(); i++) {
+    global_keypoints.insert(global_keypoints.end(), cell_keypoints[i].begin(),
+                            cell_keypoints[i].end());
+    cell_ids.insert(cell_ids.end(), cell_keypoints[i].size(), i);
+  }
 
-  int grid_width = image.cols / grid_cols_;
-  int grid_height = image.rows / grid_rows_;
-
-  for (int y = 0; y + grid_height <= image.rows; y += grid_height) {
-    for (int x = 0; x + grid_width <= image.cols; x += grid_width) {
-      cv::Rect roi = cv::Rect(x, y, grid_width, grid_height);
-      cv::Mat grid = image(roi);
-      local_keypoints = DetectLocalFeatures(grid);
-
-      for (size_t i = 0; i < local_keypoints.size(); i++) {
-        // use iterator position to translate local global coords
-        cv::KeyPoint global_pt = local_keypoints[i];
-        global_pt.pt.x += x;
-        global_pt.pt.y += y;
-        global_keypoints.push_back(global_pt);
-      }
-    }
+  if (grid_params_.border_nms_radius > 0 && cells.size() > 1) {
+    SuppressAcrossCells(global_keypoints, cell_ids,
+                        grid_params_.border_nms_radius, image.size());
   }
   return global_keypoints;
 }
@@ -66,6 +66,12 @@ void FASTDetector::Setup() {
       params_.threshold, params_.nonmax_suppression, params_.type);
 }
 
+std::shared_ptr<Detector> FASTDetector::Clone() const {
+  auto detector = std::make_shared<FASTDetector>(params_);
+  detector->SetGridParams(GetGridParams());
+  return detector;
+}
+
 std::vector<cv::KeyPoint>
     FASTDetector::DetectLocalFeatures(const cv::Mat& image) {
   // Detect features in image and return keypoints.
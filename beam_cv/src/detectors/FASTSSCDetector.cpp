@@ -63,6 +63,12 @@ void FASTSSCDetector::Setup() {
       cv::FastFeatureDetector::create(params_.threshold, false, params_.type);
 }
 
+std::shared_ptr<Detector> FASTSSCDetector::Clone() const {
+  auto detector = std::make_shared<FASTSSCDetector>(params_);
+  detector->SetGridParams(GetGridParams());
+  return detector;
+}
+
 std::vector<cv::KeyPoint>
     FASTSSCDetector::DetectLocalFeatures(const cv::Mat& image) {
   // Detect features in image and return keypoints.
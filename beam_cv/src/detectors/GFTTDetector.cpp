@@ -59,6 +59,12 @@ void GFTTDetector::Setup() {
       params_.block_size, params_.use_harris_detector, params_.k);
 }
 
+std::shared_ptr<Detector> GFTTDetector::Clone() const {
+  auto detector = std::make_shared<GFTTDetector>(params_);
+  detector->SetGridParams(GetGridParams());
+  return detector;
+}
+
 std::vector<cv::KeyPoint>
     GFTTDetector::DetectLocalFeatures(const cv::Mat& image) {
   // Detect features in image and return keypoints.
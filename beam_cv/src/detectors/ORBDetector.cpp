@@ -79,6 +79,12 @@ void ORBDetector::Setup() {
                                   patch_size, params_.fast_threshold);
 }
 
+std::shared_ptr<Detector> ORBDetector::Clone() const {
+  auto detector = std::make_shared<ORBDetector>(params_);
+  detector->SetGridParams(GetGridParams());
+  return detector;
+}
+
 std::vector<cv::KeyPoint>
     ORBDetector::DetectLocalFeatures(const cv::Mat& image) {
   // Detect features in image and return keypoints.
@@ -60,6 +60,12 @@ void SIFTDetector::Setup() {
       params_.contrast_threshold, params_.edge_threshold, params_.sigma);
 }
 
+std::shared_ptr<Detector> SIFTDetector::Clone() const {
+  auto detector = std::make_shared<SIFTDetector>(params_);
+  detector->SetGridParams(GetGridParams());
+  return detector;
+}
+
 std::vector<cv::KeyPoint>
     SIFTDetector::DetectLocalFeatures(const cv::Mat& image) {
   // Detect features in image and return keypoints.
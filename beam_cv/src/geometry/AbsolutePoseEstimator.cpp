@@ -1,5 +1,8 @@
 #include "beam_cv/geometry/AbsolutePoseEstimator.h"
 
+#include <algorithm>
+#include <array>
+
 #include <Eigen/Geometry>
 
 #include "beam_cv/geometry/Triangulation.h"
@@ -8,20 +11,18 @@
 #include <numeric>
 
 namespace beam_cv {
-std::vector<Eigen::Matrix4d, beam::AlignMat4d> AbsolutePoseEstimator::P3PEstimator(
-      const std::shared_ptr<beam_calibration::CameraModel>& cam,
-      const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
-      const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points) {
-  // store normalized pixels coords
-  std::vector<Eigen::Vector3d, beam::AlignVec3d> x;
-  for (std::size_t i = 0; i < pixels.size(); ++i) {
-    // back project and normalize each pixel before adding it to x
-    Eigen::Vector3d homogenized_pixel;
-    cam->BackProject(pixels[i], homogenized_pixel);
-    homogenized_pixel.normalize();
-    x.push_back(homogenized_pixel);
-  };
-
+namespace {
+
+/**
+ * @brief P3P on unit rays towards the points instead of pixels, see
+ * AbsolutePoseEstimator::P3PEstimator
+ * @param x unit rays towards 3 features
+ * @param points 3d locations of the 3 features
+ * @param output vector to add up to 4 transformation matrices to
+ */
+void P3PFromRays(const std::array<Eigen::Vector3d, 3>& x,
+                 const std::array<Eigen::Vector3d, 3>& points,
+                 std::vector<Eigen::Matrix4d, beam::AlignMat4d>& output) {
   // lambdatwist p3p implementation adapted from
   // https://github.com/vlarsson/lambdatwist
   Eigen::Vector3d dX12 = points[0] - points[1];
@@ -113,7 +114,6 @@ std::vector<Eigen::Matrix4d, beam::AlignMat4d> AbsolutePoseEstimator::P3PEstimat
   double lambda1, lambda2, lambda3;
 
   // prep for output
-  std::vector<Eigen::Matrix4d, beam::AlignMat4d> output;
   Eigen::Matrix4d solution = Eigen::Matrix4d::Zero();
   solution(3, 3) = 1;
 
@@ -222,14 +222,19 @@ std::vector<Eigen::Matrix4d, beam::AlignMat4d> AbsolutePoseEstimator::P3PEstimat
     }
   }
 
-  return output;
 }
 
-Eigen::Matrix4d AbsolutePoseEstimator::RANSACEstimator(
-      const std::shared_ptr<beam_calibration::CameraModel>& cam,
-      const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
-      const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points,
-      int max_iterations, double inlier_threshold, int seed) {
+/**
+ * @brief see AbsolutePoseEstimator::RANSACEstimator
+ * @param legacy_sampling draw samples with Ransac::LegacySamples, so the
+ * legacy overload gives the same samples as before RansacParams were added
+ */
+beam::opt<Eigen::Matrix4d> P3PRansac(
+    const std::shared_ptr<beam_calibration::CameraModel>& cam,
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
+    const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points,
+    const RansacParams& params, double inlier_threshold,
+    bool legacy_sampling) {
   // return nothing if input sizes do not match
   if (pixels.size() != points.size()) {
     BEAM_CRITICAL("Pixel/point vectors are not of the same size.");
@@ -241,44 +246,126 @@ Eigen::Matrix4d AbsolutePoseEstimator::RANSACEstimator(
     return {};
   }
 
-  Eigen::Matrix4d current_pose;
-  int current_inliers = 0;
-  if (seed == -1) {
-    srand(time(0));
-  } else {
-    srand(seed);
+  // back project all pixels once instead of for every sample
+  const size_t num_points = points.size();
+  std::vector<Eigen::Vector3d, beam::AlignVec3d> rays(num_points);
+  std::vector<uint8_t> valid_rays(num_points);
+  for (size_t i = 0; i < num_points; i++) {
+    valid_rays[i] = cam->BackProject(pixels[i], rays[i]);
+    rays[i].normalize();
+  }
+
+  RansacParams ransac_params = params;
+  if (cam->GetType() == beam_calibration::CameraType::LADYBUG) {
+    // the ladybug model is not thread safe
+    ransac_params.num_threads = 1;
   }
-  for (int epoch = 0; epoch < max_iterations; epoch++) {
-    std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels_copy = pixels;
-    std::vector<Eigen::Vector3d, beam::AlignVec3d> points_copy = points;
-    std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels_sample;
-    std::vector<Eigen::Vector3d, beam::AlignVec3d> points_sample;
-    // fill new point vectors with randomly sampled points from inputs
-    int n = pixels_copy.size();
-    for (uint32_t i = 0; i < 3; i++) {
-      int idx = rand() % n;
-      pixels_sample.push_back(pixels_copy[idx]);
-      points_sample.push_back(points_copy[idx]);
-      pixels_copy.erase(pixels_copy.begin() + idx);
-      points_copy.erase(points_copy.begin() + idx);
-      n--;
+
+  using PoseRansac = Ransac<Eigen::Matrix4d>;
+  auto solve = [&](const std::vector<uint32_t>& sample,
+                   PoseRansac::Models& poses) {
+    std::array<Eigen::Vector3d, 3> x;
+    std::array<Eigen::Vector3d, 3> X;
+    for (size_t i = 0; i < 3; i++) {
+      if (!valid_rays[sample[i]]) { return; }
+      x[i] = rays[sample[i]];
+      X[i] = points[sample[i]];
     }
+    P3PFromRays(x, X, poses);
+    poses.erase(std::remove_if(poses.begin(), poses.end(),
+                               [](const Eigen::Matrix4d& T) {
+                                 return !T.allFinite();
+                               }),
+                poses.end());
+  };
 
-    // perform p3p on the three samples correspondences
-    std::vector<Eigen::Matrix4d, beam::AlignMat4d> poses =
-        AbsolutePoseEstimator::P3PEstimator(cam, pixels_sample, points_sample);
-
-    // check if any of the p3p solution poses have the most inliers
-    for (size_t i = 0; i < poses.size(); i++) {
-      int inliers = beam_cv::CheckInliers(cam, points, pixels, poses[i],
-                                          inlier_threshold);
-      if (inliers > current_inliers) {
-        current_inliers = inliers;
-        current_pose = poses[i];
-      }
+  // project blocks of points at once to avoid a virtual call per point
+  const float threshold_sq = inlier_threshold * inlier_threshold;
+  auto score = [&](const Eigen::Matrix4d& T_cam_world, size_t begin,
+                   size_t end) {
+    thread_local Eigen::Matrix3Xf points_cam =
+        Eigen::Matrix3Xf::Zero(3, PoseRansac::k_block_size);
+    thread_local Eigen::Matrix2Xf projected;
+    thread_local std::vector<uint8_t> valid_mask;
+    const Eigen::Matrix3d R = T_cam_world.topLeftCorner<3, 3>();
+    const Eigen::Vector3d t = T_cam_world.topRightCorner<3, 1>();
+    for (size_t i = begin; i < end; i++) {
+      points_cam.col(i - begin) = (R * points[i] + t).cast<float>();
     }
+    cam->ProjectPoints(points_cam, projected, valid_mask);
+    int inliers = 0;
+    for (size_t i = begin; i < end; i++) {
+      if (!valid_mask[i - begin]) { continue; }
+      Eigen::Vector2f error =
+          projected.col(i - begin) - pixels[i].cast<float>();
+      if (error.squaredNorm() < threshold_sq) { inliers++; }
+    }
+    return inliers;
+  };
+
+  PoseRansac::Result result;
+  if (legacy_sampling) {
+    std::vector<uint32_t> samples = PoseRansac::LegacySamples(
+        num_points, 3, ransac_params.max_iterations, ransac_params.seed);
+    auto draw_sample = [&](int iteration, std::vector<uint32_t>& sample) {
+      std::copy_n(samples.begin() + iteration * 3, 3, sample.begin());
+    };
+    result = PoseRansac::Run(num_points, 3, ransac_params, draw_sample, solve,
+                             score);
+  } else {
+    result = PoseRansac::Run(num_points, 3, ransac_params, solve, score);
+  }
+  if (result.num_inliers <= 0) { return {}; }
+  return result.model;
+}
+
+} // namespace
+
+std::vector<Eigen::Matrix4d, beam::AlignMat4d> AbsolutePoseEstimator::P3PEstimator(
+      const std::shared_ptr<beam_calibration::CameraModel>& cam,
+      const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
+      const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points) {
+  // store normalized pixels coords
+  std::array<Eigen::Vector3d, 3> x;
+  std::array<Eigen::Vector3d, 3> X;
+  for (std::size_t i = 0; i < 3; ++i) {
+    // back project and normalize each pixel before adding it to x
+    cam->BackProject(pixels[i], x[i]);
+    x[i].normalize();
+    X[i] = points[i];
+  }
+
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> output;
+  P3PFromRays(x, X, output);
+  return output;
+}
+
+Eigen::Matrix4d AbsolutePoseEstimator::RANSACEstimator(
+      const std::shared_ptr<beam_calibration::CameraModel>& cam,
+      const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
+      const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points,
+      int max_iterations, double inlier_threshold, int seed) {
+  // all iterations are run with the same samples as before RansacParams
+  // were added
+  RansacParams params;
+  params.max_iterations = max_iterations;
+  params.confidence = 0;
+  params.seed = seed;
+  beam::opt<Eigen::Matrix4d> pose =
+      P3PRansac(cam, pixels, points, params, inlier_threshold, true);
+  if (!pose.has_value()) {
+    BEAM_WARN("No valid pose found with p3p, returning identity.");
+    return Eigen::Matrix4d::Identity();
   }
-  return current_pose;
+  return pose.value();
+}
+
+beam::opt<Eigen::Matrix4d> AbsolutePoseEstimator::RANSACEstimator(
+    const std::shared_ptr<beam_calibration::CameraModel>& cam,
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
+    const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points,
+    const RansacParams& params, double inlier_threshold) {
+  return P3PRansac(cam, pixels, points, params, inlier_threshold, false);
 }
 
 void AbsolutePoseEstimator::EigenWithKnownZero(const Eigen::Matrix3d& M,
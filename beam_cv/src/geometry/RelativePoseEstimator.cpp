@@ -1,6 +1,9 @@
 #include <beam_cv/geometry/RelativePoseEstimator.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <numeric>
 
 #include <Eigen/Geometry>
 
@@ -12,34 +15,43 @@
 
 namespace beam_cv {
 
-beam::opt<Eigen::Matrix3d> RelativePoseEstimator::EssentialMatrix8Point(
+namespace {
+
+using Rays = std::vector<Eigen::Vector3d, beam::AlignVec3d>;
+
+/**
+ * @brief back projects the pixels of both images
+ * @return false if any pixel can not be back projected
+ */
+bool BackProjectMatches(
     const std::shared_ptr<beam_calibration::CameraModel>& cam1,
     const std::shared_ptr<beam_calibration::CameraModel>& cam2,
     const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p1_v,
-    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p2_v) {
-  if (p2_v.size() < 8 || p1_v.size() < 8 || p1_v.size() != p2_v.size()) {
-    BEAM_CRITICAL("Invalid number of input point matches.");
-    return {};
-  }
-  int N = p2_v.size();
-  // normalize input points via back projection
-  std::vector<Eigen::Vector3d, beam::AlignVec3d> X_r;
-  std::vector<Eigen::Vector3d, beam::AlignVec3d> X_c;
-  for (int i = 0; i < N; i++) {
-    Eigen::Vector3d xpr;
-    Eigen::Vector3d xpc;
-    if (cam1->BackProject(p1_v[i], xpr) && cam2->BackProject(p2_v[i], xpc)) {
-      X_r.push_back(xpr);
-      X_c.push_back(xpc);
-    } else {
-      BEAM_CRITICAL("Invalid pixel input. Unable to back project.");
-      return {};
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p2_v, Rays& X_r,
+    Rays& X_c) {
+  X_r.resize(p1_v.size());
+  X_c.resize(p2_v.size());
+  for (size_t i = 0; i < p1_v.size(); i++) {
+    if (!cam1->BackProject(p1_v[i], X_r[i]) ||
+        !cam2->BackProject(p2_v[i], X_c[i])) {
+      return false;
     }
   }
+  return true;
+}
+
+/**
+ * @brief 8 point algorithm on the back projected pixels with the given
+ * indices, see RelativePoseEstimator::EssentialMatrix8Point
+ */
+Eigen::Matrix3d EssentialMatrix8PointFromRays(
+    const Rays& X_r, const Rays& X_c, const std::vector<uint32_t>& indices) {
+  int N = indices.size();
   // construct A matrix
   Eigen::MatrixXd A(N, 9);
   for (int i = 0; i < N; i++) {
-    Eigen::VectorXd K = beam::KroneckerProduct(X_r[i], X_c[i]);
+    Eigen::VectorXd K =
+        beam::KroneckerProduct(X_r[indices[i]], X_c[indices[i]]);
     A.row(i) = K;
   }
   // perform SVD on A matrix
@@ -62,42 +74,28 @@ beam::opt<Eigen::Matrix3d> RelativePoseEstimator::EssentialMatrix8Point(
   return E;
 }
 
-beam::opt<std::vector<Eigen::Matrix3d, beam::AlignMat3d>>
-    RelativePoseEstimator::EssentialMatrix7Point(
-        const std::shared_ptr<beam_calibration::CameraModel>& cam1,
-        const std::shared_ptr<beam_calibration::CameraModel>& cam2,
-        const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p1_v,
-        const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p2_v) {
-  if (p2_v.size() < 7 || p1_v.size() < 7 || p1_v.size() != p2_v.size()) {
-    BEAM_CRITICAL("Invalid number of input point matches.");
-    return {};
-  }
-  int N = p2_v.size();
-  // normalize input points via back projection
-  std::vector<Eigen::Vector3d, beam::AlignVec3d> X_r;
-  std::vector<Eigen::Vector3d, beam::AlignVec3d> X_c;
-  for (int i = 0; i < N; i++) {
-    Eigen::Vector3d xpr;
-    Eigen::Vector3d xpc;
-    if (cam1->BackProject(p1_v[i], xpr) && cam2->BackProject(p2_v[i], xpc)) {
-      X_r.push_back(xpr);
-      X_c.push_back(xpc);
-    } else {
-      BEAM_CRITICAL("Invalid pixel input. Unable to back project.");
-      return {};
-    }
-  }
+/**
+ * @brief 7 point algorithm on the back projected pixels with the given
+ * indices, see RelativePoseEstimator::EssentialMatrix7Point
+ * @param E vector to add the 1 or 3 solutions to
+ */
+void EssentialMatrix7PointFromRays(
+    const Rays& X_r, const Rays& X_c, const std::vector<uint32_t>& indices,
+    std::vector<Eigen::Matrix3d, beam::AlignMat3d>& E) {
+  int N = indices.size();
   // need vector of just normalized pixels (remove 3rd dim)
   // turn into a 2 x N matrix
   Eigen::MatrixXd matx1(2, N), matx2(2, N);
   // construct A matrix
   Eigen::MatrixXd A(N, 9);
   for (int i = 0; i < N; i++) {
-    matx1.row(0)[i] = X_r[i][0];
-    matx1.row(1)[i] = X_r[i][1];
-    matx2.row(0)[i] = X_c[i][0];
-    matx2.row(1)[i] = X_c[i][1];
-    Eigen::VectorXd K = beam::KroneckerProduct(X_r[i], X_c[i]);
+    const Eigen::Vector3d& xr = X_r[indices[i]];
+    const Eigen::Vector3d& xc = X_c[indices[i]];
+    matx1.row(0)[i] = xr[0];
+    matx1.row(1)[i] = xr[1];
+    matx2.row(0)[i] = xc[0];
+    matx2.row(1)[i] = xc[1];
+    Eigen::VectorXd K = beam::KroneckerProduct(xr, xc);
     A.row(i) = K;
   }
   // perform SVD on A matrix
@@ -136,7 +134,6 @@ beam::opt<std::vector<Eigen::Matrix3d, beam::AlignMat3d>>
   Eigen::VectorXd roots;
   beam::JenkinsTraubSolver solver(coefficients, &roots, NULL);
   solver.ExtractRoots();
-  std::vector<Eigen::Matrix3d, beam::AlignMat3d> E;
   // check sign consistency
   for (int i = 0; i < roots.size(); ++i) {
     Eigen::Matrix3d Ftmp = roots(i) * Fmat[0] + (1 - roots(i)) * Fmat[1];
@@ -153,15 +150,20 @@ beam::opt<std::vector<Eigen::Matrix3d, beam::AlignMat3d>>
     Eigen::VectorXd s = (l1_Fx.array() * l1_ex.array()).colwise().sum();
     if ((s.array() > 0).all() || (s.array() < 0).all()) { E.push_back(Ftmp); }
   }
-  return E;
 }
 
-beam::opt<Eigen::Matrix4d> RelativePoseEstimator::RANSACEstimator(
+/**
+ * @brief see RelativePoseEstimator::RANSACEstimator
+ * @param legacy_sampling draw samples with Ransac::LegacySamples, so the
+ * legacy overload gives the same samples as before RansacParams were added
+ */
+beam::opt<Eigen::Matrix4d> RelativePoseRansac(
     const std::shared_ptr<beam_calibration::CameraModel>& cam1,
     const std::shared_ptr<beam_calibration::CameraModel>& cam2,
     const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p1_v,
-    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p2_v, EstimatorMethod method,
-    int max_iterations, double inlier_threshold, int seed) {
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p2_v,
+    EstimatorMethod method, const RansacParams& params,
+    double inlier_threshold, bool legacy_sampling) {
   if (p2_v.size() != p1_v.size()) {
     BEAM_CRITICAL("Point match vectors are not of the same size.");
     return {};
@@ -173,75 +175,194 @@ beam::opt<Eigen::Matrix4d> RelativePoseEstimator::RANSACEstimator(
   } else if (method == EstimatorMethod::SEVENPOINT) {
     N = 7;
   } else if (method == EstimatorMethod::FIVEPOINT) {
-    N = 5;
+    BEAM_CRITICAL("Five point algorithm not yet implemented.");
+    return {};
   }
   // return nothing if not enough points
   if (p1_v.size() < N) {
     BEAM_CRITICAL("Not enough point correspondences, expecting at least {}", N);
     return {};
   }
-  if (seed == -1) {
-    srand(time(0));
-  } else {
-    srand(seed);
+
+  // back project all pixels once instead of for every sample. Unit rays are
+  // used for triangulation
+  const size_t num_matches = p1_v.size();
+  Rays X_r(num_matches), X_c(num_matches);
+  Rays rays_r(num_matches), rays_c(num_matches);
+  std::vector<uint8_t> valid_rays(num_matches);
+  for (size_t i = 0; i < num_matches; i++) {
+    valid_rays[i] = cam1->BackProject(p1_v[i], X_r[i]) &&
+                    cam2->BackProject(p2_v[i], X_c[i]);
+    rays_r[i] = X_r[i].normalized();
+    rays_c[i] = X_c[i].normalized();
+  }
+
+  RansacParams ransac_params = params;
+  if (cam1->GetType() == beam_calibration::CameraType::LADYBUG ||
+      cam2->GetType() == beam_calibration::CameraType::LADYBUG) {
+    // the ladybug model is not thread safe
+    ransac_params.num_threads = 1;
   }
-  int current_inliers = 0;
-  Eigen::Matrix4d current_pose;
-  bool found_valid = false;
-  for (int epoch = 0; epoch < max_iterations; epoch++) {
-    std::vector<Eigen::Vector2i, beam::AlignVec2i> pr_copy = p1_v;
-    std::vector<Eigen::Vector2i, beam::AlignVec2i> pc_copy = p2_v;
-    std::vector<Eigen::Vector2i, beam::AlignVec2i> sampled_pr;
-    std::vector<Eigen::Vector2i, beam::AlignVec2i> sampled_pc;
-    // fill new point vectors with randomly sampled points from xs and xss
-    int n = pr_copy.size();
-    for (uint32_t i = 0; i < N; i++) {
-      int idx = rand() % n;
-      sampled_pr.push_back(pr_copy[idx]);
-      sampled_pc.push_back(pc_copy[idx]);
-      pr_copy.erase(pr_copy.begin() + idx);
-      pc_copy.erase(pc_copy.begin() + idx);
-      n--;
+
+  // each essential matrix gives 4 poses. All of them are scored, so the pose
+  // is chosen by its inliers among all matches rather than by which sampled
+  // points are in front of both cameras
+  using PoseRansac = Ransac<Eigen::Matrix4d>;
+  const Eigen::Matrix4d I = Eigen::Matrix4d::Identity();
+  auto solve = [&](const std::vector<uint32_t>& sample,
+                   PoseRansac::Models& poses) {
+    for (uint32_t i : sample) {
+      if (!valid_rays[i]) { return; }
     }
-    // perform estimation of the given method
     std::vector<Eigen::Matrix3d, beam::AlignMat3d> Evec;
     if (method == EstimatorMethod::EIGHTPOINT) {
-      beam::opt<Eigen::Matrix3d> E =
-          RelativePoseEstimator::EssentialMatrix8Point(cam1, cam2, sampled_pr,
-                                                       sampled_pc);
-      if (E.has_value()) { Evec.push_back(E.value()); }
-    } else if (method == EstimatorMethod::SEVENPOINT) {
-      beam::opt<std::vector<Eigen::Matrix3d, beam::AlignMat3d>> E =
-          RelativePoseEstimator::EssentialMatrix7Point(cam1, cam2, sampled_pr,
-                                                       sampled_pc);
-      if (E.has_value()) { Evec = E.value(); }
-    } else if (method == EstimatorMethod::FIVEPOINT) {
-      BEAM_CRITICAL("Five point algorithm not yet implemented.");
-      return {};
+      Evec.push_back(EssentialMatrix8PointFromRays(X_r, X_c, sample));
+    } else {
+      EssentialMatrix7PointFromRays(X_r, X_c, sample, Evec);
     }
 
-    for (auto& E : Evec) {
-      std::vector<Eigen::Matrix3d, beam::AlignMat3d> R;
-      std::vector<Eigen::Vector3d, beam::AlignVec3d> t;
+    std::vector<Eigen::Matrix3d, beam::AlignMat3d> R;
+    std::vector<Eigen::Vector3d, beam::AlignVec3d> t;
+    for (const auto& E : Evec) {
       RelativePoseEstimator::RtFromE(E, R, t);
-      beam::opt<Eigen::Matrix4d> pose;
-      int inliers = RelativePoseEstimator::RecoverPose(
-          cam1, cam2, p1_v, p2_v, R, t, pose, inlier_threshold);
-
-      if (pose.has_value()) {
-        if (inliers > current_inliers) {
-          found_valid = true;
-          current_inliers = inliers;
-          current_pose = pose.value();
+      for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+          Eigen::Matrix4d T_cam2_cam1 = Eigen::Matrix4d::Identity();
+          T_cam2_cam1.block<3, 3>(0, 0) = R[i];
+          T_cam2_cam1.block<3, 1>(0, 3) = t[j];
+          poses.push_back(T_cam2_cam1);
         }
       }
     }
-  }
-  if (found_valid) {
-    return current_pose;
+  };
+
+  // triangulate and reproject blocks of matches at once to avoid a virtual
+  // call per point
+  const float threshold_sq = inlier_threshold * inlier_threshold;
+  auto score = [&](const Eigen::Matrix4d& T_cam2_cam1, size_t begin,
+                   size_t end) {
+    thread_local Eigen::Matrix3Xf points1 =
+        Eigen::Matrix3Xf::Zero(3, PoseRansac::k_block_size);
+    thread_local Eigen::Matrix3Xf points2 =
+        Eigen::Matrix3Xf::Zero(3, PoseRansac::k_block_size);
+    thread_local Eigen::Matrix2Xf projected1, projected2;
+    thread_local std::vector<uint8_t> valid_mask1, valid_mask2;
+    std::array<bool, PoseRansac::k_block_size> triangulated{};
+    const Eigen::Matrix3d R = T_cam2_cam1.topLeftCorner<3, 3>();
+    const Eigen::Vector3d t = T_cam2_cam1.topRightCorner<3, 1>();
+    for (size_t i = begin; i < end; i++) {
+      if (!valid_rays[i]) { continue; }
+      beam::opt<Eigen::Vector3d> point = Triangulation::TriangulateRays(
+          rays_r[i], rays_c[i], I, T_cam2_cam1);
+      if (!point.has_value()) { continue; }
+      triangulated[i - begin] = true;
+      points1.col(i - begin) = point.value().cast<float>();
+      points2.col(i - begin) = (R * point.value() + t).cast<float>();
+    }
+    cam1->ProjectPoints(points1, projected1, valid_mask1);
+    cam2->ProjectPoints(points2, projected2, valid_mask2);
+    int inliers = 0;
+    for (size_t i = begin; i < end; i++) {
+      size_t k = i - begin;
+      if (!triangulated[k] || !valid_mask1[k] || !valid_mask2[k]) {
+        continue;
+      }
+      Eigen::Vector2f error1 = projected1.col(k) - p1_v[i].cast<float>();
+      Eigen::Vector2f error2 = projected2.col(k) - p2_v[i].cast<float>();
+      if (error1.squaredNorm() < threshold_sq &&
+          error2.squaredNorm() < threshold_sq) {
+        inliers++;
+      }
+    }
+    return inliers;
+  };
+
+  PoseRansac::Result result;
+  if (legacy_sampling) {
+    std::vector<uint32_t> samples = PoseRansac::LegacySamples(
+        num_matches, N, ransac_params.max_iterations, ransac_params.seed);
+    auto draw_sample = [&](int iteration, std::vector<uint32_t>& sample) {
+      std::copy_n(samples.begin() + iteration * N, N, sample.begin());
+    };
+    result = PoseRansac::Run(num_matches, N, ransac_params, draw_sample,
+                             solve, score);
   } else {
+    result = PoseRansac::Run(num_matches, N, ransac_params, solve, score);
+  }
+  if (result.num_inliers <= 0) { return {}; }
+  return result.model;
+}
+
+} // namespace
+
+beam::opt<Eigen::Matrix3d> RelativePoseEstimator::EssentialMatrix8Point(
+    const std::shared_ptr<beam_calibration::CameraModel>& cam1,
+    const std::shared_ptr<beam_calibration::CameraModel>& cam2,
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p1_v,
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p2_v) {
+  if (p2_v.size() < 8 || p1_v.size() < 8 || p1_v.size() != p2_v.size()) {
+    BEAM_CRITICAL("Invalid number of input point matches.");
+    return {};
+  }
+  // normalize input points via back projection
+  Rays X_r, X_c;
+  if (!BackProjectMatches(cam1, cam2, p1_v, p2_v, X_r, X_c)) {
+    BEAM_CRITICAL("Invalid pixel input. Unable to back project.");
+    return {};
+  }
+  std::vector<uint32_t> indices(p1_v.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  return EssentialMatrix8PointFromRays(X_r, X_c, indices);
+}
+
+beam::opt<std::vector<Eigen::Matrix3d, beam::AlignMat3d>>
+    RelativePoseEstimator::EssentialMatrix7Point(
+        const std::shared_ptr<beam_calibration::CameraModel>& cam1,
+        const std::shared_ptr<beam_calibration::CameraModel>& cam2,
+        const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p1_v,
+        const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p2_v) {
+  if (p2_v.size() < 7 || p1_v.size() < 7 || p1_v.size() != p2_v.size()) {
+    BEAM_CRITICAL("Invalid number of input point matches.");
+    return {};
+  }
+  // normalize input points via back projection
+  Rays X_r, X_c;
+  if (!BackProjectMatches(cam1, cam2, p1_v, p2_v, X_r, X_c)) {
+    BEAM_CRITICAL("Invalid pixel input. Unable to back project.");
     return {};
   }
+  std::vector<uint32_t> indices(p1_v.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  std::vector<Eigen::Matrix3d, beam::AlignMat3d> E;
+  EssentialMatrix7PointFromRays(X_r, X_c, indices, E);
+  return E;
+}
+
+beam::opt<Eigen::Matrix4d> RelativePoseEstimator::RANSACEstimator(
+    const std::shared_ptr<beam_calibration::CameraModel>& cam1,
+    const std::shared_ptr<beam_calibration::CameraModel>& cam2,
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p1_v,
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p2_v, EstimatorMethod method,
+    int max_iterations, double inlier_threshold, int seed) {
+  // all iterations are run with the same samples as before RansacParams
+  // were added
+  RansacParams params;
+  params.max_iterations = max_iterations;
+  params.confidence = 0;
+  params.seed = seed;
+  return RelativePoseRansac(cam1, cam2, p1_v, p2_v, method, params,
+                            inlier_threshold, true);
+}
+
+beam::opt<Eigen::Matrix4d> RelativePoseEstimator::RANSACEstimator(
+    const std::shared_ptr<beam_calibration::CameraModel>& cam1,
+    const std::shared_ptr<beam_calibration::CameraModel>& cam2,
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p1_v,
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& p2_v,
+    EstimatorMethod method, const RansacParams& params,
+    double inlier_threshold) {
+  return RelativePoseRansac(cam1, cam2, p1_v, p2_v, method, params,
+                            inlier_threshold, false);
 }
 
 void RelativePoseEstimator::RtFromE(const Eigen::Matrix3d& E,
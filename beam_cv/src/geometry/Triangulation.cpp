@@ -16,6 +16,39 @@ beam::opt<Eigen::Vector3d> Triangulation::TriangulatePoint(
   if (!cam1->BackProject(p1, m1) || !cam2->BackProject(p2, m2)) { return {}; }
   m1.normalize();
   m2.normalize();
+  beam::opt<Eigen::Vector3d> point =
+      TriangulateRays(m1, m2, T_cam1_world, T_cam2_world, max_dist);
+  if (!point.has_value()) { return {}; }
+  Eigen::Vector3d xp = point.value();
+
+  // check reprojection
+  if (reprojection_threshold > 0.0) {
+    Eigen::Vector3d T_cam1_world_x =
+        (T_cam1_world * xp.homogeneous()).hnormalized();
+    Eigen::Vector3d T_cam2_world_x =
+        (T_cam2_world * xp.homogeneous()).hnormalized();
+    Eigen::Vector2d reproj_pixel1;
+    cam1->ProjectPoint(T_cam1_world_x, reproj_pixel1);
+    Eigen::Vector2i reproj_pixel1i = reproj_pixel1.cast<int>();
+    if (beam::distance(reproj_pixel1i, p1) > reprojection_threshold) {
+      return {};
+    }
+
+    Eigen::Vector2d reproj_pixel2;
+    cam2->ProjectPoint(T_cam2_world_x, reproj_pixel2);
+    Eigen::Vector2i reproj_pixel2i = reproj_pixel2.cast<int>();
+    if (beam::distance(reproj_pixel2i, p2) > reprojection_threshold) {
+      return {};
+    }
+  }
+
+  return xp;
+}
+
+beam::opt<Eigen::Vector3d> Triangulation::TriangulateRays(
+    const Eigen::Vector3d& m1, const Eigen::Vector3d& m2,
+    const Eigen::Matrix4d& T_cam1_world, const Eigen::Matrix4d& T_cam2_world,
+    const double max_dist) {
   double mx1 = m1[0], my1 = m1[1], mz1 = m1[2];
   double mx2 = m2[0], my2 = m2[1], mz2 = m2[2];
   /* building the linear system for triangulation from here:
@@ -45,23 +78,6 @@ beam::opt<Eigen::Vector3d> Triangulation::TriangulatePoint(
     return {};
   }
 
-  // check reprojection
-  if (reprojection_threshold > 0.0) {
-    Eigen::Vector2d reproj_pixel1;
-    cam1->ProjectPoint(T_cam1_world_x, reproj_pixel1);
-    Eigen::Vector2i reproj_pixel1i = reproj_pixel1.cast<int>();
-    if (beam::distance(reproj_pixel1i, p1) > reprojection_threshold) {
-      return {};
-    }
-
-    Eigen::Vector2d reproj_pixel2;
-    cam2->ProjectPoint(T_cam2_world_x, reproj_pixel2);
-    Eigen::Vector2i reproj_pixel2i = reproj_pixel2.cast<int>();
-    if (beam::distance(reproj_pixel2i, p2) > reprojection_threshold) {
-      return {};
-    }
-  }
-
   return xp;
 }
 
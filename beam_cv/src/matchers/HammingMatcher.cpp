@@ -0,0 +1,433 @@
+#include <beam_cv/matchers/HammingMatcher.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BEAM_HAMMING_X86
+#endif
+
+#include <boost/filesystem.hpp>
+#include <nlohmann/json.hpp>
+
+#include <beam_utils/parallel.h>
+
+namespace beam_cv {
+
+namespace {
+
+/** minimum number of query descriptors matched by each thread */
+constexpr size_t k_min_queries_per_thread{128};
+
+/** a fundamental matrix needs at least this many matches with RANSAC */
+constexpr size_t k_min_fundamental_matches{8};
+
+/** hamming distance between two descriptors of num_bytes bytes */
+using HammingKernel = int (*)(const uint8_t*, const uint8_t*, int);
+
+/**
+ * @brief hamming distance of the bytes from start to num_bytes, 8 bytes at a
+ * time. This is always inlined so the popcounts are compiled with the target
+ * of the calling kernel
+ */
+__attribute__((always_inline)) inline int
+    HammingDistanceWords(const uint8_t* a, const uint8_t* b, int start,
+                         int num_bytes) {
+  int distance = 0;
+  int i = start;
+  for (; i + 8 <= num_bytes; i += 8) {
+    uint64_t wa, wb;
+    std::memcpy(&wa, a + i, sizeof(uint64_t));
+    std::memcpy(&wb, b + i, sizeof(uint64_t));
+    distance += __builtin_popcountll(wa ^ wb);
+  }
+  for (; i < num_bytes; i++) { distance += __builtin_popcount(a[i] ^ b[i]); }
+  return distance;
+}
+
+/** @brief kernel for any cpu, popcounts are computed in software */
+int HammingDistanceGeneric(const uint8_t* a, const uint8_t* b, int num_bytes) {
+  return HammingDistanceWords(a, b, 0, num_bytes);
+}
+
+#if defined(BEAM_HAMMING_X86)
+/** @brief kernel using the popcnt instruction */
+__attribute__((target("popcnt"))) int
+    HammingDistancePopcnt(const uint8_t* a, const uint8_t* b, int num_bytes) {
+  return HammingDistanceWords(a, b, 0, num_bytes);
+}
+
+/**
+ * @brief number of set bits in a 256 bit register, counting each nibble with
+ * a lookup table and summing the bytes with sad
+ */
+__attribute__((target("avx2"))) inline int Popcount256(__m256i v) {
+  const __m256i lookup =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                       1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  __m256i low = _mm256_and_si256(v, low_mask);
+  __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+  __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low),
+                                   _mm256_shuffle_epi8(lookup, high));
+  __m256i sums = _mm256_sad_epu8(counts, _mm256_setzero_si256());
+  return _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+         _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+}
+
+/**
+ * @brief kernel comparing 32 bytes at a time with avx2, the remaining bytes
+ * use the popcnt instruction
+ */
+__attribute__((target("avx2,popcnt"))) int
+    HammingDistanceAvx2(const uint8_t* a, const uint8_t* b, int num_bytes) {
+  int distance = 0;
+  int i = 0;
+  for (; i + 32 <= num_bytes; i += 32) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    distance += Popcount256(_mm256_xor_si256(va, vb));
+  }
+  return distance + HammingDistanceWords(a, b, i, num_bytes);
+}
+#endif
+
+/**
+ * @brief picks the fastest kernel supported by the cpu the library is running
+ * on. This is only checked once
+ */
+HammingKernel GetHammingKernel() {
+  static const HammingKernel kernel = []() -> HammingKernel {
+#if defined(BEAM_HAMMING_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+      return HammingDistanceAvx2;
+    }
+    if (__builtin_cpu_supports("popcnt")) { return HammingDistancePopcnt; }
+#endif
+    return HammingDistanceGeneric;
+  }();
+  return kernel;
+}
+
+} // namespace
+
+void HammingMatcher::Params::LoadFromJson(const std::string& config_path) {
+  if (config_path.empty()) { return; }
+
+  if (!boost::filesystem::exists(config_path)) {
+    BEAM_ERROR("Invalid file path for Hamming matcher params, using default "
+               "params. Input: {}",
+               config_path);
+    return;
+  }
+
+  nlohmann::json J;
+  std::ifstream file(config_path);
+  file >> J;
+  ratio_threshold = J["ratio_threshold"];
+  max_distance = J["max_distance"];
+  cross_check = J["cross_check"];
+  auto_remove_outliers = J["auto_remove_outliers"];
+  search_radius = J["search_radius"];
+  if (J.contains("num_threads")) { num_threads = J["num_threads"]; }
+}
+
+HammingMatcher::HammingMatcher(const Params& params) : params_(params) {}
+
+HammingMatcher::HammingMatcher(double ratio_threshold, int max_distance,
+                               bool cross_check, bool auto_remove_outliers,
+                               double search_radius) {
+  params_.ratio_threshold = ratio_threshold;
+  params_.max_distance = max_distance;
+  params_.cross_check = cross_check;
+  params_.auto_remove_outliers = auto_remove_outliers;
+  params_.search_radius = search_radius;
+}
+
+int HammingMatcher::HammingDistance(const uint8_t* a, const uint8_t* b,
+                                    int num_bytes) {
+  return GetHammingKernel()(a, b, num_bytes);
+}
+
+std::vector<cv::DMatch> HammingMatcher::MatchDescriptors(
+    cv::Mat& descriptors_1, cv::Mat& descriptors_2,
+    const std::vector<cv::KeyPoint>& keypoints_1,
+    const std::vector<cv::KeyPoint>& keypoints_2, cv::InputArray mask) {
+  if (params_.search_radius <= 0) {
+    return Match(descriptors_1, descriptors_2, keypoints_1, keypoints_2,
+                 nullptr, mask.getMat());
+  }
+  std::vector<cv::Point2f> predicted_pixels;
+  cv::KeyPoint::convert(keypoints_1, predicted_pixels);
+  return Match(descriptors_1, descriptors_2, keypoints_1, keypoints_2,
+               &predicted_pixels, mask.getMat());
+}
+
+std::vector<cv::DMatch> HammingMatcher::MatchDescriptors(
+    const cv::Mat& descriptors_1, const cv::Mat& descriptors_2,
+    const std::vector<cv::KeyPoint>& keypoints_1,
+    const std::vector<cv::KeyPoint>& keypoints_2,
+    const std::vector<cv::Point2f>& predicted_pixels) {
+  if (params_.search_radius <= 0) {
+    BEAM_ERROR("Search radius must be set to match with predicted pixels.");
+    return {};
+  }
+  if (predicted_pixels.size() != keypoints_1.size()) {
+    BEAM_ERROR("Number of predicted pixels ({}) must match the number of "
+               "keypoints ({}).",
+               predicted_pixels.size(), keypoints_1.size());
+    return {};
+  }
+  return Match(descriptors_1, descriptors_2, keypoints_1, keypoints_2,
+               &predicted_pixels, cv::Mat());
+}
+
+std::vector<cv::DMatch> HammingMatcher::Match(
+    const cv::Mat& descriptors_1, const cv::Mat& descriptors_2,
+    const std::vector<cv::KeyPoint>& keypoints_1,
+    const std::vector<cv::KeyPoint>& keypoints_2,
+    const std::vector<cv::Point2f>* predicted_pixels,
+    const cv::Mat& mask) const {
+  if (keypoints_1.empty() || keypoints_2.empty()) {
+    BEAM_WARN("Empty keypoints vector provided, not matching descriptors.");
+    return {};
+  }
+  if (descriptors_1.depth() != CV_8U || descriptors_2.depth() != CV_8U ||
+      descriptors_1.cols != descriptors_2.cols) {
+    BEAM_ERROR("HammingMatcher requires binary (CV_8U) descriptors of the "
+               "same size.");
+    return {};
+  }
+  if (descriptors_1.rows != static_cast<int>(keypoints_1.size()) ||
+      descriptors_2.rows != static_cast<int>(keypoints_2.size())) {
+    BEAM_ERROR("Number of descriptors must match the number of keypoints.");
+    return {};
+  }
+  if (!mask.empty() &&
+      (mask.type() != CV_8UC1 || mask.rows != descriptors_1.rows ||
+       mask.cols != descriptors_2.rows)) {
+    BEAM_ERROR("Invalid mask given to HammingMatcher.");
+    return {};
+  }
+  const int num_bytes = descriptors_1.cols * descriptors_1.channels();
+  const int num_train = descriptors_2.rows;
+  const HammingKernel hamming_distance = GetHammingKernel();
+
+  // grid of the train keypoints, with cells at least the size of the search
+  // radius so all keypoints within the radius are in the 3 x 3 cells around a
+  // pixel. Cells are grown for small radii so there are not many more cells
+  // than keypoints
+  const bool use_grid = predicted_pixels != nullptr;
+  const float radius = params_.search_radius;
+  float cell_size = radius;
+  float min_x = 0, min_y = 0;
+  int grid_cols = 1, grid_rows = 1;
+  std::vector<int> cell_starts;
+  std::vector<int> cell_points;
+  // cell of a pixel. Pixels far outside the grid (or nan) are put two cells
+  // outside of it so no keypoints are searched
+  auto cell_of = [&](const cv::Point2f& p, int& cx, int& cy) {
+    float x = std::floor((p.x - min_x) / cell_size);
+    float y = std::floor((p.y - min_y) / cell_size);
+    cx = x >= -2 && x <= grid_cols + 1 ? static_cast<int>(x) : -2;
+    cy = y >= -2 && y <= grid_rows + 1 ? static_cast<int>(y) : -2;
+  };
+  if (use_grid) {
+    float max_x = keypoints_2[0].pt.x, max_y = keypoints_2[0].pt.y;
+    min_x = max_x;
+    min_y = max_y;
+    for (const cv::KeyPoint& kp : keypoints_2) {
+      min_x = std::min(min_x, kp.pt.x);
+      min_y = std::min(min_y, kp.pt.y);
+      max_x = std::max(max_x, kp.pt.x);
+      max_y = std::max(max_y, kp.pt.y);
+    }
+    float extent = std::max(max_x - min_x, max_y - min_y);
+    cell_size =
+        std::max(cell_size, extent / std::sqrt(static_cast<float>(num_train)));
+    grid_cols = static_cast<int>((max_x - min_x) / cell_size) + 1;
+    grid_rows = static_cast<int>((max_y - min_y) / cell_size) + 1;
+
+    // counting sort of the keypoints into their cells
+    cell_starts.assign(grid_cols * grid_rows + 1, 0);
+    std::vector<int> cells(num_train);
+    for (int j = 0; j < num_train; j++) {
+      int cx, cy;
+      cell_of(keypoints_2[j].pt, cx, cy);
+      cells[j] = cy * grid_cols + cx;
+      cell_starts[cells[j] + 1]++;
+    }
+    for (size_t c = 1; c < cell_starts.size(); c++) {
+      cell_starts[c] += cell_starts[c - 1];
+    }
+    cell_points.resize(num_train);
+    std::vector<int> next(cell_starts.begin(), cell_starts.end() - 1);
+    for (int j = 0; j < num_train; j++) { cell_points[next[cells[j]]++] = j; }
+  }
+
+  // best query for each train descriptor, used for the cross check. Each
+  // thread keeps its own and these are merged in order
+  struct TrainBest {
+    int distance{std::numeric_limits<int>::max()};
+    int query{-1};
+  };
+  const int num_query = descriptors_1.rows;
+  int n_threads = beam::GetNumThreads(params_.num_threads, num_query,
+                                      k_min_queries_per_thread);
+  std::vector<std::vector<TrainBest>> train_best(
+      params_.cross_check ? n_threads : 0,
+      std::vector<TrainBest>(num_train));
+  std::vector<cv::DMatch> best_matches(num_query);
+  std::vector<int> second_distances(num_query);
+
+  beam::ParallelForChunks(
+      num_query, n_threads, [&](int thread_id, size_t begin, size_t end) {
+        const float radius_sq = radius * radius;
+        for (size_t i = begin; i < end; i++) {
+          const uint8_t* query = descriptors_1.ptr<uint8_t>(i);
+          const uint8_t* mask_row = mask.empty() ? nullptr : mask.ptr(i);
+          int best = std::numeric_limits<int>::max();
+          int second = std::numeric_limits<int>::max();
+          int best_j = -1;
+          auto compare = [&](int j) {
+            if (mask_row != nullptr && !mask_row[j]) { return; }
+            int d = hamming_distance(query, descriptors_2.ptr<uint8_t>(j),
+                                     num_bytes);
+            // ties go to the lowest train index, as in a serial search,
+            // since the grid does not visit keypoints in order
+            if (d < best || (d == best && j < best_j)) {
+              second = best;
+              best = d;
+              best_j = j;
+            } else if (d < second) {
+              second = d;
+            }
+            if (params_.cross_check) {
+              TrainBest& tb = train_best[thread_id][j];
+              if (d < tb.distance) {
+                tb.distance = d;
+                tb.query = static_cast<int>(i);
+              }
+            }
+          };
+
+          if (!use_grid) {
+            for (int j = 0; j < num_train; j++) { compare(j); }
+          } else {
+            const cv::Point2f& p = (*predicted_pixels)[i];
+            int cx, cy;
+            cell_of(p, cx, cy);
+            for (int y = std::max(cy - 1, 0);
+                 y <= std::min(cy + 1, grid_rows - 1); y++) {
+              for (int x = std::max(cx - 1, 0);
+                   x <= std::min(cx + 1, grid_cols - 1); x++) {
+                int c = y * grid_cols + x;
+                for (int k = cell_starts[c]; k < cell_starts[c + 1]; k++) {
+                  int j = cell_points[k];
+                  cv::Point2f d = keypoints_2[j].pt - p;
+                  if (d.dot(d) <= radius_sq) { compare(j); }
+                }
+              }
+            }
+          }
+          best_matches[i] = cv::DMatch(static_cast<int>(i), best_j,
+                                       static_cast<float>(best));
+          second_distances[i] = second;
+        }
+      });
+
+  // merge the best query of each train descriptor, ties go to the lowest
+  // query index as in a serial search
+  std::vector<int> train_best_query;
+  if (params_.cross_check) {
+    train_best_query.assign(num_train, -1);
+    for (int j = 0; j < num_train; j++) {
+      TrainBest best;
+      for (const auto& tb : train_best) {
+        if (tb[j].distance < best.distance ||
+            (tb[j].distance == best.distance && tb[j].query < best.query)) {
+          best = tb[j];
+        }
+      }
+      train_best_query[j] = best.query;
+    }
+  }
+
+  std::vector<cv::DMatch> matches;
+  for (int i = 0; i < num_query; i++) {
+    const cv::DMatch& m = best_matches[i];
+    if (m.trainIdx < 0) { continue; }
+    if (params_.ratio_threshold < 1 &&
+        second_distances[i] != std::numeric_limits<int>::max() &&
+        !(m.distance < second_distances[i] &&
+          m.distance <= params_.ratio_threshold * second_distances[i])) {
+      continue;
+    }
+    if (params_.cross_check && train_best_query[m.trainIdx] != i) {
+      continue;
+    }
+    matches.push_back(m);
+  }
+  matches = FilterMatches(matches);
+
+  if (params_.auto_remove_outliers) {
+    return RemoveOutliers(matches, keypoints_1, keypoints_2);
+  }
+  return matches;
+}
+
+std::vector<cv::DMatch> HammingMatcher::RemoveOutliers(
+    const std::vector<cv::DMatch>& matches,
+    const std::vector<cv::KeyPoint>& keypoints_1,
+    const std::vector<cv::KeyPoint>& keypoints_2) const {
+  if (matches.size() < k_min_fundamental_matches) { return matches; }
+  std::vector<cv::Point2f> fp1, fp2;
+  fp1.reserve(matches.size());
+  fp2.reserve(matches.size());
+  for (const auto& match : matches) {
+    fp1.push_back(keypoints_1.at(match.queryIdx).pt);
+    fp2.push_back(keypoints_2.at(match.trainIdx).pt);
+  }
+  // max distance from a point to an epipolar line in pixels, and confidence,
+  // as in BFMatcher
+  std::vector<uchar> mask;
+  cv::findFundamentalMat(fp1, fp2, cv::FM_RANSAC, 3.0, 0.99, mask);
+  std::vector<cv::DMatch> good_matches;
+  for (size_t i = 0; i < mask.size(); i++) {
+    if (mask[i] != 0) { good_matches.push_back(matches[i]); }
+  }
+  return good_matches;
+}
+
+std::vector<cv::DMatch> HammingMatcher::FilterMatches(
+    const std::vector<cv::DMatch>& matches) const {
+  std::vector<cv::DMatch> filtered_matches;
+  filtered_matches.reserve(matches.size());
+  for (const auto& match : matches) {
+    if (match.distance <= params_.max_distance) {
+      filtered_matches.push_back(match);
+    }
+  }
+  return filtered_matches;
+}
+
+std::vector<cv::DMatch> HammingMatcher::FilterMatches(
+    const std::vector<std::vector<cv::DMatch>>& matches) const {
+  std::vector<cv::DMatch> filtered_matches;
+  for (const auto& match : matches) {
+    if (match.empty()) { continue; }
+    if (match.size() == 1 ||
+        (match[0].distance < match[1].distance &&
+         match[0].distance <= params_.ratio_threshold * match[1].distance)) {
+      filtered_matches.push_back(match[0]);
+    }
+  }
+  return FilterMatches(filtered_matches);
+}
+
+} // namespace beam_cv
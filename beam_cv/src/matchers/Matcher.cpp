@@ -24,6 +24,10 @@ std::shared_ptr<Matcher> Matcher::Create(MatcherType type,
     FLANNMatcher::Params params;
     params.LoadFromJson(file_to_read);
     return std::make_shared<FLANNMatcher>(params);
+  } else if (type == MatcherType::HAMMING) {
+    HammingMatcher::Params params;
+    params.LoadFromJson(file_to_read);
+    return std::make_shared<HammingMatcher>(params);
   } else {
     BEAM_WARN("Input matcher type not implemented. Using default.");
     BFMatcher::Params params;
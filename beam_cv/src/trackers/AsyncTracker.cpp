@@ -0,0 +1,138 @@
+#include <beam_cv/trackers/AsyncTracker.h>
+
+#include <beam_utils/log.h>
+
+namespace beam_cv {
+
+bool AsyncTracker::JobQueue::Push(Job& job, bool block) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (block) {
+    not_full_.wait(lock,
+                   [this] { return closed_ || jobs_.size() < capacity_; });
+  }
+  if (closed_ || jobs_.size() >= capacity_) { return false; }
+  jobs_.push_back(std::move(job));
+  lock.unlock();
+  not_empty_.notify_one();
+  return true;
+}
+
+bool AsyncTracker::JobQueue::Pop(Job& job) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  not_empty_.wait(lock, [this] { return closed_ || !jobs_.empty(); });
+  if (jobs_.empty()) { return false; }
+  job = std::move(jobs_.front());
+  jobs_.pop_front();
+  lock.unlock();
+  not_full_.notify_one();
+  return true;
+}
+
+void AsyncTracker::JobQueue::Close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+  }
+  not_empty_.notify_all();
+  not_full_.notify_all();
+}
+
+AsyncTracker::AsyncTracker(std::shared_ptr<Tracker> tracker,
+                           size_t queue_size, TracksCallback callback)
+    : tracker_(tracker),
+      callback_(callback),
+      input_queue_(queue_size),
+      preprocessed_queue_(queue_size) {
+  if (tracker_ == nullptr) {
+    BEAM_CRITICAL("Cannot create AsyncTracker, tracker is null.");
+    throw std::invalid_argument{"Tracker is null."};
+  }
+  preprocess_thread_ = std::thread(&AsyncTracker::PreprocessSpin, this);
+  track_thread_ = std::thread(&AsyncTracker::TrackSpin, this);
+}
+
+AsyncTracker::~AsyncTracker() {
+  // the preprocessing thread closes the next queue once it has emptied its
+  // own, so all added images are tracked before the threads exit
+  input_queue_.Close();
+  preprocess_thread_.join();
+  track_thread_.join();
+}
+
+std::future<std::vector<FeatureTrack>>
+    AsyncTracker::AddImage(const cv::Mat& image, const ros::Time& stamp) {
+  std::future<std::vector<FeatureTrack>> tracks;
+  Add(image, stamp, true, tracks);
+  return tracks;
+}
+
+bool AsyncTracker::TryAddImage(const cv::Mat& image, const ros::Time& stamp,
+                               std::future<std::vector<FeatureTrack>>& tracks) {
+  return Add(image, stamp, false, tracks);
+}
+
+bool AsyncTracker::Add(const cv::Mat& image, const ros::Time& stamp,
+                       bool block,
+                       std::future<std::vector<FeatureTrack>>& tracks) {
+  Job job;
+  job.frame.image = image;
+  job.frame.stamp = stamp;
+  std::future<std::vector<FeatureTrack>> future = job.promise.get_future();
+  num_pending_++;
+  if (!input_queue_.Push(job, block)) {
+    FinishJob();
+    return false;
+  }
+  tracks = std::move(future);
+  return true;
+}
+
+void AsyncTracker::WaitAll() {
+  std::unique_lock<std::mutex> lock(done_mutex_);
+  done_condition_.wait(lock, [this] { return num_pending_ == 0; });
+}
+
+void AsyncTracker::PreprocessSpin() {
+  Job job;
+  while (input_queue_.Pop(job)) {
+    try {
+      tracker_->PreprocessImage(job.frame);
+    } catch (...) { job.error = std::current_exception(); }
+    // jobs which failed are still passed on so that futures are fulfilled in
+    // order
+    preprocessed_queue_.Push(job, true);
+  }
+  preprocessed_queue_.Close();
+}
+
+void AsyncTracker::TrackSpin() {
+  Job job;
+  while (preprocessed_queue_.Pop(job)) {
+    if (job.error) {
+      job.promise.set_exception(job.error);
+      FinishJob();
+      continue;
+    }
+    try {
+      tracker_->AddPreprocessedImage(job.frame);
+      std::vector<FeatureTrack> tracks = tracker_->GetTracks(job.frame.stamp);
+      if (callback_) { callback_(job.frame.stamp, tracks); }
+      job.promise.set_value(std::move(tracks));
+    } catch (...) {
+      BEAM_ERROR("Exception thrown while tracking image at time {}.",
+                 job.frame.stamp.toSec());
+      job.promise.set_exception(std::current_exception());
+    }
+    FinishJob();
+  }
+}
+
+void AsyncTracker::FinishJob() {
+  {
+    std::lock_guard<std::mutex> lock(done_mutex_);
+    num_pending_--;
+  }
+  done_condition_.notify_all();
+}
+
+} // namespace beam_cv
@@ -105,22 +105,26 @@ void DescMatchingTracker::Reset() {
   prev_kp_.clear();
 }
 
-void DescMatchingTracker::AddImage(const cv::Mat& image,
-                                   const ros::Time& current_time) {
+void DescMatchingTracker::PreprocessImage(TrackerFrame& frame) const {
+  DetectAndCompute(frame.image, descriptor_, detector_, frame.keypoints,
+                   frame.descriptors);
+}
+
+void DescMatchingTracker::AddPreprocessedImage(const TrackerFrame& frame) {
   // Register the time this image
-  TimestampImage(current_time);
+  TimestampImage(frame.stamp);
 
-  // Check if this is the first image being tracked.
+  // Check if this is the first image being tracked. No tracks can be
+  // generated yet.
+  std::vector<cv::KeyPoint> curr_kp = frame.keypoints;
+  cv::Mat curr_desc = frame.descriptors;
   if (img_times_.size() == 1) {
-    // Detect features within first image. No tracks can be generated yet.
-    DetectAndCompute(image, descriptor_, detector_, prev_kp_, prev_desc_);
+    prev_kp_ = curr_kp;
+    prev_desc_ = curr_desc;
     return;
   }
 
-  // Detect, describe, and match keypoints
-  std::vector<cv::KeyPoint> curr_kp;
-  cv::Mat curr_desc;
-  DetectAndCompute(image, descriptor_, detector_, curr_kp, curr_desc);
+  // Match keypoints
   std::vector<cv::DMatch> matches =
       matcher_->MatchDescriptors(prev_desc_, curr_desc, prev_kp_, curr_kp);
 
@@ -2,6 +2,8 @@
 
 #include <time.h>
 
+#include <algorithm>
+
 #include <beam_utils/log.h>
 #include <beam_utils/math.h>
 #include <boost/filesystem.hpp>
@@ -31,6 +33,15 @@ void KLTracker::Params::LoadFromJson(const std::string& config_path) {
   double criteria_epsilon = J["criteria_epsilon"];
   criteria = cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS,
                               criteria_max_count, criteria_epsilon);
+
+  // optional params, so that older config files can still be loaded
+  if (J.contains("forward_backward_check")) {
+    forward_backward_check = J["forward_backward_check"];
+  }
+  if (J.contains("max_forward_backward_error")) {
+    max_forward_backward_error = J["max_forward_backward_error"];
+  }
+  if (J.contains("tracking_level")) { tracking_level = J["tracking_level"]; }
 }
 
 KLTracker::KLTracker(std::shared_ptr<beam_cv::Detector> detector,
@@ -61,6 +72,18 @@ void KLTracker::ValidateParams() {
     params_.keypoint_resample_percentage =
         params_tmp.keypoint_resample_percentage;
   }
+  if (params_.max_forward_backward_error <= 0) {
+    Params params_tmp;
+    BEAM_ERROR("Invalid max_forward_backward_error. Value must be greater than "
+               "0. Setting to default: {}",
+               params_tmp.max_forward_backward_error);
+    params_.max_forward_backward_error = params_tmp.max_forward_backward_error;
+  }
+  if (params_.tracking_level < 0) {
+    BEAM_ERROR("Invalid tracking_level. Value must be greater than or equal to "
+               "0. Setting to 0.");
+    params_.tracking_level = 0;
+  }
 }
 
 void KLTracker::Reset() {
@@ -74,36 +97,92 @@ void KLTracker::Reset() {
   original_feature_count_ = 0;
   prev_kp_.clear();
   curr_kp_.clear();
+  prev_pyramid_.clear();
 }
 
-void KLTracker::AddImage(const cv::Mat& image, const ros::Time& current_time) {
+void KLTracker::PreprocessImage(TrackerFrame& frame) const {
+  // the pyramid is kept as the previous pyramid for the next image, so it
+  // must not share memory with the input image
+  cv::buildOpticalFlowPyramid(frame.image, frame.pyramid,
+                              cv::Size(params_.win_size_u, params_.win_size_v),
+                              params_.tracking_level + params_.max_level, true,
+                              cv::BORDER_REFLECT_101, cv::BORDER_CONSTANT,
+                              false);
+}
+
+void KLTracker::AddPreprocessedImage(const TrackerFrame& frame) {
+  const cv::Mat& image = frame.image;
+
   // Register the time this image
-  TimestampImage(current_time);
+  TimestampImage(frame.stamp);
 
   // Check if this is the first image being tracked.
   if (img_times_.size() == 1) {
     // Detect features within first image. No tracks can be generated yet.
     DetectInitialFeatures(image);
+    prev_pyramid_ = frame.pyramid;
     return;
   }
 
-  // Track keypoints
+  // Track keypoints from the cached pyramid of the previous image
   std::vector<uchar> status;
-  std::vector<float> err;
   uint32_t new_points_start_id = ExtractNewKeypoints(image);
-  cv::calcOpticalFlowPyrLK(prev_image_, image, prev_kp_, curr_kp_, status, err,
-                           cv::Size(params_.win_size_u, params_.win_size_v),
-                           params_.max_level, params_.criteria);
+  TrackKeypoints(frame.pyramid, status);
 
   // assign current keypoints and descriptors & add to landmarks
   RegisterKeypoints(status, image, new_points_start_id);
 
-  // Update previous keypoints & image
-  prev_image_ = image.clone();
+  // Update previous keypoints & pyramid
+  prev_pyramid_ = frame.pyramid;
   prev_kp_ = curr_kp_;
   prev_desc_ = curr_desc_.clone();
 }
 
+void KLTracker::TrackKeypoints(const std::vector<cv::Mat>& curr_pyramid,
+                               std::vector<uchar>& status) {
+  // pyramids hold an image and its derivatives for each level. Images which
+  // are too small get fewer levels, so the tracking level is limited to the
+  // coarsest level of both pyramids
+  int num_levels =
+      static_cast<int>(std::min(prev_pyramid_.size(), curr_pyramid.size())) /
+      2;
+  int level = std::min(params_.tracking_level, num_levels - 1);
+  std::vector<cv::Mat> prev_levels(prev_pyramid_.begin() + 2 * level,
+                                   prev_pyramid_.begin() + 2 * num_levels);
+  std::vector<cv::Mat> curr_levels(curr_pyramid.begin() + 2 * level,
+                                   curr_pyramid.begin() + 2 * num_levels);
+  float scale = 1.0f / (1 << level);
+  std::vector<cv::Point2f> prev_kp_scaled = prev_kp_;
+  for (cv::Point2f& p : prev_kp_scaled) { p *= scale; }
+
+  std::vector<float> err;
+  cv::Size win_size(params_.win_size_u, params_.win_size_v);
+  cv::calcOpticalFlowPyrLK(prev_levels, curr_levels, prev_kp_scaled, curr_kp_,
+                           status, err, win_size, params_.max_level,
+                           params_.criteria);
+
+  if (params_.forward_backward_check) {
+    // track back from the tracked positions into the previous image
+    std::vector<cv::Point2f> back_kp;
+    std::vector<uchar> back_status;
+    cv::calcOpticalFlowPyrLK(curr_levels, prev_levels, curr_kp_, back_kp,
+                             back_status, err, win_size, params_.max_level,
+                             params_.criteria);
+    double max_error = params_.max_forward_backward_error * scale;
+    for (size_t i = 0; i < status.size(); i++) {
+      if (!status[i]) { continue; }
+      if (!back_status[i] || cv::norm(back_kp[i] - prev_kp_scaled[i]) >
+                                 max_error) {
+        status[i] = 0;
+      }
+    }
+  }
+
+  if (level > 0) {
+    for (cv::Point2f& p : curr_kp_) { p /= scale; }
+  }
+}
+
 void KLTracker::DetectInitialFeatures(const cv::Mat& image) {
   // get keypoints
   std::vector<cv::KeyPoint> keypoints_tmp = detector_->DetectFeatures(image);
@@ -125,7 +204,6 @@ void KLTracker::DetectInitialFeatures(const cv::Mat& image) {
     curr_ids_.push_back(std::make_pair(id, true));
   }
   tracked_features_count_ = prev_kp_.size();
-  prev_image_ = image.clone();
 }
 
 void KLTracker::RegisterKeypoints(const std::vector<uchar>& status,
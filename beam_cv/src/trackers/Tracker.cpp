@@ -4,6 +4,14 @@ namespace beam_cv {
 
 Tracker::Tracker(int window_size) : window_size_(window_size) {}
 
+void Tracker::AddImage(const cv::Mat& image, const ros::Time& current_time) {
+  TrackerFrame frame;
+  frame.image = image;
+  frame.stamp = current_time;
+  PreprocessImage(frame);
+  AddPreprocessedImage(frame);
+}
+
 void Tracker::TimestampImage(const ros::Time& current_time) {
   img_times_.insert(current_time.toNSec());
 }
@@ -207,4 +207,92 @@ TEST_CASE("Test matching: BRISK Desc + FAST Det") {
   }
 
   REQUIRE(theta_deg < 10.0);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test parallel grid detection") {
+  cv::Mat image;
+  cv::cvtColor(imL, image, cv::COLOR_BGR2GRAY);
+  std::vector<std::shared_ptr<beam_cv::Detector>> detectors{
+      std::make_shared<beam_cv::ORBDetector>(),
+      std::make_shared<beam_cv::FASTDetector>(),
+      std::make_shared<beam_cv::GFTTDetector>()};
+  for (const auto& detector : detectors) {
+    beam_cv::Detector::GridParams params;
+    REQUIRE(params.num_threads == 1);
+    std::vector<cv::KeyPoint> serial = detector->DetectFeatures(image);
+
+    params.num_threads = 4;
+    detector->SetGridParams(params);
+    std::vector<cv::KeyPoint> parallel = detector->DetectFeatures(image);
+    REQUIRE(!serial.empty());
+    REQUIRE(serial.size() == parallel.size());
+    for (size_t i = 0; i < serial.size(); i++) {
+      REQUIRE(serial[i].pt == parallel[i].pt);
+    }
+
+    // extra threads detect with clones, which keep the params
+    std::shared_ptr<beam_cv::Detector> clone = detector->Clone();
+    REQUIRE(clone != detector);
+    REQUIRE(clone->GetType() == detector->GetType());
+    REQUIRE(clone->GetGridParams().num_threads == 4);
+    std::vector<cv::KeyPoint> cloned = clone->DetectFeatures(image);
+    REQUIRE(cloned.size() == parallel.size());
+
+    // 3 x 2 grid by default
+    params.max_features_per_cell = 10;
+    detector->SetGridParams(params);
+    REQUIRE(detector->DetectFeatures(image).size() <= 60);
+
+    params.max_features_per_cell = 0;
+    params.border_nms_radius = 20;
+    detector->SetGridParams(params);
+    std::vector<cv::KeyPoint> suppressed = detector->DetectFeatures(image);
+    REQUIRE(suppressed.size() <= serial.size());
+    for (const auto& keypoint : suppressed) {
+      REQUIRE(keypoint.pt.x >= 0);
+      REQUIRE(keypoint.pt.x < image.cols);
+      REQUIRE(keypoint.pt.y >= 0);
+      REQUIRE(keypoint.pt.y < image.rows);
+    }
+  }
+}
+
+TEST_CASE("Test hamming matcher") {
+  beam_cv::ORBDetector detector;
+  beam_cv::ORBDescriptor descriptor;
+  std::vector<cv::KeyPoint> kp1 = detector.DetectFeatures(imL);
+  std::vector<cv::KeyPoint> kp2 = detector.DetectFeatures(imR);
+  cv::Mat desc1 = descriptor.ExtractDescriptors(imL, kp1);
+  cv::Mat desc2 = descriptor.ExtractDescriptors(imR, kp2);
+
+  // distances are compared with a ratio which is exact in floating point so
+  // the ratio tests of both matchers agree
+  beam_cv::BFMatcher bf_matcher(cv::NORM_HAMMING, false, false, 0.75);
+  beam_cv::HammingMatcher::Params params;
+  params.ratio_threshold = 0.75;
+  params.max_distance = 256;
+  params.auto_remove_outliers = false;
+  beam_cv::HammingMatcher hamming_matcher(params);
+  std::vector<cv::DMatch> bf_matches =
+      bf_matcher.MatchDescriptors(desc1, desc2, kp1, kp2);
+  std::vector<cv::DMatch> hamming_matches =
+      hamming_matcher.MatchDescriptors(desc1, desc2, kp1, kp2);
+  REQUIRE(!hamming_matches.empty());
+  REQUIRE(bf_matches.size() == hamming_matches.size());
+  for (size_t i = 0; i < bf_matches.size(); i++) {
+    REQUIRE(bf_matches[i].queryIdx == hamming_matches[i].queryIdx);
+    REQUIRE(bf_matches[i].trainIdx == hamming_matches[i].trainIdx);
+    REQUIRE(bf_matches[i].distance == hamming_matches[i].distance);
+  }
+
+  // gated matches must be close to the query keypoint
+  params.search_radius = 50;
+  params.cross_check = true;
+  beam_cv::HammingMatcher gated_matcher(params);
+  std::vector<cv::DMatch> gated_matches =
+      gated_matcher.MatchDescriptors(desc1, desc2, kp1, kp2);
+  REQUIRE(!gated_matches.empty());
+  for (const auto& m : gated_matches) {
+    REQUIRE(cv::norm(kp1[m.queryIdx].pt - kp2[m.trainIdx].pt) <= 50);
+  }
+}
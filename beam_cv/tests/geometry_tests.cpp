@@ -1,4 +1,5 @@
 #define CATCH_CONFIG_MAIN
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -8,6 +9,7 @@
 
 #include <beam_cv/Utils.h>
 #include <beam_cv/geometry/AbsolutePoseEstimator.h>
+#include <beam_cv/geometry/Ransac.h>
 #include <beam_cv/geometry/RelativePoseEstimator.h>
 #include <beam_cv/geometry/Triangulation.h>
 
@@ -67,6 +69,22 @@ void GenerateP3PMatches(std::shared_ptr<beam_calibration::CameraModel> cam,
   }
 }
 
+// ransac for a value shared by 600 of 1000 data, every other value is unique
+beam_cv::Ransac<int>::Result
+    RunConsensusRansac(const beam_cv::RansacParams& params) {
+  std::vector<int> data(1000);
+  for (size_t i = 0; i < data.size(); i++) { data[i] = i % 5 < 3 ? -1 : i; }
+  using IntRansac = beam_cv::Ransac<int>;
+  return IntRansac::Run(
+      data.size(), 1, params,
+      [&](const std::vector<uint32_t>& sample, IntRansac::Models& models) {
+        models.push_back(data[sample[0]]);
+      },
+      [&](int model, size_t begin, size_t end) {
+        return std::count(data.begin() + begin, data.begin() + end, model);
+      });
+}
+
 TEST_CASE("Test triangulation.") {
   std::string cam_loc = __FILE__;
   cam_loc.erase(cam_loc.end() - 24, cam_loc.end());
@@ -260,4 +278,94 @@ TEST_CASE("Test RANSAC Absolute Pose estimator.") {
   BEAM_INFO("RANSAC PnP (30 iterations): {}", elapsed);
 
   REQUIRE(pose.isApprox(truth, 1e-3));
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test parallel RANSAC is independent of the number of threads.") {
+  Eigen::Matrix4d truth = Eigen::Matrix4d::Identity();
+
+  std::string location = __FILE__;
+  location.erase(location.end() - 24, location.end());
+  std::string intrinsics_loc = location + "tests/test_data/K.json";
+  std::shared_ptr<beam_calibration::CameraModel> cam =
+      beam_calibration::CameraModel::Create(intrinsics_loc);
+
+  // enough correspondences to use multiple threads, with half outliers
+  std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels;
+  std::vector<Eigen::Vector3d, beam::AlignVec3d> points;
+  GenerateP3PMatches(cam, pixels, points, 1000);
+  for (size_t i = 0; i < pixels.size(); i += 2) {
+    points[i] += Eigen::Vector3d(1, -1, 2);
+  }
+
+  beam_cv::RansacParams params;
+  params.max_iterations = 100;
+  params.seed = 17;
+  params.num_threads = 1;
+  beam::opt<Eigen::Matrix4d> serial =
+      beam_cv::AbsolutePoseEstimator::RANSACEstimator(cam, pixels, points,
+                                                      params, 5);
+  params.num_threads = 4;
+  beam::opt<Eigen::Matrix4d> parallel =
+      beam_cv::AbsolutePoseEstimator::RANSACEstimator(cam, pixels, points,
+                                                      params, 5);
+  REQUIRE(serial.has_value());
+  REQUIRE(parallel.has_value());
+  REQUIRE(serial.value() == parallel.value());
+  REQUIRE(serial.value().isApprox(truth, 1e-3));
+
+  // the inlier ratio is high enough to stop well before max iterations
+  REQUIRE(beam_cv::Ransac<Eigen::Matrix4d>::RequiredIterations(0.5, 3, 0.99) <
+          params.max_iterations);
+  params.max_iterations = 1000;
+  params.confidence = 0.99;
+  beam_cv::Ransac<int>::Result result = RunConsensusRansac(params);
+  REQUIRE(result.model == -1);
+  REQUIRE(result.num_inliers == 600);
+  REQUIRE(result.num_iterations < params.max_iterations);
+
+  // the legacy estimator overloads rely on this running all iterations
+  params.confidence = 0;
+  result = RunConsensusRansac(params);
+  REQUIRE(result.model == -1);
+  REQUIRE(result.num_iterations == params.max_iterations);
+}
+
+TEST_CASE("Test preemptive RANSAC.") {
+  Eigen::Matrix4d truth = Eigen::Matrix4d::Identity();
+
+  std::string location = __FILE__;
+  location.erase(location.end() - 24, location.end());
+  std::string intrinsics_loc = location + "tests/test_data/K.json";
+  std::shared_ptr<beam_calibration::CameraModel> cam =
+      beam_calibration::CameraModel::Create(intrinsics_loc);
+
+  std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels;
+  std::vector<Eigen::Vector3d, beam::AlignVec3d> points;
+  GenerateP3PMatches(cam, pixels, points, 1000);
+  for (size_t i = 0; i < pixels.size(); i += 2) {
+    points[i] += Eigen::Vector3d(1, -1, 2);
+  }
+
+  beam_cv::RansacParams params;
+  params.max_iterations = 100;
+  params.seed = 17;
+  params.preemptive = true;
+  params.num_threads = 1;
+  beam::opt<Eigen::Matrix4d> serial =
+      beam_cv::AbsolutePoseEstimator::RANSACEstimator(cam, pixels, points,
+                                                      params, 5);
+  params.num_threads = 4;
+  beam::opt<Eigen::Matrix4d> parallel =
+      beam_cv::AbsolutePoseEstimator::RANSACEstimator(cam, pixels, points,
+                                                      params, 5);
+  REQUIRE(serial.has_value());
+  REQUIRE(parallel.has_value());
+  REQUIRE(serial.value() == parallel.value());
+  REQUIRE(serial.value().isApprox(truth, 1e-3));
+
+  // the winner is scored on all the data
+  beam_cv::Ransac<int>::Result result = RunConsensusRansac(params);
+  REQUIRE(result.num_iterations == params.max_iterations);
+  REQUIRE(result.model == -1);
+  REQUIRE(result.num_inliers == 600);
+}
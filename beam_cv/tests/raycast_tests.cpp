@@ -0,0 +1,101 @@
+#define CATCH_CONFIG_MAIN
+
+#include <random>
+
+#include <catch2/catch.hpp>
+
+#include <beam_calibration/CameraModel.h>
+#include <beam_cv/Raycast.h>
+
+// index of the first point along a ray within radius of the ray, or -1
+int CastRayBruteForce(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                      const Eigen::Vector3d& origin,
+                      const Eigen::Vector3d& direction, double radius,
+                      double max_distance) {
+  Eigen::Vector3d dir = direction.normalized();
+  double best_t = std::numeric_limits<double>::max();
+  int best_index = -1;
+  for (size_t i = 0; i < cloud.size(); i++) {
+    Eigen::Vector3d p =
+        cloud.points[i].getVector3fMap().cast<double>() - origin;
+    double t = p.dot(dir);
+    if (t < 0 || t > max_distance) { continue; }
+    if (p.squaredNorm() - t * t < radius * radius && t < best_t) {
+      best_t = t;
+      best_index = i;
+    }
+  }
+  return best_index;
+}
+
+std::shared_ptr<beam_calibration::CameraModel> LoadCameraModel() {
+  std::string file_location = __FILE__;
+  std::string current_file_path = "raycast_tests.cpp";
+  file_location.erase(file_location.end() - current_file_path.length(),
+                      file_location.end());
+  file_location += "test_data/F2.json";
+  return beam_calibration::CameraModel::Create(file_location);
+}
+
+TEST_CASE("Test voxel grid ray casting against brute force") {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> xy(-10, 10);
+  std::uniform_real_distribution<float> z(0.5, 20);
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (int i = 0; i < 5000; i++) {
+    cloud.push_back(pcl::PointXYZ(xy(rng), xy(rng), z(rng)));
+  }
+
+  for (double radius : {0.05, 0.3, 1.0}) {
+    beam_cv::RayVoxelGrid grid(cloud, radius);
+    REQUIRE(grid.GetVoxelSize() >= 2 * radius);
+    for (int i = 0; i < 500; i++) {
+      Eigen::Vector3d origin(xy(rng) / 5, xy(rng) / 5, 0);
+      Eigen::Vector3d direction(xy(rng) / 10, xy(rng) / 10, 1);
+      REQUIRE(grid.CastRay(origin, direction, 15) ==
+              CastRayBruteForce(cloud, origin, direction, radius, 15));
+    }
+  }
+
+  beam_cv::RayVoxelGrid empty_grid(pcl::PointCloud<pcl::PointXYZ>(), 0.1);
+  REQUIRE(empty_grid.CastRay(Eigen::Vector3d::Zero(),
+                             Eigen::Vector3d::UnitZ(), 15) == -1);
+}
+
+TEST_CASE("Test ray casting an occluded plane") {
+  auto camera_model = LoadCameraModel();
+
+  // plane at 2 m in front of a plane at 4 m
+  auto cloud = std::make_shared<pcl::PointCloud<pcl::PointXYZ>>();
+  for (float x = -1; x <= 1; x += 0.01) {
+    for (float y = -1; y <= 1; y += 0.01) {
+      cloud->push_back(pcl::PointXYZ(x, y, 2));
+      cloud->push_back(pcl::PointXYZ(x, y, 4));
+    }
+  }
+
+  for (auto backend :
+       {beam_cv::RaycastBackend::KDTREE, beam_cv::RaycastBackend::VOXEL_GRID}) {
+    auto depth_image = std::make_shared<cv::Mat>(camera_model->GetHeight(),
+                                                 camera_model->GetWidth(),
+                                                 CV_32FC1, double(0));
+    beam_cv::Raycast<pcl::PointXYZ> caster(cloud, camera_model, depth_image);
+    caster.SetBackend(backend);
+    int num_hits = 0;
+    int num_occluded_hits = 0;
+    caster.Execute(0.01, [&](std::shared_ptr<cv::Mat>& image,
+                             pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud,
+                             const int* position, int index) {
+      image->at<float>(position[0], position[1]) = cloud->points[index].z;
+      num_hits++;
+      if (cloud->points[index].z > 3) { num_occluded_hits++; }
+    });
+    REQUIRE(num_hits > 0);
+
+    // the kd tree backend steps rays by the squared distance to the closest
+    // point, so it can skip past the front plane
+    if (backend == beam_cv::RaycastBackend::VOXEL_GRID) {
+      REQUIRE(num_occluded_hits == 0);
+    }
+  }
+}
@@ -7,3 +7,4 @@ cd ./beam_cv/
 ./beam_cv_pose_refinement_tests
 ./beam_cv_feature_tests
 ./beam_cv_tracker_tests
+./beam_cv_raycast_tests
@@ -90,3 +90,69 @@ TEST_CASE("Test adding images to tracker - Brute Force Matcher (no outlier remov
   REQUIRE_THROWS(feature_tracks = tracker.GetTracks(11));
   REQUIRE_NOTHROW(feature_tracks = tracker.GetTracks(5));
 }
+
+TEST_CASE("Test async tracker matches synchronous tracker.") {
+  std::vector<cv::Mat> images = ReadImageSequence();
+  beam_cv::DescMatchingTracker tracker(detector, descriptor, matcher3, 10);
+  auto async_tracker_ptr = std::make_shared<beam_cv::DescMatchingTracker>(
+      detector, descriptor, matcher3, 10);
+
+  int num_callbacks = 0;
+  std::vector<std::future<std::vector<beam_cv::FeatureTrack>>> futures;
+  {
+    beam_cv::AsyncTracker async_tracker(
+        async_tracker_ptr, 2,
+        [&](const ros::Time&, const std::vector<beam_cv::FeatureTrack>&) {
+          num_callbacks++;
+        });
+    for (size_t i = 0; i < images.size(); i++) {
+      futures.push_back(async_tracker.AddImage(images[i], ros::Time(i + 1, 0)));
+    }
+    async_tracker.WaitAll();
+    REQUIRE(async_tracker.NumPending() == 0);
+  }
+  REQUIRE(num_callbacks == static_cast<int>(images.size()));
+
+  for (size_t i = 0; i < images.size(); i++) {
+    tracker.AddImage(images[i], ros::Time(i + 1, 0));
+    std::vector<beam_cv::FeatureTrack> tracks =
+        tracker.GetTracks(ros::Time(i + 1, 0));
+    std::vector<beam_cv::FeatureTrack> async_tracks = futures[i].get();
+    REQUIRE(tracks.size() == async_tracks.size());
+    for (size_t j = 0; j < tracks.size(); j++) {
+      REQUIRE(tracks[j].size() == async_tracks[j].size());
+    }
+  }
+
+  // KLT through the async front end
+  auto klt = std::make_shared<beam_cv::KLTracker>(detector, nullptr, 10);
+  beam_cv::AsyncTracker async_klt(klt);
+  std::future<std::vector<beam_cv::FeatureTrack>> last_tracks;
+  for (size_t i = 0; i < images.size(); i++) {
+    last_tracks = async_klt.AddImage(images[i], ros::Time(i + 1, 0));
+  }
+  REQUIRE(!last_tracks.get().empty());
+}
+
+TEST_CASE("Test KLT with forward-backward check and downscaled tracking.") {
+  std::vector<cv::Mat> images = ReadImageSequence();
+  beam_cv::KLTracker::Params params;
+  params.forward_backward_check = true;
+  params.max_forward_backward_error = 0.5;
+  params.tracking_level = 1;
+  beam_cv::KLTracker tracker(params, detector, nullptr, 10);
+  for (size_t i = 0; i < images.size(); i++) {
+    tracker.AddImage(images[i], ros::Time(i + 1, 0));
+  }
+  std::vector<beam_cv::FeatureTrack> tracks =
+      tracker.GetTracks(ros::Time(images.size(), 0));
+  REQUIRE(!tracks.empty());
+  for (const auto& track : tracks) {
+    REQUIRE(track.size() >= 2);
+    const Eigen::Vector2d& pixel = track.back().value;
+    REQUIRE(pixel[0] >= -1);
+    REQUIRE(pixel[0] <= images[0].cols);
+    REQUIRE(pixel[1] >= -1);
+    REQUIRE(pixel[1] <= images[0].rows);
+  }
+}
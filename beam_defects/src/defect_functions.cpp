@@ -212,12 +212,11 @@ float MaxLength(const pcl::PointCloud<pcl::PointXYZ>::Ptr& input_cloud) {
 float HausdorffDist(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud_a,
                     const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud_b) {
   float hausdorff_dist = 0;
-  beam::KdTree<pcl::PointXYZ> tree(*cloud_b);
+  beam::KdTree<pcl::PointXYZ> tree(cloud_b);
   float max_dist = -std::numeric_limits<float>::max();
+  std::vector<uint32_t> indices(1);
+  std::vector<float> sqr_distances(1);
   for (const auto& point : cloud_a->points) {
-    std::vector<uint32_t> indices(1);
-    std::vector<float> sqr_distances(1);
-
     tree.nearestKSearch(point, 1, indices, sqr_distances);
     if (sqr_distances[0] > max_dist) { max_dist = sqr_distances[0]; }
   }
@@ -48,6 +48,35 @@ void IPBasic(cv::Mat& depth_image);
  */
 void IDWInterpolation(cv::Mat& depth_image, int window_size);
 
+/**
+ * @brief Same as IDWInterpolation, but the inverse distance weighted sums over
+ * each window are computed for the whole image at once by filtering the depth
+ * image and the valid pixel mask with a 1 / distance kernel, and the number of
+ * points in each window with a box filter. The 1 / distance kernel is
+ * approximated by a few separable terms from its SVD, so the cost grows with
+ * the window width instead of its area; small windows, where this does not
+ * save work, use the full kernel. Empty pixels are then filled in parallel by
+ * rows. The result matches IDWInterpolation up to floating point error.
+ * @param depth_image depth map to perform on
+ * @param window_size size of window (square) to search for interpolation
+ * @param num_threads number of threads. If <= 0, this will use all hardware
+ * threads
+ */
+void FastIDWInterpolation(cv::Mat& depth_image, int window_size,
+                          int num_threads = 0);
+
+/**
+ * @brief Fills each empty pixel with the depth of the closest valid pixel,
+ * found with a distance transform of the valid pixels
+ * @param depth_image depth map to perform on
+ * @param max_distance_px pixels further than this from a valid pixel are left
+ * empty. If <= 0, all empty pixels are filled
+ * @param num_threads number of threads. If <= 0, this will use all hardware
+ * threads
+ */
+void NearestDepthFill(cv::Mat& depth_image, float max_distance_px = 0,
+                      int num_threads = 0);
+
 /**
  * @brief Segments the depth image into 3 "ranges" of depth and applies IPBasic
  * to each
@@ -78,12 +78,22 @@ public:
 
   /**
    * @brief Computes the depth image based on the given point cloud and image
-   * using projection over ray casting
+   * using projection over ray casting. Points are projected in parallel into
+   * a shared z-buffer, see SetNumThreads. The result does not depend on the
+   * number of threads.
    * @param thresh depth threshold to limit points being projected
    * @return number of points extracted
    */
   int ExtractDepthMapProjection(float thresh);
 
+  /**
+   * @brief Number of threads setter, only used by ExtractDepthMapProjection
+   * and ExtractOrganizedCloud
+   * @param num_threads number of threads. If <= 0, this will use all hardware
+   * threads
+   */
+  void SetNumThreads(int num_threads) { num_threads_ = num_threads; }
+
   /**
    * @brief Computes the depth image based on the given point cloud and image
    * using occlusion-safe projection from beam_colorize
@@ -97,6 +107,17 @@ public:
    */
   pcl::PointCloud<pcl::PointXYZ>::Ptr ExtractPointCloud();
 
+  /**
+   * @brief Creates an organized point cloud from the depth image, with one
+   * point per pixel so that pixel (u, v) is at cloud->at(u, v). Pixels with
+   * no depth or that cannot be back projected are NaN. Points are computed in
+   * parallel, see SetNumThreads. If the camera model has a bearing table it is
+   * used, otherwise each pixel is back projected. The table is never created
+   * here since the model may be shared, see CameraModel::InitBearingTable.
+   * @return organized point cloud of size width x height of the depth image
+   */
+  pcl::PointCloud<pcl::PointXYZ>::Ptr ExtractOrganizedCloud();
+
   /**
    * @brief Checks if variables (point_cloud_initialized_,
    * depth_image_extracted_ model_initialized_) are properly set
@@ -140,5 +161,6 @@ protected:
   float min_depth_, max_depth_;
   bool point_cloud_initialized_ = false, model_initialized_ = false,
        depth_image_extracted_ = false;
+  int num_threads_{0};
 };
 } // namespace beam_depth
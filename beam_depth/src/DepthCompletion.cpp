@@ -1,8 +1,20 @@
 #include "beam_depth/DepthCompletion.h"
 #include "beam_depth/Utils.h"
 
+#include <beam_utils/parallel.h>
+
 namespace beam_depth {
 
+namespace {
+
+/** minimum number of image rows filled by each thread */
+constexpr size_t k_min_rows_per_thread{16};
+
+/** max sum of the dropped singular values of the IDW kernel */
+constexpr double k_idw_kernel_tolerance{1e-5};
+
+} // namespace
+
 void DepthInterpolation(int window_width, int window_height, float threshold,
                         cv::Mat& depth_image) {
   if (depth_image.type() != CV_32F) {
@@ -94,19 +106,10 @@ void IPBasic(cv::Mat& depth_image) {
   cv::morphologyEx(depth_image, depth_image, cv::MORPH_CLOSE,
                    cv::Mat::ones(5, 5, CV_8U));
   // fill empty spaces with dilated values
-  std::vector<cv::Point2i> empty_pixels;
-  for (int row = 0; row < depth_image.rows; row++) {
-    for (int col = 0; col < depth_image.cols; col++) {
-      float distance = depth_image.at<float>(row, col);
-      if (distance < 0.1) { empty_pixels.push_back(cv::Point2i(row, col)); }
-    }
-  }
+  cv::Mat empty_pixels = depth_image < 0.1;
   cv::Mat dilated;
   cv::dilate(depth_image, dilated, cv::Mat::ones(7, 7, CV_8U));
-  for (uint32_t i = 0; i < empty_pixels.size(); i++) {
-    depth_image.at<float>(empty_pixels[i].x, empty_pixels[i].y) =
-        dilated.at<float>(empty_pixels[i].x, empty_pixels[i].y);
-  }
+  dilated.copyTo(depth_image, empty_pixels);
 
   // median blur
   cv::medianBlur(depth_image, depth_image, 5);
@@ -170,6 +173,135 @@ void IDWInterpolation(cv::Mat& depth_image, int window_size) {
   });
 }
 
+void FastIDWInterpolation(cv::Mat& depth_image, int window_size,
+                          int num_threads) {
+  if (depth_image.type() != CV_32F) {
+    BEAM_CRITICAL("Invalid OpenCV Mat type, requires CV_32F.");
+    throw std::runtime_error{"Invalid OpenCV Mat type, requires CV_32F."};
+  }
+  // IDWInterpolation searches rows and cols in [pixel - half, pixel + half)
+  int half = window_size / 2;
+  if (half <= 0) { return; }
+  cv::Size kernel_size(2 * half, 2 * half);
+  cv::Point anchor(half, half);
+
+  // 1 / distance weights, the center is always empty so its weight is unused
+  cv::Mat kernel(kernel_size, CV_64F);
+  for (int i = 0; i < kernel.rows; i++) {
+    for (int j = 0; j < kernel.cols; j++) {
+      double dist = std::sqrt(static_cast<double>((i - half) * (i - half) +
+                                                  (j - half) * (j - half)));
+      kernel.at<double>(i, j) = dist > 0 ? 1 / dist : 0;
+    }
+  }
+
+  // filter the depth and the valid mask together as 2 channels, so the
+  // numerator and denominator of each window come from the same passes
+  cv::Mat valid;
+  cv::Mat(depth_image != 0).convertTo(valid, CV_32F, 1.0 / 255);
+  cv::Mat stacked, filtered;
+  cv::merge(std::vector<cv::Mat>{depth_image, valid}, stacked);
+
+  // the 1 / distance kernel is not separable, but it is close to low rank:
+  // keep the largest singular vectors until the dropped singular values, which
+  // bound the error of each weight, are below the tolerance
+  cv::SVD svd(kernel);
+  int rank = 0;
+  double dropped = cv::sum(svd.w)[0];
+  while (rank < svd.w.rows && dropped > k_idw_kernel_tolerance) {
+    dropped -= svd.w.at<double>(rank);
+    rank++;
+  }
+
+  // each separable term costs 2 1D passes, so only use them when it is cheaper
+  // than the full kernel
+  if (2 * rank < kernel.cols) {
+    filtered = cv::Mat::zeros(stacked.size(), stacked.type());
+    cv::Mat term;
+    for (int r = 0; r < rank; r++) {
+      cv::Mat kernel_x = svd.vt.row(r).t();
+      cv::Mat kernel_y = svd.u.col(r) * svd.w.at<double>(r);
+      cv::sepFilter2D(stacked, term, CV_32F, kernel_x, kernel_y, anchor, 0,
+                      cv::BORDER_CONSTANT);
+      filtered += term;
+    }
+  } else {
+    cv::filter2D(stacked, filtered, CV_32F, kernel, anchor, 0,
+                 cv::BORDER_CONSTANT);
+  }
+  cv::Mat sums[2];
+  cv::split(filtered, sums);
+  const cv::Mat& numerator = sums[0];
+  const cv::Mat& denominator = sums[1];
+
+  // box filters use running sums, so the cost does not depend on the window
+  cv::Mat count;
+  cv::boxFilter(valid, count, CV_32F, kernel_size, anchor, false,
+                cv::BORDER_CONSTANT);
+
+  int n_threads = beam::GetNumThreads(num_threads, depth_image.rows,
+                                      k_min_rows_per_thread);
+  beam::ParallelForChunks(
+      depth_image.rows, n_threads,
+      [&](int /*thread_id*/, size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+          float* depth_row = depth_image.ptr<float>(row);
+          const float* numerator_row = numerator.ptr<float>(row);
+          const float* denominator_row = denominator.ptr<float>(row);
+          const float* count_row = count.ptr<float>(row);
+          for (int col = 0; col < depth_image.cols; col++) {
+            // counts are small integers, so compare with a margin for the
+            // filter's rounding
+            if (depth_row[col] != 0 || count_row[col] < 2.5f) { continue; }
+            depth_row[col] = numerator_row[col] / denominator_row[col];
+          }
+        }
+      });
+}
+
+void NearestDepthFill(cv::Mat& depth_image, float max_distance_px,
+                      int num_threads) {
+  if (depth_image.type() != CV_32F) {
+    BEAM_CRITICAL("Invalid OpenCV Mat type, requires CV_32F.");
+    throw std::runtime_error{"Invalid OpenCV Mat type, requires CV_32F."};
+  }
+  // distance transform to the closest zero pixel of the mask (the valid depth
+  // pixels). Each zero pixel is labelled in row major order starting at 1, so
+  // the depth of a label is found by listing valid depths in the same order
+  cv::Mat empty_mask = depth_image == 0;
+  std::vector<float> label_depths{0};
+  for (int row = 0; row < depth_image.rows; row++) {
+    const float* depth_row = depth_image.ptr<float>(row);
+    for (int col = 0; col < depth_image.cols; col++) {
+      if (depth_row[col] != 0) { label_depths.push_back(depth_row[col]); }
+    }
+  }
+  if (label_depths.size() == 1) { return; }
+
+  cv::Mat distances, labels;
+  cv::distanceTransform(empty_mask, distances, labels, cv::DIST_L2,
+                        cv::DIST_MASK_5, cv::DIST_LABEL_PIXEL);
+
+  int n_threads = beam::GetNumThreads(num_threads, depth_image.rows,
+                                      k_min_rows_per_thread);
+  beam::ParallelForChunks(
+      depth_image.rows, n_threads,
+      [&](int /*thread_id*/, size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+          float* depth_row = depth_image.ptr<float>(row);
+          const float* distance_row = distances.ptr<float>(row);
+          const int* label_row = labels.ptr<int>(row);
+          for (int col = 0; col < depth_image.cols; col++) {
+            if (depth_row[col] != 0) { continue; }
+            if (max_distance_px > 0 && distance_row[col] > max_distance_px) {
+              continue;
+            }
+            depth_row[col] = label_depths[label_row[col]];
+          }
+        }
+      });
+}
+
 void MultiscaleInterpolation(cv::Mat& depth_image) {
   if (depth_image.type() != CV_32F) {
     BEAM_CRITICAL("Invalid OpenCV Mat type, requires CV_32F.");
@@ -1,5 +1,9 @@
 #include <beam_depth/DepthMap.h>
 
+#include <atomic>
+#include <cstring>
+#include <limits>
+
 #include <pcl/io/pcd_io.h>
 
 #include <beam_colorize/ProjectionOcclusionSafe.h>
@@ -7,9 +11,40 @@
 #include <beam_cv/Utils.h>
 #include <beam_depth/Utils.h>
 #include <beam_utils/math.h>
+#include <beam_utils/parallel.h>
 
 namespace beam_depth {
 
+namespace {
+
+/** minimum number of points projected by each thread */
+constexpr size_t k_min_points_per_thread{4096};
+
+/** number of points projected at once with CameraModel::ProjectPoints */
+constexpr size_t k_batch_size{1024};
+
+/** minimum number of image rows copied out of the z-buffer by each thread */
+constexpr size_t k_min_rows_per_thread{16};
+
+/** z-buffer value of pixels with no points, the bits of +infinity */
+constexpr uint32_t k_empty_depth{0x7f800000};
+
+/**
+ * @brief set a z-buffer pixel to a depth if it is closer than the current one
+ * @param z z-buffer pixel, holding the bits of a positive float
+ * @param depth positive depth
+ */
+void AtomicMinDepth(std::atomic<uint32_t>& z, float depth) {
+  uint32_t bits;
+  std::memcpy(&bits, &depth, sizeof(float));
+  uint32_t current = z.load(std::memory_order_relaxed);
+  while (bits < current &&
+         !z.compare_exchange_weak(current, bits, std::memory_order_relaxed)) {
+  }
+}
+
+} // namespace
+
 DepthMap::DepthMap(std::shared_ptr<beam_calibration::CameraModel> model,
                    const pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_input) {
   this->SetCloud(cloud_input);
@@ -48,42 +83,85 @@ int DepthMap::ExtractDepthMap(float thresh) {
 }
 
 int DepthMap::ExtractDepthMapProjection(float thresh) {
-  // create image with 3 channels for coordinates
-  depth_image_ = std::make_shared<cv::Mat>(
-      model_->GetHeight(), model_->GetWidth(), CV_32FC1, double(0));
-  for (uint32_t i = 0; i < cloud_->points.size(); i++) {
-    Eigen::Vector3d origin(0, 0, 0);
-    Eigen::Vector3d point(cloud_->points[i].x, cloud_->points[i].y,
-                          cloud_->points[i].z);
-    bool in_image = false;
-    Eigen::Vector2d coords;
-    if (!model_->ProjectPoint(point, coords, in_image)) {
-      continue;
-    } else if (!in_image) {
-      continue;
-    }
-    // if successful projeciton calculate distance and fill depth image
-    uint16_t col = coords(0, 0), row = coords(1, 0);
-    float dist = beam::distance(point, origin);
-    if ((depth_image_->at<float>(row, col) > dist ||
-         depth_image_->at<float>(row, col) == 0) &&
-        dist < thresh) {
-      depth_image_->at<float>(row, col) = dist;
-    }
+  const int width = model_->GetWidth();
+  const int height = model_->GetHeight();
+  depth_image_ =
+      std::make_shared<cv::Mat>(height, width, CV_32FC1, double(0));
+
+  // z-buffer of depth bits. Positive floats are ordered the same as their bits
+  // so every thread can keep the closest depth with an atomic min
+  std::vector<std::atomic<uint32_t>> z_buffer(width * height);
+  for (auto& z : z_buffer) {
+    z.store(k_empty_depth, std::memory_order_relaxed);
   }
+
+  // the ladybug sdk is not thread safe
+  int n_threads = beam::GetNumThreads(num_threads_, cloud_->size(),
+                                      k_min_points_per_thread);
+  if (model_->GetType() == beam_calibration::CameraType::LADYBUG) {
+    n_threads = 1;
+  }
+  beam::ParallelForChunks(
+      cloud_->size(), n_threads,
+      [&](int /*thread_id*/, size_t begin, size_t end) {
+        Eigen::Matrix3Xf points;
+        Eigen::Matrix2Xf pixels;
+        std::vector<uint8_t> valid_mask;
+        for (size_t batch = begin; batch < end; batch += k_batch_size) {
+          size_t batch_end = std::min(end, batch + k_batch_size);
+          points.resize(3, batch_end - batch);
+          for (size_t i = batch; i < batch_end; i++) {
+            points.col(i - batch) = cloud_->points[i].getVector3fMap();
+          }
+          model_->ProjectPoints(points, pixels, valid_mask);
+          for (int j = 0; j < points.cols(); j++) {
+            if (!valid_mask[j]) { continue; }
+            float dist = points.col(j).norm();
+            if (!(dist > 0 && dist < thresh)) { continue; }
+            int col = static_cast<int>(pixels(0, j));
+            int row = static_cast<int>(pixels(1, j));
+            AtomicMinDepth(z_buffer[row * width + col], dist);
+          }
+        }
+      });
+
+  // copy the z-buffer to the depth image and compute the min and max depth
+  // and number of pixels filled by each thread, then reduce
+  struct DepthStats {
+    float min_depth{1000};
+    float max_depth{0};
+    int num_extracted{0};
+  };
+  int n_row_threads =
+      beam::GetNumThreads(num_threads_, height, k_min_rows_per_thread);
+  std::vector<DepthStats> stats(n_row_threads);
+  beam::ParallelForChunks(
+      height, n_row_threads, [&](int thread_id, size_t begin, size_t end) {
+        DepthStats& s = stats[thread_id];
+        for (size_t row = begin; row < end; row++) {
+          float* depth_row = depth_image_->ptr<float>(row);
+          const std::atomic<uint32_t>* z_row = &z_buffer[row * width];
+          for (int col = 0; col < width; col++) {
+            uint32_t bits = z_row[col].load(std::memory_order_relaxed);
+            if (bits == k_empty_depth) { continue; }
+            float dist;
+            std::memcpy(&dist, &bits, sizeof(float));
+            depth_row[col] = dist;
+            s.num_extracted++;
+            s.min_depth = std::min(s.min_depth, dist);
+            s.max_depth = std::max(s.max_depth, dist);
+          }
+        }
+      });
+
   depth_image_extracted_ = true;
   int num_extracted = 0;
-  // compute min and max depth in the image
   min_depth_ = 1000, max_depth_ = 0;
-  depth_image_->forEach<float>(
-      [&](float& distance, const int* position) -> void {
-        (void)position;
-        if (distance != 0.0) {
-          num_extracted++;
-          if (distance > max_depth_) { max_depth_ = distance; }
-          if (distance < min_depth_) { min_depth_ = distance; }
-        }
-      });
+  for (const DepthStats& s : stats) {
+    num_extracted += s.num_extracted;
+    min_depth_ = std::min(min_depth_, s.min_depth);
+    max_depth_ = std::max(max_depth_, s.max_depth);
+  }
   return num_extracted;
 }
 
@@ -102,16 +180,12 @@ int DepthMap::ExtractDepthMapProjectionNoOcclusions() {
       model_->GetHeight(), model_->GetWidth(), CV_32FC1, double(0));
   min_depth_ = 1000;
   max_depth_ = 0;
-  for (auto v_iter = projection_map.VBegin(); v_iter != projection_map.VEnd();
-       v_iter++) {
-    uint64_t v = v_iter->first;
-    const auto u_map = v_iter->second;
-    for (const auto& [u, meta] : u_map) {
-      if (meta.depth > max_depth_) { max_depth_ = meta.depth; }
-      if (meta.depth < min_depth_) { min_depth_ = meta.depth; }
-      depth_image_->at<float>(v, u) = meta.depth;
-    }
-  }
+  projection_map.ForEach([&](uint64_t u, uint64_t v,
+                             const beam_colorize::ProjectedPointMeta& meta) {
+    if (meta.depth > max_depth_) { max_depth_ = meta.depth; }
+    if (meta.depth < min_depth_) { min_depth_ = meta.depth; }
+    depth_image_->at<float>(v, u) = meta.depth;
+  });
 
   depth_image_extracted_ = true;
   return projection_map.Size();
@@ -147,6 +221,68 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr DepthMap::ExtractPointCloud() {
   return dense_cloud;
 }
 
+pcl::PointCloud<pcl::PointXYZ>::Ptr DepthMap::ExtractOrganizedCloud() {
+  if (!depth_image_extracted_ || !model_initialized_) {
+    BEAM_CRITICAL("Variables not properly set.");
+    throw std::runtime_error{"Variables not properly set."};
+  }
+  if (depth_image_->type() != CV_32FC1) {
+    BEAM_CRITICAL("Invalid depth image type, requires CV_32FC1.");
+    throw std::runtime_error{"Invalid depth image type."};
+  }
+  const int width = depth_image_->cols;
+  const int height = depth_image_->rows;
+  if (width != static_cast<int>(model_->GetWidth()) ||
+      height != static_cast<int>(model_->GetHeight())) {
+    BEAM_CRITICAL("Depth image size ({} x {}) does not match camera model ({} "
+                  "x {}).",
+                  width, height, model_->GetWidth(), model_->GetHeight());
+    throw std::runtime_error{"Depth image size does not match camera model."};
+  }
+  // the camera model is shared, so its bearing table is only used if the
+  // owner created one
+  const bool use_table = model_->HasBearingTable();
+
+  auto organized_cloud =
+      std::make_shared<pcl::PointCloud<pcl::PointXYZ>>(width, height);
+  organized_cloud->is_dense = false;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  int n_threads =
+      beam::GetNumThreads(num_threads_, height, k_min_rows_per_thread);
+  // the ladybug sdk is not thread safe
+  if (!use_table &&
+      model_->GetType() == beam_calibration::CameraType::LADYBUG) {
+    n_threads = 1;
+  }
+  beam::ParallelForChunks(
+      height, n_threads, [&](int /*thread_id*/, size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+          const float* depth_row = depth_image_->ptr<float>(row);
+          for (int col = 0; col < width; col++) {
+            size_t index = row * width + col;
+            pcl::PointXYZ& point = organized_cloud->points[index];
+            const Eigen::Vector2i pixel(col, row);
+            Eigen::Vector3d bearing;
+            bool valid = false;
+            if (depth_row[col] > 0 && use_table) {
+              bool in_domain = false;
+              valid = model_->LookupBearing(pixel, bearing, in_domain) &&
+                      in_domain;
+            } else if (depth_row[col] > 0) {
+              valid = model_->BackProject(pixel, bearing);
+            }
+            if (valid) {
+              point.getVector3fMap() =
+                  (depth_row[col] * bearing.normalized()).cast<float>();
+            } else {
+              point.x = point.y = point.z = nan;
+            }
+          }
+        }
+      });
+  return organized_cloud;
+}
+
 bool DepthMap::CheckState() {
   bool state = false;
   if (point_cloud_initialized_ && depth_image_extracted_ &&
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+
+#include <opencv2/core.hpp>
+
+#include "beam_depth/DepthCompletion.h"
+
+/**
+ * Benchmarks the depth completion functions on a kitti depth completion image,
+ * reporting the average run time, the fraction of pixels filled and the RMSE
+ * against the ground truth depth.
+ */
+
+// kitti depth images are stored as depth in metres * 256
+cv::Mat LoadKittiDepth(const std::string& path) {
+  cv::Mat depth_raw = cv::imread(path, cv::IMREAD_ANYDEPTH);
+  cv::Mat depth;
+  depth_raw.convertTo(depth, CV_32F, 1.0 / 256);
+  return depth;
+}
+
+void Benchmark(const std::string& name, const cv::Mat& depth,
+               const cv::Mat& depth_gt, int iterations,
+               const std::function<void(cv::Mat&)>& complete) {
+  cv::Mat completed;
+  double total_ms = 0;
+  for (int i = 0; i < iterations; i++) {
+    completed = depth.clone();
+    auto start = std::chrono::steady_clock::now();
+    complete(completed);
+    auto end = std::chrono::steady_clock::now();
+    total_ms +=
+        std::chrono::duration<double, std::milli>(end - start).count();
+  }
+
+  double squared_error = 0;
+  int num_compared = 0;
+  for (int row = 0; row < depth_gt.rows; row++) {
+    for (int col = 0; col < depth_gt.cols; col++) {
+      float gt = depth_gt.at<float>(row, col);
+      float d = completed.at<float>(row, col);
+      if (gt <= 0 || d <= 0) { continue; }
+      squared_error += (d - gt) * (d - gt);
+      num_compared++;
+    }
+  }
+  double filled = static_cast<double>(cv::countNonZero(completed)) /
+                  (completed.rows * completed.cols);
+  double rmse = num_compared > 0 ? std::sqrt(squared_error / num_compared) : 0;
+  std::cout << name << ": " << total_ms / iterations << " ms, "
+            << 100 * filled << " % filled, RMSE " << rmse << " m"
+            << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  std::string data_location = __FILE__;
+  data_location.erase(data_location.end() - 30, data_location.end());
+  data_location += "test_depth/";
+  int iterations = 5;
+  if (argc > 2) {
+    std::cout << "Usage: ./beam_depth_completion_benchmark [iterations]"
+              << std::endl;
+    return 1;
+  } else if (argc == 2) {
+    iterations = std::max(1, std::stoi(argv[1]));
+  }
+
+  cv::Mat depth = LoadKittiDepth(data_location + "depth.png");
+  cv::Mat depth_gt = LoadKittiDepth(data_location + "depth_gt.png");
+  if (depth.empty() || depth_gt.empty()) {
+    std::cout << "Cannot load kitti depth images from: " << data_location
+              << std::endl;
+    return 1;
+  }
+  std::cout << "Image size: " << depth.cols << " x " << depth.rows
+            << ", iterations: " << iterations << std::endl;
+
+  for (int window_size : {5, 11, 21}) {
+    std::string window = " (window " + std::to_string(window_size) + ")";
+    Benchmark("IDWInterpolation" + window, depth, depth_gt, iterations,
+              [&](cv::Mat& d) {
+                beam_depth::IDWInterpolation(d, window_size);
+              });
+    Benchmark("FastIDWInterpolation" + window, depth, depth_gt, iterations,
+              [&](cv::Mat& d) {
+                beam_depth::FastIDWInterpolation(d, window_size);
+              });
+  }
+  Benchmark("NearestDepthFill", depth, depth_gt, iterations,
+            [](cv::Mat& d) { beam_depth::NearestDepthFill(d); });
+  Benchmark("NearestDepthFill (max 5 px)", depth, depth_gt, iterations,
+            [](cv::Mat& d) { beam_depth::NearestDepthFill(d, 5); });
+  Benchmark("IPBasic", depth, depth_gt, iterations,
+            [](cv::Mat& d) { beam_depth::IPBasic(d); });
+  Benchmark("MultiscaleInterpolation", depth, depth_gt, iterations,
+            [](cv::Mat& d) { beam_depth::MultiscaleInterpolation(d); });
+  return 0;
+}
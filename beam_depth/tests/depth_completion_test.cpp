@@ -0,0 +1,57 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <beam_depth/DepthCompletion.h>
+
+static cv::Mat LoadKittiDepth(const std::string& file_name) {
+  std::string cur_location = __FILE__;
+  cur_location.erase(cur_location.end() - 31, cur_location.end());
+  cv::Mat depth_raw =
+      cv::imread(cur_location + "tests/test_depth/" + file_name,
+                 cv::IMREAD_ANYDEPTH);
+  // kitti depth images are stored as depth in metres * 256
+  cv::Mat depth;
+  depth_raw.convertTo(depth, CV_32F, 1.0 / 256);
+  return depth;
+}
+
+TEST_CASE("Test fast IDW interpolation matches IDW interpolation.") {
+  cv::Mat depth = LoadKittiDepth("depth.png");
+  REQUIRE(!depth.empty());
+  // small windows use the full kernel, large ones the separable terms
+  for (int window_size : {11, 25}) {
+    cv::Mat idw = depth.clone();
+    cv::Mat fast_idw = depth.clone();
+    beam_depth::IDWInterpolation(idw, window_size);
+    beam_depth::FastIDWInterpolation(fast_idw, window_size, 4);
+
+    REQUIRE(cv::countNonZero(idw) > cv::countNonZero(depth));
+    REQUIRE(cv::countNonZero(idw) == cv::countNonZero(fast_idw));
+    double max_error;
+    cv::minMaxLoc(cv::abs(idw - fast_idw), nullptr, &max_error);
+    REQUIRE(max_error < 1e-2);
+  }
+}
+
+TEST_CASE("Test nearest depth fill.") {
+  cv::Mat depth = cv::Mat::zeros(20, 30, CV_32F);
+  depth.at<float>(2, 3) = 5;
+  depth.at<float>(15, 25) = 10;
+  cv::Mat filled = depth.clone();
+  beam_depth::NearestDepthFill(filled);
+  REQUIRE(cv::countNonZero(filled) == filled.rows * filled.cols);
+  REQUIRE(filled.at<float>(0, 0) == 5);
+  REQUIRE(filled.at<float>(4, 5) == 5);
+  REQUIRE(filled.at<float>(19, 29) == 10);
+  REQUIRE(filled.at<float>(14, 24) == 10);
+
+  // pixels far from both points stay empty when limiting the distance
+  filled = depth.clone();
+  beam_depth::NearestDepthFill(filled, 3);
+  REQUIRE(filled.at<float>(2, 5) == 5);
+  REQUIRE(filled.at<float>(10, 15) == 0);
+
+  cv::Mat empty = cv::Mat::zeros(20, 30, CV_32F);
+  REQUIRE_NOTHROW(beam_depth::NearestDepthFill(empty));
+  REQUIRE(cv::countNonZero(empty) == 0);
+}
@@ -53,3 +53,85 @@ TEST_CASE("Test Depth map extractor.") {
   }
   REQUIRE(num_out < 500);
 }
+
+TEST_CASE("Test multithreaded depth map projection.") {
+  std::string cur_location = __FILE__;
+  cur_location.erase(cur_location.end() - 24, cur_location.end());
+  cur_location += "tests/test_data/";
+  std::shared_ptr<beam_calibration::CameraModel> F1 =
+      std::make_shared<beam_calibration::Radtan>(cur_location + "F2.json");
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+  pcl::io::loadPCDFile<pcl::PointXYZ>(cur_location + "259_map.pcd", *cloud);
+
+  beam_depth::DepthMap dm(F1, cloud);
+  dm.SetNumThreads(1);
+  int num_serial = dm.ExtractDepthMapProjection(100);
+  cv::Mat depth_serial = dm.GetDepthImage().clone();
+  dm.SetNumThreads(4);
+  int num_parallel = dm.ExtractDepthMapProjection(100);
+  cv::Mat depth_parallel = dm.GetDepthImage();
+
+  REQUIRE(num_serial > 0);
+  REQUIRE(num_serial == num_parallel);
+  REQUIRE(cv::countNonZero(depth_serial != depth_parallel) == 0);
+}
+
+static void RequireSamePoints(const cv::Mat& depth,
+                              const pcl::PointCloud<pcl::PointXYZ>& organized,
+                              const pcl::PointCloud<pcl::PointXYZ>& dense) {
+  // points are in the same row major order as the dense cloud
+  size_t dense_id = 0;
+  for (int row = 0; row < depth.rows; row++) {
+    for (int col = 0; col < depth.cols; col++) {
+      const pcl::PointXYZ& p = organized.at(col, row);
+      if (!std::isfinite(p.x)) { continue; }
+      REQUIRE(dense_id < dense.size());
+      const pcl::PointXYZ& q = dense.points[dense_id++];
+      REQUIRE(p.x == Approx(q.x).margin(1e-4));
+      REQUIRE(p.y == Approx(q.y).margin(1e-4));
+      REQUIRE(p.z == Approx(q.z).margin(1e-4));
+    }
+  }
+  REQUIRE(dense_id == dense.size());
+}
+
+TEST_CASE("Test organized cloud extraction.") {
+  std::string cur_location = __FILE__;
+  cur_location.erase(cur_location.end() - 24, cur_location.end());
+  cur_location += "tests/test_data/";
+  std::shared_ptr<beam_calibration::CameraModel> F1 =
+      std::make_shared<beam_calibration::Radtan>(cur_location + "F2.json");
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+  pcl::io::loadPCDFile<pcl::PointXYZ>(cur_location + "259_map.pcd", *cloud);
+
+  beam_depth::DepthMap dm(F1, cloud);
+  REQUIRE_THROWS(dm.ExtractOrganizedCloud());
+  dm.ExtractDepthMapProjection(100);
+  REQUIRE(!F1->HasBearingTable());
+  pcl::PointCloud<pcl::PointXYZ>::Ptr dense_cloud = dm.ExtractPointCloud();
+  pcl::PointCloud<pcl::PointXYZ>::Ptr organized_cloud =
+      dm.ExtractOrganizedCloud();
+  REQUIRE(!F1->HasBearingTable());
+
+  cv::Mat depth = dm.GetDepthImage();
+  REQUIRE(organized_cloud->width == static_cast<uint32_t>(depth.cols));
+  REQUIRE(organized_cloud->height == static_cast<uint32_t>(depth.rows));
+  REQUIRE(!organized_cloud->is_dense);
+  RequireSamePoints(depth, *organized_cloud, *dense_cloud);
+
+  // same points from the bearing table created by the owner of the model
+  F1->InitBearingTable();
+  organized_cloud = dm.ExtractOrganizedCloud();
+  RequireSamePoints(depth, *organized_cloud, *dense_cloud);
+
+  // the bearing table belongs to the camera model, so changing the intrinsics
+  // cannot leave stale bearings
+  Eigen::VectorXd intrinsics = F1->GetIntrinsics();
+  intrinsics[0] *= 1.1;
+  intrinsics[1] *= 1.1;
+  F1->SetIntrinsics(intrinsics);
+  REQUIRE(!F1->HasBearingTable());
+  dense_cloud = dm.ExtractPointCloud();
+  organized_cloud = dm.ExtractOrganizedCloud();
+  RequireSamePoints(depth, *organized_cloud, *dense_cloud);
+}
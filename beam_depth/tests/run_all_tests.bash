@@ -4,3 +4,4 @@ cd ./beam_depth/
 
 ./beam_depth_map_tests
 ./beam_depth_utils_tests
+./beam_depth_completion_tests
@@ -0,0 +1,298 @@
+/** @file
+ * @ingroup filtering
+ */
+
+#pragma once
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <beam_filtering/PointCloudFile.h>
+#include <beam_filtering/Utils.h>
+#include <beam_utils/log.h>
+
+namespace beam_filtering {
+/// @addtogroup filtering
+
+/**
+ * @brief class for running a filter pipeline (see FilterPointCloud) on point
+ * cloud files which are too large to be loaded into memory.
+ *
+ * The input file is streamed three times:
+ *
+ *  1. to compute the bounds of the cloud and the max range of its points
+ *
+ *  2. to split the points into square tiles in the xy plane (covering the
+ *  full z extent). Each tile is padded by a margin which is the sum of the
+ *  reach of all filters in the pipeline (the search radius of ROR and DROR
+ *  filters, and the voxel diagonal of VoxelDownsample filters), so that every
+ *  point in the core of a tile sees the same neighbours as it would in the
+ *  full cloud. Tiles are stored in temporary files next to the output file.
+ *
+ *  3. to filter each tile with FilterPointCloud and append the output points
+ *  which lie in the tile core to the output file.
+ *
+ * VoxelDownsample grids are aligned to the origin, so the output is the same as
+ * running FilterPointCloud on the full cloud, up to the order of the points.
+ * Only one tile (with its margin) is in memory at a time, so tile_size_m
+ * should be chosen based on the density of the cloud. Non-finite points are
+ * dropped. The input can be a pcd or ply file (see PointCloudFileReader) and
+ * the output is always a binary pcd file.
+ */
+template <class PointT>
+class ChunkedFilter {
+public:
+  using PointCloudType = pcl::PointCloud<PointT>;
+
+  /**
+   * @brief constructor
+   * @param filter_params filters to run on each tile, see FilterPointCloud
+   * @param tile_size_m edge length of each tile in the xy plane
+   * @param batch_size max number of points read from, or buffered for, a file
+   * at a time
+   * @param num_threads number of threads used by the filters. If <= 0, this
+   * will use all hardware threads
+   */
+  ChunkedFilter(const std::vector<FilterParamsType>& filter_params,
+                double tile_size_m = 50, size_t batch_size = 1000000,
+                int num_threads = 0)
+      : filter_params_(filter_params),
+        tile_size_m_(tile_size_m),
+        batch_size_(batch_size),
+        num_threads_(num_threads) {}
+
+  /**
+   * @brief Default destructor
+   */
+  ~ChunkedFilter() = default;
+
+  /**
+   * @brief filter a point cloud file
+   * @param input_file full path to a .pcd or .ply file
+   * @param output_file full path to the output .pcd file
+   * @return true if successful. If false, no output file is written
+   */
+  bool Filter(const std::string& input_file, const std::string& output_file) {
+    if (!(tile_size_m_ > 0) || batch_size_ == 0) {
+      BEAM_ERROR("Invalid ChunkedFilter params, tile size and batch size must "
+                 "be greater than 0.");
+      return false;
+    }
+
+    PointCloudFileReader reader;
+    if (!reader.Open(input_file)) { return false; }
+
+    // pass 1: bounds and max range
+    Eigen::Vector2d min_xy(std::numeric_limits<double>::max(),
+                           std::numeric_limits<double>::max());
+    Eigen::Vector2d max_xy(std::numeric_limits<double>::lowest(),
+                           std::numeric_limits<double>::lowest());
+    double max_range = 0;
+    ForEachBatch(reader, [&](const PointCloudType& batch) {
+      for (const auto& p : batch) {
+        if (!IsFinite(p)) { continue; }
+        min_xy = min_xy.cwiseMin(Eigen::Vector2d(p.x, p.y));
+        max_xy = max_xy.cwiseMax(Eigen::Vector2d(p.x, p.y));
+        max_range = std::max(max_range, p.getVector3fMap().norm() * 1.0);
+      }
+    });
+
+    std::vector<pcl::PCLPointField> fields;
+    uint32_t record_size = GetPackedFields<PointT>(fields);
+    PointCloudFileWriter writer;
+    if (!writer.Open(output_file, fields, record_size)) { return false; }
+    if (min_xy.x() > max_xy.x()) {
+      BEAM_WARN("No finite points in file: {}", input_file);
+      return writer.Close();
+    }
+
+    margin_m_ = GetMargin(max_range);
+    tile_min_ = Eigen::Vector2i(std::floor(min_xy.x() / tile_size_m_),
+                                std::floor(min_xy.y() / tile_size_m_));
+    Eigen::Vector2i tile_max(std::floor(max_xy.x() / tile_size_m_),
+                             std::floor(max_xy.y() / tile_size_m_));
+    num_tiles_ = tile_max - tile_min_ + Eigen::Vector2i::Ones();
+    BEAM_INFO("Filtering {} points in {} x {} tiles with a margin of {} m",
+              reader.NumPoints(), num_tiles_.x(), num_tiles_.y(), margin_m_);
+
+    // pass 2: split points into tiles
+    boost::filesystem::path tmp_dir =
+        boost::filesystem::path(output_file).parent_path() /
+        boost::filesystem::unique_path("beam_chunked_filter_%%%%-%%%%");
+    boost::filesystem::create_directories(tmp_dir);
+    tmp_dir_ = tmp_dir.string();
+
+    bool success = SplitTiles(reader) && FilterTiles(writer);
+    success = writer.Close() && success;
+    boost::filesystem::remove_all(tmp_dir);
+    if (!success) {
+      // don't leave a partial output behind
+      boost::filesystem::remove(output_file);
+      return false;
+    }
+    BEAM_INFO("Wrote {} points to: {}", writer.NumPoints(), output_file);
+    return true;
+  }
+
+  /**
+   * @brief get the margin added around each tile by the last call to Filter
+   */
+  double GetMargin() const { return margin_m_; }
+
+private:
+  /**
+   * @brief read all points of a file in batches of batch_size_
+   */
+  template <typename Func>
+  void ForEachBatch(PointCloudFileReader& reader, Func&& func) {
+    reader.Restart();
+    std::vector<uint8_t> data;
+    PointCloudType batch;
+    size_t n;
+    while ((n = reader.ReadRecords(batch_size_, data)) > 0) {
+      RecordsToPointCloud(reader.GetFields(), reader.GetRecordSize(), data, n,
+                          batch);
+      func(batch);
+    }
+  }
+
+  bool IsFinite(const PointT& p) const {
+    return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z);
+  }
+
+  /**
+   * @brief compute the distance from a point at which other points can affect
+   * its output, summed over all filters in the pipeline
+   * @param max_range max range of any point in the cloud, used for the dynamic
+   * radius of DROR
+   */
+  double GetMargin(double max_range) const {
+    double margin = 0;
+    for (const auto& [filter_type, params] : filter_params_) {
+      // kd tree search radii are compared to squared distances
+      if (filter_type == FilterType::ROR) {
+        margin += std::sqrt(params.at(0));
+      } else if (filter_type == FilterType::DROR) {
+        double radius =
+            params.at(0) * params.at(1) * M_PI / 180 * max_range;
+        margin += std::sqrt(std::max(radius, params.at(3)));
+      } else if (filter_type == FilterType::VOXEL) {
+        margin += Eigen::Vector3d(params.at(0), params.at(1), params.at(2))
+                      .norm();
+      }
+    }
+    return margin;
+  }
+
+  std::string GetTileFile(int tile_id) const {
+    return tmp_dir_ + "/tile_" + std::to_string(tile_id) + ".bin";
+  }
+
+  /**
+   * @brief write the points of each tile (including its margin) to its
+   * temporary file
+   */
+  bool SplitTiles(PointCloudFileReader& reader) {
+    std::map<int, std::vector<PointT>> buffers;
+    size_t num_buffered = 0;
+    bool success = true;
+    auto flush = [&]() {
+      for (auto& [tile_id, points] : buffers) {
+        if (points.empty()) { continue; }
+        std::ofstream file(GetTileFile(tile_id),
+                           std::ios::out | std::ios::binary | std::ios::app);
+        file.write(reinterpret_cast<const char*>(points.data()),
+                   points.size() * sizeof(PointT));
+        if (!file.good()) {
+          BEAM_ERROR("Unable to write tile file: {}", GetTileFile(tile_id));
+          success = false;
+        }
+        points.clear();
+      }
+      num_buffered = 0;
+    };
+
+    ForEachBatch(reader, [&](const PointCloudType& batch) {
+      for (const auto& p : batch) {
+        if (!IsFinite(p)) { continue; }
+        int x0 = std::floor((p.x - margin_m_) / tile_size_m_) - tile_min_.x();
+        int x1 = std::floor((p.x + margin_m_) / tile_size_m_) - tile_min_.x();
+        int y0 = std::floor((p.y - margin_m_) / tile_size_m_) - tile_min_.y();
+        int y1 = std::floor((p.y + margin_m_) / tile_size_m_) - tile_min_.y();
+        for (int x = std::max(x0, 0); x <= std::min(x1, num_tiles_.x() - 1);
+             x++) {
+          for (int y = std::max(y0, 0); y <= std::min(y1, num_tiles_.y() - 1);
+               y++) {
+            buffers[x * num_tiles_.y() + y].push_back(p);
+            num_buffered++;
+          }
+        }
+      }
+      if (num_buffered >= batch_size_) { flush(); }
+    });
+    flush();
+    return success;
+  }
+
+  /**
+   * @brief filter each tile and write the points in its core to the output
+   */
+  bool FilterTiles(PointCloudFileWriter& writer) {
+    std::vector<uint8_t> data;
+    for (int x = 0; x < num_tiles_.x(); x++) {
+      for (int y = 0; y < num_tiles_.y(); y++) {
+        std::string tile_file = GetTileFile(x * num_tiles_.y() + y);
+        if (!boost::filesystem::exists(tile_file)) { continue; }
+
+        size_t num_points =
+            boost::filesystem::file_size(tile_file) / sizeof(PointT);
+        PointCloudType tile;
+        tile.resize(num_points);
+        std::ifstream file(tile_file, std::ios::in | std::ios::binary);
+        if (!file.read(reinterpret_cast<char*>(tile.points.data()),
+                       num_points * sizeof(PointT))) {
+          BEAM_ERROR("Unable to read tile file: {}", tile_file);
+          return false;
+        }
+        file.close();
+        boost::filesystem::remove(tile_file);
+
+        PointCloudType filtered =
+            FilterPointCloud(tile, filter_params_, num_threads_);
+
+        // keep points in the core [x_min, x_max) x [y_min, y_max)
+        int tile_x = x + tile_min_.x();
+        int tile_y = y + tile_min_.y();
+        PointCloudType core;
+        core.reserve(filtered.size());
+        for (const auto& p : filtered) {
+          if (std::floor(p.x / tile_size_m_) == tile_x &&
+              std::floor(p.y / tile_size_m_) == tile_y) {
+            core.push_back(p);
+          }
+        }
+        PointCloudToRecords(core, data);
+        if (!writer.WriteRecords(data, core.size())) { return false; }
+      }
+    }
+    return true;
+  }
+
+  std::vector<FilterParamsType> filter_params_;
+  double tile_size_m_;
+  size_t batch_size_;
+  int num_threads_;
+
+  double margin_m_{0};
+  std::string tmp_dir_;
+  Eigen::Vector2i tile_min_;
+  Eigen::Vector2i num_tiles_;
+};
+
+} // namespace beam_filtering
@@ -141,28 +141,27 @@ public:
     // perform filtering
     for (auto p = this->input_cloud_->begin(); p != this->input_cloud_->end();
          p++) {
-      PointT point = pcl::transformPoint(*p, T_box_cloud_);
-
-      if (point.x < min_vec_[0] || point.y < min_vec_[1] ||
-          point.z < min_vec_[2] || point.x > max_vec_[0] ||
-          point.y > max_vec_[1] || point.z > max_vec_[2]) {
-        if (remove_outside_points_) {
-          continue;
-        } else {
-          this->output_cloud_.push_back(*p);
-        }
-      } else {
-        if (remove_outside_points_) {
-          this->output_cloud_.push_back(*p);
-        } else {
-          continue;
-        }
-      }
+      if (KeepPoint(*p)) { this->output_cloud_.push_back(*p); }
     }
 
     return true;
   }
 
+  /**
+   * @brief Method for checking if a single point is kept by the filter. This
+   * lets pipelines apply multiple crop boxes in one pass over a cloud, see
+   * FilterPointCloud.
+   * @param p point in the cloud frame
+   * @return true if the point would be in the filtered cloud
+   */
+  inline bool KeepPoint(const PointT& p) const {
+    PointT point = pcl::transformPoint(p, T_box_cloud_);
+    bool outside = point.x < min_vec_[0] || point.y < min_vec_[1] ||
+                   point.z < min_vec_[2] || point.x > max_vec_[0] ||
+                   point.y > max_vec_[1] || point.z > max_vec_[2];
+    return outside != remove_outside_points_;
+  }
+
 private:
 
   Eigen::Vector3f min_vec_{0, 0, 0};
@@ -106,6 +106,19 @@ public:
    */
   inline float GetMinSearchRadius() const { return min_search_radius_; }
 
+  /**
+   * @brief Method for setting the number of threads used for the neighbor
+   * searches
+   * @param num_threads if <= 0, this will use all hardware threads
+   */
+  inline void SetNumThreads(int num_threads) { num_threads_ = num_threads; }
+
+  /**
+   * @brief Method for retrieving the number of threads
+   * @return num_threads
+   */
+  inline int GetNumThreads() const { return num_threads_; }
+
   /**
    * @brief Method for returning type of defect
    * @return filter type
@@ -123,37 +136,79 @@ public:
     // check cloud has points
     if (this->input_cloud_->size() == 0) { return false; }
 
-    // init. kd search tree
-    beam::KdTree<PointT> kd_tree(*this->input_cloud_);
+    // init. kd search tree without copying the input cloud
+    beam::KdTree<PointT> kd_tree(this->input_cloud_);
 
-    // Go over all the points and check which doesn't have enough neighbors
-    // perform filtering
-    for (auto p = this->input_cloud_->begin(); p != this->input_cloud_->end();
-         p++) {
-      float range_i = sqrt(pow(p->x, 2) + pow(p->y, 2));
+    std::vector<uint8_t> mask(this->input_cloud_->size(), 1);
+    FilterMask(*this->input_cloud_, kd_tree, mask);
+
+    // keep the points which have enough neighbors
+    this->output_cloud_.reserve(this->input_cloud_->size());
+    for (size_t i = 0; i < this->input_cloud_->size(); i++) {
+      if (mask[i]) {
+        this->output_cloud_.push_back(this->input_cloud_->points[i]);
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Method for applying the filter to the subset of a cloud given by a
+   * mask, using a kd tree which was built on the whole cloud. Only points in
+   * the mask are counted as neighbors, so this gives the same result as
+   * filtering a cloud containing only those points. This lets multiple
+   * filters share one tree, see FilterPointCloud.
+   * @param cloud cloud the kd tree was built on
+   * @param kd_tree kd tree built on cloud
+   * @param mask points with a non-zero entry are filtered, and set to zero if
+   * they don't have enough neighbors. Must be the same size as cloud
+   */
+  inline void FilterMask(const PointCloudType& cloud,
+                         const beam::KdTree<PointT>& kd_tree,
+                         std::vector<uint8_t>& mask) const {
+    // compute the dynamic search radius of each point
+    std::vector<uint32_t> query_ids;
+    std::vector<float> search_radii;
+    for (size_t i = 0; i < cloud.size(); i++) {
+      if (!mask[i]) { continue; }
+      const PointT& p = cloud.points[i];
+      float range_i = sqrt(pow(p.x, 2) + pow(p.y, 2));
       float search_radius_dynamic =
           radius_multiplier_ * azimuth_angle_ * M_PI / 180 * range_i;
 
       if (search_radius_dynamic < min_search_radius_) {
         search_radius_dynamic = min_search_radius_;
       }
+      query_ids.push_back(i);
+      search_radii.push_back(search_radius_dynamic);
+    }
 
-      std::vector<uint32_t> point_id_radius_search;
-      std::vector<float> point_radius_squared_dist;
-
-      size_t neighbors = kd_tree.radiusSearch(*p, search_radius_dynamic,
-                                              point_id_radius_search,
-                                              point_radius_squared_dist);
+    // count the neighbors of all points. We only need to know if each point
+    // has at least min_neighbors_, so the search can stop there
+    std::vector<uint32_t> num_neighbors;
+    kd_tree.radiusCountBatch(query_ids, search_radii, mask, num_neighbors,
+                             MaxCount(), num_threads_);
 
-      if (neighbors >= min_neighbors_) { this->output_cloud_.push_back(*p); }
+    // masks are only updated after all searches so that the points removed by
+    // this filter are still counted as neighbors
+    for (size_t i = 0; i < query_ids.size(); i++) {
+      if (num_neighbors[i] < min_neighbors_) { mask[query_ids[i]] = 0; }
     }
-
-    return true;
   }
 
 private:
+  /**
+   * @brief the neighbor search can stop once this many neighbors are found
+   */
+  inline size_t MaxCount() const {
+    return min_neighbors_ > 0 ? static_cast<size_t>(std::ceil(min_neighbors_))
+                              : 0;
+  }
+
   float radius_multiplier_{3};
   float azimuth_angle_{0.04};
+  int num_threads_{0};
   float min_neighbors_{3};
   float min_search_radius_{0.04};
 };
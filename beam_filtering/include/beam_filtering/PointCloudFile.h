@@ -0,0 +1,281 @@
+/** @file
+ * @ingroup filtering
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <pcl/PCLPointField.h>
+#include <pcl/point_cloud.h>
+#include <pcl/common/io.h>
+
+namespace beam_filtering {
+/// @addtogroup filtering
+
+/**
+ * @brief class for reading the points of a PCD or PLY file in batches, without
+ * loading the whole file into memory. Supported formats are ascii and binary
+ * PCD files, and ascii and binary little endian PLY files where the vertex
+ * element is the first element and has no list properties. Compressed PCD
+ * files are not supported.
+ *
+ * Points are returned as packed records: each record contains all fields of
+ * the file in order, in the types given by GetFields(). Use
+ * RecordsToPointCloud to convert them to a pcl point type. For PLY files which
+ * store colors as red, green and blue properties, a float rgb field is
+ * appended to each record so that they can be converted to pcl's color point
+ * types.
+ */
+class PointCloudFileReader {
+public:
+  /**
+   * @brief default constructor
+   */
+  PointCloudFileReader() = default;
+
+  /**
+   * @brief open a file and read its header
+   * @param filename full path to a .pcd or .ply file
+   * @return true if successful
+   */
+  bool Open(const std::string& filename);
+
+  /**
+   * @brief get the total number of points in the file
+   */
+  size_t NumPoints() const { return num_points_; }
+
+  /**
+   * @brief get the fields of each record, with offsets within the record
+   */
+  const std::vector<pcl::PCLPointField>& GetFields() const { return fields_; }
+
+  /**
+   * @brief get the size of each record in bytes
+   */
+  uint32_t GetRecordSize() const { return record_size_; }
+
+  /**
+   * @brief read the next batch of points
+   * @param max_points maximum number of points to read
+   * @param data output packed records, resized to the number of points read
+   * times GetRecordSize()
+   * @return number of points read, 0 once all points have been read
+   */
+  size_t ReadRecords(size_t max_points, std::vector<uint8_t>& data);
+
+  /**
+   * @brief go back to the first point of the file
+   */
+  void Restart();
+
+private:
+  bool ParsePCDHeader();
+
+  bool ParsePLYHeader();
+
+  /**
+   * @brief parse one line of an ascii file into a record
+   */
+  bool ParseASCIILine(const std::string& line, uint8_t* record) const;
+
+  /**
+   * @brief compute the offset of each field and the record size, and add the
+   * rgb field if needed
+   */
+  void ComputeOffsets();
+
+  /**
+   * @brief fill the rgb field of a record from its red, green and blue fields
+   */
+  void PackRGB(uint8_t* record) const;
+
+  std::string filename_;
+  std::ifstream file_;
+  bool binary_{true};
+  std::streampos data_start_{0};
+  size_t num_points_{0};
+  size_t num_read_{0};
+  std::vector<pcl::PCLPointField> fields_;
+  uint32_t record_size_{0};
+
+  // size of the records stored in the file, which does not include the rgb
+  // field if it was added
+  uint32_t file_record_size_{0};
+  int red_field_{-1};
+  int green_field_{-1};
+  int blue_field_{-1};
+};
+
+/**
+ * @brief class for writing points to a binary PCD file in batches, without
+ * keeping them in memory. Since the number of points needs to be in the
+ * header, records are written to a temporary file next to the output and
+ * copied after the header when the writer is closed.
+ */
+class PointCloudFileWriter {
+public:
+  /**
+   * @brief default constructor
+   */
+  PointCloudFileWriter() = default;
+
+  /**
+   * @brief destructor, closes the file if needed
+   */
+  ~PointCloudFileWriter();
+
+  /**
+   * @brief open a file for writing
+   * @param filename full path to a .pcd file
+   * @param fields fields of each record, with offsets within the record (see
+   * PointCloudToRecords)
+   * @param record_size size of each record in bytes
+   * @return true if successful
+   */
+  bool Open(const std::string& filename,
+            const std::vector<pcl::PCLPointField>& fields,
+            uint32_t record_size);
+
+  /**
+   * @brief append packed records to the file
+   * @param data packed records
+   * @param num_points number of records in data
+   * @return true if successful. If false, the output is incomplete and Close
+   * will also fail
+   */
+  bool WriteRecords(const std::vector<uint8_t>& data, size_t num_points);
+
+  /**
+   * @brief write the header and all records to the output file
+   * @return true if successful, false if this or any previous write failed
+   */
+  bool Close();
+
+  /**
+   * @brief get the number of points written so far
+   */
+  size_t NumPoints() const { return num_points_; }
+
+private:
+  std::string filename_;
+  std::string tmp_filename_;
+  std::ofstream tmp_file_;
+  std::vector<pcl::PCLPointField> fields_;
+  uint32_t record_size_{0};
+  size_t num_points_{0};
+  bool write_failed_{false};
+};
+
+/**
+ * @brief get the size in bytes of a pcl field datatype
+ */
+uint32_t GetFieldSize(uint8_t datatype);
+
+/**
+ * @brief convert a single value between pcl field datatypes
+ * @param src pointer to the input value
+ * @param src_type datatype of the input value
+ * @param dst pointer to the output value
+ * @param dst_type datatype of the output value
+ */
+void ConvertFieldValue(const uint8_t* src, uint8_t src_type, uint8_t* dst,
+                       uint8_t dst_type);
+
+/**
+ * @brief convert packed records read by PointCloudFileReader to a pcl cloud.
+ * Fields are matched by name and converted to the type of the point field.
+ * Fields of PointT which are not in the file are left default initialized.
+ * @param fields fields of each record
+ * @param record_size size of each record in bytes
+ * @param data packed records
+ * @param num_points number of records in data
+ * @param cloud output cloud, resized to num_points
+ */
+template <class PointT>
+void RecordsToPointCloud(const std::vector<pcl::PCLPointField>& fields,
+                         uint32_t record_size, const std::vector<uint8_t>& data,
+                         size_t num_points, pcl::PointCloud<PointT>& cloud) {
+  // match each field of the point type to a field in the file
+  std::vector<pcl::PCLPointField> point_fields = pcl::getFields<PointT>();
+  std::vector<std::pair<const pcl::PCLPointField*, const pcl::PCLPointField*>>
+      matches;
+  for (const auto& point_field : point_fields) {
+    for (const auto& field : fields) {
+      if (field.name == point_field.name) {
+        matches.emplace_back(&field, &point_field);
+        break;
+      }
+    }
+  }
+
+  cloud.resize(num_points);
+  for (size_t i = 0; i < num_points; i++) {
+    const uint8_t* record = &data[i * record_size];
+    uint8_t* point = reinterpret_cast<uint8_t*>(&cloud.points[i]);
+    for (const auto& [field, point_field] : matches) {
+      uint32_t count = std::min(field->count, point_field->count);
+      uint32_t src_size = GetFieldSize(field->datatype);
+      uint32_t dst_size = GetFieldSize(point_field->datatype);
+      for (uint32_t c = 0; c < count; c++) {
+        ConvertFieldValue(record + field->offset + c * src_size,
+                          field->datatype,
+                          point + point_field->offset + c * dst_size,
+                          point_field->datatype);
+      }
+    }
+  }
+}
+
+/**
+ * @brief get the fields and record size used by PointCloudToRecords for a
+ * point type, i.e., all fields of the point type packed without padding
+ * @param fields output fields
+ * @return record size in bytes
+ */
+template <class PointT>
+uint32_t GetPackedFields(std::vector<pcl::PCLPointField>& fields) {
+  fields.clear();
+  uint32_t offset = 0;
+  for (pcl::PCLPointField field : pcl::getFields<PointT>()) {
+    if (field.name == "_") { continue; }
+    field.offset = offset;
+    offset += field.count * GetFieldSize(field.datatype);
+    fields.push_back(field);
+  }
+  return offset;
+}
+
+/**
+ * @brief convert a pcl cloud to packed records for PointCloudFileWriter
+ * @param cloud input cloud
+ * @param data output packed records with the layout given by GetPackedFields
+ */
+template <class PointT>
+void PointCloudToRecords(const pcl::PointCloud<PointT>& cloud,
+                         std::vector<uint8_t>& data) {
+  std::vector<pcl::PCLPointField> fields;
+  uint32_t record_size = GetPackedFields<PointT>(fields);
+  std::vector<pcl::PCLPointField> point_fields;
+  for (const auto& field : pcl::getFields<PointT>()) {
+    if (field.name != "_") { point_fields.push_back(field); }
+  }
+
+  data.resize(cloud.size() * record_size);
+  for (size_t i = 0; i < cloud.size(); i++) {
+    const uint8_t* point = reinterpret_cast<const uint8_t*>(&cloud.points[i]);
+    uint8_t* record = &data[i * record_size];
+    for (size_t f = 0; f < fields.size(); f++) {
+      std::copy(point + point_fields[f].offset,
+                point + point_fields[f].offset +
+                    fields[f].count * GetFieldSize(fields[f].datatype),
+                record + fields[f].offset);
+    }
+  }
+}
+
+} // namespace beam_filtering
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <memory>
+
 #include <nlohmann/json.hpp>
 #include <pcl/impl/point_types.hpp>
 
@@ -69,63 +72,158 @@ FilterParamsType GetFilterParams(const nlohmann::json& J);
  */
 std::vector<FilterParamsType> LoadFilterParamsVector(const nlohmann::json& J);
 
+/**
+ * @brief method for building a filter from its params. See
+ * filter_params.json in test_data for the meaning of the params of each filter
+ */
+template <class PointT>
+inline CropBox<PointT> GetCropBox(const std::vector<double>& params) {
+  Eigen::Vector3f min_vec(params.at(0), params.at(1), params.at(2));
+  Eigen::Vector3f max_vec(params.at(3), params.at(4), params.at(5));
+  CropBox<PointT> cropper;
+  cropper.SetMinVector(min_vec);
+  cropper.SetMaxVector(max_vec);
+  cropper.SetRemoveOutsidePoints(params.at(6) == 1);
+  return cropper;
+}
+
 /**
  * @brief method for filtering a point cloud based on a list of filters with
- * their associated parameters
+ * their associated parameters.
+ *
+ * The filters are run as a pipeline which does not copy the cloud between
+ * filters. Instead, points removed by CropBox, ROR and DROR filters are
+ * marked in a mask over the current cloud:
+ *
+ *  - consecutive CropBox filters are fused into a single pass over the cloud
+ *
+ *  - ROR and DROR filters share a single kd tree built on the current cloud,
+ *  only counting points which are still in the mask as neighbors (this gives
+ *  the same result as rebuilding the tree on the output of the last filter).
+ *  If most points have already been removed when the tree is needed, the
+ *  remaining points are extracted first so the tree is smaller
+ *
+ *  - VoxelDownsample filters read the masked cloud directly and their output
+ *  becomes the new current cloud
+ *
+ * The remaining points are only copied to the output once at the end.
+ *
  * @param cloud point cloud to filter
  * @param filter_params
+ * @param num_threads number of threads used by the filters. If <= 0, this
+ * will use all hardware threads
  * @return filtered_cloud
  */
 template <class PointT>
 inline pcl::PointCloud<PointT>
     FilterPointCloud(const pcl::PointCloud<PointT>& cloud,
-                     const std::vector<FilterParamsType>& filter_params) {
-  pcl::PointCloud<PointT> filtered_cloud = cloud;
-  for (uint8_t i = 0; i < filter_params.size(); i++) {
-    std::shared_ptr<pcl::PointCloud<PointT>> input_cloud =
-        std::make_shared<pcl::PointCloud<PointT>>(filtered_cloud);
+                     const std::vector<FilterParamsType>& filter_params,
+                     int num_threads = 0) {
+  using PointCloudType = pcl::PointCloud<PointT>;
+  const size_t min_points_per_thread = 100000;
+
+  // current cloud is either the input cloud or the output of the last filter
+  // that creates new points, which is stored in owned_cloud
+  const PointCloudType* current_cloud = &cloud;
+  PointCloudType owned_cloud;
+  std::vector<uint8_t> mask(cloud.size(), 1);
+  size_t num_kept = cloud.size();
+
+  // kd tree on current_cloud, reused by consecutive neighbourhood filters
+  std::unique_ptr<beam::KdTree<PointT>> kd_tree;
+
+  // replaces the current cloud by the points remaining in the mask
+  auto extract_remaining = [&]() {
+    PointCloudType remaining;
+    remaining.reserve(num_kept);
+    for (size_t i = 0; i < current_cloud->size(); i++) {
+      if (mask[i]) { remaining.push_back(current_cloud->points[i]); }
+    }
+    kd_tree.reset();
+    owned_cloud = std::move(remaining);
+    current_cloud = &owned_cloud;
+    mask.assign(owned_cloud.size(), 1);
+  };
+
+  auto update_num_kept = [&]() {
+    num_kept = std::count(mask.begin(), mask.end(), 1);
+  };
+
+  size_t i = 0;
+  while (i < filter_params.size()) {
     FilterType filter_type = filter_params[i].first;
-    std::vector<double> params = filter_params[i].second;
-    if (filter_type == FilterType::DROR) {
-      beam_filtering::DROR<PointT> outlier_removal;
-      outlier_removal.SetRadiusMultiplier(params.at(0));
-      outlier_removal.SetAzimuthAngle(params.at(1));
-      outlier_removal.SetMinNeighbors(params.at(2));
-      outlier_removal.SetMinSearchRadius(params.at(3));
-      outlier_removal.SetInputCloud(input_cloud);
-      outlier_removal.Filter();
-      filtered_cloud = outlier_removal.GetFilteredCloud();
-    } else if (filter_type == FilterType::ROR) {
-      beam_filtering::ROR<PointT> outlier_removal;
-      outlier_removal.SetRadiusSearch(params.at(0));
-      outlier_removal.SetMinNeighbors(params.at(1));
-      outlier_removal.SetInputCloud(input_cloud);
-      outlier_removal.Filter();
-      filtered_cloud = outlier_removal.GetFilteredCloud();
+    const std::vector<double>& params = filter_params[i].second;
+    if (filter_type == FilterType::CROPBOX) {
+      // fuse all consecutive crop boxes into one pass
+      std::vector<CropBox<PointT>> croppers;
+      for (; i < filter_params.size() &&
+             filter_params[i].first == FilterType::CROPBOX;
+           i++) {
+        croppers.push_back(GetCropBox<PointT>(filter_params[i].second));
+      }
+      int n_threads = beam::GetNumThreads(num_threads, current_cloud->size(),
+                                          min_points_per_thread);
+      beam::ParallelForChunks(
+          current_cloud->size(), n_threads, [&](int, size_t begin, size_t end) {
+            for (size_t j = begin; j < end; j++) {
+              if (!mask[j]) { continue; }
+              for (const auto& cropper : croppers) {
+                if (!cropper.KeepPoint(current_cloud->points[j])) {
+                  mask[j] = 0;
+                  break;
+                }
+              }
+            }
+          });
+      update_num_kept();
+      continue;
+    }
+
+    if (filter_type == FilterType::DROR || filter_type == FilterType::ROR) {
+      if (!kd_tree) {
+        if (num_kept < current_cloud->size() / 2) { extract_remaining(); }
+        kd_tree =
+            std::make_unique<beam::KdTree<PointT>>(*current_cloud, false);
+      }
+      if (filter_type == FilterType::DROR) {
+        beam_filtering::DROR<PointT> outlier_removal;
+        outlier_removal.SetRadiusMultiplier(params.at(0));
+        outlier_removal.SetAzimuthAngle(params.at(1));
+        outlier_removal.SetMinNeighbors(params.at(2));
+        outlier_removal.SetMinSearchRadius(params.at(3));
+        outlier_removal.SetNumThreads(num_threads);
+        outlier_removal.FilterMask(*current_cloud, *kd_tree, mask);
+      } else {
+        beam_filtering::ROR<PointT> outlier_removal;
+        outlier_removal.SetRadiusSearch(params.at(0));
+        outlier_removal.SetMinNeighbors(params.at(1));
+        outlier_removal.SetNumThreads(num_threads);
+        outlier_removal.FilterMask(*current_cloud, *kd_tree, mask);
+      }
+      update_num_kept();
     } else if (filter_type == FilterType::VOXEL) {
       beam_filtering::VoxelDownsample<PointT> downsampler;
       downsampler.SetVoxelSize(
           Eigen::Vector3f(params.at(0), params.at(1), params.at(2)));
-      downsampler.SetInputCloud(input_cloud);
-      downsampler.Filter();
-      filtered_cloud = downsampler.GetFilteredCloud();
-    } else if (filter_type == FilterType::CROPBOX) {
-      Eigen::Vector3d min_vec(params.at(0), params.at(1), params.at(2));
-      Eigen::Vector3d max_vec(params.at(3), params.at(4), params.at(5));
-      Eigen::Vector3f min_vecf = min_vec.cast<float>();
-      Eigen::Vector3f max_vecf = max_vec.cast<float>();
-      beam_filtering::CropBox<PointT> cropper;
-      cropper.SetMinVector(min_vecf);
-      cropper.SetMaxVector(max_vecf);
-      if (params[6] == 1) {
-        cropper.SetRemoveOutsidePoints(true);
-      } else {
-        cropper.SetRemoveOutsidePoints(false);
-      }
-      cropper.SetInputCloud(input_cloud);
-      cropper.Filter();
-      filtered_cloud = cropper.GetFilteredCloud();
+      downsampler.SetNumThreads(num_threads);
+      PointCloudType downsampled;
+      downsampler.Downsample(*current_cloud, &mask, downsampled);
+      kd_tree.reset();
+      owned_cloud = std::move(downsampled);
+      current_cloud = &owned_cloud;
+      mask.assign(owned_cloud.size(), 1);
+      num_kept = owned_cloud.size();
     }
+    i++;
+  }
+
+  if (current_cloud == &owned_cloud && num_kept == owned_cloud.size()) {
+    return owned_cloud;
+  }
+  PointCloudType filtered_cloud;
+  filtered_cloud.reserve(num_kept);
+  for (size_t j = 0; j < current_cloud->size(); j++) {
+    if (mask[j]) { filtered_cloud.push_back(current_cloud->points[j]); }
   }
   return filtered_cloud;
 }
@@ -4,30 +4,64 @@
 
 #pragma once
 
-#include <pcl/common/common.h>
-#include <pcl/filters/voxel_grid.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+#include <pcl/common/centroid.h>
 
 #include <beam_filtering/Filter.h>
+#include <beam_utils/parallel.h>
 
 namespace beam_filtering {
 /**
  * @addtogroup filtering
  */
 
+/**
+ * @brief Enum class for how the points in each voxel are combined
+ */
+enum class VoxelDownsampleMode {
+  // replace points with their centroid (all fields supported by
+  // pcl::CentroidPoint are averaged, others are taken from the first point)
+  CENTROID = 0,
+  // keep the first point (in input order) of each voxel
+  FIRST_POINT
+};
+
+/**
+ * @brief mixes the bits of a packed voxel key so that neighboring voxels are
+ * spread evenly over hash buckets (splitmix64 finalizer)
+ */
+inline uint64_t HashVoxelKey(uint64_t key) {
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return key;
+}
+
 /**
  * @brief VoxelDownsample is a filter for downsampling a pointcloud using a
- * voxel grid. Points in each voxel are replaced with a single point in their
- * centroid.  This is currently implemented as a wrapper over PCL's voxel grid
- * filter.
+ * voxel grid. Points in each voxel are replaced with a single point, either
+ * their centroid or the first point in the voxel (see VoxelDownsampleMode).
  *
- * PCL stores the number of voxels using 32bit integers, so integer overflow
- * protection is implemented. Clouds are split up to be filtered piecewise if
- * overflow is predicted. Midpoint splitting is used in a recursive pattern
- * until overflow is not predicted for any piece.  The output cloud is the
- * concatenation of each piece filtered.
+ * The voxel grid is aligned with the origin of the cloud frame, so clouds
+ * which overlap get the same voxel boundaries. The integer voxel indices of
+ * each point are packed into a 64 bit key, using only as many bits per axis as
+ * the extent of the cloud requires. This supports up to 2^63 voxels in the
+ * bounding box of the cloud, so unlike pcl::VoxelGrid (which uses 32 bit
+ * indices) large maps are filtered in one pass without splitting.
  *
- * VoxelDownsample currently supports the PointXYZ point type with templating
- * coming soon.
+ * Filtering is split across threads: keys are computed in parallel, points are
+ * partitioned by the hash of their key into a fixed number of buckets, then
+ * each bucket is reduced independently with its own hash map. The output
+ * points are ordered by the index of the first input point in their voxel, so
+ * the result does not depend on the number of threads. Memory used is two 64
+ * bit integers per input point plus the output.
  */
 template <class PointT = pcl::PointXYZ>
 class VoxelDownsample : public FilterBase<PointT> {
@@ -37,11 +71,13 @@ public:
   /**
    * @brief Constructor.
    * @param voxel_size Initial voxel size in x, y, and z.
+   * @param mode how to combine the points in each voxel
    */
   VoxelDownsample(const Eigen::Vector3f& voxel_size = Eigen::Vector3f(0.05,
                                                                       0.05,
-                                                                      0.05))
-      : voxel_size_(voxel_size) {}
+                                                                      0.05),
+                  VoxelDownsampleMode mode = VoxelDownsampleMode::CENTROID)
+      : voxel_size_(voxel_size), mode_(mode) {}
 
   /**
    * @brief Default destructor.
@@ -62,6 +98,30 @@ public:
     voxel_size_ = voxel_size;
   }
 
+  /**
+   * @brief Get how points in each voxel are combined
+   * @return mode
+   */
+  inline VoxelDownsampleMode GetMode() const { return mode_; }
+
+  /**
+   * @brief Set how points in each voxel are combined
+   * @param mode
+   */
+  inline void SetMode(VoxelDownsampleMode mode) { mode_ = mode; }
+
+  /**
+   * @brief Method for setting the number of threads
+   * @param num_threads if <= 0, this will use all hardware threads
+   */
+  inline void SetNumThreads(int num_threads) { num_threads_ = num_threads; }
+
+  /**
+   * @brief Method for retrieving the number of threads
+   * @return num_threads
+   */
+  inline int GetNumThreads() const { return num_threads_; }
+
   /**
    * @brief Method for returning type of defect
    * @return filter type
@@ -79,18 +139,101 @@ public:
     // check cloud has points
     if (this->input_cloud_->size() == 0) { return false; }
 
-    // Filter cloud in pieces to prevent integer overflow.
-    std::vector<PointCloudTypePtr> broken_clouds =
-        BreakUpPointCloud(*(this->input_cloud_));
-
-    // Create a pcl voxel grid filter and use voxel_size_ as grid size.
-    pcl::VoxelGrid<PointT> downsampler;
-    downsampler.setLeafSize(voxel_size_[0], voxel_size_[1], voxel_size_[2]);
-    for (const auto& cloud : broken_clouds) {
-      PointCloudType downsampled_points;
-      downsampler.setInputCloud(cloud);
-      downsampler.filter(downsampled_points);
-      this->output_cloud_ += downsampled_points;
+    return Downsample(*this->input_cloud_, nullptr, this->output_cloud_);
+  }
+
+  /**
+   * @brief Method for downsampling a cloud, or the subset of a cloud given by
+   * a mask, directly into an output cloud. This lets pipelines run the filter
+   * without copying their input, see FilterPointCloud.
+   * @param cloud input cloud
+   * @param mask if not null, only points with a non-zero entry are used. Must
+   * be the same size as cloud
+   * @param output output cloud, must not be the same as cloud
+   * @return true if successful
+   */
+  inline bool Downsample(const PointCloudType& cloud,
+                         const std::vector<uint8_t>* mask,
+                         PointCloudType& output) {
+    output.clear();
+
+    if ((voxel_size_.array() <= 0).any()) {
+      BEAM_ERROR("Invalid voxel size: [{}, {}, {}], all dimensions must be "
+                 "greater than zero.",
+                 voxel_size_[0], voxel_size_[1], voxel_size_[2]);
+      return false;
+    }
+
+    int n_threads = beam::GetNumThreads(num_threads_, cloud.size(),
+                                        min_points_per_thread_);
+
+    if (!ComputeKeyLayout(cloud, mask, n_threads)) { return false; }
+
+    // compute the key of each point, and partition the point ids by bucket.
+    // Each thread counts the points per bucket in its chunk, then writes its
+    // ids to its own range within each bucket so the ids in each bucket stay
+    // in input order
+    std::vector<uint64_t> keys(cloud.size());
+    std::vector<std::array<size_t, num_buckets_>> counts(n_threads);
+    beam::ParallelForChunks(
+        cloud.size(), n_threads, [&](int thread_id, size_t begin, size_t end) {
+          std::array<size_t, num_buckets_>& thread_counts = counts[thread_id];
+          thread_counts.fill(0);
+          for (size_t i = begin; i < end; i++) {
+            keys[i] =
+                mask && !(*mask)[i] ? invalid_key_ : GetKey(cloud[i]);
+            if (keys[i] == invalid_key_) { continue; }
+            thread_counts[GetBucket(keys[i])]++;
+          }
+        });
+
+    std::vector<size_t> bucket_begin(num_buckets_ + 1);
+    size_t num_valid = 0;
+    for (size_t b = 0; b < num_buckets_; b++) {
+      bucket_begin[b] = num_valid;
+      for (auto& thread_counts : counts) {
+        size_t count = thread_counts[b];
+        thread_counts[b] = num_valid;
+        num_valid += count;
+      }
+    }
+    bucket_begin[num_buckets_] = num_valid;
+
+    std::vector<size_t> sorted_ids(num_valid);
+    beam::ParallelForChunks(
+        cloud.size(), n_threads, [&](int thread_id, size_t begin, size_t end) {
+          std::array<size_t, num_buckets_>& offsets = counts[thread_id];
+          for (size_t i = begin; i < end; i++) {
+            if (keys[i] == invalid_key_) { continue; }
+            sorted_ids[offsets[GetBucket(keys[i])]++] = i;
+          }
+        });
+
+    // reduce each bucket. Each voxel stores the id of its first point which is
+    // used to order the output
+    std::vector<PointCloudType> thread_points(n_threads);
+    std::vector<std::vector<size_t>> thread_first_ids(n_threads);
+    beam::ParallelForChunks(
+        num_buckets_, n_threads, [&](int thread_id, size_t begin, size_t end) {
+          ReduceBuckets(cloud, keys, sorted_ids, bucket_begin, begin, end,
+                        thread_points[thread_id], thread_first_ids[thread_id]);
+        });
+
+    std::vector<std::pair<size_t, const PointT*>> voxels;
+    for (int t = 0; t < n_threads; t++) {
+      for (size_t v = 0; v < thread_first_ids[t].size(); v++) {
+        voxels.emplace_back(thread_first_ids[t][v], &thread_points[t][v]);
+      }
+    }
+    std::sort(voxels.begin(), voxels.end(),
+              [](const std::pair<size_t, const PointT*>& a,
+                 const std::pair<size_t, const PointT*>& b) {
+                return a.first < b.first;
+              });
+
+    output.resize(voxels.size());
+    for (size_t v = 0; v < voxels.size(); v++) {
+      output[v] = *voxels[v].second;
     }
 
     return true;
@@ -98,82 +241,157 @@ public:
 
 private:
   /**
-   * @brief Private method for breaking up clouds.
-   * @param input_cloud Reference to the cloud to be broken up.
-   * @return A vector of the broken up clouds.
+   * @brief Private method for computing the offset and number of bits of the
+   * voxel indices along each axis, from the bounds of the cloud.
+   * @param cloud input cloud
+   * @param mask if not null, only points with a non-zero entry are used
+   * @param n_threads number of threads
+   * @return false if the number of voxels cannot be stored in 63 bits
+   */
+  inline bool ComputeKeyLayout(const PointCloudType& cloud,
+                               const std::vector<uint8_t>* mask,
+                               int n_threads) {
+    std::vector<Eigen::Vector3f> mins(
+        n_threads,
+        Eigen::Vector3f::Constant(std::numeric_limits<float>::max()));
+    std::vector<Eigen::Vector3f> maxs(
+        n_threads,
+        Eigen::Vector3f::Constant(std::numeric_limits<float>::lowest()));
+    beam::ParallelForChunks(
+        cloud.size(), n_threads, [&](int thread_id, size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            const PointT& p = cloud[i];
+            if ((mask && !(*mask)[i]) || !std::isfinite(p.x) ||
+                !std::isfinite(p.y) || !std::isfinite(p.z)) {
+              continue;
+            }
+            Eigen::Vector3f v(p.x, p.y, p.z);
+            mins[thread_id] = mins[thread_id].cwiseMin(v);
+            maxs[thread_id] = maxs[thread_id].cwiseMax(v);
+          }
+        });
+    Eigen::Vector3f min = mins[0];
+    Eigen::Vector3f max = maxs[0];
+    for (int t = 1; t < n_threads; t++) {
+      min = min.cwiseMin(mins[t]);
+      max = max.cwiseMax(maxs[t]);
+    }
+
+    // no finite points, GetKey will return invalid_key_ for all of them
+    if ((min.array() > max.array()).any()) { return true; }
+
+    int total_bits = 0;
+    for (int i = 0; i < 3; i++) {
+      inverse_voxel_size_[i] = 1.0 / voxel_size_[i];
+      min_index_[i] = static_cast<int64_t>(
+          std::floor(static_cast<double>(min[i]) * inverse_voxel_size_[i]));
+      int64_t max_index = static_cast<int64_t>(
+          std::floor(static_cast<double>(max[i]) * inverse_voxel_size_[i]));
+      uint64_t num_voxels = static_cast<uint64_t>(max_index - min_index_[i]);
+      key_shift_[i] = total_bits;
+      while (num_voxels > 0) {
+        num_voxels >>= 1;
+        total_bits++;
+      }
+    }
+
+    if (total_bits > 63) {
+      BEAM_ERROR("Voxel size too small for input cloud, number of voxels in "
+                 "the bounding box cannot be stored in 63 bits.");
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Private method for getting the key of the voxel containing a
+   * point. Must be called after ComputeKeyLayout.
+   * @param p input point
+   * @return key, or invalid_key_ if the point is not finite
    */
-  inline std::vector<PointCloudTypePtr>
-      BreakUpPointCloud(const PointCloudType& input_cloud) {
-    // Determine if integer overflow will occur.
-    PointT min;
-    PointT max;
-    pcl::getMinMax3D(input_cloud, min, max);
-    Eigen::Vector3f axis_dimensions(std::abs(max.x - min.x),
-                                    std::abs(max.y - min.y),
-                                    std::abs(max.z - min.z));
-    uint64_t voxel_count_x =
-        static_cast<uint64_t>((axis_dimensions[0] / voxel_size_[0]) + 1);
-    uint64_t voxel_count_y =
-        static_cast<uint64_t>((axis_dimensions[1] / voxel_size_[1]) + 1);
-    uint64_t voxel_count_z =
-        static_cast<uint64_t>((axis_dimensions[2] / voxel_size_[2]) + 1);
-
-    if ((voxel_count_x * voxel_count_y * voxel_count_z) >
-        static_cast<uint64_t>(std::numeric_limits<std::int32_t>::max())) {
-      // Split cloud along max axis until integer overflow does not occur.
-      int max_axis;
-      axis_dimensions.maxCoeff(&max_axis);
-      std::pair<PointCloudTypePtr, PointCloudTypePtr> split_clouds =
-          SplitCloudInTwo(input_cloud, max_axis);
-
-      // Recursively call BreakUpPointCloud on each split.
-      std::vector<PointCloudTypePtr> cloud_1 =
-          BreakUpPointCloud(*(split_clouds.first));
-      std::vector<PointCloudTypePtr> cloud_2 =
-          BreakUpPointCloud(*(split_clouds.second));
-      cloud_1.insert(cloud_1.end(), cloud_2.begin(), cloud_2.end());
-      return cloud_1;
-    } else {
-      // No overflow, return output cloud pointers in vector.
-      PointCloudTypePtr output_cloud =
-          std::make_shared<PointCloudType>(input_cloud);
-      return std::vector<PointCloudTypePtr>{output_cloud};
+  inline uint64_t GetKey(const PointT& p) const {
+    if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+      return invalid_key_;
+    }
+    const float coords[3] = {p.x, p.y, p.z};
+    uint64_t key = 0;
+    for (int i = 0; i < 3; i++) {
+      int64_t index = static_cast<int64_t>(std::floor(
+          static_cast<double>(coords[i]) * inverse_voxel_size_[i]));
+      key |= static_cast<uint64_t>(index - min_index_[i]) << key_shift_[i];
     }
+    return key;
   }
 
   /**
-   * @brief Private method for splitting one cloud into two
-   * format.
-   * @param input_cloud Cloud to be split.
-   * @param max_axis The axis of greatest magnitude to split the cloud.
-   * @return A pair of the split clouds.
+   * @brief Private method for getting the bucket of a key
    */
-  inline std::pair<PointCloudTypePtr, PointCloudTypePtr>
-      SplitCloudInTwo(const PointCloudType& input_cloud, int max_axis) {
-    // Get mid point of cloud.
-    PointT min;
-    PointT max;
-    pcl::getMinMax3D(input_cloud, min, max);
-    Eigen::Vector3f eigen_min(min.x, min.y, min.z);
-    Eigen::Vector3f eigen_max(max.x, max.y, max.z);
-    float midpoint = (eigen_max[max_axis] + eigen_min[max_axis]) / 2;
-
-    // Create clouds for points (1) < than midpoint (2) > than midpoint.
-    PointCloudTypePtr cloud_1 = std::make_shared<PointCloudType>();
-    PointCloudTypePtr cloud_2 = std::make_shared<PointCloudType>();
-    for (const PointT& point : input_cloud) {
-      Eigen::Vector3f eigen_point(point.x, point.y, point.z);
-      if (eigen_point[max_axis] < midpoint) {
-        cloud_1->push_back(point);
-      } else {
-        cloud_2->push_back(point);
+  inline static size_t GetBucket(uint64_t key) {
+    return HashVoxelKey(key) >> (64 - num_bucket_bits_);
+  }
+
+  /**
+   * @brief Private method for combining the points in a range of buckets
+   * @param cloud input cloud
+   * @param keys key of each point
+   * @param sorted_ids ids of points sorted by bucket
+   * @param bucket_begin index of the first id of each bucket in sorted_ids
+   * @param begin first bucket
+   * @param end one past the last bucket
+   * @param points output point for each voxel
+   * @param first_ids output id of the first point of each voxel
+   */
+  inline void ReduceBuckets(const PointCloudType& cloud,
+                            const std::vector<uint64_t>& keys,
+                            const std::vector<size_t>& sorted_ids,
+                            const std::vector<size_t>& bucket_begin,
+                            size_t begin, size_t end, PointCloudType& points,
+                            std::vector<size_t>& first_ids) const {
+    std::unordered_map<uint64_t, size_t, KeyHash> voxel_ids;
+    std::vector<pcl::CentroidPoint<PointT>,
+                Eigen::aligned_allocator<pcl::CentroidPoint<PointT>>>
+        centroids;
+    for (size_t b = begin; b < end; b++) {
+      voxel_ids.clear();
+      centroids.clear();
+      size_t first_voxel = points.size();
+      for (size_t j = bucket_begin[b]; j < bucket_begin[b + 1]; j++) {
+        size_t id = sorted_ids[j];
+        auto [iter, inserted] = voxel_ids.emplace(keys[id], points.size());
+        if (inserted) {
+          points.push_back(cloud[id]);
+          first_ids.push_back(id);
+          if (mode_ == VoxelDownsampleMode::CENTROID) {
+            centroids.emplace_back();
+          }
+        }
+        if (mode_ == VoxelDownsampleMode::CENTROID) {
+          centroids[iter->second - first_voxel].add(cloud[id]);
+        }
+      }
+      for (size_t v = 0; v < centroids.size(); v++) {
+        centroids[v].get(points[first_voxel + v]);
       }
     }
-
-    return std::pair<PointCloudTypePtr, PointCloudTypePtr>(cloud_1, cloud_2);
   }
 
+  struct KeyHash {
+    size_t operator()(uint64_t key) const { return HashVoxelKey(key); }
+  };
+
+  static constexpr size_t num_bucket_bits_{10};
+  static constexpr size_t num_buckets_{size_t(1) << num_bucket_bits_};
+  static constexpr size_t min_points_per_thread_{50000};
+  static constexpr uint64_t invalid_key_{std::numeric_limits<uint64_t>::max()};
+
   Eigen::Vector3f voxel_size_{0.05, 0.05, 0.05};
+  VoxelDownsampleMode mode_{VoxelDownsampleMode::CENTROID};
+  int num_threads_{0};
+
+  // key layout of the current input cloud, see ComputeKeyLayout
+  std::array<double, 3> inverse_voxel_size_;
+  std::array<int64_t, 3> min_index_;
+  std::array<int, 3> key_shift_;
 };
 
-} // namespace beam_filtering
\ No newline at end of file
+} // namespace beam_filtering
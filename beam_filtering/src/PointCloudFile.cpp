@@ -0,0 +1,573 @@
+#include <beam_filtering/PointCloudFile.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include <beam_utils/filesystem.h>
+#include <beam_utils/log.h>
+
+namespace beam_filtering {
+
+namespace {
+
+/** number of bytes copied at a time when assembling the output file */
+constexpr size_t k_copy_buffer_size{1 << 20};
+
+template <typename T>
+double ReadValue(const uint8_t* src) {
+  T value;
+  std::memcpy(&value, src, sizeof(T));
+  return static_cast<double>(value);
+}
+
+template <typename T>
+void WriteValue(double value, uint8_t* dst) {
+  T v = static_cast<T>(value);
+  std::memcpy(dst, &v, sizeof(T));
+}
+
+/**
+ * @brief get the pcl datatype of a PCD field from its SIZE and TYPE entries
+ * @return datatype, or 0 if invalid
+ */
+uint8_t GetPCDDatatype(int size, char type) {
+  if (type == 'F') {
+    if (size == 4) { return pcl::PCLPointField::FLOAT32; }
+    if (size == 8) { return pcl::PCLPointField::FLOAT64; }
+  } else if (type == 'I') {
+    if (size == 1) { return pcl::PCLPointField::INT8; }
+    if (size == 2) { return pcl::PCLPointField::INT16; }
+    if (size == 4) { return pcl::PCLPointField::INT32; }
+  } else if (type == 'U') {
+    if (size == 1) { return pcl::PCLPointField::UINT8; }
+    if (size == 2) { return pcl::PCLPointField::UINT16; }
+    if (size == 4) { return pcl::PCLPointField::UINT32; }
+  }
+  return 0;
+}
+
+/**
+ * @brief get the PCD TYPE entry of a pcl datatype
+ */
+char GetPCDType(uint8_t datatype) {
+  switch (datatype) {
+    case pcl::PCLPointField::INT8:
+    case pcl::PCLPointField::INT16:
+    case pcl::PCLPointField::INT32:
+      return 'I';
+    case pcl::PCLPointField::UINT8:
+    case pcl::PCLPointField::UINT16:
+    case pcl::PCLPointField::UINT32:
+      return 'U';
+    default:
+      return 'F';
+  }
+}
+
+/**
+ * @brief get the pcl datatype of a PLY property type
+ * @return datatype, or 0 if invalid
+ */
+uint8_t GetPLYDatatype(const std::string& type) {
+  static const std::map<std::string, uint8_t> types = {
+      {"char", pcl::PCLPointField::INT8},
+      {"int8", pcl::PCLPointField::INT8},
+      {"uchar", pcl::PCLPointField::UINT8},
+      {"uint8", pcl::PCLPointField::UINT8},
+      {"short", pcl::PCLPointField::INT16},
+      {"int16", pcl::PCLPointField::INT16},
+      {"ushort", pcl::PCLPointField::UINT16},
+      {"uint16", pcl::PCLPointField::UINT16},
+      {"int", pcl::PCLPointField::INT32},
+      {"int32", pcl::PCLPointField::INT32},
+      {"uint", pcl::PCLPointField::UINT32},
+      {"uint32", pcl::PCLPointField::UINT32},
+      {"float", pcl::PCLPointField::FLOAT32},
+      {"float32", pcl::PCLPointField::FLOAT32},
+      {"double", pcl::PCLPointField::FLOAT64},
+      {"float64", pcl::PCLPointField::FLOAT64}};
+  auto iter = types.find(type);
+  return iter == types.end() ? 0 : iter->second;
+}
+
+bool IsLittleEndian() {
+  uint16_t value = 1;
+  uint8_t first_byte;
+  std::memcpy(&first_byte, &value, 1);
+  return first_byte == 1;
+}
+
+} // namespace
+
+uint32_t GetFieldSize(uint8_t datatype) {
+  switch (datatype) {
+    case pcl::PCLPointField::INT8:
+    case pcl::PCLPointField::UINT8:
+      return 1;
+    case pcl::PCLPointField::INT16:
+    case pcl::PCLPointField::UINT16:
+      return 2;
+    case pcl::PCLPointField::INT32:
+    case pcl::PCLPointField::UINT32:
+    case pcl::PCLPointField::FLOAT32:
+      return 4;
+    case pcl::PCLPointField::FLOAT64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+void ConvertFieldValue(const uint8_t* src, uint8_t src_type, uint8_t* dst,
+                       uint8_t dst_type) {
+  if (src_type == dst_type) {
+    std::memcpy(dst, src, GetFieldSize(src_type));
+    return;
+  }
+
+  double value = 0;
+  switch (src_type) {
+    case pcl::PCLPointField::INT8:
+      value = ReadValue<int8_t>(src);
+      break;
+    case pcl::PCLPointField::UINT8:
+      value = ReadValue<uint8_t>(src);
+      break;
+    case pcl::PCLPointField::INT16:
+      value = ReadValue<int16_t>(src);
+      break;
+    case pcl::PCLPointField::UINT16:
+      value = ReadValue<uint16_t>(src);
+      break;
+    case pcl::PCLPointField::INT32:
+      value = ReadValue<int32_t>(src);
+      break;
+    case pcl::PCLPointField::UINT32:
+      value = ReadValue<uint32_t>(src);
+      break;
+    case pcl::PCLPointField::FLOAT32:
+      value = ReadValue<float>(src);
+      break;
+    case pcl::PCLPointField::FLOAT64:
+      value = ReadValue<double>(src);
+      break;
+  }
+
+  switch (dst_type) {
+    case pcl::PCLPointField::INT8:
+      WriteValue<int8_t>(value, dst);
+      break;
+    case pcl::PCLPointField::UINT8:
+      WriteValue<uint8_t>(value, dst);
+      break;
+    case pcl::PCLPointField::INT16:
+      WriteValue<int16_t>(value, dst);
+      break;
+    case pcl::PCLPointField::UINT16:
+      WriteValue<uint16_t>(value, dst);
+      break;
+    case pcl::PCLPointField::INT32:
+      WriteValue<int32_t>(value, dst);
+      break;
+    case pcl::PCLPointField::UINT32:
+      WriteValue<uint32_t>(value, dst);
+      break;
+    case pcl::PCLPointField::FLOAT32:
+      WriteValue<float>(value, dst);
+      break;
+    case pcl::PCLPointField::FLOAT64:
+      WriteValue<double>(value, dst);
+      break;
+  }
+}
+
+bool PointCloudFileReader::Open(const std::string& filename) {
+  filename_ = filename;
+  fields_.clear();
+  num_points_ = 0;
+  num_read_ = 0;
+  red_field_ = green_field_ = blue_field_ = -1;
+
+  if (file_.is_open()) { file_.close(); }
+  file_.clear();
+  file_.open(filename, std::ios::in | std::ios::binary);
+  if (!file_.is_open()) {
+    BEAM_ERROR("Unable to open point cloud file: {}", filename);
+    return false;
+  }
+
+  bool success;
+  if (beam::HasExtension(filename, ".pcd")) {
+    success = ParsePCDHeader();
+  } else if (beam::HasExtension(filename, ".ply")) {
+    success = ParsePLYHeader();
+  } else {
+    BEAM_ERROR("Invalid point cloud file extension, must be .pcd or .ply. "
+               "Input: {}",
+               filename);
+    success = false;
+  }
+  if (!success) {
+    file_.close();
+    return false;
+  }
+
+  ComputeOffsets();
+  data_start_ = file_.tellg();
+  return true;
+}
+
+bool PointCloudFileReader::ParsePCDHeader() {
+  std::vector<std::string> names;
+  std::vector<int> sizes;
+  std::vector<char> types;
+  std::vector<uint32_t> counts;
+  std::string line;
+  while (std::getline(file_, line)) {
+    if (line.empty() || line[0] == '#') { continue; }
+    std::stringstream ss(line);
+    std::string key;
+    ss >> key;
+    if (key == "FIELDS") {
+      std::string name;
+      while (ss >> name) { names.push_back(name); }
+    } else if (key == "SIZE") {
+      int size;
+      while (ss >> size) { sizes.push_back(size); }
+    } else if (key == "TYPE") {
+      char type;
+      while (ss >> type) { types.push_back(type); }
+    } else if (key == "COUNT") {
+      uint32_t count;
+      while (ss >> count) { counts.push_back(count); }
+    } else if (key == "POINTS") {
+      ss >> num_points_;
+    } else if (key == "DATA") {
+      std::string data_type;
+      ss >> data_type;
+      if (data_type == "ascii") {
+        binary_ = false;
+      } else if (data_type == "binary") {
+        binary_ = true;
+      } else {
+        BEAM_ERROR("Unsupported PCD data type '{}' in file: {}. Only ascii "
+                   "and binary are supported.",
+                   data_type, filename_);
+        return false;
+      }
+      break;
+    }
+  }
+
+  if (counts.empty()) { counts.resize(names.size(), 1); }
+  if (names.empty() || sizes.size() != names.size() ||
+      types.size() != names.size() || counts.size() != names.size()) {
+    BEAM_ERROR("Invalid PCD header in file: {}", filename_);
+    return false;
+  }
+
+  for (size_t i = 0; i < names.size(); i++) {
+    pcl::PCLPointField field;
+    field.name = names[i];
+    field.datatype = GetPCDDatatype(sizes[i], types[i]);
+    field.count = counts[i];
+    if (field.datatype == 0) {
+      BEAM_ERROR("Invalid type for field {} in PCD file: {}", names[i],
+                 filename_);
+      return false;
+    }
+    fields_.push_back(field);
+  }
+  return true;
+}
+
+bool PointCloudFileReader::ParsePLYHeader() {
+  std::string line;
+  std::getline(file_, line);
+  if (line.rfind("ply", 0) != 0) {
+    BEAM_ERROR("Invalid PLY header in file: {}", filename_);
+    return false;
+  }
+
+  // only read properties of the vertex element, which must be the first one
+  bool in_vertex = false;
+  bool vertex_read = false;
+  while (std::getline(file_, line)) {
+    if (!line.empty() && line.back() == '\r') { line.pop_back(); }
+    std::stringstream ss(line);
+    std::string key;
+    ss >> key;
+    if (key == "format") {
+      std::string format;
+      ss >> format;
+      if (format == "ascii") {
+        binary_ = false;
+      } else if (format == "binary_little_endian" && IsLittleEndian()) {
+        binary_ = true;
+      } else {
+        BEAM_ERROR("Unsupported PLY format '{}' in file: {}", format,
+                   filename_);
+        return false;
+      }
+    } else if (key == "element") {
+      std::string name;
+      ss >> name;
+      if (name == "vertex" && !vertex_read) {
+        ss >> num_points_;
+        in_vertex = true;
+        vertex_read = true;
+      } else if (!vertex_read) {
+        BEAM_ERROR("Vertex element must be the first element in PLY file: {}",
+                   filename_);
+        return false;
+      } else {
+        in_vertex = false;
+      }
+    } else if (key == "property" && in_vertex) {
+      std::string type, name;
+      ss >> type >> name;
+      if (type == "list") {
+        BEAM_ERROR("List properties are not supported for vertices in PLY "
+                   "file: {}",
+                   filename_);
+        return false;
+      }
+      pcl::PCLPointField field;
+      field.name = name;
+      field.datatype = GetPLYDatatype(type);
+      field.count = 1;
+      if (field.datatype == 0) {
+        BEAM_ERROR("Invalid type for property {} in PLY file: {}", name,
+                   filename_);
+        return false;
+      }
+      fields_.push_back(field);
+    } else if (key == "end_header") {
+      break;
+    }
+  }
+
+  if (fields_.empty()) {
+    BEAM_ERROR("No vertex properties in PLY file: {}", filename_);
+    return false;
+  }
+
+  for (size_t i = 0; i < fields_.size(); i++) {
+    if (fields_[i].datatype != pcl::PCLPointField::UINT8) { continue; }
+    if (fields_[i].name == "red") { red_field_ = i; }
+    if (fields_[i].name == "green") { green_field_ = i; }
+    if (fields_[i].name == "blue") { blue_field_ = i; }
+  }
+  return true;
+}
+
+void PointCloudFileReader::ComputeOffsets() {
+  uint32_t offset = 0;
+  for (auto& field : fields_) {
+    field.offset = offset;
+    offset += field.count * GetFieldSize(field.datatype);
+  }
+  file_record_size_ = offset;
+
+  if (red_field_ >= 0 && green_field_ >= 0 && blue_field_ >= 0) {
+    pcl::PCLPointField rgb;
+    rgb.name = "rgb";
+    rgb.datatype = pcl::PCLPointField::FLOAT32;
+    rgb.count = 1;
+    rgb.offset = offset;
+    fields_.push_back(rgb);
+    offset += 4;
+  }
+  record_size_ = offset;
+}
+
+void PointCloudFileReader::PackRGB(uint8_t* record) const {
+  if (red_field_ < 0 || green_field_ < 0 || blue_field_ < 0) { return; }
+  uint32_t rgb = (static_cast<uint32_t>(record[fields_[red_field_].offset])
+                  << 16) |
+                 (static_cast<uint32_t>(record[fields_[green_field_].offset])
+                  << 8) |
+                 static_cast<uint32_t>(record[fields_[blue_field_].offset]);
+  std::memcpy(record + file_record_size_, &rgb, sizeof(uint32_t));
+}
+
+bool PointCloudFileReader::ParseASCIILine(const std::string& line,
+                                          uint8_t* record) const {
+  // strtod is used since, unlike stream extraction, it parses the nan and inf
+  // values PCL writes for non-finite points
+  const char* token = line.c_str();
+  for (const auto& field : fields_) {
+    // the rgb field added for PLY files is not in the file
+    if (field.offset >= file_record_size_) { break; }
+    for (uint32_t c = 0; c < field.count; c++) {
+      char* token_end;
+      double value = std::strtod(token, &token_end);
+      if (token_end == token) { return false; }
+      token = token_end;
+      uint8_t* dst = record + field.offset + c * GetFieldSize(field.datatype);
+      ConvertFieldValue(reinterpret_cast<const uint8_t*>(&value),
+                        pcl::PCLPointField::FLOAT64, dst, field.datatype);
+    }
+  }
+  return true;
+}
+
+size_t PointCloudFileReader::ReadRecords(size_t max_points,
+                                         std::vector<uint8_t>& data) {
+  size_t n = std::min(max_points, num_points_ - num_read_);
+  data.resize(n * record_size_);
+  if (n == 0) { return 0; }
+
+  size_t num_parsed = 0;
+  if (binary_ && record_size_ == file_record_size_) {
+    file_.read(reinterpret_cast<char*>(data.data()), n * record_size_);
+    num_parsed = file_.gcount() / record_size_;
+  } else if (binary_) {
+    for (; num_parsed < n; num_parsed++) {
+      uint8_t* record = &data[num_parsed * record_size_];
+      if (!file_.read(reinterpret_cast<char*>(record), file_record_size_)) {
+        break;
+      }
+      PackRGB(record);
+    }
+  } else {
+    std::string line;
+    while (num_parsed < n && std::getline(file_, line)) {
+      if (line.empty() || line == "\r") { continue; }
+      uint8_t* record = &data[num_parsed * record_size_];
+      if (!ParseASCIILine(line, record)) {
+        BEAM_ERROR("Invalid line in point cloud file {}: {}", filename_, line);
+        break;
+      }
+      PackRGB(record);
+      num_parsed++;
+    }
+  }
+
+  if (num_parsed < n) {
+    BEAM_ERROR("Point cloud file {} ended after {} of {} points.", filename_,
+               num_read_ + num_parsed, num_points_);
+    num_points_ = num_read_ + num_parsed;
+  }
+  num_read_ += num_parsed;
+  data.resize(num_parsed * record_size_);
+  return num_parsed;
+}
+
+void PointCloudFileReader::Restart() {
+  file_.clear();
+  file_.seekg(data_start_);
+  num_read_ = 0;
+}
+
+PointCloudFileWriter::~PointCloudFileWriter() {
+  if (tmp_file_.is_open()) { Close(); }
+}
+
+bool PointCloudFileWriter::Open(const std::string& filename,
+                                const std::vector<pcl::PCLPointField>& fields,
+                                uint32_t record_size) {
+  if (!beam::HasExtension(filename, ".pcd")) {
+    BEAM_ERROR("Invalid output file extension, must be .pcd. Input: {}",
+               filename);
+    return false;
+  }
+  boost::filesystem::path path(filename);
+  if (!path.parent_path().empty() &&
+      !boost::filesystem::exists(path.parent_path())) {
+    BEAM_ERROR("Output directory does not exist: {}",
+               path.parent_path().string());
+    return false;
+  }
+
+  filename_ = filename;
+  tmp_filename_ = filename + ".tmp";
+  fields_ = fields;
+  record_size_ = record_size;
+  num_points_ = 0;
+  write_failed_ = false;
+  tmp_file_.open(tmp_filename_,
+                 std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!tmp_file_.is_open()) {
+    BEAM_ERROR("Unable to open file for writing: {}", tmp_filename_);
+    return false;
+  }
+  return true;
+}
+
+bool PointCloudFileWriter::WriteRecords(const std::vector<uint8_t>& data,
+                                        size_t num_points) {
+  if (data.size() < num_points * record_size_) {
+    BEAM_ERROR("Not enough data for {} records, cannot write to: {}",
+               num_points, tmp_filename_);
+    write_failed_ = true;
+    return false;
+  }
+  tmp_file_.write(reinterpret_cast<const char*>(data.data()),
+                  num_points * record_size_);
+  if (!tmp_file_.good()) {
+    BEAM_ERROR("Error writing to file: {}", tmp_filename_);
+    write_failed_ = true;
+    return false;
+  }
+  num_points_ += num_points;
+  return true;
+}
+
+bool PointCloudFileWriter::Close() {
+  tmp_file_.close();
+  if (write_failed_ || tmp_file_.fail()) {
+    BEAM_ERROR("Error writing to file: {}, not writing: {}", tmp_filename_,
+               filename_);
+    boost::filesystem::remove(tmp_filename_);
+    return false;
+  }
+
+  std::ofstream file(filename_,
+                     std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    BEAM_ERROR("Unable to open file for writing: {}", filename_);
+    return false;
+  }
+
+  // header, see http://pointclouds.org/documentation/tutorials/pcd_file_format
+  file << "# .PCD v0.7 - Point Cloud Data file format\nVERSION 0.7\nFIELDS";
+  for (const auto& field : fields_) { file << " " << field.name; }
+  file << "\nSIZE";
+  for (const auto& field : fields_) {
+    file << " " << GetFieldSize(field.datatype);
+  }
+  file << "\nTYPE";
+  for (const auto& field : fields_) {
+    file << " " << GetPCDType(field.datatype);
+  }
+  file << "\nCOUNT";
+  for (const auto& field : fields_) { file << " " << field.count; }
+  file << "\nWIDTH " << num_points_ << "\nHEIGHT 1\nVIEWPOINT 0 0 0 1 0 0 0"
+       << "\nPOINTS " << num_points_ << "\nDATA binary\n";
+
+  // copy the records from the temporary file
+  std::ifstream tmp_file(tmp_filename_, std::ios::in | std::ios::binary);
+  std::vector<char> buffer(k_copy_buffer_size);
+  size_t num_copied = 0;
+  while (tmp_file.read(buffer.data(), buffer.size()) || tmp_file.gcount()) {
+    file.write(buffer.data(), tmp_file.gcount());
+    num_copied += tmp_file.gcount();
+  }
+  bool copy_failed = tmp_file.bad() || num_copied != num_points_ * record_size_;
+  tmp_file.close();
+  boost::filesystem::remove(tmp_filename_);
+
+  file.close();
+  if (copy_failed || file.fail()) {
+    BEAM_ERROR("Error writing point cloud file: {}", filename_);
+    return false;
+  }
+  return true;
+}
+
+} // namespace beam_filtering
@@ -0,0 +1,176 @@
+#define CATCH_CONFIG_MAIN
+
+#include <limits>
+
+#include <boost/filesystem.hpp>
+#include <catch2/catch.hpp>
+#include <pcl/io/pcd_io.h>
+#include <pcl/io/ply_io.h>
+
+#include <beam_filtering/ChunkedFilter.h>
+#include <beam_utils/kdtree.h>
+
+using namespace beam_filtering;
+
+std::string GetFilePath(const std::string& filename) {
+  std::string current_file = "ChunkedFilterTest.cpp";
+  std::string filepath = __FILE__;
+  filepath.erase(filepath.end() - current_file.length(), filepath.end());
+  filepath += "test_data/" + filename;
+  return filepath;
+}
+
+// checks that each point in cloud has a distinct point in expected within a
+// small tolerance. Points near tile boundaries are filtered in different
+// tiles, so they can differ by float rounding (e.g. voxel centroids).
+bool HaveSamePoints(const PointCloud& cloud, const PointCloud& expected) {
+  if (cloud.size() != expected.size()) { return false; }
+  beam::KdTree<pcl::PointXYZ> tree(expected);
+  std::vector<bool> matched(expected.size(), false);
+  std::vector<uint32_t> ids;
+  std::vector<float> distances;
+  for (const auto& p : cloud) {
+    int n = tree.nearestKSearch(p, 5, ids, distances);
+    bool found = false;
+    for (int i = 0; i < n && !found; i++) {
+      if (distances[i] < 1e-4 && !matched[ids[i]]) {
+        matched[ids[i]] = true;
+        found = true;
+      }
+    }
+    if (!found) { return false; }
+  }
+  return true;
+}
+
+PointCloud LoadCloud() {
+  PointCloud cloud;
+  pcl::io::loadPCDFile<pcl::PointXYZ>(GetFilePath("snowy_scan.pcd"), cloud);
+  return cloud;
+}
+
+PointCloud cloud_ = LoadCloud();
+std::vector<FilterParamsType> params_vec_{
+    {FilterType::CROPBOX, {-1, -1, -1, 1, 1, 1, 0}},
+    {FilterType::DROR, {3, 0.04, 4, 0.02}},
+    {FilterType::VOXEL, {0.05, 0.05, 0.05}},
+    {FilterType::ROR, {0.05, 2}}};
+
+TEST_CASE("Test point cloud file read write") {
+  std::string tmp_dir = boost::filesystem::temp_directory_path().string();
+  std::string pcd_file = tmp_dir + "/chunked_filter_test_in.pcd";
+  std::string ply_file = tmp_dir + "/chunked_filter_test_in.ply";
+  pcl::io::savePCDFileASCII(pcd_file, cloud_);
+  pcl::io::savePLYFileBinary(ply_file, cloud_);
+
+  for (const auto& filename : {pcd_file, ply_file}) {
+    PointCloudFileReader reader;
+    REQUIRE(reader.Open(filename));
+    REQUIRE(reader.NumPoints() == cloud_.size());
+
+    // read in small batches, twice to test restarting
+    for (int pass = 0; pass < 2; pass++) {
+      reader.Restart();
+      std::vector<uint8_t> data;
+      PointCloud batch;
+      PointCloud cloud;
+      size_t n;
+      while ((n = reader.ReadRecords(1000, data)) > 0) {
+        RecordsToPointCloud(reader.GetFields(), reader.GetRecordSize(), data,
+                            n, batch);
+        cloud += batch;
+      }
+      REQUIRE(cloud.size() == cloud_.size());
+      for (size_t i = 0; i < cloud.size(); i++) {
+        REQUIRE(cloud[i].x == Approx(cloud_[i].x));
+        REQUIRE(cloud[i].y == Approx(cloud_[i].y));
+        REQUIRE(cloud[i].z == Approx(cloud_[i].z));
+      }
+    }
+  }
+
+  // write and read back with pcl
+  std::string out_file = tmp_dir + "/chunked_filter_test_out.pcd";
+  std::vector<pcl::PCLPointField> fields;
+  uint32_t record_size = GetPackedFields<pcl::PointXYZ>(fields);
+  REQUIRE(record_size == 12);
+  PointCloudFileWriter writer;
+  REQUIRE(writer.Open(out_file, fields, record_size));
+  std::vector<uint8_t> data;
+  PointCloudToRecords(cloud_, data);
+  REQUIRE(writer.WriteRecords(data, cloud_.size()));
+  REQUIRE(writer.WriteRecords(data, cloud_.size()));
+  REQUIRE(writer.Close());
+
+  PointCloud cloud;
+  REQUIRE(pcl::io::loadPCDFile<pcl::PointXYZ>(out_file, cloud) == 0);
+  REQUIRE(cloud.size() == 2 * cloud_.size());
+  for (size_t i = 0; i < cloud.size(); i++) {
+    REQUIRE(cloud[i].x == cloud_[i % cloud_.size()].x);
+    REQUIRE(cloud[i].y == cloud_[i % cloud_.size()].y);
+    REQUIRE(cloud[i].z == cloud_[i % cloud_.size()].z);
+  }
+
+  // a failed write must make the whole file fail
+  REQUIRE(writer.Open(out_file, fields, record_size));
+  REQUIRE(writer.WriteRecords(data, cloud_.size()));
+  REQUIRE_FALSE(writer.WriteRecords(data, cloud_.size() + 1));
+  REQUIRE_FALSE(writer.Close());
+
+  boost::filesystem::remove(pcd_file);
+  boost::filesystem::remove(ply_file);
+  boost::filesystem::remove(out_file);
+}
+
+TEST_CASE("Test chunked filter matches filtering the full cloud") {
+  std::string tmp_dir = boost::filesystem::temp_directory_path().string();
+  std::string in_file = tmp_dir + "/chunked_filter_test_in.pcd";
+  std::string out_file = tmp_dir + "/chunked_filter_test_out.pcd";
+  pcl::io::savePCDFileBinary(in_file, cloud_);
+
+  PointCloud expected = FilterPointCloud(cloud_, params_vec_);
+  REQUIRE(expected.size() > 0);
+
+  // small tiles and batches so that most points are in several tiles
+  for (double tile_size : {0.5, 2.0, 100.0}) {
+    ChunkedFilter<pcl::PointXYZ> filter(params_vec_, tile_size, 5000);
+    REQUIRE(filter.Filter(in_file, out_file));
+    REQUIRE(filter.GetMargin() > 0);
+
+    PointCloud filtered;
+    REQUIRE(pcl::io::loadPCDFile<pcl::PointXYZ>(out_file, filtered) == 0);
+    REQUIRE(HaveSamePoints(filtered, expected));
+  }
+
+  boost::filesystem::remove(in_file);
+  boost::filesystem::remove(out_file);
+}
+
+TEST_CASE("Test chunked filter drops non-finite points in ascii files") {
+  std::string tmp_dir = boost::filesystem::temp_directory_path().string();
+  std::string in_file = tmp_dir + "/chunked_filter_test_in.pcd";
+  std::string out_file = tmp_dir + "/chunked_filter_test_out.pcd";
+
+  // pcl writes the non-finite point as nan values in the middle of the file
+  PointCloud cloud_nan = cloud_;
+  float nan = std::numeric_limits<float>::quiet_NaN();
+  cloud_nan.insert(cloud_nan.begin() + cloud_nan.size() / 2,
+                   pcl::PointXYZ(nan, nan, nan));
+  cloud_nan.is_dense = false;
+  pcl::io::savePCDFileASCII(in_file, cloud_nan);
+
+  PointCloudFileReader reader;
+  REQUIRE(reader.Open(in_file));
+  std::vector<uint8_t> data;
+  REQUIRE(reader.ReadRecords(cloud_nan.size(), data) == cloud_nan.size());
+
+  PointCloud expected = FilterPointCloud(cloud_, params_vec_);
+  ChunkedFilter<pcl::PointXYZ> filter(params_vec_, 2.0, 5000);
+  REQUIRE(filter.Filter(in_file, out_file));
+  PointCloud filtered;
+  REQUIRE(pcl::io::loadPCDFile<pcl::PointXYZ>(out_file, filtered) == 0);
+  REQUIRE(HaveSamePoints(filtered, expected));
+
+  boost::filesystem::remove(in_file);
+  boost::filesystem::remove(out_file);
+}
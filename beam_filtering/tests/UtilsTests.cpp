@@ -2,14 +2,14 @@
 
 #include <catch2/catch.hpp>
 #include <nlohmann/json.hpp>
+#include <pcl/io/pcd_io.h>
 
 #include <beam_filtering/Utils.h>
 #include <beam_utils/filesystem.h>
 
 using namespace beam_filtering;
 
-std::string GetFilePath() {
-  std::string filename = "filter_params.json";
+std::string GetFilePath(const std::string& filename = "filter_params.json") {
   std::string current_file = "UtilsTests.cpp";
   std::string filepath = __FILE__;
   filepath.erase(filepath.end() - current_file.length(), filepath.end());
@@ -75,3 +75,53 @@ TEST_CASE("Test params read write with json") {
   REQUIRE(cropbox_counter == 1);
 
 }
+
+TEST_CASE("Test filter pipeline matches running each filter") {
+  PointCloudPtr cloud = std::make_shared<PointCloud>();
+  REQUIRE(pcl::io::loadPCDFile<pcl::PointXYZ>(GetFilePath("snowy_scan.pcd"),
+                                              *cloud) == 0);
+
+  std::vector<FilterParamsType> params_vec{
+      {FilterType::CROPBOX, {-20, -20, -5, 20, 20, 5, 1}},
+      {FilterType::CROPBOX, {-1, -1, -1, 1, 1, 1, 0}},
+      {FilterType::DROR, {3, 0.04, 4, 0.02}},
+      {FilterType::ROR, {0.03, 3}},
+      {FilterType::VOXEL, {0.05, 0.05, 0.05}},
+      {FilterType::ROR, {0.05, 2}}};
+
+  PointCloud expected = *cloud;
+  for (const auto& [type, params] : params_vec) {
+    PointCloudPtr input = std::make_shared<PointCloud>(expected);
+    if (type == FilterType::CROPBOX) {
+      CropBox<pcl::PointXYZ> filter = GetCropBox<pcl::PointXYZ>(params);
+      filter.SetInputCloud(input);
+      filter.Filter();
+      expected = filter.GetFilteredCloud();
+    } else if (type == FilterType::DROR) {
+      DROR<pcl::PointXYZ> filter(params[0], params[1], params[2], params[3]);
+      filter.SetInputCloud(input);
+      filter.Filter();
+      expected = filter.GetFilteredCloud();
+    } else if (type == FilterType::ROR) {
+      ROR<pcl::PointXYZ> filter(params[0], params[1]);
+      filter.SetInputCloud(input);
+      filter.Filter();
+      expected = filter.GetFilteredCloud();
+    } else if (type == FilterType::VOXEL) {
+      VoxelDownsample<pcl::PointXYZ> filter(
+          Eigen::Vector3f(params[0], params[1], params[2]));
+      filter.SetInputCloud(input);
+      filter.Filter();
+      expected = filter.GetFilteredCloud();
+    }
+    REQUIRE(expected.size() > 0);
+  }
+
+  PointCloud filtered = FilterPointCloud(*cloud, params_vec);
+  REQUIRE(filtered.size() == expected.size());
+  for (size_t i = 0; i < filtered.size(); i++) {
+    REQUIRE(filtered[i].x == expected[i].x);
+    REQUIRE(filtered[i].y == expected[i].y);
+    REQUIRE(filtered[i].z == expected[i].z);
+  }
+}
@@ -1,5 +1,8 @@
 #define CATCH_CONFIG_MAIN
 
+#include <array>
+#include <map>
+
 #include <boost/filesystem.hpp>
 #include <catch2/catch.hpp>
 #include <pcl/io/pcd_io.h>
@@ -80,4 +83,85 @@ TEST_CASE("Testing voxeldownsample pointcloud I/O w/ real scan and generated "
   REQUIRE(uniform_output_cloud.points.size() /
               uniform_input_cloud_ptr->points.size() <
           .1);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Testing voxeldownsample centroids and first points") {
+  PointCloudPtr input_cloud_ptr = GetPCD();
+  Eigen::Vector3f voxel_size(.5, .5, .5);
+
+  // compute the centroid of each voxel and order the voxels by first point
+  std::map<std::array<int64_t, 3>, std::pair<Eigen::Vector3d, int>> voxels;
+  std::vector<std::array<int64_t, 3>> voxel_order;
+  for (const auto& p : *input_cloud_ptr) {
+    if (!pcl::isFinite(p)) { continue; }
+    std::array<int64_t, 3> key{
+        static_cast<int64_t>(std::floor(p.x / voxel_size[0])),
+        static_cast<int64_t>(std::floor(p.y / voxel_size[1])),
+        static_cast<int64_t>(std::floor(p.z / voxel_size[2]))};
+    auto iter = voxels.find(key);
+    if (iter == voxels.end()) {
+      voxel_order.push_back(key);
+      iter = voxels.emplace(key, std::make_pair(Eigen::Vector3d::Zero(), 0))
+                 .first;
+    }
+    iter->second.first += Eigen::Vector3d(p.x, p.y, p.z);
+    iter->second.second++;
+  }
+
+  beam_filtering::VoxelDownsample<> downsampler(voxel_size);
+  downsampler.SetInputCloud(input_cloud_ptr);
+  downsampler.SetNumThreads(1);
+  REQUIRE(downsampler.Filter());
+  PointCloud output_single_thread = downsampler.GetFilteredCloud();
+  downsampler.SetNumThreads(4);
+  REQUIRE(downsampler.Filter());
+  PointCloud output = downsampler.GetFilteredCloud();
+
+  REQUIRE(output.size() == voxels.size());
+  REQUIRE(output_single_thread.size() == voxels.size());
+  for (size_t i = 0; i < voxel_order.size(); i++) {
+    const auto& [sum, count] = voxels.at(voxel_order[i]);
+    Eigen::Vector3d centroid = sum / count;
+    REQUIRE(output[i].x == Approx(centroid[0]).margin(1e-4));
+    REQUIRE(output[i].y == Approx(centroid[1]).margin(1e-4));
+    REQUIRE(output[i].z == Approx(centroid[2]).margin(1e-4));
+    REQUIRE(output[i].x == output_single_thread[i].x);
+    REQUIRE(output[i].y == output_single_thread[i].y);
+    REQUIRE(output[i].z == output_single_thread[i].z);
+  }
+
+  // first point mode should keep a subset of the input, in input order
+  downsampler.SetMode(beam_filtering::VoxelDownsampleMode::FIRST_POINT);
+  REQUIRE(downsampler.Filter());
+  PointCloud first_points = downsampler.GetFilteredCloud();
+  REQUIRE(first_points.size() == voxels.size());
+  size_t input_id = 0;
+  for (const auto& p : first_points) {
+    while (input_id < input_cloud_ptr->size() &&
+           (input_cloud_ptr->at(input_id).x != p.x ||
+            input_cloud_ptr->at(input_id).y != p.y ||
+            input_cloud_ptr->at(input_id).z != p.z)) {
+      input_id++;
+    }
+    REQUIRE(input_id < input_cloud_ptr->size());
+  }
+}
+
+TEST_CASE("Testing voxeldownsample with more voxels than fit in 32 bits") {
+  // 2e6 x 1e6 x 2e4 voxels in the bounding box
+  PointCloudPtr input_cloud_ptr = std::make_shared<PointCloud>();
+  for (int i = 0; i < 1000; i++) {
+    input_cloud_ptr->push_back(pcl::PointXYZ(i * 100 + 0.02, -i * 50, i));
+    input_cloud_ptr->push_back(pcl::PointXYZ(i * 100 + 0.03, -i * 50, i));
+  }
+
+  beam_filtering::VoxelDownsample<> downsampler(Eigen::Vector3f(.05, .05, .05));
+  downsampler.SetInputCloud(input_cloud_ptr);
+  REQUIRE(downsampler.Filter());
+  PointCloud output = downsampler.GetFilteredCloud();
+  REQUIRE(output.size() == 1000);
+  for (int i = 0; i < 1000; i++) {
+    REQUIRE(output[i].x == Approx(i * 100 + 0.025).margin(0.01));
+    REQUIRE(output[i].y == Approx(-i * 50));
+  }
+}
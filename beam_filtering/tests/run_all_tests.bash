@@ -5,4 +5,5 @@ cd ./beam_filtering/
 ./beam_filtering_cropbox_tests
 ./beam_filtering_dror_tests
 ./beam_filtering_voxeldownsample_tests
-./beam_filtering_utils_tests
\ No newline at end of file
+./beam_filtering_utils_tests
+./beam_filtering_chunked_filter_tests
\ No newline at end of file
@@ -0,0 +1,163 @@
+/** @file
+ * @ingroup matching
+ *
+ * The is an implementation of Lidar Odometry and Mapping (LOAM). See the
+ * following papers:
+ *
+ *    Zhang, J., & Singh, S. (2014). LOAM : Lidar Odometry and Mapping in
+ * Real-time. Robotics: Science and Systems.
+ * https://doi.org/10.1007/s10514-016-9548-2
+ *
+ *    Zhang, J., & Singh, S. (2018). Laser–visual–inertial odometry and mapping
+ * with high robustness and low drift. Journal of Field Robotics, 35(8),
+ * 1242–1264. https://doi.org/10.1002/rob.21809
+ *
+ * This code was derived from the following repos:
+ *
+ *    https://github.com/laboshinl/loam_velodyne
+ *
+ *    https://github.com/libing64/lidar_pose_estimator
+ *
+ *    https://github.com/TixiaoShan/LIO-SAM
+ *
+ */
+
+#pragma once
+
+#include <beam_matching/Matcher.h>
+#include <beam_matching/loam/LoamParams.h>
+#include <beam_matching/loam/LoamPointCloud.h>
+#include <beam_matching/loam/LoamScanRegistration.h>
+#include <beam_matching/loam/LoamVoxelMap.h>
+
+namespace beam_matching {
+/** @addtogroup matching
+ *  @{ */
+
+/**
+ * @brief derived Matcher class which registers scans against a local map of
+ * loam features instead of a single reference scan. The local map is stored in
+ * a LoamVoxelMap: each registered scan is inserted into the map and voxels
+ * further than map_radius_m from the latest scan are removed, so the cost of
+ * each registration depends on the size of the local map and not on how many
+ * scans have been added.
+ *
+ * Usage through the Matcher interface: SetRef sets the first scan of the map
+ * (which defines the map frame), then call SetTarget and Match for each new
+ * scan. Each successful match adds the target to the map. Alternatively, call
+ * AddScan for each scan.
+ */
+class LoamMapMatcher : public Matcher<LoamPointCloudPtr> {
+public:
+  using Params = LoamParams;
+
+  LoamMapMatcher();
+
+  explicit LoamMapMatcher(const LoamParams& params);
+
+  ~LoamMapMatcher() = default;
+
+  /**
+   * @brief sets the parameters for the matcher. This will clear the map.
+   * @param params - LoamParams
+   */
+  void SetParams(const LoamParams& params);
+
+  /**
+   * @brief clears the map and inserts ref as the first scan. The map frame is
+   * set to the ref scan frame.
+   * @param ref - loam pointcloud
+   */
+  void SetRef(const LoamPointCloudPtr& ref) override;
+
+  /**
+   * @brief sets the target scan to be registered against the map on the next
+   * call to Match()
+   * @param target - loam pointcloud in its own scan frame
+   */
+  void SetTarget(const LoamPointCloudPtr& target) override;
+
+  /**
+   * @brief sets the initial estimate of the target scan pose for the next
+   * call to Match(). If not set, the last registered scan pose is used.
+   * @param T_MAP_TGT initial guess of the transform from target to map frame
+   */
+  void SetInitialGuess(const Eigen::Matrix4d& T_MAP_TGT);
+
+  /**
+   * @brief registers the target scan against the local map. If successful,
+   * the target is inserted into the map and voxels far from the target pose
+   * are removed.
+   * @return true if successful
+   */
+  bool Match() override;
+
+  /**
+   * @brief convenience function for incremental mapping. If the map is empty,
+   * the scan is added with the initial pose, otherwise it is registered
+   * against the map and added with the refined pose.
+   * @param scan - loam pointcloud in its own scan frame
+   * @param T_MAP_SCAN_init initial guess of the scan pose
+   * @return true if the scan was added to the map
+   */
+  bool AddScan(const LoamPointCloudPtr& scan,
+               const Eigen::Matrix4d& T_MAP_SCAN_init);
+
+  /**
+   * @brief get pose of the last registered scan
+   * @return T_MAP_SCAN
+   */
+  Eigen::Matrix4d GetT_MAP_SCAN() const { return T_MAP_TGT_; }
+
+  /**
+   * @brief get a copy of the current local map (in the map frame)
+   */
+  LoamPointCloudPtr GetMap() { return map_.GetLoamPointCloud(); }
+
+  /**
+   * @brief get the number of voxels currently stored in the local map
+   */
+  size_t NumVoxels() const { return map_.NumVoxels(); }
+
+  /**
+   * @brief clears the local map
+   */
+  void Reset();
+
+  /**
+   * @brief gets the parameters for the matcher
+   * @return LoamParams
+   */
+  LoamParamsPtr GetParams() { return params_; }
+
+  /**
+   * @brief see matcher.h for details. The map is searched through its KD
+   * trees during registration, so it is saved separately as prefix_map.pcd
+   * (this includes the last registered scan).
+   */
+  void SaveResults(const std::string& output_dir,
+                   const std::string& prefix = "cloud") override;
+
+private:
+  /**
+   * @brief Uses covariance estimate from Ceres
+   */
+  void CalculateCovariance() override;
+
+  /**
+   * @brief inserts the target into the map using T_MAP_TGT_ and removes
+   * voxels outside the local map radius
+   */
+  void UpdateMap();
+
+  LoamPointCloudPtr target_;
+  LoamParamsPtr params_;
+  LoamVoxelMap map_;
+
+  Eigen::Matrix4d T_MAP_TGT_{Eigen::Matrix4d::Identity()};
+
+  std::unique_ptr<LoamScanRegistration> loam_scan_registration_;
+};
+
+/** @} group matching */
+} // namespace beam_matching
@@ -69,6 +69,10 @@ template <typename T>
 class Matcher {
 public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /** sensor data type used by the matcher */
+  using DataType = T;
+
   /**
    * @brief This constructor takes an argument in order to adjust how much
    * downsampling is done before matching is attempted. Pointclouds are
@@ -13,3 +13,4 @@
 #include <beam_matching/GicpMatcher.h>
 #include <beam_matching/NdtMatcher.h>
 #include <beam_matching/LoamMatcher.h>
+#include <beam_matching/LoamMapMatcher.h>
@@ -7,14 +7,18 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
-#include <tuple>
+#include <vector>
 
 #include <beam_matching/Matcher.h>
-#include <beam_utils/math.h>
+#include <beam_matching/loam/LoamPointCloud.h>
 #include <beam_utils/pointclouds.h>
 
 namespace beam_matching {
@@ -22,79 +26,180 @@ namespace beam_matching {
  *  @{ */
 
 /**
- * @brief Class is templated for different matcher types
- * @tparam T matcher type
- * @tparam R matcher params type
+ * @brief Class for registering many pairs of scans in parallel, e.g., to
+ * verify loop closure candidates. Each worker thread owns a matcher and a
+ * queue of jobs. Jobs are distributed round-robin over the workers when they
+ * are submitted, and workers which run out of jobs steal from the back of the
+ * other queues so that expensive matches do not stall the batch.
+ *
+ * Clouds are shared between jobs and the matchers only read them, so the same
+ * cloud can be submitted in many jobs at once. Clouds must not be modified
+ * until all jobs using them have finished.
+ *
+ * @tparam MatcherT matcher type, one of IcpMatcher, GicpMatcher, NdtMatcher or
+ * LoamMatcher
  */
-template <typename T, typename R>
+template <typename MatcherT>
 class MultiMatcher {
 public:
-  MultiMatcher(int n_threads = std::thread::hardware_concurrency(),
-               int queue_s = 10, R params = R())
-      : n_thread(n_threads), queue_size(queue_s), config(params) {
-    this->stop = false;
-    this->remaining_matches = 0;
-    this->InitPool(params);
-  }
+  using DataType = typename MatcherT::DataType;
+  using Params = typename MatcherT::Params;
+
+  /**
+   * @brief Result of a single job
+   */
+  struct Result {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    /// id given to Submit
+    int id;
+
+    /// true if the matcher converged
+    bool successful{false};
+
+    /// transform from target to reference frame
+    Eigen::Matrix4d T_REF_TGT{Eigen::Matrix4d::Identity()};
+
+    /// covariance of the match (see Matcher::GetCovariance). Identity if
+    /// covariances are not computed
+    Eigen::Matrix<double, 6, 6> covariance{
+        Eigen::Matrix<double, 6, 6>::Identity()};
+
+    /// time between submitting the job and a worker starting it
+    double queue_time_s{0};
+
+    /// time taken by the matcher, including the covariance estimate
+    double match_time_s{0};
 
+    /// id of the worker thread which ran the job
+    int worker_id{0};
+  };
+
+  /**
+   * @brief constructor which starts the worker threads
+   * @param params params for the matcher of each worker
+   * @param num_threads number of worker threads. If <= 0, this will use all
+   * hardware threads
+   * @param compute_covariance set to true to compute the covariance of each
+   * match
+   */
+  explicit MultiMatcher(const Params& params = Params(), int num_threads = 0,
+                        bool compute_covariance = false);
+
+  /**
+   * @brief destructor. Waits for all submitted jobs to finish, then stops the
+   * worker threads
+   */
   ~MultiMatcher();
 
+  MultiMatcher(const MultiMatcher&) = delete;
+
+  MultiMatcher& operator=(const MultiMatcher&) = delete;
+
+  /**
+   * @brief submit a pair of scans to be matched
+   * @param id id returned with the result
+   * @param ref reference scan
+   * @param tgt target scan, in its own frame
+   * @param T_REF_TGT_init initial guess of the transform from target to
+   * reference frame. The target is transformed by it (into a copy) before
+   * matching, see Matcher::SetRef
+   * @return future which will hold the result of the job
+   */
+  std::future<Result> Submit(
+      int id, DataType ref, DataType tgt,
+      const Eigen::Matrix4d& T_REF_TGT_init = Eigen::Matrix4d::Identity());
+
   /**
-   * @brief inserts a pair of scans into the queue to be matched. The resulting
-   * transform is the transform used to map
-   * the source pointcloud to the target pointcloud
-   * @param id for result
-   * @param source pointcloud
-   * @param target pointcloud
+   * @brief block until all submitted jobs have finished
    */
-  void Insert(const int& id, const PointCloudPtr& src,
-              const PointCloudPtr& target);
+  void WaitAll();
 
   /**
-   * @brief Checks to see if there are any remaining matches in the queue.
-   * @return bool
+   * @brief get the number of jobs which have been submitted but not finished
    */
-  bool Done();
+  size_t NumPending() const { return num_pending_; }
 
   /**
-   * @brief Gets a result at the start of the queue. Will block until a result
-   * is ready if the output buffer is empty but there are matches pending.
-   * @param id id of result
-   * @param transform result
-   * @param info information matrix of match
-   * @return true if result has been output, false if the output queue is
-   * empty and there are no matches pending
+   * @brief get the number of worker threads
    */
-  bool GetResult(int* id, Eigen::Affine3d* transform,
-                 Eigen::Matrix<double, 6, 6>* info);
+  int GetNumThreads() const { return static_cast<int>(workers_.size()); }
 
 private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Job {
+    int id;
+    DataType ref;
+    DataType tgt;
+    Eigen::Matrix4d T_REF_TGT_init{Eigen::Matrix4d::Identity()};
+    Clock::time_point submit_time;
+    std::promise<Result> promise;
+  };
+
+  struct Worker {
+    std::unique_ptr<MatcherT> matcher;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::thread thread;
+  };
+
   /**
    * @brief Function run by each worker thread
-   * @param threadid pair of clouds to match
+   * @param worker_id index of the worker
    */
-  void Spin(int threadid);
-  void InitPool(R params);
-
-  const int n_thread;
-  const int queue_size;
-  int remaining_matches;
-  R config;
-  std::queue<std::tuple<int, PointCloudPtr, PointCloudPtr>> input;
-  std::queue<std::tuple<int, Eigen::Affine3d, Eigen::Matrix<double, 6, 6>>>
-      output;
-  std::vector<std::thread> pool;
-  std::vector<T, Eigen::aligned_allocator<T>> matchers;
-
-  // Synchronization
-  std::mutex ip_mutex;
-  std::mutex op_mutex;
-  std::mutex cnt_mutex;
-  std::condition_variable ip_condition;
-  std::condition_variable op_condition;
-  bool stop;
+  void Spin(int worker_id);
+
+  /**
+   * @brief pop the next job from the front of the worker's own queue, or
+   * steal one from the back of another worker's queue
+   * @return true if a job was found
+   */
+  bool GetJob(int worker_id, Job& job);
+
+  /**
+   * @brief run a job on the worker's matcher and fulfill its promise
+   */
+  void RunJob(int worker_id, Job& job);
+
+  /**
+   * @brief get a copy of the target transformed by T_REF_TGT_init
+   */
+  static PointCloudPtr TransformTarget(const PointCloudPtr& tgt,
+                                       const Eigen::Matrix4d& T_REF_TGT_init);
+
+  static LoamPointCloudPtr
+      TransformTarget(const LoamPointCloudPtr& tgt,
+                      const Eigen::Matrix4d& T_REF_TGT_init);
+
+  /**
+   * @brief prepare a reference scan to be read by several matchers at once.
+   * Loam registration lazily builds KD trees on the reference features, so
+   * these are built once before the job is queued.
+   */
+  static void PrepareRef(const PointCloudPtr& /*ref*/) {}
+
+  static void PrepareRef(const LoamPointCloudPtr& ref);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  bool compute_covariance_;
+  std::atomic<size_t> next_worker_{0};
+
+  // number of jobs in the worker queues, and submitted jobs not yet finished.
+  // Both are incremented while holding state_mutex_ so that waiting threads
+  // are always woken up
+  std::atomic<size_t> num_queued_{0};
+  std::atomic<size_t> num_pending_{0};
+  bool stop_{false};
+  std::mutex state_mutex_;
+  std::condition_variable work_condition_;
+  std::condition_variable done_condition_;
+
+  // serializes PrepareRef for refs submitted from several threads
+  std::mutex prepare_mutex_;
 };
 
+/** @} group matching */
 } // namespace beam_matching
 
 #include <beam_matching/MultiMatcherImpl.hpp>
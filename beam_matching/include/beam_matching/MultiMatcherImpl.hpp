@@ -1,94 +1,173 @@
 #pragma once
 
-#include <iostream>
+#include <algorithm>
+#include <exception>
 
 namespace beam_matching {
 
-template <class T, class R>
-MultiMatcher<T, R>::~MultiMatcher() {
-    // Destroy all the workers
-    this->stop = true;
-    this->ip_condition.notify_all();
-    for (int id = 0; id < this->n_thread; ++id) {
-        this->pool.at(id).join();
-    }
+template <class MatcherT>
+MultiMatcher<MatcherT>::MultiMatcher(const Params& params, int num_threads,
+                                     bool compute_covariance)
+    : compute_covariance_(compute_covariance) {
+  if (num_threads <= 0) {
+    num_threads = std::max<int>(1, std::thread::hardware_concurrency());
+  }
+  for (int i = 0; i < num_threads; i++) {
+    workers_.emplace_back(std::make_unique<Worker>());
+    workers_.back()->matcher = std::make_unique<MatcherT>(params);
+  }
+  // start threads only once all workers exist, since they steal from each
+  // other
+  for (int i = 0; i < num_threads; i++) {
+    workers_[i]->thread = std::thread(&MultiMatcher<MatcherT>::Spin, this, i);
+  }
 }
 
-template <class T, class R>
-void MultiMatcher<T, R>::InitPool(R params) {
-    this->config = params;
-    for (int i = 0; i < this->n_thread; i++) {
-        this->matchers.emplace_back(T(R(this->config)));
-        this->pool.emplace_back(
-          std::thread(&MultiMatcher<T, R>::Spin, this, i));
-    }
+template <class MatcherT>
+MultiMatcher<MatcherT>::~MultiMatcher() {
+  {
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    stop_ = true;
+  }
+  work_condition_.notify_all();
+  for (auto& worker : workers_) { worker->thread.join(); }
+}
+
+template <class MatcherT>
+std::future<typename MultiMatcher<MatcherT>::Result>
+    MultiMatcher<MatcherT>::Submit(int id, DataType ref, DataType tgt,
+                                   const Eigen::Matrix4d& T_REF_TGT_init) {
+  {
+    std::unique_lock<std::mutex> lock(prepare_mutex_);
+    PrepareRef(ref);
+  }
+
+  Job job;
+  job.id = id;
+  job.ref = std::move(ref);
+  job.tgt = std::move(tgt);
+  job.T_REF_TGT_init = T_REF_TGT_init;
+  job.submit_time = Clock::now();
+  std::future<Result> future = job.promise.get_future();
+
+  Worker& worker = *workers_[next_worker_++ % workers_.size()];
+  {
+    // the job is counted before it is visible to other workers so that
+    // num_queued_ never underflows
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    num_queued_++;
+    num_pending_++;
+    std::unique_lock<std::mutex> worker_lock(worker.mutex);
+    worker.jobs.push_back(std::move(job));
+  }
+  work_condition_.notify_one();
+  return future;
+}
+
+template <class MatcherT>
+void MultiMatcher<MatcherT>::WaitAll() {
+  std::unique_lock<std::mutex> lock(state_mutex_);
+  done_condition_.wait(lock, [this]() { return num_pending_ == 0; });
 }
 
-template <class T, class R>
-void MultiMatcher<T, R>::Spin(int threadid) {
-    std::tuple<int, PointCloudPtr, PointCloudPtr> val;
-    while (true) {
-        {
-            std::unique_lock<std::mutex> lock(this->ip_mutex);
-            while (!this->stop && this->input.empty()) {
-                this->ip_condition.wait(lock);
-            }
-            if (this->stop) {
-                return;
-            }
-            val = this->input.front();
-            this->input.pop();
-            lock.unlock();
-            this->ip_condition.notify_one();
-        }
-        this->matchers.at(threadid).SetRef(std::get<1>(val));
-        this->matchers.at(threadid).SetTarget(std::get<2>(val));
-        this->matchers.at(threadid).Match();
-        this->matchers.at(threadid).EstimateInfo();
-        {
-            std::unique_lock<std::mutex> lockop(this->op_mutex);
-            this->output.emplace(std::get<0>(val),
-                                 this->matchers.at(threadid).GetResult(),
-                                 this->matchers.at(threadid).GetInfo());
-            {
-                std::unique_lock<std::mutex> lockcnt(this->cnt_mutex);
-                --(this->remaining_matches);
-            }
-            lockop.unlock();
-            this->op_condition.notify_one();
-        }
+template <class MatcherT>
+void MultiMatcher<MatcherT>::Spin(int worker_id) {
+  Job job;
+  while (true) {
+    if (GetJob(worker_id, job)) {
+      RunJob(worker_id, job);
+      {
+        std::unique_lock<std::mutex> lock(state_mutex_);
+        num_pending_--;
+      }
+      done_condition_.notify_all();
+      continue;
     }
+
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    work_condition_.wait(lock,
+                         [this]() { return stop_ || num_queued_ > 0; });
+    if (stop_ && num_queued_ == 0) { return; }
+  }
 }
 
-template <class T, class R>
-void MultiMatcher<T, R>::Insert(const int &id,
-                                const PointCloudPtr &src,
-                                const PointCloudPtr &target) {
-    {
-        std::unique_lock<std::mutex> lock(this->ip_mutex);
-        while (this->input.size() >= static_cast<size_t>(this->queue_size)) {
-            this->ip_condition.wait(lock);
-        }
-        this->input.emplace(id, src, target);
-        {
-            std::unique_lock<std::mutex> lockcnt(this->cnt_mutex);
-            ++(this->remaining_matches);
-        }
-        lock.unlock();
-        this->ip_condition.notify_one();
+template <class MatcherT>
+bool MultiMatcher<MatcherT>::GetJob(int worker_id, Job& job) {
+  // own queue first, in submission order
+  {
+    Worker& worker = *workers_[worker_id];
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    if (!worker.jobs.empty()) {
+      job = std::move(worker.jobs.front());
+      worker.jobs.pop_front();
+      num_queued_--;
+      return true;
     }
+  }
+
+  // steal the most recently submitted job of another worker
+  for (size_t i = 1; i < workers_.size(); i++) {
+    Worker& victim = *workers_[(worker_id + i) % workers_.size()];
+    std::unique_lock<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      job = std::move(victim.jobs.back());
+      victim.jobs.pop_back();
+      num_queued_--;
+      return true;
+    }
+  }
+  return false;
 }
 
-template <class T, class R>
-bool MultiMatcher<T, R>::Done() {
-    {
-        std::unique_lock<std::mutex> lockcnt(this->cnt_mutex);
-        if (this->remaining_matches == 0) {
-            return true;
-        } else {
-            return false;
-        }
+template <class MatcherT>
+void MultiMatcher<MatcherT>::RunJob(int worker_id, Job& job) {
+  Clock::time_point start_time = Clock::now();
+  Result result;
+  result.id = job.id;
+  result.worker_id = worker_id;
+  result.queue_time_s =
+      std::chrono::duration<double>(start_time - job.submit_time).count();
+
+  try {
+    MatcherT& matcher = *workers_[worker_id]->matcher;
+    matcher.SetRef(job.ref);
+    if (job.T_REF_TGT_init.isIdentity()) {
+      matcher.SetTarget(job.tgt);
+    } else {
+      matcher.SetTarget(TransformTarget(job.tgt, job.T_REF_TGT_init));
     }
+    result.successful = matcher.Match();
+    result.T_REF_TGT = matcher.ApplyResult(job.T_REF_TGT_init);
+    if (compute_covariance_) { result.covariance = matcher.GetCovariance(); }
+    result.match_time_s =
+        std::chrono::duration<double>(Clock::now() - start_time).count();
+    job.promise.set_value(result);
+  } catch (...) { job.promise.set_exception(std::current_exception()); }
+
+  // release the clouds held by the job
+  job = Job();
+}
+
+template <class MatcherT>
+PointCloudPtr MultiMatcher<MatcherT>::TransformTarget(
+    const PointCloudPtr& tgt, const Eigen::Matrix4d& T_REF_TGT_init) {
+  auto tgt_in_ref = std::make_shared<PointCloud>();
+  pcl::transformPointCloud(*tgt, *tgt_in_ref, T_REF_TGT_init);
+  return tgt_in_ref;
+}
+
+template <class MatcherT>
+LoamPointCloudPtr MultiMatcher<MatcherT>::TransformTarget(
+    const LoamPointCloudPtr& tgt, const Eigen::Matrix4d& T_REF_TGT_init) {
+  return std::make_shared<LoamPointCloud>(*tgt, T_REF_TGT_init);
+}
+
+template <class MatcherT>
+void MultiMatcher<MatcherT>::PrepareRef(const LoamPointCloudPtr& ref) {
+  ref->edges.strong.BuildKDTree();
+  ref->edges.weak.BuildKDTree();
+  ref->surfaces.strong.BuildKDTree();
+  ref->surfaces.weak.BuildKDTree();
 }
 
-}  // namespace beam_matching
+} // namespace beam_matching
@@ -6,6 +6,7 @@
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -143,12 +144,39 @@ using InvKeyTree = KDTreeVectorOfVectorsAdaptor<KeyMat, float>;
 // namespace SC2
 // {
 
+// descriptor size, 20 x 60 in the original paper (IROS 18)
+constexpr int SC_NUM_RING = 20;
+constexpr int SC_NUM_SECTOR = 60;
+
+using SCDescriptor = Eigen::Matrix<float, SC_NUM_RING, SC_NUM_SECTOR>;
+using SCSectorVector = Eigen::Matrix<float, 1, SC_NUM_SECTOR>;
+
+/**
+ * Scan context stored for fast distance computation: a fixed size float
+ * descriptor (column major, so each sector is contiguous) with its sector key
+ * and per sector inverse norms precomputed. Empty sectors have an inverse norm
+ * of 0 and are not counted in valid_sectors.
+ */
+struct CompactScancontext {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  SCDescriptor desc;
+  SCSectorVector sectorkey;
+  SCSectorVector inv_sector_norms;
+  SCSectorVector valid_sectors;
+};
+
+using CompactScancontexts =
+    std::vector<CompactScancontext,
+                Eigen::aligned_allocator<CompactScancontext> >;
+
 void coreImportTest(void);
 
 // sc param-independent helper functions
 float xy2theta(const float& _x, const float& _y);
 MatrixXd circshift(MatrixXd& _mat, int _num_shift);
 std::vector<float> eig2stdvec(MatrixXd _eigmat);
+CompactScancontext makeCompactScancontext(const Eigen::MatrixXd& _desc);
 
 class SCManager {
 public:
@@ -168,6 +196,16 @@ public:
       MatrixXd& _sc1,
       MatrixXd& _sc2); // "D" (eq 6) in the original paper (IROS 18)
 
+  // same as above for compact descriptors, without allocating shifted copies.
+  // _num_shift circularly shifts the columns of _sc2 to the right
+  int fastAlignUsingVkey(const CompactScancontext& _sc1,
+                         const CompactScancontext& _sc2) const;
+  double distDirectSC(const CompactScancontext& _sc1,
+                      const CompactScancontext& _sc2, int _num_shift) const;
+  std::pair<double, int>
+      distanceBtnScanContext(const CompactScancontext& _sc1,
+                             const CompactScancontext& _sc2) const;
+
   // User-side API
   void makeAndSaveScancontextAndKeys(pcl::PointCloud<SCPointType>& _scan_down);
 
@@ -187,8 +225,8 @@ public:
            // the lidar local coord (not robot base coord) / if you use
            // robot-coord-transformed lidar scans, just set this as 0.
 
-  const int PC_NUM_RING = 20;   // 20 in the original paper (IROS 18)
-  const int PC_NUM_SECTOR = 60; // 60 in the original paper (IROS 18)
+  static constexpr int PC_NUM_RING = SC_NUM_RING;
+  static constexpr int PC_NUM_SECTOR = SC_NUM_SECTOR;
   const double PC_MAX_RADIUS =
       80.0; // 80 meter max in the original paper (IROS 18)
   const double PC_UNIT_SECTORANGLE = 360.0 / double(PC_NUM_SECTOR);
@@ -221,14 +259,20 @@ public:
 
   // data
   std::vector<double> polarcontexts_timestamp_; // optional.
-  std::vector<Eigen::MatrixXd> polarcontexts_;
-  std::vector<Eigen::MatrixXd> polarcontext_invkeys_;
-  std::vector<Eigen::MatrixXd> polarcontext_vkeys_;
+  CompactScancontexts polarcontexts_;
 
   KeyMat polarcontext_invkeys_mat_;
   KeyMat polarcontext_invkeys_to_search_;
   std::unique_ptr<InvKeyTree> polarcontext_tree_;
 
+private:
+  // rebuilds the ringkey tree if needed, then returns the distance to the
+  // nearest candidate, its index and its alignment (shift)
+  double findNearestCandidate(const std::vector<float>& _curr_key,
+                              const CompactScancontext& _curr_desc,
+                              size_t _num_exclude_recent, int& _nn_idx,
+                              int& _nn_align);
+
 }; // SCManager
 
 // } // namespace SC2
@@ -118,6 +118,20 @@ public:
     output_ceres_summary = J["output_ceres_summary"];
     output_optimization_summary = J["output_optimization_summary"];
 
+    // optional params, default to serial correspondence search
+    if (J.contains("correspondence_threads")) {
+      correspondence_threads = J["correspondence_threads"];
+    }
+
+    // optional params only used by LoamMapMatcher
+    if (J.contains("map_voxel_size_m")) {
+      map_voxel_size_m = J["map_voxel_size_m"];
+    }
+    if (J.contains("map_radius_m")) { map_radius_m = J["map_radius_m"]; }
+    if (J.contains("map_max_points_per_voxel")) {
+      map_max_points_per_voxel = J["map_max_points_per_voxel"];
+    }
+
     if (!check_strong_features_first && ignore_weak_features) {
       BEAM_WARN(
           "If ignore_weak_features is set to true, check_strong_features_first "
@@ -216,6 +230,23 @@ public:
   /** Maximum number of times to iterate the correspondences */
   int max_correspondence_iterations{10};
 
+  /** Number of threads used to search for correspondences between the target
+   * features and reference features. Set to 1 to search serially, or <= 0 to
+   * use all available hardware threads. Results are identical regardless of
+   * the number of threads used. */
+  int correspondence_threads{1};
+
+  /** Voxel size used by LoamMapMatcher to store the local feature map */
+  double map_voxel_size_m{1.0};
+
+  /** Voxels further than this distance from the latest scan pose are removed
+   * from the LoamMapMatcher local map */
+  double map_radius_m{50.0};
+
+  /** Max number of features of each type stored per voxel in the
+   * LoamMapMatcher local map. Set to 0 to keep all features. */
+  int map_max_points_per_voxel{20};
+
   /** all params needed for ceres */
   beam_optimization::CeresParams optimizer_params;
 
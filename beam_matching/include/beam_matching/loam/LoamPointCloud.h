@@ -82,19 +82,33 @@ using LoamPointCloudCombined = pcl::PointCloud<PointLoam>;
  */
 class LoamFeatureCloud {
 public:
+  LoamFeatureCloud() = default;
+
+  /** The KD tree indexes the points of the cloud it was built from without
+   * copying them, so copies only copy the cloud and need to rebuild the tree */
+  LoamFeatureCloud(const LoamFeatureCloud& other);
+
+  LoamFeatureCloud& operator=(const LoamFeatureCloud& other);
+
+  LoamFeatureCloud(LoamFeatureCloud&& other) = default;
+
+  LoamFeatureCloud& operator=(LoamFeatureCloud&& other) = default;
+
   /** Pointcloud containing xyz coordinates of all features */
   PointCloudIRT cloud;
 
   /** KD search tree for fast searching. Will only be built when BuildKDTree is
-   * called. This will get cleared whenever TransformPointCloud is called as it
-   * would need to be recalculated. */
+   * called. This will get cleared whenever the cloud is modified through
+   * LoamPointCloud as it would need to be recalculated. Note that the tree
+   * indexes the points in cloud directly, so if cloud is modified directly,
+   * ClearKDTree must be called before searching. */
   std::shared_ptr<beam::KdTree<PointXYZIRT>> kdtree{
       std::make_shared<beam::KdTree<PointXYZIRT>>(PointCloudIRT())};
 
   /** Builds the KD search tree and sets the kdtree_empty to false */
   void BuildKDTree(bool override_tree = false);
 
-  /** Clears the KD tree and cloud */
+  /** Clears the KD tree and cloud, and unsets the dynamic KD tree */
   void Clear();
 
   /** Clears the KD tree */
@@ -103,6 +117,25 @@ public:
   /** Bool to determine if kdtree is built or not. Helps us make sure we don't
    * keep rebuilding a tree that's already built because this takes time. */
   bool kdtree_empty{true};
+
+  /** Optional dynamic KD search tree owned by an incrementally updated map
+   * (see LoamVoxelMap). If set, the features are stored in this tree instead
+   * of cloud, which stays empty, and searches use it instead of kdtree. Use
+   * NearestKSearch, GetPoint and Size to access the features either way. */
+  std::shared_ptr<const beam::DynamicKdTree<PointXYZIRT>> dynamic_kdtree;
+
+  /** Searches the dynamic kdtree if set, otherwise kdtree (see
+   * beam::KdTree::nearestKSearch). BuildKDTree must have been called if the
+   * dynamic kdtree is not set. */
+  int NearestKSearch(const PointXYZIRT& p, int k,
+                     std::vector<uint32_t>& point_ids,
+                     std::vector<float>& point_distances) const;
+
+  /** Gets a point by the id returned by NearestKSearch */
+  const PointXYZIRT& GetPoint(uint32_t id) const;
+
+  /** Gets the number of features, in cloud or in the dynamic kdtree */
+  size_t Size() const;
 };
 
 /**
@@ -132,6 +132,29 @@ private:
 
   bool GetSurfaceMeasurements();
 
+  /**
+   * @brief concatenates measurements found by each thread in thread order so
+   * that the result is the same as a serial correspondence search
+   * @param thread_measurements measurements found by each thread
+   * @param measurements output measurements, will be overwritten
+   */
+  template <typename MeasurementT>
+  void MergeMeasurements(
+      std::vector<std::vector<MeasurementT>>& thread_measurements,
+      std::vector<MeasurementT>& measurements) const {
+    if (thread_measurements.size() == 1) {
+      measurements = std::move(thread_measurements.front());
+      return;
+    }
+    size_t total_size = 0;
+    for (const auto& m : thread_measurements) { total_size += m.size(); }
+    measurements.clear();
+    measurements.reserve(total_size);
+    for (const auto& m : thread_measurements) {
+      measurements.insert(measurements.end(), m.begin(), m.end());
+    }
+  }
+
   bool Solve(int iteration);
 
   bool HasConverged(int iteration);
@@ -151,6 +174,10 @@ private:
 
   LoamParamsPtr params_;
 
+  /** don't split the correspondence search across threads if each thread
+   * would get less than this many features */
+  static constexpr size_t min_features_per_thread_{50};
+
   OptimizationSummary optimization_summary_;
 
   LoamPointCloudPtr ref_;
@@ -0,0 +1,194 @@
+/** @file
+ * @ingroup matching
+ *
+ * The is an implementation of Lidar Odometry and Mapping (LOAM). See the
+ * following papers:
+ *
+ *    Zhang, J., & Singh, S. (2014). LOAM : Lidar Odometry and Mapping in
+ * Real-time. Robotics: Science and Systems.
+ * https://doi.org/10.1007/s10514-016-9548-2
+ *
+ *    Zhang, J., & Singh, S. (2018). Laser–visual–inertial odometry and mapping
+ * with high robustness and low drift. Journal of Field Robotics, 35(8),
+ * 1242–1264. https://doi.org/10.1002/rob.21809
+ *
+ * This code was derived from the following repos:
+ *
+ *    https://github.com/laboshinl/loam_velodyne
+ *
+ *    https://github.com/libing64/lidar_pose_estimator
+ *
+ *    https://github.com/TixiaoShan/LIO-SAM
+ *
+ */
+
+#pragma once
+
+#include <unordered_map>
+
+#include <beam_matching/loam/LoamPointCloud.h>
+
+namespace beam_matching {
+/** @addtogroup matching
+ *  @{ */
+
+/**
+ * @brief class for storing a local map of loam features in a voxel hash map.
+ * The features of each type are also stored in a dynamic KD search tree, so
+ * inserting a scan only adds its features to the trees and removing voxels far
+ * from the current pose only removes their features, instead of rebuilding
+ * the trees over the whole map. The trees can be searched through
+ * GetSearchCloud.
+ */
+class LoamVoxelMap {
+public:
+  /**
+   * @brief constructor
+   * @param voxel_size_m edge length of each voxel
+   * @param max_points_per_voxel maximum number of points of each feature type
+   * that are stored per voxel. Once a voxel is full, new points of that type
+   * are discarded. Set to 0 to store all points.
+   */
+  LoamVoxelMap(double voxel_size_m = 1.0, size_t max_points_per_voxel = 20);
+
+  /** The KD trees are shared with the search cloud, so maps can be moved but
+   * not copied */
+  LoamVoxelMap(const LoamVoxelMap&) = delete;
+
+  LoamVoxelMap& operator=(const LoamVoxelMap&) = delete;
+
+  LoamVoxelMap(LoamVoxelMap&&) = default;
+
+  LoamVoxelMap& operator=(LoamVoxelMap&&) = default;
+
+  /**
+   * @brief add all features in a scan to the map. Points that are not finite
+   * or too far from the origin for their voxel index to fit in 32 bits are
+   * skipped.
+   * @param scan loam features in the scan frame
+   * @param T_MAP_SCAN transform from scan frame to map frame
+   */
+  void AddScan(const LoamPointCloud& scan,
+               const Eigen::Matrix4d& T_MAP_SCAN = Eigen::Matrix4d::Identity());
+
+  /**
+   * @brief remove all voxels whose center is further than radius_m from
+   * center
+   * @param center center of the local map, in the map frame
+   * @param radius_m radius of the local map
+   * @return number of voxels removed
+   */
+  size_t RemoveVoxelsOutsideRadius(const Eigen::Vector3d& center,
+                                   double radius_m);
+
+  /**
+   * @brief get a loam pointcloud for searching the map, e.g. as the reference
+   * cloud of LoamScanRegistration. Its feature clouds are empty and share the
+   * dynamic KD trees of this map (see LoamFeatureCloud::dynamic_kdtree), so it
+   * is updated along with the map and must not be searched while the map is
+   * modified.
+   */
+  LoamPointCloudPtr GetSearchCloud() const { return search_cloud_; }
+
+  /**
+   * @brief get a copy of all features in the map as a loam pointcloud, e.g.
+   * for saving the map. This is cached until the map changes. It is not needed
+   * for searching the map, see GetSearchCloud.
+   */
+  LoamPointCloudPtr GetLoamPointCloud();
+
+  /**
+   * @brief clear all voxels
+   */
+  void Clear();
+
+  /**
+   * @brief get the number of voxels in the map
+   */
+  size_t NumVoxels() const;
+
+  /**
+   * @brief get the total number of features in the map
+   */
+  uint64_t Size() const;
+
+  /**
+   * @brief returns true if the map contains no features
+   */
+  bool Empty() const;
+
+private:
+  /** Integer voxel indices */
+  struct VoxelKey {
+    int32_t x;
+    int32_t y;
+    int32_t z;
+
+    bool operator==(const VoxelKey& other) const {
+      return x == other.x && y == other.y && z == other.z;
+    }
+  };
+
+  struct VoxelKeyHash {
+    size_t operator()(const VoxelKey& key) const {
+      return (static_cast<size_t>(key.x) * 73856093) ^
+             (static_cast<size_t>(key.y) * 19349663) ^
+             (static_cast<size_t>(key.z) * 83492791);
+    }
+  };
+
+  /** Ids of the features stored in a single voxel, in the KD tree of each
+   * feature type */
+  struct Voxel {
+    std::vector<uint32_t> edges_strong;
+    std::vector<uint32_t> edges_weak;
+    std::vector<uint32_t> surfaces_strong;
+    std::vector<uint32_t> surfaces_weak;
+  };
+
+  using KdTree = beam::DynamicKdTree<PointXYZIRT>;
+
+  /**
+   * @brief add the points in a feature cloud to their voxels and to the KD
+   * tree of that feature type
+   * @param cloud features in the scan frame
+   * @param T_MAP_SCAN transform from scan frame to map frame
+   * @param ids member of Voxel to add the point ids to
+   * @param tree KD tree of this feature type
+   */
+  void AddFeatures(const PointCloudIRT& cloud,
+                   const Eigen::Affine3f& T_MAP_SCAN,
+                   std::vector<uint32_t> Voxel::*ids, KdTree& tree);
+
+  /**
+   * @brief get the key of the voxel containing a point
+   * @return false if the voxel index does not fit in 32 bits
+   */
+  bool GetKey(const Eigen::Vector3f& p, VoxelKey& key) const;
+
+  /**
+   * @brief get the center of a voxel from its key
+   */
+  Eigen::Vector3d GetVoxelCenter(const VoxelKey& key) const;
+
+  /**
+   * @brief make new empty KD trees and share them with the search cloud
+   */
+  void ResetTrees();
+
+  double voxel_size_m_;
+  size_t max_points_per_voxel_;
+  std::unordered_map<VoxelKey, Voxel, VoxelKeyHash> voxels_;
+
+  std::shared_ptr<KdTree> edges_strong_;
+  std::shared_ptr<KdTree> edges_weak_;
+  std::shared_ptr<KdTree> surfaces_strong_;
+  std::shared_ptr<KdTree> surfaces_weak_;
+  LoamPointCloudPtr search_cloud_;
+
+  LoamPointCloudPtr map_;
+  bool map_updated_{true};
+};
+
+/** @} group matching */
+} // namespace beam_matching
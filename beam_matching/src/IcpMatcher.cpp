@@ -454,14 +454,13 @@ void IcpMatcher::EstimateLUMold() {
   Eigen::Matrix<double, 6, 6> edgeCov = Eigen::Matrix<double, 6, 6>::Identity();
 
   // build kd tree for source points
-  beam::KdTree<pcl::PointXYZ> kdtree(*targetc);
+  beam::KdTree<pcl::PointXYZ> kdtree(targetc);
 
   // iterate through the source cloud and compute match covariance
-
+  std::vector<uint32_t> nn_idx;
+  std::vector<float> nn_sqr_dist;
   for (uint64_t i = 0; i < numSourcePts; i++) {
     pcl::PointXYZ qpt = source_trans->points[i];
-    std::vector<uint32_t> nn_idx;
-    std::vector<float> nn_sqr_dist;
     // returns the index of the nn point in the targetc
     kdtree.nearestKSearch(qpt, 1, nn_idx, nn_sqr_dist);
 
@@ -0,0 +1,100 @@
+#include <beam_matching/LoamMapMatcher.h>
+
+#include <beam_utils/log.h>
+#include <beam_utils/math.h>
+#include <beam_utils/se3.h>
+
+namespace beam_matching {
+
+LoamMapMatcher::LoamMapMatcher() : LoamMapMatcher(LoamParams()) {}
+
+LoamMapMatcher::LoamMapMatcher(const LoamParams& params)
+    : params_(std::make_shared<LoamParams>(params)),
+      map_(params.map_voxel_size_m, params.map_max_points_per_voxel) {
+  loam_scan_registration_ = std::make_unique<LoamScanRegistration>(params_);
+}
+
+void LoamMapMatcher::SetParams(const LoamParams& params) {
+  params_ = std::make_shared<LoamParams>(params);
+  map_ = LoamVoxelMap(params_->map_voxel_size_m,
+                      params_->map_max_points_per_voxel);
+  loam_scan_registration_ = std::make_unique<LoamScanRegistration>(params_);
+  Reset();
+}
+
+void LoamMapMatcher::SetRef(const LoamPointCloudPtr& ref) {
+  Reset();
+  map_.AddScan(*ref);
+}
+
+void LoamMapMatcher::SetTarget(const LoamPointCloudPtr& target) {
+  this->target_ = target;
+}
+
+void LoamMapMatcher::SetInitialGuess(const Eigen::Matrix4d& T_MAP_TGT) {
+  T_MAP_TGT_ = T_MAP_TGT;
+}
+
+bool LoamMapMatcher::Match() {
+  if (!target_) {
+    BEAM_ERROR("Target cloud not set, cannot run LoamMapMatcher.");
+    return false;
+  }
+  if (map_.Empty()) {
+    BEAM_ERROR("Local map is empty, set a reference cloud before matching.");
+    return false;
+  }
+
+  // if no initial guess was given, T_MAP_TGT_ still holds the pose of the last
+  // registered scan which is used as the initial guess
+  bool registration_successful = loam_scan_registration_->RegisterScans(
+      map_.GetSearchCloud(), target_, T_MAP_TGT_);
+  if (!registration_successful) { return false; }
+
+  T_MAP_TGT_ = loam_scan_registration_->GetT_REF_TGT();
+  result_ = Eigen::Affine3d(beam::InvertTransform(T_MAP_TGT_));
+  UpdateMap();
+  return true;
+}
+
+bool LoamMapMatcher::AddScan(const LoamPointCloudPtr& scan,
+                             const Eigen::Matrix4d& T_MAP_SCAN_init) {
+  SetTarget(scan);
+  SetInitialGuess(T_MAP_SCAN_init);
+  if (map_.Empty()) {
+    result_ = Eigen::Affine3d(beam::InvertTransform(T_MAP_TGT_));
+    UpdateMap();
+    return true;
+  }
+  return Match();
+}
+
+void LoamMapMatcher::UpdateMap() {
+  map_.AddScan(*target_, T_MAP_TGT_);
+  map_.RemoveVoxelsOutsideRadius(T_MAP_TGT_.block<3, 1>(0, 3),
+                                 params_->map_radius_m);
+}
+
+void LoamMapMatcher::Reset() {
+  map_.Clear();
+  T_MAP_TGT_ = Eigen::Matrix4d::Identity();
+}
+
+void LoamMapMatcher::SaveResults(const std::string& output_dir,
+                                 const std::string& prefix) {
+  loam_scan_registration_->SaveResults(output_dir, prefix);
+  map_.GetLoamPointCloud()->SaveCombined(output_dir, prefix + "_map.pcd", 0, 0,
+                                         255);
+}
+
+void LoamMapMatcher::CalculateCovariance() {
+  // see LoamMatcher::CalculateCovariance
+  Eigen::Matrix<double, 7, 7> covariance_full =
+      loam_scan_registration_->GetCovariance();
+  covariance_.block(0, 0, 3, 3) = covariance_full.block(4, 4, 3, 3);
+  covariance_.block(0, 3, 3, 3) = covariance_full.block(4, 1, 3, 3);
+  covariance_.block(3, 0, 3, 3) = covariance_full.block(1, 4, 3, 3);
+  covariance_.block(3, 3, 3, 3) = covariance_full.block(1, 1, 3, 3);
+}
+
+} // namespace beam_matching
@@ -49,6 +49,20 @@ std::vector<float> eig2stdvec(MatrixXd _eigmat) {
   return vec;
 } // eig2stdvec
 
+CompactScancontext makeCompactScancontext(const Eigen::MatrixXd& _desc) {
+  assert(_desc.rows() == SC_NUM_RING && _desc.cols() == SC_NUM_SECTOR);
+
+  CompactScancontext sc;
+  sc.desc = _desc.cast<float>();
+  sc.sectorkey = sc.desc.colwise().mean();
+  for (int col_idx = 0; col_idx < SC_NUM_SECTOR; col_idx++) {
+    float sector_norm = sc.desc.col(col_idx).norm();
+    sc.inv_sector_norms(col_idx) = sector_norm == 0 ? 0 : 1 / sector_norm;
+    sc.valid_sectors(col_idx) = sector_norm == 0 ? 0 : 1;
+  }
+  return sc;
+} // makeCompactScancontext
+
 double SCManager::distDirectSC(MatrixXd& _sc1, MatrixXd& _sc2) {
   int num_eff_cols = 0; // i.e., to exclude all-nonzero sector
   double sum_sector_similarity = 0;
@@ -72,14 +86,19 @@ double SCManager::distDirectSC(MatrixXd& _sc1, MatrixXd& _sc2) {
 } // distDirectSC
 
 int SCManager::fastAlignUsingVkey(MatrixXd& _vkey1, MatrixXd& _vkey2) {
+  // compare against the shifted key in place instead of using circshift
+  const int num_cols = _vkey1.cols();
   int argmin_vkey_shift = 0;
   double min_veky_diff_norm = 10000000;
-  for (int shift_idx = 0; shift_idx < _vkey1.cols(); shift_idx++) {
-    MatrixXd vkey2_shifted = circshift(_vkey2, shift_idx);
-
-    MatrixXd vkey_diff = _vkey1 - vkey2_shifted;
+  for (int shift_idx = 0; shift_idx < num_cols; shift_idx++) {
+    double cur_diff_sq = 0;
+    for (int col_idx = 0; col_idx < num_cols; col_idx++) {
+      double diff = _vkey1(0, col_idx) -
+                    _vkey2(0, (col_idx - shift_idx + num_cols) % num_cols);
+      cur_diff_sq += diff * diff;
+    }
 
-    double cur_diff_norm = vkey_diff.norm();
+    double cur_diff_norm = std::sqrt(cur_diff_sq);
     if (cur_diff_norm < min_veky_diff_norm) {
       argmin_vkey_shift = shift_idx;
       min_veky_diff_norm = cur_diff_norm;
@@ -92,19 +111,81 @@ int SCManager::fastAlignUsingVkey(MatrixXd& _vkey1, MatrixXd& _vkey2) {
 
 std::pair<double, int> SCManager::distanceBtnScanContext(MatrixXd& _sc1,
                                                          MatrixXd& _sc2) {
+  return distanceBtnScanContext(makeCompactScancontext(_sc1),
+                                makeCompactScancontext(_sc2));
+} // distanceBtnScanContext
+
+int SCManager::fastAlignUsingVkey(const CompactScancontext& _sc1,
+                                  const CompactScancontext& _sc2) const {
+  const int n = SC_NUM_SECTOR;
+  int argmin_vkey_shift = 0;
+  float min_vkey_diff_sq = std::numeric_limits<float>::max();
+  for (int shift_idx = 0; shift_idx < n; shift_idx++) {
+    float cur_diff_sq = (_sc1.sectorkey.tail(n - shift_idx) -
+                         _sc2.sectorkey.head(n - shift_idx))
+                            .squaredNorm() +
+                        (_sc1.sectorkey.head(shift_idx) -
+                         _sc2.sectorkey.tail(shift_idx))
+                            .squaredNorm();
+    if (cur_diff_sq < min_vkey_diff_sq) {
+      argmin_vkey_shift = shift_idx;
+      min_vkey_diff_sq = cur_diff_sq;
+    }
+  }
+
+  return argmin_vkey_shift;
+
+} // fastAlignUsingVkey
+
+double SCManager::distDirectSC(const CompactScancontext& _sc1,
+                               const CompactScancontext& _sc2,
+                               int _num_shift) const {
+  // column i of _sc1 is compared to column i - _num_shift (wrapped) of _sc2.
+  // The two wrapped blocks are compared directly, so the shifted descriptor
+  // is never built and the fixed size columns are vectorized by Eigen
+  const int n = SC_NUM_SECTOR;
+  const int s = _num_shift;
+  SCSectorVector sector_dots;
+  sector_dots.tail(n - s) =
+      _sc1.desc.rightCols(n - s)
+          .cwiseProduct(_sc2.desc.leftCols(n - s))
+          .colwise()
+          .sum();
+  sector_dots.head(s) = _sc1.desc.leftCols(s)
+                            .cwiseProduct(_sc2.desc.rightCols(s))
+                            .colwise()
+                            .sum();
+
+  float sum_sector_similarity =
+      sector_dots.tail(n - s)
+          .cwiseProduct(_sc1.inv_sector_norms.tail(n - s))
+          .dot(_sc2.inv_sector_norms.head(n - s)) +
+      sector_dots.head(s)
+          .cwiseProduct(_sc1.inv_sector_norms.head(s))
+          .dot(_sc2.inv_sector_norms.tail(s));
+  float num_eff_cols =
+      _sc1.valid_sectors.tail(n - s).dot(_sc2.valid_sectors.head(n - s)) +
+      _sc1.valid_sectors.head(s).dot(_sc2.valid_sectors.tail(s));
+
+  double sc_sim = sum_sector_similarity / num_eff_cols;
+  return 1.0 - sc_sim;
+
+} // distDirectSC
+
+std::pair<double, int>
+    SCManager::distanceBtnScanContext(const CompactScancontext& _sc1,
+                                      const CompactScancontext& _sc2) const {
   // 1. fast align using variant key (not in original IROS18)
-  MatrixXd vkey_sc1 = makeSectorkeyFromScancontext(_sc1);
-  MatrixXd vkey_sc2 = makeSectorkeyFromScancontext(_sc2);
-  int argmin_vkey_shift = fastAlignUsingVkey(vkey_sc1, vkey_sc2);
+  int argmin_vkey_shift = fastAlignUsingVkey(_sc1, _sc2);
 
   const int SEARCH_RADIUS =
-      round(0.5 * SEARCH_RATIO * _sc1.cols()); // a half of search range
+      round(0.5 * SEARCH_RATIO * SC_NUM_SECTOR); // a half of search range
   std::vector<int> shift_idx_search_space{argmin_vkey_shift};
   for (int ii = 1; ii < SEARCH_RADIUS + 1; ii++) {
-    shift_idx_search_space.push_back((argmin_vkey_shift + ii + _sc1.cols()) %
-                                     _sc1.cols());
-    shift_idx_search_space.push_back((argmin_vkey_shift - ii + _sc1.cols()) %
-                                     _sc1.cols());
+    shift_idx_search_space.push_back((argmin_vkey_shift + ii + SC_NUM_SECTOR) %
+                                     SC_NUM_SECTOR);
+    shift_idx_search_space.push_back((argmin_vkey_shift - ii + SC_NUM_SECTOR) %
+                                     SC_NUM_SECTOR);
   }
   std::sort(shift_idx_search_space.begin(), shift_idx_search_space.end());
 
@@ -112,8 +193,7 @@ std::pair<double, int> SCManager::distanceBtnScanContext(MatrixXd& _sc1,
   int argmin_shift = 0;
   double min_sc_dist = 10000000;
   for (int num_shift : shift_idx_search_space) {
-    MatrixXd sc2_shifted = circshift(_sc2, num_shift);
-    double cur_sc_dist = distDirectSC(_sc1, sc2_shifted);
+    double cur_sc_dist = distDirectSC(_sc1, _sc2, num_shift);
     if (cur_sc_dist < min_sc_dist) {
       argmin_shift = num_shift;
       min_sc_dist = cur_sc_dist;
@@ -204,34 +284,17 @@ void SCManager::makeAndSaveScancontextAndKeys(
     pcl::PointCloud<SCPointType>& _scan_down) {
   Eigen::MatrixXd sc = makeScancontext(_scan_down); // v1
   Eigen::MatrixXd ringkey = makeRingkeyFromScancontext(sc);
-  Eigen::MatrixXd sectorkey = makeSectorkeyFromScancontext(sc);
   std::vector<float> polarcontext_invkey_vec = eig2stdvec(ringkey);
 
-  polarcontexts_.push_back(sc);
-  polarcontext_invkeys_.push_back(ringkey);
-  polarcontext_vkeys_.push_back(sectorkey);
+  polarcontexts_.push_back(makeCompactScancontext(sc));
   polarcontext_invkeys_mat_.push_back(polarcontext_invkey_vec);
 
-  // cout <<polarcontext_vkeys_.size() << endl;
-
 } // SCManager::makeAndSaveScancontextAndKeys
 
-std::pair<int, float> SCManager::detectLoopClosureID(void) {
-  int loop_id{-1}; // init with -1, -1 means no loop (== LeGO-LOAM's variable
-                   // "closestHistoryFrameID")
-
-  auto curr_key =
-      polarcontext_invkeys_mat_.back();   // current observation (query)
-  auto curr_desc = polarcontexts_.back(); // current observation (query)
-
-  /*
-   * step 1: candidates from ringkey tree_
-   */
-  if (polarcontext_invkeys_mat_.size() < NUM_EXCLUDE_RECENT + 1) {
-    std::pair<int, float> result{loop_id, 0.0};
-    return result; // Early return
-  }
-
+double SCManager::findNearestCandidate(const std::vector<float>& _curr_key,
+                                       const CompactScancontext& _curr_desc,
+                                       size_t _num_exclude_recent,
+                                       int& _nn_idx, int& _nn_align) {
   // tree_ reconstruction (not mandatory to make everytime)
   if (tree_making_period_conter % TREE_MAKING_PERIOD_ ==
       0) // to save computation cost
@@ -241,7 +304,7 @@ std::pair<int, float> SCManager::detectLoopClosureID(void) {
     polarcontext_invkeys_to_search_.clear();
     polarcontext_invkeys_to_search_.assign(polarcontext_invkeys_mat_.begin(),
                                            polarcontext_invkeys_mat_.end() -
-                                               NUM_EXCLUDE_RECENT);
+                                               _num_exclude_recent);
 
     polarcontext_tree_.reset();
     polarcontext_tree_ = std::make_unique<InvKeyTree>(
@@ -255,8 +318,8 @@ std::pair<int, float> SCManager::detectLoopClosureID(void) {
   tree_making_period_conter = tree_making_period_conter + 1;
 
   double min_dist = 10000000; // init with somthing large
-  int nn_align = 0;
-  int nn_idx = 0;
+  _nn_align = 0;
+  _nn_idx = 0;
 
   // knn search
   std::vector<size_t> candidate_indexes(NUM_CANDIDATES_FROM_TREE);
@@ -267,7 +330,7 @@ std::pair<int, float> SCManager::detectLoopClosureID(void) {
       NUM_CANDIDATES_FROM_TREE);
   knnsearch_result.init(&candidate_indexes[0], &out_dists_sqr[0]);
   polarcontext_tree_->index->findNeighbors(knnsearch_result,
-                                           &curr_key[0] /* query */,
+                                           &_curr_key[0] /* query */,
                                            beam::nanoflann::SearchParams(10));
   t_tree_search.toc("Tree search");
 
@@ -276,25 +339,50 @@ std::pair<int, float> SCManager::detectLoopClosureID(void) {
    * distance)
    */
   beam::TicToc t_calc_dist;
-  for (int candidate_iter_idx = 0;
-       candidate_iter_idx < NUM_CANDIDATES_FROM_TREE; candidate_iter_idx++) {
-    MatrixXd polarcontext_candidate =
+  for (size_t candidate_iter_idx = 0;
+       candidate_iter_idx < knnsearch_result.size(); candidate_iter_idx++) {
+    const CompactScancontext& polarcontext_candidate =
         polarcontexts_[candidate_indexes[candidate_iter_idx]];
     std::pair<double, int> sc_dist_result =
-        distanceBtnScanContext(curr_desc, polarcontext_candidate);
+        distanceBtnScanContext(_curr_desc, polarcontext_candidate);
 
     double candidate_dist = sc_dist_result.first;
     int candidate_align = sc_dist_result.second;
 
     if (candidate_dist < min_dist) {
       min_dist = candidate_dist;
-      nn_align = candidate_align;
+      _nn_align = candidate_align;
 
-      nn_idx = candidate_indexes[candidate_iter_idx];
+      _nn_idx = candidate_indexes[candidate_iter_idx];
     }
   }
   t_calc_dist.toc("Distance calc");
 
+  return min_dist;
+
+} // SCManager::findNearestCandidate
+
+std::pair<int, float> SCManager::detectLoopClosureID(void) {
+  int loop_id{-1}; // init with -1, -1 means no loop (== LeGO-LOAM's variable
+                   // "closestHistoryFrameID")
+
+  /*
+   * step 1: candidates from ringkey tree_
+   */
+  if (polarcontext_invkeys_mat_.size() < NUM_EXCLUDE_RECENT + 1) {
+    std::pair<int, float> result{loop_id, 0.0};
+    return result; // Early return
+  }
+
+  const auto& curr_key =
+      polarcontext_invkeys_mat_.back();          // current observation (query)
+  const auto& curr_desc = polarcontexts_.back(); // current observation (query)
+
+  int nn_align = 0;
+  int nn_idx = 0;
+  double min_dist = findNearestCandidate(curr_key, curr_desc,
+                                         NUM_EXCLUDE_RECENT, nn_idx, nn_align);
+
   /*
    * loop threshold check
    */
@@ -328,10 +416,6 @@ std::pair<int, float>
   int loop_id{-1}; // init with -1, -1 means no loop (== LeGO-LOAM's variable
                    // "closestHistoryFrameID")
 
-  Eigen::MatrixXd curr_desc = makeScancontext(_query_scan); // v1
-  Eigen::MatrixXd ringkey = makeRingkeyFromScancontext(curr_desc);
-  std::vector<float> curr_key = eig2stdvec(ringkey);
-
   /*
    * step 1: candidates from ringkey tree_
    */
@@ -344,68 +428,15 @@ std::pair<int, float>
     return result; // Early return
   }
 
-  // tree_ reconstruction (not mandatory to make everytime)
-  if (tree_making_period_conter % TREE_MAKING_PERIOD_ ==
-      0) // to save computation cost
-  {
-    beam::TicToc t_tree_construction;
-
-    polarcontext_invkeys_to_search_.clear();
-    polarcontext_invkeys_to_search_.assign(polarcontext_invkeys_mat_.begin(),
-                                           polarcontext_invkeys_mat_.end() -
-                                               _num_exclude_recent);
-
-    polarcontext_tree_.reset();
-    polarcontext_tree_ = std::make_unique<InvKeyTree>(
-        PC_NUM_RING /* dim */, polarcontext_invkeys_to_search_,
-        10 /* max leaf */);
-    // tree_ptr_->index->buildIndex(); // inernally called in the constructor of
-    // InvKeyTree (for detail, refer the nanoflann and
-    // KDtreeVectorOfVectorsAdaptor)
-    t_tree_construction.toc("Tree construction");
-  }
-  tree_making_period_conter = tree_making_period_conter + 1;
+  Eigen::MatrixXd sc = makeScancontext(_query_scan); // v1
+  Eigen::MatrixXd ringkey = makeRingkeyFromScancontext(sc);
+  std::vector<float> curr_key = eig2stdvec(ringkey);
+  CompactScancontext curr_desc = makeCompactScancontext(sc);
 
-  double min_dist = 10000000; // init with somthing large
   int nn_align = 0;
   int nn_idx = 0;
-
-  // knn search
-  std::vector<size_t> candidate_indexes(NUM_CANDIDATES_FROM_TREE);
-  std::vector<float> out_dists_sqr(NUM_CANDIDATES_FROM_TREE);
-
-  beam::TicToc t_tree_search;
-  beam::nanoflann::KNNResultSet<float> knnsearch_result(
-      NUM_CANDIDATES_FROM_TREE);
-  knnsearch_result.init(&candidate_indexes[0], &out_dists_sqr[0]);
-  polarcontext_tree_->index->findNeighbors(knnsearch_result,
-                                           &curr_key[0] /* query */,
-                                           beam::nanoflann::SearchParams(10));
-  t_tree_search.toc("Tree search");
-
-  /*
-   *  step 2: pairwise distance (find optimal columnwise best-fit using cosine
-   * distance)
-   */
-  beam::TicToc t_calc_dist;
-  for (int candidate_iter_idx = 0;
-       candidate_iter_idx < NUM_CANDIDATES_FROM_TREE; candidate_iter_idx++) {
-    MatrixXd polarcontext_candidate =
-        polarcontexts_[candidate_indexes[candidate_iter_idx]];
-    std::pair<double, int> sc_dist_result =
-        distanceBtnScanContext(curr_desc, polarcontext_candidate);
-
-    double candidate_dist = sc_dist_result.first;
-    int candidate_align = sc_dist_result.second;
-
-    if (candidate_dist < min_dist) {
-      min_dist = candidate_dist;
-      nn_align = candidate_align;
-
-      nn_idx = candidate_indexes[candidate_iter_idx];
-    }
-  }
-  t_calc_dist.toc("Distance calc");
+  double min_dist = findNearestCandidate(curr_key, curr_desc,
+                                         _num_exclude_recent, nn_idx, nn_align);
 
   /*
    * loop threshold check
@@ -436,4 +467,4 @@ std::pair<int, float>
 
 } // SCManager::detectLoopClosureID
 
-// } // namespace SC2
\ No newline at end of file
+// } // namespace SC2
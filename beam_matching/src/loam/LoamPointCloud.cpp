@@ -14,13 +14,45 @@ void LoamFeatures::Clear() {
   weak.Clear();
 }
 
+LoamFeatureCloud::LoamFeatureCloud(const LoamFeatureCloud& other)
+    : cloud(other.cloud), dynamic_kdtree(other.dynamic_kdtree) {}
+
+LoamFeatureCloud& LoamFeatureCloud::operator=(const LoamFeatureCloud& other) {
+  if (this == &other) { return *this; }
+  cloud = other.cloud;
+  kdtree = std::make_shared<beam::KdTree<PointXYZIRT>>(PointCloudIRT());
+  kdtree_empty = true;
+  dynamic_kdtree = other.dynamic_kdtree;
+  return *this;
+}
+
+int LoamFeatureCloud::NearestKSearch(
+    const PointXYZIRT& p, int k, std::vector<uint32_t>& point_ids,
+    std::vector<float>& point_distances) const {
+  if (dynamic_kdtree) {
+    return dynamic_kdtree->nearestKSearch(p, k, point_ids, point_distances);
+  }
+  return kdtree->nearestKSearch(p, k, point_ids, point_distances);
+}
+
+const PointXYZIRT& LoamFeatureCloud::GetPoint(uint32_t id) const {
+  if (dynamic_kdtree) { return dynamic_kdtree->at(id); }
+  return cloud.points.at(id);
+}
+
+size_t LoamFeatureCloud::Size() const {
+  if (dynamic_kdtree) { return dynamic_kdtree->size(); }
+  return cloud.size();
+}
+
 void LoamFeatureCloud::Clear() {
   cloud.clear();
   ClearKDTree();
+  dynamic_kdtree.reset();
 }
 
 void LoamFeatureCloud::ClearKDTree() {
-  kdtree->clear();
+  if (kdtree) { kdtree->clear(); }
   kdtree_empty = true;
 }
 
@@ -45,7 +77,12 @@ void LoamFeatureCloud::BuildKDTree(bool override_tree) {
   // if tree is not empty, and we do not want to override, then do nothing
   if (!kdtree_empty && !override_tree) { return; }
 
-  kdtree = std::make_shared<beam::KdTree<PointXYZIRT>>(cloud);
+  // the dynamic tree is kept up to date by its owner
+  if (dynamic_kdtree) { return; }
+
+  // index the cloud directly instead of copying it. The tree is cleared
+  // whenever the cloud is modified, see LoamPointCloud
+  kdtree = std::make_shared<beam::KdTree<PointXYZIRT>>(cloud, false);
   kdtree_empty = false;
 }
 
@@ -65,9 +102,11 @@ void LoamPointCloud::AddSurfaceFeaturesStrong(const PointCloudIRT& new_features,
     PointCloudIRT new_features_transformed;
     pcl::transformPointCloud(new_features, new_features_transformed, T);
     surfaces.strong.cloud += new_features_transformed;
+    surfaces.strong.ClearKDTree();
     return;
   }
   surfaces.strong.cloud += new_features;
+  surfaces.strong.ClearKDTree();
   return;
 }
 
@@ -77,9 +116,11 @@ void LoamPointCloud::AddEdgeFeaturesStrong(const PointCloudIRT& new_features,
     PointCloudIRT new_features_transformed;
     pcl::transformPointCloud(new_features, new_features_transformed, T);
     edges.strong.cloud += new_features_transformed;
+    edges.strong.ClearKDTree();
     return;
   }
   edges.strong.cloud += new_features;
+  edges.strong.ClearKDTree();
   return;
 }
 
@@ -89,9 +130,11 @@ void LoamPointCloud::AddSurfaceFeaturesWeak(const PointCloudIRT& new_features,
     PointCloudIRT new_features_transformed;
     pcl::transformPointCloud(new_features, new_features_transformed, T);
     surfaces.weak.cloud += new_features_transformed;
+    surfaces.weak.ClearKDTree();
     return;
   }
   surfaces.weak.cloud += new_features;
+  surfaces.weak.ClearKDTree();
   return;
 }
 
@@ -101,9 +144,11 @@ void LoamPointCloud::AddEdgeFeaturesWeak(const PointCloudIRT& new_features,
     PointCloudIRT new_features_transformed;
     pcl::transformPointCloud(new_features, new_features_transformed, T);
     edges.weak.cloud += new_features_transformed;
+    edges.weak.ClearKDTree();
     return;
   }
   edges.weak.cloud += new_features;
+  edges.weak.ClearKDTree();
   return;
 }
 
@@ -276,15 +321,15 @@ void LoamPointCloud::Print(std::ostream& stream) const {
 }
 
 uint64_t LoamPointCloud::Size() const {
-  return edges.strong.cloud.size() + edges.weak.cloud.size() +
-         surfaces.strong.cloud.size() + surfaces.weak.cloud.size();
+  return edges.strong.Size() + edges.weak.Size() + surfaces.strong.Size() +
+         surfaces.weak.Size();
 }
 
 bool LoamPointCloud::Empty() const {
-  if (!edges.strong.cloud.empty()) { return false; }
-  if (!edges.weak.cloud.empty()) { return false; }
-  if (!surfaces.strong.cloud.empty()) { return false; }
-  if (!surfaces.weak.cloud.empty()) { return false; }
+  if (edges.strong.Size() != 0) { return false; }
+  if (edges.weak.Size() != 0) { return false; }
+  if (surfaces.strong.Size() != 0) { return false; }
+  if (surfaces.weak.Size() != 0) { return false; }
   return true;
 }
 
@@ -310,6 +355,10 @@ void LoamPointCloud::LoadFromCombined(const LoamPointCloudCombined& cloud) {
       throw std::runtime_error{"invalid type parameter in cloud"};
     }
   }
+  edges.strong.ClearKDTree();
+  edges.weak.ClearKDTree();
+  surfaces.strong.ClearKDTree();
+  surfaces.weak.ClearKDTree();
 }
 
 LoamPointCloudCombined LoamPointCloud::GetCombinedCloud() const {
@@ -11,6 +11,7 @@
 #include <beam_optimization/PointToPlaneCost.h>
 #include <beam_utils/log.h>
 #include <beam_utils/math.h>
+#include <beam_utils/parallel.h>
 #include <beam_utils/se3.h>
 
 namespace beam_matching {
@@ -99,7 +100,7 @@ bool LoamScanRegistration::GetEdgeMeasurements() {
 
   // build kdtrees if not already done
   if (params_->check_strong_features_first) {
-    if (ref_->edges.strong.cloud.size() > 0) {
+    if (ref_->edges.strong.Size() > 0) {
       ref_->edges.strong.BuildKDTree(false);
     } else {
       BEAM_ERROR(
@@ -107,31 +108,53 @@ bool LoamScanRegistration::GetEdgeMeasurements() {
       return false;
     }
   }
-  bool weak_kd_tree_built = false;
-
-  for (size_t tgt_iter = 0; tgt_iter < tgt_features.size(); tgt_iter++) {
-    const auto& search_pt = tgt_features.points.at(tgt_iter);
-    const auto& query_pt = tgt_->edges.strong.cloud.at(tgt_iter);
 
-    bool success = false;
-    EdgeMeasurement measurement;
-    if (params_->check_strong_features_first) {
-      // search for correspondence in strong features
-      success = GetEdgePointMeasurement(measurement, search_pt, query_pt,
-                                        ref_->edges.strong);
-    }
-    if (!success && !params_->ignore_weak_features) {
-      if (!weak_kd_tree_built) {
-        ref_->edges.weak.BuildKDTree(false);
-        weak_kd_tree_built = true;
-      }
-      success = GetEdgePointMeasurement(measurement, search_pt, query_pt,
-                                        ref_->edges.weak);
-    }
+  int n_threads = beam::GetNumThreads(params_->correspondence_threads,
+                                      tgt_features.size(),
+                                      min_features_per_thread_);
 
-    if (success) { edge_measurements_.push_back(measurement); }
+  // The weak kdtree is built lazily when searching serially. When using
+  // multiple threads we build it before searching so the reference cloud is
+  // only ever read from the worker threads.
+  bool weak_kd_tree_built = false;
+  if (n_threads > 1 && !params_->ignore_weak_features) {
+    ref_->edges.weak.BuildKDTree(false);
+    weak_kd_tree_built = true;
   }
 
+  std::vector<std::vector<EdgeMeasurement>> thread_measurements(n_threads);
+  beam::ParallelForChunks(
+      tgt_features.size(), n_threads,
+      [&](int thread_id, size_t begin, size_t end) {
+        std::vector<EdgeMeasurement>& measurements =
+            thread_measurements[thread_id];
+        measurements.reserve(end - begin);
+        for (size_t tgt_iter = begin; tgt_iter < end; tgt_iter++) {
+          const auto& search_pt = tgt_features.points.at(tgt_iter);
+          const auto& query_pt = tgt_->edges.strong.cloud.at(tgt_iter);
+
+          bool success = false;
+          EdgeMeasurement measurement;
+          if (params_->check_strong_features_first) {
+            // search for correspondence in strong features
+            success = GetEdgePointMeasurement(measurement, search_pt,
+                                              query_pt, ref_->edges.strong);
+          }
+          if (!success && !params_->ignore_weak_features) {
+            if (!weak_kd_tree_built) {
+              ref_->edges.weak.BuildKDTree(false);
+              weak_kd_tree_built = true;
+            }
+            success = GetEdgePointMeasurement(measurement, search_pt,
+                                              query_pt, ref_->edges.weak);
+          }
+
+          if (success) { measurements.push_back(measurement); }
+        }
+      });
+
+  MergeMeasurements(thread_measurements, edge_measurements_);
+
   return true;
 }
 
@@ -149,7 +172,7 @@ bool LoamScanRegistration::GetSurfaceMeasurements() {
 
   // build kdtree if not already done
   if (params_->check_strong_features_first) {
-    if (ref_->surfaces.strong.cloud.size() > 0) {
+    if (ref_->surfaces.strong.Size() > 0) {
       ref_->surfaces.strong.BuildKDTree(false);
     } else {
       BEAM_ERROR(
@@ -157,31 +180,51 @@ bool LoamScanRegistration::GetSurfaceMeasurements() {
       return false;
     }
   }
-  bool weak_kd_tree_built = false;
-
-  for (size_t tgt_iter = 0; tgt_iter < tgt_features.size(); tgt_iter++) {
-    const auto& search_pt = tgt_features.points.at(tgt_iter);
-    const auto& query_pt = tgt_->surfaces.strong.cloud.at(tgt_iter);
 
-    bool success = false;
-    SurfaceMeasurement measurement;
-    if (params_->check_strong_features_first) {
-      // search for correspondence in strong features
-      success = GetSurfacePointMeasurement(measurement, search_pt, query_pt,
-                                           ref_->surfaces.strong);
-    }
-    if (!success && !params_->ignore_weak_features) {
-      if (!weak_kd_tree_built) {
-        ref_->surfaces.weak.BuildKDTree(false);
-        weak_kd_tree_built = true;
-      }
-      success = GetSurfacePointMeasurement(measurement, search_pt, query_pt,
-                                           ref_->surfaces.weak);
-    }
+  int n_threads = beam::GetNumThreads(params_->correspondence_threads,
+                                      tgt_features.size(),
+                                      min_features_per_thread_);
 
-    if (success) { surface_measurements_.push_back(measurement); }
+  // see GetEdgeMeasurements
+  bool weak_kd_tree_built = false;
+  if (n_threads > 1 && !params_->ignore_weak_features) {
+    ref_->surfaces.weak.BuildKDTree(false);
+    weak_kd_tree_built = true;
   }
 
+  std::vector<std::vector<SurfaceMeasurement>> thread_measurements(n_threads);
+  beam::ParallelForChunks(
+      tgt_features.size(), n_threads,
+      [&](int thread_id, size_t begin, size_t end) {
+        std::vector<SurfaceMeasurement>& measurements =
+            thread_measurements[thread_id];
+        measurements.reserve(end - begin);
+        for (size_t tgt_iter = begin; tgt_iter < end; tgt_iter++) {
+          const auto& search_pt = tgt_features.points.at(tgt_iter);
+          const auto& query_pt = tgt_->surfaces.strong.cloud.at(tgt_iter);
+
+          bool success = false;
+          SurfaceMeasurement measurement;
+          if (params_->check_strong_features_first) {
+            // search for correspondence in strong features
+            success = GetSurfacePointMeasurement(
+                measurement, search_pt, query_pt, ref_->surfaces.strong);
+          }
+          if (!success && !params_->ignore_weak_features) {
+            if (!weak_kd_tree_built) {
+              ref_->surfaces.weak.BuildKDTree(false);
+              weak_kd_tree_built = true;
+            }
+            success = GetSurfacePointMeasurement(
+                measurement, search_pt, query_pt, ref_->surfaces.weak);
+          }
+
+          if (success) { measurements.push_back(measurement); }
+        }
+      });
+
+  MergeMeasurements(thread_measurements, surface_measurements_);
+
   return true;
 }
 
@@ -191,7 +234,7 @@ bool LoamScanRegistration::GetSurfacePointMeasurement(
     const LoamFeatureCloud& search_features) const {
   std::vector<uint32_t> point_search_ind;
   std::vector<float> point_search_sq_dist;
-  size_t num_returned = search_features.kdtree->nearestKSearch(
+  size_t num_returned = search_features.NearestKSearch(
       search_point_in_ref, 3, point_search_ind, point_search_sq_dist);
 
   if (num_returned != 3) { return false; }
@@ -206,17 +249,17 @@ bool LoamScanRegistration::GetSurfacePointMeasurement(
   measurement.query_pt[1] = search_point_in_tgt.y;
   measurement.query_pt[2] = search_point_in_tgt.z;
 
-  const auto& ref_pt1 = search_features.cloud.points.at(point_search_ind.at(0));
+  const auto& ref_pt1 = search_features.GetPoint(point_search_ind.at(0));
   measurement.ref_pt1[0] = ref_pt1.x;
   measurement.ref_pt1[1] = ref_pt1.y;
   measurement.ref_pt1[2] = ref_pt1.z;
 
-  const auto& ref_pt2 = search_features.cloud.points.at(point_search_ind.at(1));
+  const auto& ref_pt2 = search_features.GetPoint(point_search_ind.at(1));
   measurement.ref_pt2[0] = ref_pt2.x;
   measurement.ref_pt2[1] = ref_pt2.y;
   measurement.ref_pt2[2] = ref_pt2.z;
 
-  const auto& ref_pt3 = search_features.cloud.points.at(point_search_ind.at(2));
+  const auto& ref_pt3 = search_features.GetPoint(point_search_ind.at(2));
   measurement.ref_pt3[0] = ref_pt3.x;
   measurement.ref_pt3[1] = ref_pt3.y;
   measurement.ref_pt3[2] = ref_pt3.z;
@@ -230,7 +273,7 @@ bool LoamScanRegistration::GetEdgePointMeasurement(
     const LoamFeatureCloud& search_features) const {
   std::vector<uint32_t> point_search_ind;
   std::vector<float> point_search_sq_dist;
-  size_t num_returned = search_features.kdtree->nearestKSearch(
+  size_t num_returned = search_features.NearestKSearch(
       search_point_in_ref, 2, point_search_ind, point_search_sq_dist);
 
   if (num_returned != 2) { return false; }
@@ -244,12 +287,12 @@ bool LoamScanRegistration::GetEdgePointMeasurement(
   measurement.query_pt[1] = search_point_in_tgt.y;
   measurement.query_pt[2] = search_point_in_tgt.z;
 
-  const auto& ref_pt1 = search_features.cloud.points.at(point_search_ind.at(0));
+  const auto& ref_pt1 = search_features.GetPoint(point_search_ind.at(0));
   measurement.ref_pt1[0] = ref_pt1.x;
   measurement.ref_pt1[1] = ref_pt1.y;
   measurement.ref_pt1[2] = ref_pt1.z;
 
-  const auto& ref_pt2 = search_features.cloud.points.at(point_search_ind.at(1));
+  const auto& ref_pt2 = search_features.GetPoint(point_search_ind.at(1));
   measurement.ref_pt2[0] = ref_pt2.x;
   measurement.ref_pt2[1] = ref_pt2.y;
   measurement.ref_pt2[2] = ref_pt2.z;
@@ -0,0 +1,181 @@
+#include <beam_matching/loam/LoamVoxelMap.h>
+
+#include <cmath>
+#include <limits>
+
+#include <beam_utils/log.h>
+
+namespace beam_matching {
+
+LoamVoxelMap::LoamVoxelMap(double voxel_size_m, size_t max_points_per_voxel)
+    : voxel_size_m_(voxel_size_m), max_points_per_voxel_(max_points_per_voxel) {
+  if (voxel_size_m_ <= 0) {
+    BEAM_ERROR("Invalid voxel size for LoamVoxelMap: {}", voxel_size_m_);
+    throw std::invalid_argument{"voxel size must be greater than zero"};
+  }
+  ResetTrees();
+}
+
+void LoamVoxelMap::AddScan(const LoamPointCloud& scan,
+                           const Eigen::Matrix4d& T_MAP_SCAN) {
+  Eigen::Affine3f T(T_MAP_SCAN.cast<float>());
+  AddFeatures(scan.edges.strong.cloud, T, &Voxel::edges_strong, *edges_strong_);
+  AddFeatures(scan.edges.weak.cloud, T, &Voxel::edges_weak, *edges_weak_);
+  AddFeatures(scan.surfaces.strong.cloud, T, &Voxel::surfaces_strong,
+              *surfaces_strong_);
+  AddFeatures(scan.surfaces.weak.cloud, T, &Voxel::surfaces_weak,
+              *surfaces_weak_);
+  map_updated_ = true;
+}
+
+void LoamVoxelMap::AddFeatures(const PointCloudIRT& cloud,
+                               const Eigen::Affine3f& T_MAP_SCAN,
+                               std::vector<uint32_t> Voxel::*ids,
+                               KdTree& tree) {
+  // accepted points are added to the tree in one batch at the end, and get
+  // consecutive ids starting at the id of the next point in the tree (which
+  // is returned when adding no points)
+  PointCloudIRT points_new;
+  uint32_t next_id = tree.AddPoints(points_new);
+  size_t num_skipped = 0;
+  for (const PointXYZIRT& p : cloud) {
+    Eigen::Vector3f p_map = T_MAP_SCAN * Eigen::Vector3f(p.x, p.y, p.z);
+    VoxelKey key;
+    if (!GetKey(p_map, key)) {
+      num_skipped++;
+      continue;
+    }
+    std::vector<uint32_t>& voxel_ids = voxels_[key].*ids;
+    if (max_points_per_voxel_ > 0 &&
+        voxel_ids.size() >= max_points_per_voxel_) {
+      continue;
+    }
+    PointXYZIRT p_new = p;
+    p_new.x = p_map[0];
+    p_new.y = p_map[1];
+    p_new.z = p_map[2];
+    points_new.push_back(p_new);
+    voxel_ids.push_back(next_id++);
+  }
+  tree.AddPoints(points_new);
+  if (num_skipped > 0) {
+    BEAM_WARN("Skipped {} invalid or out of range points in LoamVoxelMap",
+              num_skipped);
+  }
+}
+
+size_t LoamVoxelMap::RemoveVoxelsOutsideRadius(const Eigen::Vector3d& center,
+                                               double radius_m) {
+  std::vector<uint32_t> edges_strong;
+  std::vector<uint32_t> edges_weak;
+  std::vector<uint32_t> surfaces_strong;
+  std::vector<uint32_t> surfaces_weak;
+  size_t num_removed = 0;
+  double radius_sq = radius_m * radius_m;
+  for (auto iter = voxels_.begin(); iter != voxels_.end();) {
+    if ((GetVoxelCenter(iter->first) - center).squaredNorm() <= radius_sq) {
+      iter++;
+      continue;
+    }
+    const Voxel& v = iter->second;
+    edges_strong.insert(edges_strong.end(), v.edges_strong.begin(),
+                        v.edges_strong.end());
+    edges_weak.insert(edges_weak.end(), v.edges_weak.begin(),
+                      v.edges_weak.end());
+    surfaces_strong.insert(surfaces_strong.end(), v.surfaces_strong.begin(),
+                           v.surfaces_strong.end());
+    surfaces_weak.insert(surfaces_weak.end(), v.surfaces_weak.begin(),
+                         v.surfaces_weak.end());
+    iter = voxels_.erase(iter);
+    num_removed++;
+  }
+  if (num_removed == 0) { return 0; }
+
+  // remove all points of each type at once so each tree is compacted at most
+  // once
+  edges_strong_->RemovePoints(edges_strong);
+  edges_weak_->RemovePoints(edges_weak);
+  surfaces_strong_->RemovePoints(surfaces_strong);
+  surfaces_weak_->RemovePoints(surfaces_weak);
+  map_updated_ = true;
+  return num_removed;
+}
+
+LoamPointCloudPtr LoamVoxelMap::GetLoamPointCloud() {
+  if (!map_updated_ && map_) { return map_; }
+
+  map_ = std::make_shared<LoamPointCloud>();
+  map_->edges.strong.cloud.reserve(edges_strong_->size());
+  map_->edges.weak.cloud.reserve(edges_weak_->size());
+  map_->surfaces.strong.cloud.reserve(surfaces_strong_->size());
+  map_->surfaces.weak.cloud.reserve(surfaces_weak_->size());
+  for (const auto& [key, v] : voxels_) {
+    for (uint32_t id : v.edges_strong) {
+      map_->edges.strong.cloud.push_back(edges_strong_->at(id));
+    }
+    for (uint32_t id : v.edges_weak) {
+      map_->edges.weak.cloud.push_back(edges_weak_->at(id));
+    }
+    for (uint32_t id : v.surfaces_strong) {
+      map_->surfaces.strong.cloud.push_back(surfaces_strong_->at(id));
+    }
+    for (uint32_t id : v.surfaces_weak) {
+      map_->surfaces.weak.cloud.push_back(surfaces_weak_->at(id));
+    }
+  }
+  map_updated_ = false;
+  return map_;
+}
+
+void LoamVoxelMap::Clear() {
+  voxels_.clear();
+  ResetTrees();
+  map_.reset();
+  map_updated_ = true;
+}
+
+size_t LoamVoxelMap::NumVoxels() const {
+  return voxels_.size();
+}
+
+uint64_t LoamVoxelMap::Size() const {
+  return edges_strong_->size() + edges_weak_->size() +
+         surfaces_strong_->size() + surfaces_weak_->size();
+}
+
+bool LoamVoxelMap::Empty() const {
+  return Size() == 0;
+}
+
+bool LoamVoxelMap::GetKey(const Eigen::Vector3f& p, VoxelKey& key) const {
+  int32_t* indices[3] = {&key.x, &key.y, &key.z};
+  for (int i = 0; i < 3; i++) {
+    double index = std::floor(p[i] / voxel_size_m_);
+    // also false for NaN
+    if (!(index >= std::numeric_limits<int32_t>::min() &&
+          index <= std::numeric_limits<int32_t>::max())) {
+      return false;
+    }
+    *indices[i] = static_cast<int32_t>(index);
+  }
+  return true;
+}
+
+Eigen::Vector3d LoamVoxelMap::GetVoxelCenter(const VoxelKey& key) const {
+  return Eigen::Vector3d(key.x + 0.5, key.y + 0.5, key.z + 0.5) *
+         voxel_size_m_;
+}
+
+void LoamVoxelMap::ResetTrees() {
+  edges_strong_ = std::make_shared<KdTree>();
+  edges_weak_ = std::make_shared<KdTree>();
+  surfaces_strong_ = std::make_shared<KdTree>();
+  surfaces_weak_ = std::make_shared<KdTree>();
+  search_cloud_ = std::make_shared<LoamPointCloud>();
+  search_cloud_->edges.strong.dynamic_kdtree = edges_strong_;
+  search_cloud_->edges.weak.dynamic_kdtree = edges_weak_;
+  search_cloud_->surfaces.strong.dynamic_kdtree = surfaces_strong_;
+  search_cloud_->surfaces.weak.dynamic_kdtree = surfaces_weak_;
+}
+
+} // namespace beam_matching
@@ -2,11 +2,13 @@
 
 #include <pcl/io/pcd_io.h>
 
+#include <beam_matching/LoamMapMatcher.h>
 #include <beam_matching/LoamMatcher.h>
 #include <beam_matching/loam/LoamFeatureExtractor.h>
 #include <beam_matching/loam/LoamParams.h>
 #include <beam_matching/loam/LoamPointCloud.h>
 #include <beam_matching/loam/LoamScanRegistration.h>
+#include <beam_matching/loam/LoamVoxelMap.h>
 #include <beam_utils/log.h>
 #include <beam_utils/math.h>
 #include <beam_utils/pointclouds.h>
@@ -167,6 +169,35 @@ TEST(ScanRegistration, SmallPerturb) {
       beam::ArePosesEqual(T_CLOUD1_CLOUD3_mea, T_CLOUD1_CLOUD3, 1, 0.05));
 }
 
+TEST(ScanRegistration, MultiThreadedCorrespondences) {
+  LoamParamsPtr params = std::make_shared<LoamParams>();
+  *params = *data_.params;
+  params->iterate_correspondences = true;
+  params->ignore_weak_features = false;
+  params->correspondence_threads = 1;
+  LoamFeatureExtractor fea_extractor(params);
+
+  auto loam_cloud1 = std::make_shared<LoamPointCloud>(
+      fea_extractor.ExtractFeatures(*data_.cloud1));
+  auto loam_cloud3 = std::make_shared<LoamPointCloud>(
+      fea_extractor.ExtractFeatures(*data_.cloud3));
+
+  LoamScanRegistration scan_reg_serial(params);
+  bool reg_successful_serial =
+      scan_reg_serial.RegisterScans(loam_cloud1, loam_cloud3);
+
+  LoamParamsPtr params_mt = std::make_shared<LoamParams>();
+  *params_mt = *params;
+  params_mt->correspondence_threads = 4;
+  LoamScanRegistration scan_reg_mt(params_mt);
+  bool reg_successful_mt = scan_reg_mt.RegisterScans(loam_cloud1, loam_cloud3);
+
+  EXPECT_TRUE(reg_successful_serial);
+  EXPECT_TRUE(reg_successful_mt);
+  EXPECT_TRUE(scan_reg_serial.GetT_REF_TGT().isApprox(
+      scan_reg_mt.GetT_REF_TGT(), 1e-9));
+}
+
 TEST(LoamMatcher, SmallPerturb) {
   // get loam params
   LoamParamsPtr params = std::make_shared<LoamParams>();
@@ -223,4 +254,100 @@ TEST(LoamMatcher, LargePerturb) {
   EXPECT_TRUE(!cov.isIdentity());
 }
 
+TEST(LoamVoxelMap, AddAndRemove) {
+  LoamFeatureExtractor fea_extractor(data_.params);
+  LoamPointCloud loam_cloud1 = fea_extractor.ExtractFeatures(*data_.cloud1);
+
+  // without a max number of points per voxel, all points are kept
+  LoamVoxelMap map_all(1.0, 0);
+  map_all.AddScan(loam_cloud1);
+  EXPECT_EQ(map_all.Size(), loam_cloud1.Size());
+  EXPECT_EQ(map_all.GetLoamPointCloud()->Size(), loam_cloud1.Size());
+
+  // adding the same scan again with a limit of 1 point per voxel and type
+  // should not grow the map
+  LoamVoxelMap map(1.0, 1);
+  map.AddScan(loam_cloud1);
+  uint64_t size_first = map.Size();
+  size_t num_voxels_first = map.NumVoxels();
+  EXPECT_LT(size_first, loam_cloud1.Size());
+  map.AddScan(loam_cloud1);
+  EXPECT_EQ(map.Size(), size_first);
+  EXPECT_EQ(map.NumVoxels(), num_voxels_first);
+
+  // removing voxels far from the origin should shrink the map and only leave
+  // points within the radius (plus half a voxel diagonal)
+  double radius = 5;
+  size_t num_removed =
+      map.RemoveVoxelsOutsideRadius(Eigen::Vector3d::Zero(), radius);
+  EXPECT_GT(num_removed, size_t(0));
+  EXPECT_EQ(map.NumVoxels(), num_voxels_first - num_removed);
+  LoamPointCloudPtr local_map = map.GetLoamPointCloud();
+  EXPECT_EQ(local_map->Size(), map.Size());
+  for (const auto& p : local_map->surfaces.strong.cloud) {
+    EXPECT_LT(Eigen::Vector3d(p.x, p.y, p.z).norm(), radius + 1);
+  }
+
+  // the search cloud is updated incrementally and only finds points that are
+  // still in the map
+  LoamPointCloudPtr search_cloud = map.GetSearchCloud();
+  EXPECT_EQ(search_cloud->Size(), map.Size());
+  std::vector<uint32_t> ids;
+  std::vector<float> distances;
+  PointXYZIRT far_point;
+  far_point.x = 100;
+  far_point.y = 100;
+  far_point.z = 0;
+  ASSERT_EQ(search_cloud->surfaces.strong.NearestKSearch(far_point, 1, ids,
+                                                         distances),
+            1);
+  const PointXYZIRT& p = search_cloud->surfaces.strong.GetPoint(ids[0]);
+  EXPECT_LT(Eigen::Vector3d(p.x, p.y, p.z).norm(), radius + 1);
+
+  map.Clear();
+  EXPECT_TRUE(map.Empty());
+  EXPECT_EQ(map.GetSearchCloud()->Size(), uint64_t(0));
+
+  // points far from the origin should not share voxels
+  LoamPointCloud far_points;
+  PointXYZIRT p_far;
+  p_far.x = 0.5;
+  p_far.y = 0.5;
+  p_far.z = 0.5;
+  far_points.edges.strong.cloud.push_back(p_far);
+  p_far.x += std::pow(2, 21);
+  far_points.edges.strong.cloud.push_back(p_far);
+  map.AddScan(far_points);
+  EXPECT_EQ(map.Size(), uint64_t(2));
+  EXPECT_EQ(map.NumVoxels(), size_t(2));
+}
+
+TEST(LoamMapMatcher, SmallPerturb) {
+  LoamParamsPtr params = std::make_shared<LoamParams>();
+  *params = *data_.params;
+  params->iterate_correspondences = true;
+  params->map_max_points_per_voxel = 0;
+
+  LoamFeatureExtractor fea_extractor(params);
+  auto loam_cloud1 = std::make_shared<LoamPointCloud>(
+      fea_extractor.ExtractFeatures(*data_.cloud1));
+  auto loam_cloud3 = std::make_shared<LoamPointCloud>(
+      fea_extractor.ExtractFeatures(*data_.cloud3));
+
+  LoamMapMatcher matcher(*params);
+  matcher.SetRef(loam_cloud1);
+  uint64_t map_size_initial = matcher.GetMap()->Size();
+  matcher.SetTarget(loam_cloud3);
+
+  bool match_success = matcher.Match();
+  Eigen::Matrix4d T_CLOUD3_CLOUD1_meas = matcher.GetResult().matrix();
+
+  EXPECT_TRUE(match_success);
+  EXPECT_TRUE(beam::ArePosesEqual(T_CLOUD3_CLOUD1_meas, data_.T_CLOUD3_CLOUD1,
+                                  1, 0.05));
+
+  // target should have been added to the map
+  EXPECT_GT(matcher.GetMap()->Size(), map_size_initial);
+}
+
 } // namespace beam_matching
@@ -4,35 +4,122 @@
 #include <pcl/io/pcd_io.h>
 
 #include <beam_matching/IcpMatcher.h>
+#include <beam_matching/LoamMatcher.h>
 #include <beam_matching/MultiMatcher.h>
+#include <beam_matching/loam/LoamFeatureExtractor.h>
+#include <beam_utils/se3.h>
 
 namespace beam_matching {
 
-void SetUp() {
+std::string GetTestPath() {
   std::string test_path = __FILE__;
   std::string current_file = "multi_matcher_tests.cpp";
   test_path.erase(test_path.end() - current_file.size(), test_path.end());
-  std::string scan_path = test_path + "data/testscan.pcd";
+  return test_path;
+}
+
+PointCloudPtr LoadScan() {
+  auto cloud = std::make_shared<PointCloud>();
+  pcl::io::loadPCDFile(GetTestPath() + "data/test_scan_vlp16.pcd", *cloud);
+  return cloud;
+}
+
+/**
+ * @brief get transforms of small perturbations, used as T_TGT_REF
+ */
+std::vector<Eigen::Matrix4d, beam::AlignMat4d> GetPerturbations(int n) {
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> perturbations;
+  for (int i = 0; i < n; i++) {
+    Eigen::VectorXd perturb(6);
+    perturb << 0.5 * (i % 3), -0.5, i % 4, 0.01 * (i % 5), -0.02, 0.01;
+    perturbations.push_back(
+        beam::PerturbTransformDegM(Eigen::Matrix4d::Identity(), perturb));
+  }
+  return perturbations;
+}
+
+PointCloudPtr cloud_ = LoadScan();
+
+TEST_CASE("Test simultaneous matching with ICP") {
+  IcpMatcher::Params params(GetTestPath() + "config/icp_config.json");
+  MultiMatcher<IcpMatcher> matcher(params, 4);
+  REQUIRE(matcher.GetNumThreads() == 4);
+
+  // the same ref is used by all jobs
+  auto perturbations = GetPerturbations(12);
+  std::vector<std::future<MultiMatcher<IcpMatcher>::Result>> futures;
+  for (size_t i = 0; i < perturbations.size(); i++) {
+    auto tgt = std::make_shared<PointCloud>();
+    pcl::transformPointCloud(*cloud_, *tgt, perturbations[i]);
+    futures.push_back(matcher.Submit(i, cloud_, tgt));
+  }
 
-  cld_ = std::make_shared<PointCloud>();
-  pcl::io::loadPCDFile(scan_path, *(cld_));
+  for (size_t i = 0; i < futures.size(); i++) {
+    MultiMatcher<IcpMatcher>::Result result = futures[i].get();
+    REQUIRE(result.id == static_cast<int>(i));
+    REQUIRE(result.successful);
+    REQUIRE(result.match_time_s > 0);
+    REQUIRE(result.queue_time_s >= 0);
+    REQUIRE(beam::ArePosesEqual(result.T_REF_TGT,
+                                beam::InvertTransform(perturbations[i]), 1,
+                                0.05));
+  }
+  REQUIRE(matcher.NumPending() == 0);
 }
 
-TEST_CASE("Test simultaneous matching") {
-  PointCloudPtr cld_;
-  MultiMatcher<IcpMatcher, IcpMatcherParams> matcher_;
-      
-  SetUp();
-  PointCloudPtr dupes[9];
-  for (int i = 0; i < 9; i++) {
-    dupes[i] = std::make_shared<PointCloud>();
-    *(dupes[i]) = *(cld_);
+TEST_CASE("Test simultaneous matching with initial guesses") {
+  IcpMatcher::Params params(GetTestPath() + "config/icp_config.json");
+  MultiMatcher<IcpMatcher> matcher(params, 2);
+
+  // targets are far from the ref, but initial guesses are close
+  Eigen::VectorXd offset(6);
+  offset << 0, 0, 60, 5, 3, 0;
+  Eigen::Matrix4d T_TGT_OFFSET =
+      beam::PerturbTransformDegM(Eigen::Matrix4d::Identity(), offset);
+  auto perturbations = GetPerturbations(6);
+  std::vector<std::future<MultiMatcher<IcpMatcher>::Result>> futures;
+  for (size_t i = 0; i < perturbations.size(); i++) {
+    auto tgt = std::make_shared<PointCloud>();
+    pcl::transformPointCloud(*cloud_, *tgt, T_TGT_OFFSET * perturbations[i]);
+    futures.push_back(
+        matcher.Submit(i, cloud_, tgt, beam::InvertTransform(T_TGT_OFFSET)));
   }
-  for (int i = 0; i < 8; i++) {
-    matcher_.Insert(i, dupes[i], dupes[i + 1]);
+
+  matcher.WaitAll();
+  REQUIRE(matcher.NumPending() == 0);
+  for (size_t i = 0; i < futures.size(); i++) {
+    MultiMatcher<IcpMatcher>::Result result = futures[i].get();
+    REQUIRE(result.successful);
+    Eigen::Matrix4d T_REF_TGT =
+        beam::InvertTransform(T_TGT_OFFSET * perturbations[i]);
+    REQUIRE(beam::ArePosesEqual(result.T_REF_TGT, T_REF_TGT, 1, 0.05));
   }
-  while (!matcher_.Done()) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+}
+
+TEST_CASE("Test simultaneous matching with LOAM") {
+  auto params = std::make_shared<LoamParams>(GetTestPath() +
+                                             "config/loam_config.json");
+  LoamFeatureExtractor extractor(params);
+  auto ref = std::make_shared<LoamPointCloud>(
+      extractor.ExtractFeatures(*cloud_).Copy());
+
+  MultiMatcher<LoamMatcher> matcher(*params, 3, true);
+  auto perturbations = GetPerturbations(6);
+  std::vector<std::future<MultiMatcher<LoamMatcher>::Result>> futures;
+  for (size_t i = 0; i < perturbations.size(); i++) {
+    PointCloud tgt_cloud;
+    pcl::transformPointCloud(*cloud_, tgt_cloud, perturbations[i]);
+    auto tgt = std::make_shared<LoamPointCloud>(
+        extractor.ExtractFeatures(tgt_cloud).Copy());
+    futures.push_back(matcher.Submit(i, ref, tgt));
+  }
+
+  for (size_t i = 0; i < futures.size(); i++) {
+    MultiMatcher<LoamMatcher>::Result result = futures[i].get();
+    REQUIRE(result.successful);
+    REQUIRE(beam::ArePosesEqual(result.T_REF_TGT,
+                                beam::InvertTransform(perturbations[i]), 1,
+                                0.05));
   }
 }
 
@@ -6,4 +6,5 @@ cd ./beam_matching/
 ./beam_matching_icp_tests
 ./beam_matching_ndt_tests
 ./beam_matching_multi_matcher_tests
+./beam_matching_scancontext_tests
 ./gtests/beam_matching_loam_gtests
@@ -0,0 +1,48 @@
+#define CATCH_CONFIG_MAIN
+
+#include <random>
+
+#include <catch2/catch.hpp>
+
+#include <beam_matching/Scancontext.h>
+
+Eigen::MatrixXd RandomScancontext(std::mt19937& gen) {
+  std::uniform_real_distribution<double> height(0, 5);
+  Eigen::MatrixXd desc(SC_NUM_RING, SC_NUM_SECTOR);
+  for (int r = 0; r < SC_NUM_RING; r++) {
+    for (int s = 0; s < SC_NUM_SECTOR; s++) {
+      // leave some bins and whole sectors empty
+      desc(r, s) = (gen() % 4 == 0 || s % 7 == 0) ? 0 : height(gen);
+    }
+  }
+  return desc;
+}
+
+TEST_CASE("Test compact scan context distance matches shifted descriptors") {
+  std::mt19937 gen(0);
+  SCManager sc_manager;
+  for (int i = 0; i < 10; i++) {
+    Eigen::MatrixXd sc1 = RandomScancontext(gen);
+    Eigen::MatrixXd sc2 = RandomScancontext(gen);
+    CompactScancontext compact1 = makeCompactScancontext(sc1);
+    CompactScancontext compact2 = makeCompactScancontext(sc2);
+    for (int shift = 0; shift < SC_NUM_SECTOR; shift++) {
+      Eigen::MatrixXd sc2_shifted = circshift(sc2, shift);
+      REQUIRE(sc_manager.distDirectSC(compact1, compact2, shift) ==
+              Approx(sc_manager.distDirectSC(sc1, sc2_shifted)).margin(1e-5));
+    }
+  }
+}
+
+TEST_CASE("Test scan context alignment") {
+  std::mt19937 gen(1);
+  SCManager sc_manager;
+  Eigen::MatrixXd sc1 = RandomScancontext(gen);
+  for (int shift : {0, 1, 17, 59}) {
+    Eigen::MatrixXd sc2 = circshift(sc1, shift);
+    std::pair<double, int> result =
+        sc_manager.distanceBtnScanContext(sc1, sc2);
+    REQUIRE(result.first == Approx(0).margin(1e-5));
+    REQUIRE(result.second == (SC_NUM_SECTOR - shift) % SC_NUM_SECTOR);
+  }
+}
@@ -9,10 +9,18 @@
 
 #define PCL_NO_PRECOMPILE
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 
 #include <beam_utils/nanoflann.hpp>
+#include <beam_utils/parallel.h>
 
 namespace beam {
 /** @addtogroup utils
@@ -57,74 +65,785 @@ struct PointCloud {
   }
 };
 
+/**
+ * @brief nanoflann dataset adaptor which reads point coordinates directly from
+ * an array of points, given the address of the first x coordinate and the
+ * stride (in bytes) between consecutive points. The y and z coordinates must
+ * directly follow x, which is the case for nanoflann::PointCloud<T>::Point and
+ * all pcl point types using PCL_ADD_POINT4D. This lets us index the storage
+ * of a pcl::PointCloud<PointT> without copying it.
+ */
+struct StridedPointCloudAdaptor {
+  using coord_t = float; //!< The type of each coordinate
+
+  /** address of the x coordinate of the first point */
+  const uint8_t* data{nullptr};
+
+  /** number of bytes between consecutive points */
+  size_t stride{0};
+
+  /** number of points */
+  size_t num_points{0};
+
+  // Must return the number of data points
+  inline size_t kdtree_get_point_count() const { return num_points; }
+
+  // Returns the dim'th component of the idx'th point
+  inline float kdtree_get_pt(const size_t idx, const size_t dim) const {
+    return reinterpret_cast<const float*>(data + idx * stride)[dim];
+  }
+
+  // Optional bounding-box computation: return false to default to a standard
+  // bbox computation loop.
+  template <class BBOX>
+  bool kdtree_get_bbox(BBOX& /* bb */) const {
+    return false;
+  }
+};
+
+/**
+ * @brief nanoflann result set which only counts the points within a radius
+ * instead of storing them. The search stops early once max_count points have
+ * been found (if max_count > 0), which is all that is needed to check if a
+ * point has enough neighbors. If a mask is given, only points with a non-zero
+ * mask entry are counted.
+ */
+template <typename DistanceType, typename IndexType = size_t>
+class RadiusCountResultSet {
+public:
+  RadiusCountResultSet(DistanceType radius_, size_t max_count_ = 0,
+                       const uint8_t* mask_ = nullptr)
+      : radius(radius_), max_count(max_count_), mask(mask_) {}
+
+  inline size_t size() const { return count; }
+
+  inline bool full() const { return true; }
+
+  inline bool addPoint(DistanceType dist, IndexType index) {
+    if (dist < radius && (mask == nullptr || mask[index])) { count++; }
+    return max_count == 0 || count < max_count;
+  }
+
+  inline DistanceType worstDist() const { return radius; }
+
+  const DistanceType radius;
+  const size_t max_count;
+  const uint8_t* mask;
+  size_t count{0};
+};
+
 } // namespace nanoflann
 
 const int k_pointcloud_dims{3};
 const int k_max_leaf{10};
 
+/** minimum number of queries given to each thread in batch searches */
+const size_t k_min_queries_per_thread{1000};
+
+/**
+ * @brief converts squared distances returned by nanoflann to distances and
+ * zeros the unused entries of the knn output vectors
+ */
+inline void FinalizeKnnResults(int num_results,
+                               std::vector<uint32_t>& point_ids,
+                               std::vector<float>& point_distances) {
+  for (int i = 0; i < num_results; i++) {
+    point_distances[i] = std::sqrt(point_distances[i]);
+  }
+  std::fill(point_ids.begin() + num_results, point_ids.end(), 0);
+  std::fill(point_distances.begin() + num_results, point_distances.end(), 0);
+}
+
 using KdTreeType = nanoflann::KDTreeSingleIndexAdaptor<
-    nanoflann::L2_Simple_Adaptor<float, nanoflann::PointCloud<float>>,
-    nanoflann::PointCloud<float>, k_pointcloud_dims>;
+    nanoflann::L2_Simple_Adaptor<float, nanoflann::StridedPointCloudAdaptor>,
+    nanoflann::StridedPointCloudAdaptor, k_pointcloud_dims>;
 
+/**
+ * @brief KdTree for pcl point clouds. Depending on how the input cloud is
+ * given, the tree will either:
+ *
+ *  (1) index a copy of the xyz coordinates (default when passing a const
+ *  reference). This is always safe, but costs an extra pass over the cloud and
+ *  12 bytes per point.
+ *
+ *  (2) index the pcl::PointCloud storage directly without copying, when
+ *  passing a shared pointer (the tree keeps the cloud alive) or when passing a
+ *  const reference with copy_cloud = false (the caller must keep the cloud
+ *  alive). In both cases the cloud must not be modified while the tree is in
+ *  use.
+ *
+ * nearestKSearch and radiusSearch resize the output vectors instead of
+ * reallocating them, so reusing the same vectors across queries avoids
+ * allocating on every query. To search for many points at once, use the batch
+ * versions which write all results into flat arrays and split the queries
+ * across threads. Searches are const and do not modify the tree, so they can
+ * also be called from multiple threads directly.
+ */
 template <class PointT>
 class KdTree {
 public:
-  KdTree(const pcl::PointCloud<PointT>& cloud_in) {
-    for (const auto& p : cloud_in) {
-      cloud.pts.push_back(
-          nanoflann::PointCloud<float>::Point{.x = p.x, .y = p.y, .z = p.z});
-    }
-    kdtree = std::make_unique<KdTreeType>(k_pointcloud_dims, cloud, k_max_leaf);
+  /**
+   * @brief constructor
+   * @param cloud_in input cloud
+   * @param copy_cloud set to false to index cloud_in directly. In this case
+   * cloud_in must outlive this tree and must not be modified.
+   */
+  KdTree(const pcl::PointCloud<PointT>& cloud_in, bool copy_cloud = true) {
+    setInputCloud(cloud_in, copy_cloud);
+  }
+
+  /**
+   * @brief constructor which indexes the input cloud without copying it. The
+   * tree shares ownership of the cloud.
+   * @param cloud_in input cloud
+   */
+  KdTree(const std::shared_ptr<const pcl::PointCloud<PointT>>& cloud_in) {
+    setInputCloud(cloud_in);
   }
 
+  /**
+   * @brief search for the k nearest neighbors of point p
+   * @param p query point
+   * @param k number of neighbors
+   * @param point_ids output ids of the neighbors, sorted by distance. Resized
+   * to k, entries past the number of neighbors found are set to 0
+   * @param point_distances output distances (not squared) to the neighbors.
+   * Resized to k, entries past the number of neighbors found are set to 0
+   * @return number of neighbors found
+   */
   int nearestKSearch(const PointT& p, int k, std::vector<uint32_t>& point_ids,
-                     std::vector<float>& point_distances) {
-    point_ids = std::vector<uint32_t>(k);
-    point_distances = std::vector<float>(k);
-    std::vector<float> point_distances_sqr(k);
+                     std::vector<float>& point_distances) const {
+    point_ids.resize(k);
+    point_distances.resize(k);
     const float query_pt[3] = {p.x, p.y, p.z};
     int num_results = kdtree->knnSearch(&query_pt[0], static_cast<size_t>(k),
-                                        &point_ids[0], &point_distances_sqr[0]);
-    for (int i = 0; i < k; i++) {
-      if (point_distances_sqr.at(i) > 0) {
-        point_distances.at(i) = std ::sqrt(point_distances_sqr.at(i));
-      }
-    }
+                                        &point_ids[0], &point_distances[0]);
+    FinalizeKnnResults(num_results, point_ids, point_distances);
     return num_results;
   }
 
+  /**
+   * @brief search for all neighbors of point p within a radius. Note the
+   * radius is compared to the squared distance of each point, as in nanoflann
+   * @param p query point
+   * @param radius search radius
+   * @param point_ids output ids of the neighbors, sorted by distance
+   * @param point_distances output squared distances to the neighbors
+   * @return number of neighbors found
+   */
   size_t radiusSearch(const PointT& p, const float radius,
                       std::vector<uint32_t>& point_ids,
-                      std::vector<float>& point_distances) {
-    point_ids.clear();
-    point_distances.clear();
-    std::vector<std::pair<uint32_t, float>> ret_matches;
+                      std::vector<float>& point_distances) const {
+    // reuse the same matches buffer for all queries on this thread
+    thread_local std::vector<std::pair<uint32_t, float>> ret_matches;
     nanoflann::SearchParams params;
     const float query_pt[3] = {p.x, p.y, p.z};
     size_t n_matches =
         kdtree->radiusSearch(&query_pt[0], radius, ret_matches, params);
+    point_ids.resize(n_matches);
+    point_distances.resize(n_matches);
     for (size_t i = 0; i < n_matches; i++) {
-      point_ids.push_back(ret_matches[i].first);
-      point_ids.push_back(ret_matches[i].second);
+      point_ids[i] = ret_matches[i].first;
+      point_distances[i] = ret_matches[i].second;
     }
     return n_matches;
   }
 
-  void setInputCloud(const pcl::PointCloud<PointT>& point_cloud) {
+  /**
+   * @brief search for the k nearest neighbors of all points in a cloud. The
+   * queries are split across threads.
+   * @param queries query points
+   * @param k number of neighbors
+   * @param point_ids output ids of the neighbors, resized to queries.size() *
+   * k. The neighbors of query i are stored in [i * k, (i + 1) * k), sorted by
+   * distance, with entries past the number of neighbors found set to 0
+   * @param point_distances output distances (not squared) to the neighbors,
+   * with the same layout as point_ids
+   * @param num_threads number of threads. If <= 0, this will use all hardware
+   * threads
+   * @return number of neighbors found for each query, which is min(k, size())
+   */
+  int nearestKSearchBatch(const pcl::PointCloud<PointT>& queries, int k,
+                          std::vector<uint32_t>& point_ids,
+                          std::vector<float>& point_distances,
+                          int num_threads = 0) const {
+    point_ids.resize(queries.size() * k);
+    point_distances.resize(queries.size() * k);
+    int num_results = std::min<int>(k, size());
+    if (queries.empty() || k <= 0) { return num_results; }
+    int n_threads = GetNumThreads(num_threads, queries.size(),
+                                  k_min_queries_per_thread);
+    ParallelForChunks(
+        queries.size(), n_threads, [&](int, size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            const PointT& p = queries[i];
+            const float query_pt[3] = {p.x, p.y, p.z};
+            uint32_t* ids = &point_ids[i * k];
+            float* dists = &point_distances[i * k];
+            kdtree->knnSearch(&query_pt[0], static_cast<size_t>(k), ids,
+                              dists);
+            for (int j = 0; j < num_results; j++) {
+              dists[j] = std::sqrt(dists[j]);
+            }
+            std::fill(ids + num_results, ids + k, 0);
+            std::fill(dists + num_results, dists + k, 0);
+          }
+        });
+    return num_results;
+  }
+
+  /**
+   * @brief search for all neighbors within a radius of all points in a
+   * cloud. The queries are split across threads. As in radiusSearch, the
+   * radius is compared to the squared distance of each point.
+   * @param queries query points
+   * @param radius search radius, used for all queries
+   * @param point_ids output ids of the neighbors of all queries. The
+   * neighbors of query i are stored in [offsets[i], offsets[i + 1]), sorted by
+   * distance
+   * @param point_distances output squared distances to the neighbors, with the
+   * same layout as point_ids
+   * @param offsets output offsets of the results of each query, resized to
+   * queries.size() + 1
+   * @param num_threads number of threads. If <= 0, this will use all hardware
+   * threads
+   * @return total number of neighbors found
+   */
+  size_t radiusSearchBatch(const pcl::PointCloud<PointT>& queries,
+                           float radius, std::vector<uint32_t>& point_ids,
+                           std::vector<float>& point_distances,
+                           std::vector<size_t>& offsets,
+                           int num_threads = 0) const {
+    return RadiusSearchBatch(
+        queries, [radius](size_t) { return radius; }, point_ids,
+        point_distances, offsets, num_threads);
+  }
+
+  /**
+   * @brief same as above but with a different radius for each query
+   * @param radii search radius of each query, must be the same size as
+   * queries
+   */
+  size_t radiusSearchBatch(const pcl::PointCloud<PointT>& queries,
+                           const std::vector<float>& radii,
+                           std::vector<uint32_t>& point_ids,
+                           std::vector<float>& point_distances,
+                           std::vector<size_t>& offsets,
+                           int num_threads = 0) const {
+    CheckRadii(queries, radii);
+    return RadiusSearchBatch(
+        queries, [&radii](size_t i) { return radii[i]; }, point_ids,
+        point_distances, offsets, num_threads);
+  }
+
+  /**
+   * @brief count the neighbors within a radius of all points in a cloud,
+   * without storing them. The queries are split across threads. As in
+   * radiusSearch, the radius is compared to the squared distance of each
+   * point.
+   * @param queries query points
+   * @param radius search radius, used for all queries
+   * @param counts output number of neighbors of each query, resized to
+   * queries.size()
+   * @param max_count if > 0, stop searching once this many neighbors are
+   * found, so counts will be at most max_count. This is much faster when we
+   * only need to know if a point has enough neighbors.
+   * @param num_threads number of threads. If <= 0, this will use all hardware
+   * threads
+   */
+  void radiusCountBatch(const pcl::PointCloud<PointT>& queries, float radius,
+                        std::vector<uint32_t>& counts, size_t max_count = 0,
+                        int num_threads = 0) const {
+    RadiusCountBatch(
+        queries.size(),
+        [&queries](size_t i, float* query_pt) {
+          query_pt[0] = queries[i].x;
+          query_pt[1] = queries[i].y;
+          query_pt[2] = queries[i].z;
+        },
+        [radius](size_t) { return radius; }, nullptr, counts, max_count,
+        num_threads);
+  }
+
+  /**
+   * @brief same as above but with a different radius for each query
+   * @param radii search radius of each query, must be the same size as
+   * queries
+   */
+  void radiusCountBatch(const pcl::PointCloud<PointT>& queries,
+                        const std::vector<float>& radii,
+                        std::vector<uint32_t>& counts, size_t max_count = 0,
+                        int num_threads = 0) const {
+    CheckRadii(queries, radii);
+    RadiusCountBatch(
+        queries.size(),
+        [&queries](size_t i, float* query_pt) {
+          query_pt[0] = queries[i].x;
+          query_pt[1] = queries[i].y;
+          query_pt[2] = queries[i].z;
+        },
+        [&radii](size_t i) { return radii[i]; }, nullptr, counts, max_count,
+        num_threads);
+  }
+
+  /**
+   * @brief count the neighbors within a radius of points in the tree, only
+   * counting the points which are set in a mask. This lets filters which
+   * remove points keep using the tree built on their input, instead of
+   * building a new tree on their output. As in radiusSearch, the radius is
+   * compared to the squared distance of each point.
+   * @param query_ids ids of the points in the tree to use as queries
+   * @param radii search radius of each query, must be the same size as
+   * query_ids
+   * @param point_mask points in the tree with a non-zero entry are counted as
+   * neighbors, must be the same size as the tree
+   * @param counts output number of neighbors of each query, resized to
+   * query_ids.size()
+   * @param max_count if > 0, stop searching once this many neighbors are
+   * found, so counts will be at most max_count
+   * @param num_threads number of threads. If <= 0, this will use all hardware
+   * threads
+   */
+  void radiusCountBatch(const std::vector<uint32_t>& query_ids,
+                        const std::vector<float>& radii,
+                        const std::vector<uint8_t>& point_mask,
+                        std::vector<uint32_t>& counts, size_t max_count = 0,
+                        int num_threads = 0) const {
+    if (radii.size() != query_ids.size()) {
+      throw std::invalid_argument{
+          "number of radii must be equal to the number of queries"};
+    }
+    if (point_mask.size() != size()) {
+      throw std::invalid_argument{
+          "point mask must be the same size as the tree"};
+    }
+    RadiusCountBatch(
+        query_ids.size(),
+        [this, &query_ids](size_t i, float* query_pt) {
+          for (int d = 0; d < k_pointcloud_dims; d++) {
+            query_pt[d] = adaptor_->kdtree_get_pt(query_ids[i], d);
+          }
+        },
+        [&radii](size_t i) { return radii[i]; }, point_mask.data(), counts,
+        max_count, num_threads);
+  }
+
+  /**
+   * @brief set the input cloud and rebuild the tree
+   * @param point_cloud input cloud
+   * @param copy_cloud set to false to index point_cloud directly. In this
+   * case point_cloud must outlive this tree and must not be modified.
+   */
+  void setInputCloud(const pcl::PointCloud<PointT>& point_cloud,
+                     bool copy_cloud = true) {
+    shared_cloud_.reset();
     cloud.pts.clear();
+    if (!copy_cloud) {
+      BuildIndex(point_cloud);
+      return;
+    }
+    cloud.pts.reserve(point_cloud.size());
     for (const auto& p : point_cloud) {
       cloud.pts.push_back(
           nanoflann::PointCloud<float>::Point{.x = p.x, .y = p.y, .z = p.z});
     }
-    kdtree = std::make_unique<KdTreeType>(k_pointcloud_dims, cloud, k_max_leaf);
+    BuildIndex(cloud);
+  }
+
+  /**
+   * @brief set the input cloud and rebuild the tree without copying the cloud
+   * @param point_cloud input cloud, the tree shares ownership
+   */
+  void setInputCloud(
+      const std::shared_ptr<const pcl::PointCloud<PointT>>& point_cloud) {
+    cloud.pts.clear();
+    shared_cloud_ = point_cloud;
+    BuildIndex(*shared_cloud_);
   }
 
   void clear() {
+    shared_cloud_.reset();
     cloud.pts.clear();
-    kdtree = std::make_unique<KdTreeType>(k_pointcloud_dims, cloud, k_max_leaf);
+    BuildIndex(cloud);
   }
+
+  /**
+   * @brief get the number of points in the tree
+   */
+  size_t size() const { return adaptor_->num_points; }
+
+  /** copy of the input points, empty if indexing the input cloud directly */
   nanoflann::PointCloud<float> cloud;
   std::unique_ptr<KdTreeType> kdtree;
+
+private:
+  void CheckRadii(const pcl::PointCloud<PointT>& queries,
+                  const std::vector<float>& radii) const {
+    if (radii.size() != queries.size()) {
+      throw std::invalid_argument{
+          "number of radii must be equal to the number of queries"};
+    }
+  }
+
+  template <typename RadiusFunc>
+  size_t RadiusSearchBatch(const pcl::PointCloud<PointT>& queries,
+                           RadiusFunc get_radius,
+                           std::vector<uint32_t>& point_ids,
+                           std::vector<float>& point_distances,
+                           std::vector<size_t>& offsets,
+                           int num_threads) const {
+    offsets.assign(queries.size() + 1, 0);
+    point_ids.clear();
+    point_distances.clear();
+    if (queries.empty()) { return 0; }
+    int n_threads = GetNumThreads(num_threads, queries.size(),
+                                  k_min_queries_per_thread);
+
+    // each thread stores its matches in its own buffer, which are then copied
+    // into the outputs in order. With one thread, the outputs are used
+    // directly.
+    std::vector<std::vector<std::pair<uint32_t, float>>> thread_matches(
+        n_threads > 1 ? n_threads : 0);
+    ParallelForChunks(
+        queries.size(), n_threads, [&](int thread_id, size_t begin,
+                                       size_t end) {
+          thread_local std::vector<std::pair<uint32_t, float>> ret_matches;
+          nanoflann::SearchParams params;
+          for (size_t i = begin; i < end; i++) {
+            const PointT& p = queries[i];
+            const float query_pt[3] = {p.x, p.y, p.z};
+            size_t n_matches = kdtree->radiusSearch(
+                &query_pt[0], get_radius(i), ret_matches, params);
+            offsets[i + 1] = n_matches;
+            if (n_threads > 1) {
+              thread_matches[thread_id].insert(
+                  thread_matches[thread_id].end(), ret_matches.begin(),
+                  ret_matches.end());
+              continue;
+            }
+            for (const auto& [id, dist] : ret_matches) {
+              point_ids.push_back(id);
+              point_distances.push_back(dist);
+            }
+          }
+        });
+
+    for (size_t i = 0; i < queries.size(); i++) {
+      offsets[i + 1] += offsets[i];
+    }
+    if (n_threads > 1) {
+      point_ids.resize(offsets.back());
+      point_distances.resize(offsets.back());
+      size_t n = 0;
+      for (const auto& matches : thread_matches) {
+        for (const auto& [id, dist] : matches) {
+          point_ids[n] = id;
+          point_distances[n] = dist;
+          n++;
+        }
+      }
+    }
+    return offsets.back();
+  }
+
+  template <typename QueryFunc, typename RadiusFunc>
+  void RadiusCountBatch(size_t num_queries, QueryFunc get_query,
+                        RadiusFunc get_radius, const uint8_t* point_mask,
+                        std::vector<uint32_t>& counts, size_t max_count,
+                        int num_threads) const {
+    counts.resize(num_queries);
+    int n_threads =
+        GetNumThreads(num_threads, num_queries, k_min_queries_per_thread);
+    ParallelForChunks(
+        num_queries, n_threads, [&](int, size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            float query_pt[3];
+            get_query(i, &query_pt[0]);
+            nanoflann::RadiusCountResultSet<float, uint32_t> result(
+                get_radius(i), max_count, point_mask);
+            kdtree->findNeighbors(result, &query_pt[0],
+                                  nanoflann::SearchParams());
+            counts[i] = result.size();
+          }
+        });
+  }
+
+  void BuildIndex(const nanoflann::PointCloud<float>& input) {
+    BuildIndex(input.pts.empty() ? nullptr : &input.pts[0].x,
+               sizeof(nanoflann::PointCloud<float>::Point), input.pts.size());
+  }
+
+  void BuildIndex(const pcl::PointCloud<PointT>& input) {
+    BuildIndex(input.empty() ? nullptr : &input.points[0].x, sizeof(PointT),
+               input.size());
+  }
+
+  void BuildIndex(const float* x, size_t stride, size_t num_points) {
+    // the adaptor is stored on the heap since the index keeps a reference to
+    // it, which would otherwise be invalidated if this tree is moved
+    adaptor_ = std::make_unique<nanoflann::StridedPointCloudAdaptor>();
+    adaptor_->data = reinterpret_cast<const uint8_t*>(x);
+    adaptor_->stride = stride;
+    adaptor_->num_points = num_points;
+    kdtree = std::make_unique<KdTreeType>(k_pointcloud_dims, *adaptor_,
+                                          k_max_leaf);
+  }
+
+  std::shared_ptr<const pcl::PointCloud<PointT>> shared_cloud_;
+  std::unique_ptr<nanoflann::StridedPointCloudAdaptor> adaptor_;
+};
+
+using DynamicKdTreeType = nanoflann::KDTreeSingleIndexDynamicAdaptor<
+    nanoflann::L2_Simple_Adaptor<float, nanoflann::StridedPointCloudAdaptor>,
+    nanoflann::StridedPointCloudAdaptor, k_pointcloud_dims>;
+
+/**
+ * @brief KdTree that supports adding and removing points without rebuilding
+ * the whole tree. This wraps nanoflann's dynamic index which stores points in
+ * a forest of static trees of size 2^i (the logarithmic method), so adding
+ * points only rebuilds the small trees that get merged, giving amortized
+ * O(log^2 N) insertion.
+ *
+ * Removed points are skipped by all searches right away, and are deleted from
+ * memory once they make up more than a set fraction of the stored points (see
+ * SetMaxRemovedFraction). The remaining points are then copied and the tree is
+ * rebuilt, which is amortized over the removals, so memory stays proportional
+ * to the number of points in the tree when points are continuously added and
+ * removed (e.g. for a sliding window map).
+ *
+ * Point ids are assigned consecutively in insertion order starting at 0, are
+ * never reused, and do not change when removed points are deleted. The full
+ * point for an id can be retrieved with at(). The search interface is the same
+ * as KdTree. Searches are const and can be called from multiple threads, but
+ * not while points are added or removed.
+ */
+template <class PointT>
+class DynamicKdTree {
+public:
+  /**
+   * @brief constructor for an empty tree
+   */
+  DynamicKdTree() { clear(); }
+
+  /**
+   * @brief constructor that adds all points in cloud_in
+   */
+  explicit DynamicKdTree(const pcl::PointCloud<PointT>& cloud_in) {
+    clear();
+    AddPoints(cloud_in);
+  }
+
+  /**
+   * @brief add points to the tree
+   * @param points new points
+   * @return id of the first point added. The i-th point gets id: first id + i
+   */
+  uint32_t AddPoints(const pcl::PointCloud<PointT>& points) {
+    uint32_t first_id = next_id_;
+    if (points.empty()) { return first_id; }
+    size_t first_index = points_->size();
+    points_->reserve(first_index + points.size());
+    for (const auto& p : points) {
+      points_->push_back(p);
+      ids_.push_back(next_id_++);
+    }
+    removed_.resize(points_->size(), false);
+
+    // the points may have been reallocated
+    adaptor_->data = reinterpret_cast<const uint8_t*>(&points_->points[0].x);
+    adaptor_->num_points = points_->size();
+    kdtree_->addPoints(first_index, points_->size() - 1);
+    return first_id;
+  }
+
+  /**
+   * @brief remove a point from the tree. Invalid or already removed ids are
+   * ignored.
+   * @param id id returned when adding the point
+   */
+  void RemovePoint(uint32_t id) {
+    RemoveIndex(GetIndex(id));
+    CompactIfNeeded();
+  }
+
+  /**
+   * @brief remove a set of points from the tree
+   * @param ids ids returned when adding the points
+   */
+  void RemovePoints(const std::vector<uint32_t>& ids) {
+    for (uint32_t id : ids) { RemoveIndex(GetIndex(id)); }
+    CompactIfNeeded();
+  }
+
+  /**
+   * @brief set the fraction of stored points which can be removed points
+   * before they are deleted from memory. Lower values use less memory but
+   * rebuild the tree more often. Default is 0.5
+   */
+  void SetMaxRemovedFraction(double max_removed_fraction) {
+    max_removed_fraction_ = max_removed_fraction;
+    CompactIfNeeded();
+  }
+
+  /**
+   * @brief get the number of points that can be returned by a search
+   */
+  size_t size() const { return points_->size() - num_removed_points_; }
+
+  /**
+   * @brief get the number of points stored in memory, including removed points
+   * that have not been deleted yet
+   */
+  size_t stored_size() const { return points_->size(); }
+
+  /**
+   * @brief get a point in the tree
+   * @param id id returned when adding the point
+   * @throws std::out_of_range if the id is invalid or the point was removed
+   */
+  const PointT& at(uint32_t id) const {
+    size_t index = GetIndex(id);
+    if (index == k_invalid_index || removed_[index]) {
+      throw std::out_of_range{"invalid DynamicKdTree point id"};
+    }
+    return points_->points[index];
+  }
+
+  /**
+   * @brief see KdTree::nearestKSearch
+   */
+  int nearestKSearch(const PointT& p, int k, std::vector<uint32_t>& point_ids,
+                     std::vector<float>& point_distances) const {
+    point_ids.resize(k);
+    point_distances.resize(k);
+    const float query_pt[3] = {p.x, p.y, p.z};
+    nanoflann::KNNResultSet<float, uint32_t> result_set(k);
+    result_set.init(&point_ids[0], &point_distances[0]);
+    kdtree_->findNeighbors(result_set, &query_pt[0],
+                           nanoflann::SearchParams());
+    int num_results = result_set.size();
+    for (int i = 0; i < num_results; i++) { point_ids[i] = ids_[point_ids[i]]; }
+    FinalizeKnnResults(num_results, point_ids, point_distances);
+    return num_results;
+  }
+
+  /**
+   * @brief see KdTree::radiusSearch
+   */
+  size_t radiusSearch(const PointT& p, const float radius,
+                      std::vector<uint32_t>& point_ids,
+                      std::vector<float>& point_distances) const {
+    thread_local std::vector<std::pair<uint32_t, float>> ret_matches;
+    nanoflann::RadiusResultSet<float, uint32_t> result_set(radius, ret_matches);
+    const float query_pt[3] = {p.x, p.y, p.z};
+    kdtree_->findNeighbors(result_set, &query_pt[0],
+                           nanoflann::SearchParams());
+    std::sort(ret_matches.begin(), ret_matches.end(),
+              nanoflann::IndexDist_Sorter());
+    size_t n_matches = ret_matches.size();
+    point_ids.resize(n_matches);
+    point_distances.resize(n_matches);
+    for (size_t i = 0; i < n_matches; i++) {
+      point_ids[i] = ids_[ret_matches[i].first];
+      point_distances[i] = ret_matches[i].second;
+    }
+    return n_matches;
+  }
+
+  /**
+   * @brief remove all points (including removed points) from the tree. Ids
+   * start at 0 again.
+   */
+  void clear() {
+    points_ = std::make_unique<pcl::PointCloud<PointT>>();
+    ids_.clear();
+    removed_.clear();
+    num_removed_points_ = 0;
+    next_id_ = 0;
+    BuildIndex();
+  }
+
+private:
+  static constexpr size_t k_invalid_index{std::numeric_limits<size_t>::max()};
+
+  /** Don't delete removed points until at least this many are stored, so
+   * small trees are not rebuilt on every removal */
+  static constexpr size_t k_min_removed_to_compact{64};
+
+  /**
+   * @brief get the index of a point in points_, or k_invalid_index if the id
+   * is not stored. Ids are sorted since points are only ever appended, and
+   * compacting keeps their order.
+   */
+  size_t GetIndex(uint32_t id) const {
+    auto iter = std::lower_bound(ids_.begin(), ids_.end(), id);
+    if (iter == ids_.end() || *iter != id) { return k_invalid_index; }
+    return iter - ids_.begin();
+  }
+
+  void RemoveIndex(size_t index) {
+    if (index == k_invalid_index || removed_[index]) { return; }
+    kdtree_->removePoint(index);
+    removed_[index] = true;
+    num_removed_points_++;
+  }
+
+  /**
+   * @brief delete removed points from memory and rebuild the tree if there
+   * are too many of them
+   */
+  void CompactIfNeeded() {
+    if (num_removed_points_ < k_min_removed_to_compact ||
+        num_removed_points_ <= max_removed_fraction_ * points_->size()) {
+      return;
+    }
+    auto points_new = std::make_unique<pcl::PointCloud<PointT>>();
+    std::vector<uint32_t> ids_new;
+    points_new->reserve(size());
+    ids_new.reserve(size());
+    for (size_t i = 0; i < points_->size(); i++) {
+      if (removed_[i]) { continue; }
+      points_new->push_back(points_->points[i]);
+      ids_new.push_back(ids_[i]);
+    }
+    points_ = std::move(points_new);
+    ids_ = std::move(ids_new);
+    removed_.assign(points_->size(), false);
+    num_removed_points_ = 0;
+    BuildIndex();
+  }
+
+  /**
+   * @brief build the index over all points in points_. The adaptor is stored
+   * on the heap since the index keeps a reference to it
+   */
+  void BuildIndex() {
+    adaptor_ = std::make_unique<nanoflann::StridedPointCloudAdaptor>();
+    adaptor_->data = points_->empty()
+                         ? nullptr
+                         : reinterpret_cast<const uint8_t*>(
+                               &points_->points[0].x);
+    adaptor_->stride = sizeof(PointT);
+    adaptor_->num_points = points_->size();
+    kdtree_ = std::make_unique<DynamicKdTreeType>(
+        k_pointcloud_dims, *adaptor_,
+        nanoflann::KDTreeSingleIndexAdaptorParams(k_max_leaf));
+  }
+
+  /** all stored points including removed points, in insertion order */
+  std::unique_ptr<pcl::PointCloud<PointT>> points_;
+
+  /** id of each stored point, sorted */
+  std::vector<uint32_t> ids_;
+
+  /** true for stored points which were removed */
+  std::vector<bool> removed_;
+
+  std::unique_ptr<nanoflann::StridedPointCloudAdaptor> adaptor_;
+  std::unique_ptr<DynamicKdTreeType> kdtree_;
+  size_t num_removed_points_{0};
+  uint32_t next_id_{0};
+  double max_removed_fraction_{0.5};
 };
 
 /** @} group utils */
@@ -0,0 +1,80 @@
+/** @file
+ * @ingroup utils
+ *
+ * Small helpers for splitting loops over independent items across threads.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace beam {
+/** @addtogroup utils
+ *  @{ */
+
+/**
+ * @brief Get the number of threads to use for a parallel loop
+ * @param requested_threads number of threads requested by the user. If <= 0,
+ * this will default to std::thread::hardware_concurrency()
+ * @param num_items number of items to be processed
+ * @param min_items_per_thread minimum number of items each thread should get,
+ * so that we don't spawn threads for trivial amounts of work
+ * @return number of threads in [1, requested_threads]
+ */
+inline int GetNumThreads(int requested_threads, size_t num_items,
+                         size_t min_items_per_thread = 1) {
+  int n_threads = requested_threads;
+  if (n_threads <= 0) {
+    n_threads = std::max<int>(1, std::thread::hardware_concurrency());
+  }
+  min_items_per_thread = std::max<size_t>(1, min_items_per_thread);
+  size_t max_threads = num_items / min_items_per_thread;
+  if (max_threads < static_cast<size_t>(n_threads)) {
+    n_threads = static_cast<int>(std::max<size_t>(1, max_threads));
+  }
+  return n_threads;
+}
+
+/**
+ * @brief Splits the range [0, num_items) into n_threads contiguous chunks of
+ * (almost) equal size and calls func(thread_id, begin, end) on each chunk in
+ * its own thread. Chunk i always covers the same range for a given num_items
+ * and n_threads, so per-thread outputs that are concatenated in thread_id
+ * order will be in the same order as a serial loop. If n_threads <= 1, func is
+ * called once on the calling thread.
+ * @param num_items number of items to process
+ * @param n_threads number of threads (see GetNumThreads)
+ * @param func callable with signature void(int, size_t, size_t)
+ */
+template <typename Func>
+void ParallelForChunks(size_t num_items, int n_threads, Func&& func) {
+  if (num_items == 0) { return; }
+  if (n_threads <= 1) {
+    func(0, 0, num_items);
+    return;
+  }
+
+  size_t chunk_size = num_items / n_threads;
+  size_t remainder = num_items % n_threads;
+  std::vector<std::thread> threads;
+  threads.reserve(n_threads - 1);
+  size_t begin = 0;
+  size_t first_end = 0;
+  for (int i = 0; i < n_threads; i++) {
+    size_t end = begin + chunk_size + (static_cast<size_t>(i) < remainder);
+    if (i == 0) {
+      // run the first chunk on the calling thread after launching the others
+      first_end = end;
+    } else {
+      threads.emplace_back([&func, i, begin, end]() { func(i, begin, end); });
+    }
+    begin = end;
+  }
+  func(0, 0, first_end);
+  for (auto& t : threads) { t.join(); }
+}
+
+/** @} group utils */
+} // namespace beam
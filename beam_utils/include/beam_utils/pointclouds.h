@@ -643,10 +643,10 @@ void ExtractEuclideanClusters(const pcl::PointCloud<PointT>& cloud,
                               std::vector<pcl::PointIndices>& clusters,
                               int min_pts_per_cluster,
                               int max_pts_per_cluster) {
-  if (tree->cloud.pts.size() != cloud.size()) {
+  if (tree->size() != cloud.size()) {
     BEAM_ERROR("{}: Tree built for a different point cloud "
                "dataset ({}) than the input cloud ({})!",
-               __func__, tree->cloud.pts.size(), cloud.size());
+               __func__, tree->size(), cloud.size());
     return;
   }
   // Create a bool vector of processed point indices, and initialize it to false
@@ -719,16 +719,16 @@ float PointCloudError(const pcl::PointCloud<PointT>& cloud_source,
 
   float rmse = 0.0f;
 
-  beam::KdTree<pcl::PointXYZ> tree(*xyz_target);
+  beam::KdTree<pcl::PointXYZ> tree(xyz_target);
 
+  std::vector<uint32_t> nn_indices(1);
+  std::vector<float> nn_distances(1);
   for (std::size_t point_i = 0; point_i < xyz_source->size(); ++point_i) {
     const auto source_point = xyz_source->points[point_i];
     if (!std::isfinite(source_point.x) || !std::isfinite(source_point.y) ||
         !std::isfinite(source_point.z))
       continue;
 
-    std::vector<uint32_t> nn_indices(1);
-    std::vector<float> nn_distances(1);
     if (!tree.nearestKSearch(source_point, 1, nn_indices, nn_distances))
       continue;
 
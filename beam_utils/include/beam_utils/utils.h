@@ -17,6 +17,7 @@
 #include <beam_utils/math.h>
 #include <beam_utils/nanoflann.hpp>
 #include <beam_utils/optional.h>
+#include <beam_utils/parallel.h>
 #include <beam_utils/pcl_conversions.h>
 #include <beam_utils/pointclouds.h>
 #include <beam_utils/polynomial.h>
@@ -0,0 +1,203 @@
+#include "beam_utils/kdtree.h"
+
+#include <catch2/catch.hpp>
+
+#include "beam_utils/math.h"
+
+namespace {
+
+pcl::PointCloud<pcl::PointXYZ> RandomCloud(size_t num_points) {
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (size_t i = 0; i < num_points; i++) {
+    cloud.push_back(pcl::PointXYZ(beam::randf(10, -10), beam::randf(10, -10),
+                                  beam::randf(10, -10)));
+  }
+  return cloud;
+}
+
+} // namespace
+
+TEST_CASE("DynamicKdTree matches static KdTree", "[KdTree.h]") {
+  pcl::PointCloud<pcl::PointXYZ> cloud1 = RandomCloud(500);
+  pcl::PointCloud<pcl::PointXYZ> cloud2 = RandomCloud(700);
+  pcl::PointCloud<pcl::PointXYZ> cloud_all = cloud1;
+  for (const auto& p : cloud2) { cloud_all.push_back(p); }
+
+  beam::KdTree<pcl::PointXYZ> tree(cloud_all);
+  beam::DynamicKdTree<pcl::PointXYZ> dynamic_tree(cloud1);
+  REQUIRE(dynamic_tree.AddPoints(cloud2) == cloud1.size());
+  REQUIRE(dynamic_tree.size() == cloud_all.size());
+
+  pcl::PointCloud<pcl::PointXYZ> queries = RandomCloud(50);
+  for (const auto& q : queries) {
+    std::vector<uint32_t> ids, ids_dynamic;
+    std::vector<float> dists, dists_dynamic;
+    int n = tree.nearestKSearch(q, 5, ids, dists);
+    int n_dynamic = dynamic_tree.nearestKSearch(q, 5, ids_dynamic,
+                                                dists_dynamic);
+    REQUIRE(n == n_dynamic);
+    REQUIRE(ids == ids_dynamic);
+    for (int i = 0; i < n; i++) {
+      REQUIRE(dists[i] == Approx(dists_dynamic[i]));
+    }
+    size_t n_radius = tree.radiusSearch(q, 4, ids, dists);
+    size_t n_radius_dynamic =
+        dynamic_tree.radiusSearch(q, 4, ids_dynamic, dists_dynamic);
+    REQUIRE(n_radius == n_radius_dynamic);
+  }
+}
+
+TEST_CASE("DynamicKdTree remove points", "[KdTree.h]") {
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (int i = 0; i < 10; i++) { cloud.push_back(pcl::PointXYZ(i, 0, 0)); }
+
+  beam::DynamicKdTree<pcl::PointXYZ> tree(cloud);
+  std::vector<uint32_t> ids;
+  std::vector<float> dists;
+  REQUIRE(tree.nearestKSearch(pcl::PointXYZ(0.1, 0, 0), 1, ids, dists) == 1);
+  REQUIRE(ids[0] == 0);
+
+  tree.RemovePoints({0, 1});
+  tree.RemovePoint(0);
+  REQUIRE(tree.size() == 8);
+  REQUIRE(tree.nearestKSearch(pcl::PointXYZ(0.1, 0, 0), 1, ids, dists) == 1);
+  REQUIRE(ids[0] == 2);
+
+  tree.clear();
+  REQUIRE(tree.size() == 0);
+  REQUIRE(tree.nearestKSearch(pcl::PointXYZ(0.1, 0, 0), 1, ids, dists) == 0);
+}
+
+TEST_CASE("DynamicKdTree sliding window", "[KdTree.h]") {
+  beam::DynamicKdTree<pcl::PointXYZ> tree;
+  std::vector<std::pair<uint32_t, pcl::PointCloud<pcl::PointXYZ>>> window;
+  size_t batch_size = 200;
+  size_t window_size = 5;
+  for (int cycle = 0; cycle < 50; cycle++) {
+    pcl::PointCloud<pcl::PointXYZ> batch = RandomCloud(batch_size);
+    window.emplace_back(tree.AddPoints(batch), batch);
+    if (window.size() > window_size) {
+      std::vector<uint32_t> ids;
+      for (size_t i = 0; i < batch_size; i++) {
+        ids.push_back(window.front().first + i);
+      }
+      tree.RemovePoints(ids);
+      REQUIRE_THROWS(tree.at(ids.front()));
+      window.erase(window.begin());
+    }
+
+    // removed points must be deleted from memory
+    REQUIRE(tree.size() == window.size() * batch_size);
+    REQUIRE(tree.stored_size() <= 2 * tree.size());
+
+    // ids stay valid after removed points are deleted, and searches match a
+    // brute force search over the points in the window
+    REQUIRE(tree.at(window.front().first + 1).x ==
+            window.front().second[1].x);
+    pcl::PointXYZ q = RandomCloud(1)[0];
+    std::vector<uint32_t> ids;
+    std::vector<float> dists;
+    REQUIRE(tree.nearestKSearch(q, 1, ids, dists) == 1);
+    float d_min = std::numeric_limits<float>::max();
+    uint32_t id_min = 0;
+    for (const auto& [first_id, points] : window) {
+      for (size_t i = 0; i < points.size(); i++) {
+        const auto& p = points[i];
+        float d = std::sqrt((p.x - q.x) * (p.x - q.x) +
+                            (p.y - q.y) * (p.y - q.y) +
+                            (p.z - q.z) * (p.z - q.z));
+        if (d < d_min) {
+          d_min = d;
+          id_min = first_id + i;
+        }
+      }
+    }
+    REQUIRE(ids[0] == id_min);
+    REQUIRE(dists[0] == Approx(d_min));
+  }
+}
+
+TEST_CASE("KdTree without copying cloud", "[KdTree.h]") {
+  pcl::PointCloud<pcl::PointXYZ> cloud = RandomCloud(1000);
+  auto cloud_ptr = std::make_shared<const pcl::PointCloud<pcl::PointXYZ>>(
+      RandomCloud(1000));
+
+  beam::KdTree<pcl::PointXYZ> tree(cloud);
+  beam::KdTree<pcl::PointXYZ> tree_no_copy(cloud, false);
+  beam::KdTree<pcl::PointXYZ> tree_shared(cloud_ptr);
+  beam::KdTree<pcl::PointXYZ> tree_shared_copy(*cloud_ptr);
+  REQUIRE(tree_no_copy.size() == cloud.size());
+  REQUIRE(tree_shared.size() == cloud_ptr->size());
+
+  std::vector<uint32_t> ids, ids_no_copy;
+  std::vector<float> dists, dists_no_copy;
+  pcl::PointCloud<pcl::PointXYZ> queries = RandomCloud(50);
+  for (const auto& q : queries) {
+    REQUIRE(tree.nearestKSearch(q, 5, ids, dists) ==
+            tree_no_copy.nearestKSearch(q, 5, ids_no_copy, dists_no_copy));
+    REQUIRE(ids == ids_no_copy);
+    REQUIRE(dists == dists_no_copy);
+
+    REQUIRE(tree_shared_copy.radiusSearch(q, 4, ids, dists) ==
+            tree_shared.radiusSearch(q, 4, ids_no_copy, dists_no_copy));
+    REQUIRE(ids == ids_no_copy);
+    for (size_t i = 0; i < ids.size(); i++) {
+      const auto& p = cloud_ptr->at(ids[i]);
+      float d_sq = (p.x - q.x) * (p.x - q.x) + (p.y - q.y) * (p.y - q.y) +
+                   (p.z - q.z) * (p.z - q.z);
+      REQUIRE(dists_no_copy[i] == Approx(d_sq));
+      REQUIRE(d_sq <= 4);
+    }
+  }
+
+  // asking for more neighbors than points in the tree
+  pcl::PointCloud<pcl::PointXYZ> small_cloud = RandomCloud(3);
+  beam::KdTree<pcl::PointXYZ> small_tree(small_cloud, false);
+  REQUIRE(small_tree.nearestKSearch(queries[0], 5, ids, dists) == 3);
+  REQUIRE(ids.size() == 5);
+  REQUIRE(dists[4] == 0);
+}
+
+TEST_CASE("KdTree batch searches match single searches", "[KdTree.h]") {
+  pcl::PointCloud<pcl::PointXYZ> cloud = RandomCloud(3000);
+  pcl::PointCloud<pcl::PointXYZ> queries = RandomCloud(2500);
+  beam::KdTree<pcl::PointXYZ> tree(cloud);
+
+  std::vector<float> radii;
+  for (size_t i = 0; i < queries.size(); i++) { radii.push_back(i % 5); }
+
+  for (int num_threads : {1, 4}) {
+    std::vector<uint32_t> knn_ids, radius_ids, counts, counts_capped;
+    std::vector<float> knn_dists, radius_dists;
+    std::vector<size_t> offsets;
+    REQUIRE(tree.nearestKSearchBatch(queries, 5, knn_ids, knn_dists,
+                                     num_threads) == 5);
+    size_t total = tree.radiusSearchBatch(queries, radii, radius_ids,
+                                          radius_dists, offsets, num_threads);
+    REQUIRE(knn_ids.size() == queries.size() * 5);
+    REQUIRE(offsets.size() == queries.size() + 1);
+    REQUIRE(total == offsets.back());
+    REQUIRE(radius_ids.size() == total);
+    tree.radiusCountBatch(queries, radii, counts, 0, num_threads);
+    tree.radiusCountBatch(queries, radii, counts_capped, 3, num_threads);
+
+    std::vector<uint32_t> ids;
+    std::vector<float> dists;
+    for (size_t i = 0; i < queries.size(); i++) {
+      tree.nearestKSearch(queries[i], 5, ids, dists);
+      for (int j = 0; j < 5; j++) {
+        REQUIRE(knn_ids[i * 5 + j] == ids[j]);
+        REQUIRE(knn_dists[i * 5 + j] == dists[j]);
+      }
+
+      size_t n = tree.radiusSearch(queries[i], radii[i], ids, dists);
+      REQUIRE(offsets[i + 1] - offsets[i] == n);
+      REQUIRE(counts[i] == n);
+      REQUIRE(counts_capped[i] == std::min<size_t>(n, 3));
+      for (size_t j = 0; j < n; j++) {
+        REQUIRE(radius_ids[offsets[i] + j] == ids[j]);
+        REQUIRE(radius_dists[offsets[i] + j] == dists[j]);
+      }
+    }
+  }
+}
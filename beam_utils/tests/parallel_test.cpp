@@ -0,0 +1,42 @@
+#include "beam_utils/parallel.h"
+
+#include <catch2/catch.hpp>
+#include <numeric>
+
+TEST_CASE("GetNumThreads", "[Parallel.h]") {
+  REQUIRE(beam::GetNumThreads(4, 100) == 4);
+  REQUIRE(beam::GetNumThreads(4, 2) == 2);
+  REQUIRE(beam::GetNumThreads(4, 0) == 1);
+  REQUIRE(beam::GetNumThreads(8, 100, 50) == 2);
+  REQUIRE(beam::GetNumThreads(0, 1000) >= 1);
+}
+
+TEST_CASE("ParallelForChunks", "[Parallel.h]") {
+  size_t num_items = 1003;
+  int n_threads = 4;
+  std::vector<std::vector<size_t>> outputs(n_threads);
+  beam::ParallelForChunks(num_items, n_threads,
+                          [&](int thread_id, size_t begin, size_t end) {
+                            for (size_t i = begin; i < end; i++) {
+                              outputs[thread_id].push_back(i);
+                            }
+                          });
+
+  // merging in thread order should give the same order as a serial loop
+  std::vector<size_t> merged;
+  for (const auto& o : outputs) {
+    merged.insert(merged.end(), o.begin(), o.end());
+  }
+  std::vector<size_t> expected(num_items);
+  std::iota(expected.begin(), expected.end(), 0);
+  REQUIRE(merged == expected);
+
+  // single thread runs everything in one chunk
+  int calls = 0;
+  beam::ParallelForChunks(num_items, 1, [&](int, size_t begin, size_t end) {
+    calls++;
+    REQUIRE(begin == 0);
+    REQUIRE(end == num_items);
+  });
+  REQUIRE(calls == 1);
+}